@@ -115,8 +115,10 @@
 #include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <poll.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <syslog.h>
 #include <stdarg.h>
 
@@ -166,7 +168,9 @@ char *program_name;
 
 #define	MAX_ABORTS		50
 #define	MAX_REPORTS		50
+#define	MAX_DEVICES		64
 #define	DEFAULT_CHAT_TIMEOUT	45
+#define	DEFAULT_CHAR_DELAY	10	/* milliseconds */
 
 int echo          = 0;
 int verbose       = 0;
@@ -182,7 +186,10 @@ char *report_file = (char *) 0;
 char *chat_file   = (char *) 0;
 char *phone_num   = (char *) 0;
 char *phone_num2  = (char *) 0;
-int timeout       = DEFAULT_CHAT_TIMEOUT;
+int timeout       = DEFAULT_CHAT_TIMEOUT * 1000;	/* milliseconds */
+int char_delay    = DEFAULT_CHAR_DELAY;
+char *devices[MAX_DEVICES];
+int n_devices     = 0;
 
 int have_tty_parameters = 0;
 
@@ -233,7 +240,15 @@ int  get_string (register char *string);
 int  put_string (register char *s);
 int  write_char (int c);
 int  put_char (int c);
+int  flush_output (void);
+void write_failed (void);
 int  get_char (void);
+int  parse_timeout (char *s);
+void set_deadline (int ms);
+int  time_left (void);
+int  wait_fd (int fd, int events);
+void chat_sleep (int ms);
+void run_multi (void);
 int  chat_send (register char *s);
 char *character (int c);
 void chat_expect (register char *s);
@@ -323,11 +338,26 @@ main(int argc, char **argv)
 
 	case 't':
 	    if ((arg = OPTARG(argc, argv)) != NULL)
-		timeout = atoi(arg);
+		timeout = parse_timeout(arg);
 	    else
 		usage();
 	    break;
 
+	case 'i':
+	    if ((arg = OPTARG(argc, argv)) != NULL)
+		char_delay = atoi(arg) < 0 ? 0 : atoi(arg);
+	    else
+		usage();
+	    break;
+
+	case 'm':
+	    if ((arg = OPTARG(argc, argv)) == NULL)
+		usage();
+	    if (n_devices >= MAX_DEVICES)
+		fatal(2, "Too many devices");
+	    devices[n_devices++] = copy_of(arg);
+	    break;
+
 	case 'r':
 	    arg = OPTARG (argc, argv);
 	    if (arg) {
@@ -378,6 +408,9 @@ main(int argc, char **argv)
 	    setlogmask(LOG_UPTO(LOG_WARNING));
     }
 
+    if (n_devices > 0)
+	run_multi();
+
     init();
     
     if (chat_file != NULL) {
@@ -477,8 +510,9 @@ void do_file (char *chat_file)
 void usage(void)
 {
     fprintf(stderr, "\
-Usage: %s [-e] [-E] [-v] [-V] [-t timeout] [-r report-file]\n\
-     [-T phone-number] [-U phone-number2] {-f chat-file | chat-script}\n", program_name);
+Usage: %s [-e] [-E] [-v] [-V] [-t timeout] [-i delay] [-r report-file]\n\
+     [-T phone-number] [-U phone-number2] [-m device ...]\n\
+     {-f chat-file | chat-script}\n", program_name);
     exit(1);
 }
 
@@ -520,17 +554,7 @@ void fatal(int code, const char *fmt, ...)
     terminate(code);
 }
 
-int alarmed = 0;
-int alarmsig = 0;
-
-SIGTYPE sigalrm(int signo)
-{
-    int flags;
-
-    alarm(1);
-    alarmed = 1;
-    alarmsig = 1;
-}
+int alarmed = 0;		/* the current send or expect timed out */
 
 const char *fatalsig = NULL;
 
@@ -551,21 +575,13 @@ SIGTYPE sighup(int signo)
 
 void checksigs(void)
 {
-    int err;
     const char *signame;
 
     if (fatalsig) {
 	signame = fatalsig;
 	fatalsig = NULL;
-	alarmsig = 0;
 	fatal(2, signame);
     }
-    if (alarmsig && verbose) {
-	err = errno;
-	msgf("alarm");
-	errno = err;
-	alarmsig = 0;
-    }
 }
 
 void init(void)
@@ -581,9 +597,6 @@ void init(void)
     sigaction(SIGHUP, &sa, NULL);
 
     set_tty_parameters();
-    sa.sa_handler = sigalrm;
-    sigaction(SIGALRM, &sa, NULL);
-    alarm(0);
     alarmed = 0;
 }
 
@@ -634,9 +647,8 @@ void terminate(int status)
 
 	rep_len = strlen(report_buffer);
 	while (rep_len + 1 < sizeof(report_buffer)) {
-	    alarm(1);
+	    set_deadline(1000);
 	    c = get_char();
-	    alarm(0);
 	    if (c < 0 || iscntrl(c))
 		break;
 	    report_buffer[rep_len] = c;
@@ -1150,13 +1162,16 @@ int chat_send (register char *s)
     if (timeout_next) {
 	timeout_next = 0;
 	s = clean(s, 0);
-	timeout = atoi(s);
-	
-	if (timeout <= 0)
-	    timeout = DEFAULT_CHAT_TIMEOUT;
+	timeout = parse_timeout(s);
+	if (timeout == 0)
+	    timeout = DEFAULT_CHAT_TIMEOUT * 1000;
 
-	if (verbose)
-	    msgf("timeout set to %d seconds", timeout);
+	if (verbose) {
+	    if (timeout % 1000)
+		msgf("timeout set to %d.%03d seconds", timeout / 1000, timeout % 1000);
+	    else
+		msgf("timeout set to %d seconds", timeout / 1000);
+	}
 	free(s);
 	return 0;
     }
@@ -1209,61 +1224,209 @@ int chat_send (register char *s)
     return 0;
 }
 
+/*
+ * Timeouts are tracked as a deadline on the monotonic clock, so that
+ * they are not disturbed by changes to the system time, and can be
+ * less than a second.  A timeout of 0 means none: wait for ever.
+ */
+static struct timespec deadline;
+static int no_deadline;
+
+/*
+ * Convert a timeout in (possibly fractional) seconds to milliseconds.
+ * Zero or less gives 0, no timeout.
+ */
+int parse_timeout(char *s)
+{
+    double t = strtod(s, NULL);
+
+    if (t <= 0)
+	return 0;
+    if (t > 86400)
+	return DEFAULT_CHAT_TIMEOUT * 1000;
+    return (int)(t * 1000 + 0.5) ? (int)(t * 1000 + 0.5) : 1;
+}
+
+void set_deadline(int ms)
+{
+    no_deadline = (ms == 0);
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec  += ms / 1000;
+    deadline.tv_nsec += (ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+	deadline.tv_nsec -= 1000000000L;
+	++deadline.tv_sec;
+    }
+}
+
+/*
+ * Milliseconds until the deadline, rounded up, or 0 once it has passed,
+ * or -1 if there is no deadline.
+ */
+int time_left(void)
+{
+    struct timespec now;
+    long ms;
+
+    if (no_deadline)
+	return -1;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (now.tv_sec > deadline.tv_sec ||
+	(now.tv_sec == deadline.tv_sec && now.tv_nsec >= deadline.tv_nsec))
+	return 0;
+    ms = (deadline.tv_sec - now.tv_sec) * 1000L
+	+ (deadline.tv_nsec - now.tv_nsec + 999999L) / 1000000L;
+    return ms > 0 ? ms : 1;
+}
+
+/*
+ * Wait until fd is ready for events, or the deadline passes.
+ * Returns 1 if ready, 0 on timeout (and sets alarmed), -1 on error.
+ */
+int wait_fd(int fd, int events)
+{
+    struct pollfd pfd;
+    int ms, r;
+
+    for (;;) {
+	ms = time_left();
+	if (ms == 0) {
+	    alarmed = 1;
+	    return 0;
+	}
+	pfd.fd = fd;
+	pfd.events = events;
+	pfd.revents = 0;
+	r = poll(&pfd, 1, ms);
+	checksigs();
+	if (r > 0)
+	    return 1;
+	if (r < 0 && errno != EINTR)
+	    return -1;
+    }
+}
+
+void chat_sleep(int ms)
+{
+    struct timespec saved = deadline;
+    int saved_none = no_deadline;
+
+    set_deadline(ms);
+    while (time_left() > 0) {
+	poll(NULL, 0, time_left());
+	checksigs();
+    }
+    deadline = saved;
+    no_deadline = saved_none;
+}
+
+/*
+ * Received characters are buffered, get_string() limits each read() to
+ * read_ahead characters so that nothing past the end of the expect string
+ * is consumed from the modem.
+ */
+static unsigned char inbuf[STR_LEN];
+static int inpos = 0, inlen = 0;
+static int read_ahead = 1;
+
 int get_char(void)
 {
-    int status;
-    char c;
+    int status, want;
 
-    status = read(0, &c, 1);
-    checksigs();
+    while (inpos >= inlen) {
+	if (wait_fd(0, POLLIN) <= 0)
+	    return (-1);
 
-    switch (status) {
-    case 1:
-	return ((int)c & 0x7F);
+	want = read_ahead;
+	if (want < 1 || want > sizeof(inbuf))
+	    want = sizeof(inbuf);
 
-    default:
-	msgf("warning: read() on stdin returned %d", status);
+	status = read(0, inbuf, want);
+	checksigs();
 
-    case -1:
-	return (-1);
+	if (status > 0) {
+	    inpos = 0;
+	    inlen = status;
+	} else if (status < 0 && (errno == EINTR || errno == EAGAIN)) {
+	    continue;
+	} else {
+	    if (status == 0)
+		msgf("warning: read() on stdin returned %d", status);
+	    return (-1);
+	}
     }
+
+    return (inbuf[inpos++] & 0x7F);
 }
 
-int put_char(int c)
+/*
+ * Characters to be sent are collected in outbuf and written as a block,
+ * unless an inter-character delay is in effect.
+ */
+static char outbuf[STR_LEN];
+static int outlen = 0;
+
+int flush_output(void)
 {
+    char *p = outbuf;
     int status;
-    char ch = c;
 
-    usleep(10000);		/* inter-character typing delay (?) */
-    checksigs();
+    while (outlen > 0) {
+	if (wait_fd(1, POLLOUT) <= 0) {
+	    outlen = 0;
+	    return (-1);
+	}
 
-    status = write(1, &ch, 1);
-    checksigs();
+	status = write(1, p, outlen);
+	checksigs();
 
-    switch (status) {
-    case 1:
-	return (0);
-	
-    default:
-	msgf("warning: write() on stdout returned %d", status);
-	
-    case -1:
-	return (-1);
+	if (status > 0) {
+	    p += status;
+	    outlen -= status;
+	} else if (status < 0 && (errno == EINTR || errno == EAGAIN)) {
+	    continue;
+	} else {
+	    if (status == 0)
+		msgf("warning: write() on stdout returned %d", status);
+	    outlen = 0;
+	    return (-1);
+	}
+    }
+    return (0);
+}
+
+int put_char(int c)
+{
+    if (char_delay > 0) {
+	chat_sleep(char_delay);	/* inter-character typing delay (?) */
+	outbuf[outlen++] = c;
+	return flush_output();
+    }
+
+    outbuf[outlen++] = c;
+    if (outlen == sizeof(outbuf))
+	return flush_output();
+    return (0);
+}
+
+void write_failed(void)
+{
+    int timed_out = alarmed;
+
+    alarmed = 0;
+
+    if (verbose) {
+	if (timed_out || errno == EINTR || errno == EWOULDBLOCK)
+	    msgf(" -- write timed out");
+	else
+	    msgf(" -- write failed: %m");
     }
 }
 
 int write_char(int c)
 {
     if (alarmed || put_char(c) < 0) {
-	alarm(0);
-	alarmed = 0;
-
-	if (verbose) {
-	    if (errno == EINTR || errno == EWOULDBLOCK)
-		msgf(" -- write timed out");
-	    else
-		msgf(" -- write failed: %m");
-	}
+	write_failed();
 	return (0);
     }
     return (1);
@@ -1284,7 +1447,8 @@ int put_string(register char *s)
 	    msgf("send (%v)", s);
     }
 
-    alarm(timeout); alarmed = 0;
+    set_deadline(timeout);
+    alarmed = 0;
 
     while (*s) {
 	register char c = *s++;
@@ -1300,15 +1464,30 @@ int put_string(register char *s)
 	c = *s++;
 	switch (c) {
 	case 'd':
-	    sleep(1);
+	    if (flush_output() < 0) {
+		write_failed();
+		free(s1);
+		return 0;
+	    }
+	    chat_sleep(1000);
 	    break;
 
 	case 'K':
+	    if (flush_output() < 0) {
+		write_failed();
+		free(s1);
+		return 0;
+	    }
 	    break_sequence();
 	    break;
 
 	case 'p':
-	    usleep(10000); 	/* 1/100th of a second (arg is microseconds) */
+	    if (flush_output() < 0) {
+		write_failed();
+		free(s1);
+		return 0;
+	    }
+	    chat_sleep(10); 	/* 1/100th of a second */
 	    break;
 
 	default:
@@ -1321,7 +1500,12 @@ int put_string(register char *s)
 	checksigs();
     }
 
-    alarm(0);
+    if (flush_output() < 0) {
+	write_failed();
+	free(s1);
+	return 0;
+    }
+
     alarmed = 0;
     free(s1);
     return (1);
@@ -1360,15 +1544,160 @@ int echo_stderr(int n)
     return ret;
 }
 
+/*
+ * Aho-Corasick automaton over the expect, ABORT and REPORT strings.
+ * It is built once per expect step, after which every received
+ * character costs one state transition, instead of a comparison
+ * against the tail of the buffer for each string.
+ */
+#define MATCH_EXPECT	0
+#define MATCH_ABORT	1
+#define MATCH_REPORT	2
+
+struct ac_node {
+    int child;			/* first child, or -1 */
+    int sibling;		/* next sibling, or -1 */
+    int fail;			/* longest proper suffix in the trie */
+    int dict;			/* nearest node on the fail chain with output */
+    int out;			/* first pattern ending here, or -1 */
+    int ep;			/* longest suffix that is a prefix of the expect string */
+    unsigned char c;		/* label of the edge into this node */
+};
+
+struct ac_pattern {
+    int type;			/* MATCH_* */
+    int index;			/* into abort_string[] or report_string[] */
+    int next;			/* next pattern ending at the same node */
+};
+
+struct ac_machine {
+    struct ac_node *node;
+    int n_nodes, max_nodes;
+    struct ac_pattern pat[1 + MAX_ABORTS + MAX_REPORTS];
+    int n_pats;
+    int state;
+};
+
+static int ac_new_node(struct ac_machine *m, int c)
+{
+    struct ac_node *n;
+
+    if (m->n_nodes == m->max_nodes) {
+	m->max_nodes = m->max_nodes ? 2 * m->max_nodes : 64;
+	m->node = realloc(m->node, m->max_nodes * sizeof(*m->node));
+	if (m->node == NULL)
+	    fatal(2, "Out of memory building expect automaton");
+    }
+    n = &m->node[m->n_nodes];
+    n->child = n->sibling = n->out = n->dict = n->ep = -1;
+    n->fail = 0;
+    n->c = c;
+    return m->n_nodes++;
+}
+
+static void ac_init(struct ac_machine *m)
+{
+    memset(m, 0, sizeof(*m));
+    ac_new_node(m, 0);		/* root */
+    m->node[0].ep = 0;
+}
+
+static void ac_free(struct ac_machine *m)
+{
+    free(m->node);
+    m->node = NULL;
+}
+
+static int ac_goto(struct ac_machine *m, int s, int c)
+{
+    for (s = m->node[s].child; s >= 0; s = m->node[s].sibling)
+	if (m->node[s].c == c)
+	    return s;
+    return -1;
+}
+
+static void ac_add(struct ac_machine *m, char *str, int type, int index)
+{
+    int s = 0, t, depth = 0;
+    struct ac_pattern *p;
+
+    for (; *str; ++str) {
+	int c = (unsigned char) *str;
+
+	if (c & 0x80)
+	    return;		/* received characters are 7 bit, can't match */
+	t = ac_goto(m, s, c);
+	if (t < 0) {
+	    t = ac_new_node(m, c);
+	    m->node[t].sibling = m->node[s].child;
+	    m->node[s].child = t;
+	}
+	s = t;
+	if (type == MATCH_EXPECT)
+	    m->node[s].ep = ++depth;
+    }
+
+    p = &m->pat[m->n_pats];
+    p->type = type;
+    p->index = index;
+    p->next = m->node[s].out;
+    m->node[s].out = m->n_pats++;
+}
+
+/*
+ * Compute the failure and dictionary links, breadth first.
+ */
+static void ac_build(struct ac_machine *m)
+{
+    int *queue, head = 0, tail = 0, u, v, f, t;
+
+    queue = malloc(m->n_nodes * sizeof(*queue));
+    if (queue == NULL)
+	fatal(2, "Out of memory building expect automaton");
+
+    queue[tail++] = 0;
+    while (head < tail) {
+	u = queue[head++];
+	for (v = m->node[u].child; v >= 0; v = m->node[v].sibling) {
+	    queue[tail++] = v;
+	    if (u == 0) {
+		m->node[v].fail = 0;
+	    } else {
+		f = m->node[u].fail;
+		while ((t = ac_goto(m, f, m->node[v].c)) < 0 && f != 0)
+		    f = m->node[f].fail;
+		m->node[v].fail = t < 0 ? 0 : t;
+	    }
+	    f = m->node[v].fail;
+	    m->node[v].dict = m->node[f].out >= 0 ? f : m->node[f].dict;
+	    if (m->node[v].ep < 0)
+		m->node[v].ep = m->node[f].ep;
+	}
+    }
+    free(queue);
+    m->state = 0;
+}
+
+static int ac_step(struct ac_machine *m, int c)
+{
+    int s = m->state, t;
+
+    while ((t = ac_goto(m, s, c)) < 0 && s != 0)
+	s = m->node[s].fail;
+    m->state = t < 0 ? 0 : t;
+    return m->state;
+}
+
 /*
  *	'Wait for' this string to appear on this file descriptor.
  */
 int get_string(register char *string)
 {
     char temp[STR_LEN];
-    int c, printed = 0, len, minlen;
+    int c, n, printed = 0, len, minlen;
     register char *s = temp, *end = s + STR_LEN;
     char *s1, *logged = temp;
+    struct ac_machine ac;
 
     fail_reason = (char *)0;
     string = s1 = clean(string, 0);
@@ -1392,11 +1721,22 @@ int get_string(register char *string)
 	return (1);
     }
 
-    alarm(timeout);
+    ac_init(&ac);
+    ac_add(&ac, string, MATCH_EXPECT, 0);
+    for (n = 0; n < n_aborts; ++n)
+	ac_add(&ac, abort_string[n], MATCH_ABORT, n);
+    for (n = 0; n < n_reports; ++n)
+	if (report_string[n] != (char*) NULL)
+	    ac_add(&ac, report_string[n], MATCH_REPORT, n);
+    ac_build(&ac);
+
+    set_deadline(timeout);
     alarmed = 0;
 
-    while ( ! alarmed && (c = get_char()) >= 0) {
-	int n, abort_len, report_len;
+    /* never read past the point where the expect string could complete */
+    while ( ! alarmed &&
+	    (read_ahead = len - ac.node[ac.state].ep, c = get_char()) >= 0) {
+	int got_expect = 0, got_abort = -1, got_report = -1, p;
 
 	if (echo) {
 	    if (echo_stderr(c) != 0) {
@@ -1425,24 +1765,41 @@ int get_string(register char *string)
 	       fprintf( stderr, "%s", character(c) );
 	}
 
-	if (!report_gathering) {
-	    for (n = 0; n < n_reports; ++n) {
-		if ((report_string[n] != (char*) NULL) &&
-		    s - temp >= (report_len = strlen(report_string[n])) &&
-		    strncmp(s - report_len, report_string[n], report_len) == 0) {
-		    time_t time_now   = time ((time_t*) NULL);
-		    struct tm* tm_now = localtime (&time_now);
-
-		    strftime (report_buffer, 20, "%b %d %H:%M:%S ", tm_now);
-		    strcat (report_buffer, report_string[n]);
-
-		    free(report_string[n]);
-		    report_string[n] = (char *) NULL;
-		    report_gathering = 1;
+	/* collect everything that ends at this character, lowest index wins */
+	for (n = ac_step(&ac, c); n >= 0; n = ac.node[n].dict) {
+	    for (p = ac.node[n].out; p >= 0; p = ac.pat[p].next) {
+		int index = ac.pat[p].index;
+
+		switch (ac.pat[p].type) {
+		case MATCH_EXPECT:
+		    got_expect = 1;
+		    break;
+		case MATCH_ABORT:
+		    if (got_abort < 0 || index < got_abort)
+			got_abort = index;
+		    break;
+		case MATCH_REPORT:
+		    if (report_string[index] != (char*) NULL &&
+			(got_report < 0 || index < got_report))
+			got_report = index;
 		    break;
 		}
 	    }
 	}
+
+	if (!report_gathering) {
+	    if (got_report >= 0) {
+		time_t time_now   = time ((time_t*) NULL);
+		struct tm* tm_now = localtime (&time_now);
+
+		strftime (report_buffer, 20, "%b %d %H:%M:%S ", tm_now);
+		strcat (report_buffer, report_string[got_report]);
+
+		free(report_string[got_report]);
+		report_string[got_report] = (char *) NULL;
+		report_gathering = 1;
+	    }
+	}
 	else {
 	    if (!iscntrl (c)) {
 		int rep_len = strlen (report_buffer);
@@ -1457,37 +1814,34 @@ int get_string(register char *string)
 	    }
 	}
 
-	if (s - temp >= len &&
-	    c == string[len - 1] &&
-	    strncmp(s - len, string, len) == 0) {
+	if (got_expect) {
 	    if (verbose) {
 		if (s > logged)
 		    msgf("%0.*v", s - logged, logged);
 		msgf(" -- got it\n");
 	    }
 
-	    alarm(0);
 	    alarmed = 0;
+	    read_ahead = 1;
+	    ac_free(&ac);
 	    free(s1);
 	    return (1);
 	}
 
-	for (n = 0; n < n_aborts; ++n) {
-	    if (s - temp >= (abort_len = strlen(abort_string[n])) &&
-		strncmp(s - abort_len, abort_string[n], abort_len) == 0) {
-		if (verbose) {
-		    if (s > logged)
-			msgf("%0.*v", s - logged, logged);
-		    msgf(" -- failed");
-		}
-
-		alarm(0);
-		alarmed = 0;
-		exit_code = n + 4;
-		strcpy(fail_reason = fail_buffer, abort_string[n]);
-		free(s1);
-		return (0);
+	if (got_abort >= 0) {
+	    if (verbose) {
+		if (s > logged)
+		    msgf("%0.*v", s - logged, logged);
+		msgf(" -- failed");
 	    }
+
+	    alarmed = 0;
+	    read_ahead = 1;
+	    exit_code = got_abort + 4;
+	    strcpy(fail_reason = fail_buffer, abort_string[got_abort]);
+	    ac_free(&ac);
+	    free(s1);
+	    return (0);
 	}
 
 	if (s >= end) {
@@ -1501,13 +1855,10 @@ int get_string(register char *string)
 	    logged = temp + (logged - s);
 	    s = temp + minlen;
 	}
-
-	if (alarmed && verbose)
-	    msgf("warning: alarm synchronization problem");
     }
 
-    alarm(0);
-    
+    read_ahead = 1;
+
     if (verbose && printed) {
 	if (alarmed)
 	    msgf(" -- read timed out");
@@ -1517,45 +1868,87 @@ int get_string(register char *string)
 
     exit_code = 3;
     alarmed   = 0;
+    ac_free(&ac);
     free(s1);
     return (0);
 }
 
 /*
- * Gross kludge to handle Solaris versions >= 2.6 having usleep.
+ * Run the script against each of the devices given with -m, each in its
+ * own process.  The first device to complete the script is printed on
+ * stdout, and the others are stopped.
  */
-#ifdef SOL2
-#include <sys/param.h>
-#if MAXUID > 65536		/* then this is Solaris 2.6 or later */
-#undef NO_USLEEP
-#endif
-#endif /* SOL2 */
+void run_multi(void)
+{
+    pid_t pids[MAX_DEVICES], pid;
+    struct sigaction sa;
+    int i, fd, status, running = 0, code = 3;
 
-#ifdef NO_USLEEP
-#include <sys/types.h>
-#include <sys/time.h>
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sigint;
+    sigaction(SIGINT, &sa, NULL);
+    sa.sa_handler = sigterm;
+    sigaction(SIGTERM, &sa, NULL);
 
-/*
-  usleep -- support routine for 4.2BSD system call emulations
-  last edit:  29-Oct-1984     D A Gwyn
-  */
+    for (i = 0; i < n_devices; ++i) {
+	pid = fork();
+	if (pid < 0)
+	    fatal(2, "fork: %m");
+
+	if (pid == 0) {
+	    /* don't block waiting for carrier */
+	    fd = open(devices[i], O_RDWR | O_NOCTTY | O_NONBLOCK);
+	    if (fd < 0)
+		fatal(2, "Can't open %s: %m", devices[i]);
+	    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+	    dup2(fd, 0);
+	    dup2(fd, 1);
+	    if (fd > 1)
+		close(fd);
+	    return;		/* carry on with the script */
+	}
 
-extern int	  select();
+	pids[i] = pid;
+	++running;
+    }
 
-/* returns 0 if ok, else -1 */
-int usleep(long usec)		/* delay in microseconds */
-{
-    static struct {		/* `timeval' */
-	long	tv_sec;		/* seconds */
-	long	tv_usec;	/* microsecs */
-    } delay;	    		/* _select() timeout */
+    while (running > 0) {
+	pid = wait(&status);
+	if (pid < 0) {
+	    if (errno == EINTR && !fatalsig)
+		continue;
+	    break;
+	}
+
+	for (i = 0; i < n_devices && pids[i] != pid; ++i)
+	    ;
+	if (i == n_devices)
+	    continue;
+	pids[i] = 0;
+	--running;
+
+	code = WIFEXITED(status) ? WEXITSTATUS(status) : 2;
+	if (code == 0) {
+	    if (verbose)
+		msgf("connected on %s", devices[i]);
+	    printf("%s\n", devices[i]);
+	    fflush(stdout);
+	    break;
+	}
+	if (verbose)
+	    msgf("%s failed with code %d", devices[i], code);
+    }
 
-    delay.tv_sec  = usec / 1000000L;
-    delay.tv_usec = usec % 1000000L;
+    for (i = 0; i < n_devices; ++i)
+	if (pids[i] > 0)
+	    kill(pids[i], SIGTERM);
+    while (running > 0 && wait(NULL) > 0)
+	--running;
 
-    return select(0, (long *)0, (long *)0, (long *)0, &delay);
+    if (fatalsig)
+	code = 2;
+    exit(code);
 }
-#endif
 
 void pack_array (
     char **array, /* The address of the array of string pointers */
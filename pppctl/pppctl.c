@@ -0,0 +1,403 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*
+ * pppctl - query or adjust a running pppd through its control socket.
+ *
+ * pppd listens on the socket given with its "control" option; the
+ * message formats are in control.h.  Each command here is a single
+ * request and reply.
+ *
+ * Copyright (c) 2026 The pppd Project. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THE AUTHORS OF THIS SOFTWARE DISCLAIM ALL WARRANTIES WITH REGARD TO
+ * THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+ * AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "control.h"
+
+#ifndef PPP_IPCP
+#define PPP_IPCP	0x8021
+#define PPP_IPV6CP	0x8057
+#define PPP_CCP		0x80fd
+#define PPP_LCP		0xc021
+#endif
+
+static char *progname;
+static int ctl_fd = -1;
+
+static void
+usage(void)
+{
+    fprintf(stderr, "usage: %s socket command [value]\n"
+	    "commands: status stats options echo timers\n"
+	    "          echo-interval secs  echo-interval-ms ms"
+	    "  echo-failure n  debug level\n", progname);
+    exit(2);
+}
+
+static void
+ctl_connect(const char *path)
+{
+    struct sockaddr_un sun;
+
+    if (strlen(path) >= sizeof(sun.sun_path)) {
+	fprintf(stderr, "%s: socket path %s is too long\n", progname, path);
+	exit(1);
+    }
+    memset(&sun, 0, sizeof(sun));
+    sun.sun_family = AF_UNIX;
+    strcpy(sun.sun_path, path);
+    ctl_fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (ctl_fd < 0
+	|| connect(ctl_fd, (struct sockaddr *) &sun, sizeof(sun)) < 0) {
+	fprintf(stderr, "%s: %s: %s\n", progname, path, strerror(errno));
+	exit(1);
+    }
+}
+
+/*
+ * ctl_request - send a request and wait for its reply.  Returns the
+ * length of the reply data, which is left in buf.
+ */
+static int
+ctl_request(int type, const void *data, int len, unsigned char *buf)
+{
+    struct ppp_ctl_msg msg;
+    int n;
+
+    msg.type = type;
+    msg.status = 0;
+    msg.len = len;
+    memcpy(buf, &msg, sizeof(msg));
+    if (len > 0)
+	memcpy(buf + sizeof(msg), data, len);
+    if (send(ctl_fd, buf, sizeof(msg) + len, 0) < 0) {
+	fprintf(stderr, "%s: send: %s\n", progname, strerror(errno));
+	exit(1);
+    }
+    n = recv(ctl_fd, buf, PPP_CTL_MAXMSG, 0);
+    if (n < 0) {
+	fprintf(stderr, "%s: recv: %s\n", progname, strerror(errno));
+	exit(1);
+    }
+    if (n < (int) sizeof(msg)) {
+	fprintf(stderr, "%s: pppd closed the connection\n", progname);
+	exit(1);
+    }
+    memcpy(&msg, buf, sizeof(msg));
+    if (msg.status != 0) {
+	fprintf(stderr, "%s: %s\n", progname, strerror(msg.status));
+	exit(1);
+    }
+    n -= sizeof(msg);
+    memmove(buf, buf + sizeof(msg), n);
+    return n;
+}
+
+/* Copy a reply into a structure, zero-filling what an older pppd omits */
+static void
+ctl_copy(void *dst, size_t size, const unsigned char *src, int len)
+{
+    memset(dst, 0, size);
+    memcpy(dst, src, (size_t) len < size? (size_t) len: size);
+}
+
+static void
+show_status(void)
+{
+    unsigned char buf[PPP_CTL_MAXMSG];
+    struct ppp_ctl_status st;
+    int n;
+
+    n = ctl_request(PPP_CTL_GET_STATUS, NULL, 0, buf);
+    ctl_copy(&st, sizeof(st), buf, n);
+    st.ifname[sizeof(st.ifname) - 1] = 0;
+    printf("version %u\npid %d\nphase %d\ndebug %d\n",
+	   st.version, st.pid, st.phase, st.debug);
+    if (st.ifunit >= 0)
+	printf("unit %d\ninterface %s\n", st.ifunit, st.ifname);
+}
+
+static void
+show_stats(void)
+{
+    unsigned char buf[PPP_CTL_MAXMSG];
+    struct ppp_ctl_stats st;
+    int n;
+
+    n = ctl_request(PPP_CTL_GET_STATS, NULL, 0, buf);
+    ctl_copy(&st, sizeof(st), buf, n);
+    if (!st.valid) {
+	printf("link not up\n");
+	return;
+    }
+    printf("connect_time %u\n", st.connect_time);
+    printf("bytes_in %llu\nbytes_out %llu\n",
+	   (unsigned long long) st.bytes_in, (unsigned long long) st.bytes_out);
+    printf("packets_in %llu\npackets_out %llu\n",
+	   (unsigned long long) st.pkts_in, (unsigned long long) st.pkts_out);
+    printf("errors_in %u\nerrors_out %u\ndropped_in %u\ndropped_out %u\n",
+	   st.errors_in, st.errors_out, st.dropped_in, st.dropped_out);
+    if (st.xmit_idle >= 0)
+	printf("xmit_idle %d\nrecv_idle %d\n", st.xmit_idle, st.recv_idle);
+}
+
+struct flag_name {
+    uint32_t	bit;
+    const char	*name;
+};
+
+static const struct flag_name lcp_flags[] = {
+    { PPP_CTL_LCP_MRU, "mru" }, { PPP_CTL_LCP_ASYNCMAP, "asyncmap" },
+    { PPP_CTL_LCP_UPAP, "pap" }, { PPP_CTL_LCP_CHAP, "chap" },
+    { PPP_CTL_LCP_EAP, "eap" }, { PPP_CTL_LCP_MAGIC, "magic" },
+    { PPP_CTL_LCP_PCOMP, "pcomp" }, { PPP_CTL_LCP_ACCOMP, "accomp" },
+    { PPP_CTL_LCP_LQR, "lqr" }, { PPP_CTL_LCP_CBCP, "cbcp" },
+    { PPP_CTL_LCP_MRRU, "mrru" }, { PPP_CTL_LCP_SSNHF, "ssnhf" },
+    { PPP_CTL_LCP_ENDPOINT, "endpoint" }, { 0, NULL }
+};
+
+static const struct flag_name ipcp_flags[] = {
+    { PPP_CTL_IPCP_ADDR, "addr" }, { PPP_CTL_IPCP_VJ, "vj" },
+    { PPP_CTL_IPCP_VJ_CFLAG, "vj-cflag" }, { PPP_CTL_IPCP_DNS1, "dns1" },
+    { PPP_CTL_IPCP_DNS2, "dns2" }, { PPP_CTL_IPCP_WINS1, "wins1" },
+    { PPP_CTL_IPCP_WINS2, "wins2" }, { 0, NULL }
+};
+
+static const struct flag_name ipv6cp_flags[] = {
+    { PPP_CTL_IPV6CP_IFACEID, "ifaceid" }, { PPP_CTL_IPV6CP_VJ, "vj" },
+    { 0, NULL }
+};
+
+static const struct flag_name ccp_flags[] = {
+    { PPP_CTL_CCP_BSD, "bsdcomp" }, { PPP_CTL_CCP_DEFLATE, "deflate" },
+    { PPP_CTL_CCP_PRED1, "predictor1" }, { PPP_CTL_CCP_PRED2, "predictor2" },
+    { PPP_CTL_CCP_MPPE, "mppe" }, { 0, NULL }
+};
+
+static void
+print_flags(uint32_t flags, const struct flag_name *names)
+{
+    printf(" [");
+    for (; names->name != NULL; ++names)
+	if (flags & names->bit) {
+	    flags &= ~names->bit;
+	    printf("%s%s", names->name, flags? " ": "");
+	}
+    printf("]");
+}
+
+static void
+print_addr(const char *name, uint32_t addr)
+{
+    struct in_addr in;
+
+    in.s_addr = addr;
+    printf(" %s %s", name, inet_ntoa(in));
+}
+
+static void
+print_id(const char *name, const uint8_t *id)
+{
+    printf(" %s %02x%02x:%02x%02x:%02x%02x:%02x%02x", name,
+	   id[0], id[1], id[2], id[3], id[4], id[5], id[6], id[7]);
+}
+
+static void
+show_options(void)
+{
+    unsigned char buf[PPP_CTL_MAXMSG], *p;
+    struct ppp_ctl_options rec;
+    struct ppp_ctl_lcp lcp;
+    struct ppp_ctl_ipcp ipcp;
+    struct ppp_ctl_ipv6cp ipv6cp;
+    struct ppp_ctl_ccp ccp;
+    const char *which;
+    int n;
+
+    n = ctl_request(PPP_CTL_GET_OPTIONS, NULL, 0, buf);
+    for (p = buf; n >= (int) sizeof(rec); p += rec.len, n -= rec.len) {
+	memcpy(&rec, p, sizeof(rec));
+	p += sizeof(rec);
+	n -= sizeof(rec);
+	if (rec.len > (uint32_t) n)
+	    break;
+	which = rec.which == PPP_CTL_GOT? "ours": "his";
+	switch (rec.protocol) {
+	case PPP_LCP:
+	    ctl_copy(&lcp, sizeof(lcp), p, rec.len);
+	    printf("lcp %s", which);
+	    print_flags(lcp.flags, lcp_flags);
+	    printf(" mru %u asyncmap 0x%x magic 0x%x", lcp.mru, lcp.asyncmap,
+		   lcp.magic);
+	    if (lcp.flags & PPP_CTL_LCP_MRRU)
+		printf(" mrru %u", lcp.mrru);
+	    if (lcp.flags & PPP_CTL_LCP_LQR)
+		printf(" lqr-period %u", lcp.lqr_period);
+	    printf("\n");
+	    break;
+	case PPP_IPCP:
+	    ctl_copy(&ipcp, sizeof(ipcp), p, rec.len);
+	    printf("ipcp %s", which);
+	    print_flags(ipcp.flags, ipcp_flags);
+	    print_addr("local", ipcp.ouraddr);
+	    print_addr("remote", ipcp.hisaddr);
+	    if (ipcp.flags & (PPP_CTL_IPCP_DNS1 | PPP_CTL_IPCP_DNS2)) {
+		print_addr("dns", ipcp.dns[0]);
+		print_addr("dns", ipcp.dns[1]);
+	    }
+	    printf("\n");
+	    break;
+	case PPP_IPV6CP:
+	    ctl_copy(&ipv6cp, sizeof(ipv6cp), p, rec.len);
+	    printf("ipv6cp %s", which);
+	    print_flags(ipv6cp.flags, ipv6cp_flags);
+	    print_id("local", ipv6cp.ourid);
+	    print_id("remote", ipv6cp.hisid);
+	    printf("\n");
+	    break;
+	case PPP_CCP:
+	    ctl_copy(&ccp, sizeof(ccp), p, rec.len);
+	    printf("ccp %s", which);
+	    print_flags(ccp.flags, ccp_flags);
+	    printf(" method %d\n", ccp.method);
+	    break;
+	}
+    }
+}
+
+static void
+show_echo(void)
+{
+    unsigned char buf[PPP_CTL_MAXMSG];
+    struct ppp_ctl_echo e;
+    int n;
+
+    n = ctl_request(PPP_CTL_GET_ECHO, NULL, 0, buf);
+    ctl_copy(&e, sizeof(e), buf, n);
+    printf("interval %d\ninterval_ms %d\nfailure %d\npending %d\n",
+	   e.interval, e.interval_ms, e.fails, e.pending);
+    printf("srtt_us %d\nrttvar_us %d\n", e.srtt, e.rttvar);
+}
+
+static void
+show_timers(void)
+{
+    unsigned char buf[PPP_CTL_MAXMSG];
+    struct ppp_ctl_timer t;
+    int i, n;
+
+    n = ctl_request(PPP_CTL_GET_TIMERS, NULL, 0, buf);
+    for (i = 0; i + (int) sizeof(t) <= n; i += sizeof(t)) {
+	memcpy(&t, buf + i, sizeof(t));
+	printf("%lld.%06lld\n", (long long) t.usecs / 1000000,
+	       (long long) t.usecs % 1000000);
+    }
+}
+
+static int
+get_value(const char *arg)
+{
+    char *end;
+    long v;
+
+    if (arg == NULL)
+	usage();
+    v = strtol(arg, &end, 10);
+    if (*end != 0 || end == arg || v < 0 || v > 0x7fffffff) {
+	fprintf(stderr, "%s: bad value %s\n", progname, arg);
+	exit(2);
+    }
+    return v;
+}
+
+static void
+set_echo(const char *cmd, const char *arg)
+{
+    unsigned char buf[PPP_CTL_MAXMSG];
+    struct ppp_ctl_echo e;
+
+    memset(&e, 0, sizeof(e));
+    e.interval = e.interval_ms = e.fails = -1;
+    if (strcmp(cmd, "echo-interval") == 0)
+	e.interval = get_value(arg);
+    else if (strcmp(cmd, "echo-interval-ms") == 0)
+	e.interval_ms = get_value(arg);
+    else
+	e.fails = get_value(arg);
+    ctl_request(PPP_CTL_SET_ECHO, &e, sizeof(e), buf);
+}
+
+static void
+set_debug(const char *arg)
+{
+    unsigned char buf[PPP_CTL_MAXMSG];
+    int32_t level = get_value(arg);
+
+    ctl_request(PPP_CTL_SET_DEBUG, &level, sizeof(level), buf);
+}
+
+int
+main(int argc, char **argv)
+{
+    const char *cmd;
+
+    progname = strrchr(argv[0], '/');
+    progname = progname? progname + 1: argv[0];
+    if (argc < 3 || argc > 4)
+	usage();
+    cmd = argv[2];
+
+    ctl_connect(argv[1]);
+    if (strcmp(cmd, "status") == 0)
+	show_status();
+    else if (strcmp(cmd, "stats") == 0)
+	show_stats();
+    else if (strcmp(cmd, "options") == 0)
+	show_options();
+    else if (strcmp(cmd, "echo") == 0)
+	show_echo();
+    else if (strcmp(cmd, "timers") == 0)
+	show_timers();
+    else if (strcmp(cmd, "echo-interval") == 0
+	     || strcmp(cmd, "echo-interval-ms") == 0
+	     || strcmp(cmd, "echo-failure") == 0)
+	set_echo(cmd, argv[3]);
+    else if (strcmp(cmd, "debug") == 0)
+	set_debug(argv[3]);
+    else
+	usage();
+    close(ctl_fd);
+    return 0;
+}
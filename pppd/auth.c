@@ -127,9 +127,10 @@
 #include "multilink.h"
 #include "pathnames.h"
 #include "session.h"
+#include "meter.h"
 
 
-/* Bits in scan_authfile return value */
+/* Bits in secrets_lookup return value */
 #define NONWILD_SERVER	1
 #define NONWILD_CLIENT	2
 
@@ -166,6 +167,11 @@ static int num_np_open;
 /* Number of network protocols which have come up. */
 static int num_np_up;
 
+/* Octets used at the last traffic limit check, and when. */
+static uint64_t mo_last_used;
+static struct timeval mo_last_when;
+static int mo_last_valid;
+
 /* Set if we got the contents of passwd[] from the pap-secrets file. */
 static int passwd_from_file;
 
@@ -266,6 +272,7 @@ char *cert_file    = NULL;  /* Client certificate file (pem format) */
 char *privkey_file = NULL;  /* Client private key file (pem format) */
 char *pkcs12_file  = NULL;  /* Client private key envelope file (pkcs12 format) */
 bool need_peer_eap = 0;	    /* Require peer to authenticate us */
+char *tls_ticket_keys = NULL; /* Session ticket keys shared between servers */
 #endif
 
 static char *uafname;		/* name of most recent +ua file */
@@ -273,7 +280,7 @@ static char *uafname;		/* name of most recent +ua file */
 /* Prototypes for procedures local to this file. */
 
 static void network_phase (int);
-static void check_idle (void *);
+static int check_idle (const struct ppp_meter_sample *, void *);
 static void connect_time_expired (void *);
 static int  null_login (int);
 static int  get_pap_passwd (char *);
@@ -295,9 +302,9 @@ static int  scan_authfile_eaptls(FILE * f, char *client, char *server,
 #endif
 
 static int  ip_addr_check (u_int32_t, struct permitted_ip *);
-static int  scan_authfile(FILE *, char *, char *, char *,
-			  struct wordlist **, struct wordlist **,
-			  char *, int);
+static struct secrets_index *secrets_open(char *);
+static int  secrets_lookup(struct secrets_index *, char *, char *, char *,
+			   struct wordlist **, struct wordlist **, int);
 static void free_wordlist (struct wordlist *);
 static void auth_script (char *);
 static void auth_script_done (void *);
@@ -309,7 +316,7 @@ static int  set_noauth_addr (char **);
 static int  set_permitted_number (char **);
 static void check_access (FILE *, char *);
 static int  wordlist_count (struct wordlist *);
-static void check_maxoctets (void *);
+static int check_maxoctets (const struct ppp_meter_sample *, void *);
 
 /*
  * Authentication-related options.
@@ -465,6 +472,8 @@ struct option auth_options[] = {
     { "pkcs12", o_string, &pkcs12_file, "EAP-TLS client credentials in PKCS12 format" },
     { "need-peer-eap", o_bool, &need_peer_eap,
       "Require the peer to authenticate us", 1 },
+    { "tls-ticket-keys", o_string, &tls_ticket_keys,
+      "Resume EAP-TLS sessions with session ticket keys from file", OPT_PRIV },
 #endif /* PPP_WITH_EAPTLS */
     { NULL }
 };
@@ -1187,7 +1196,7 @@ np_up(int unit, int proto)
 	else
 	    tlim = ppp_get_max_idle_time();
 	if (tlim > 0)
-	    TIMEOUT(check_idle, NULL, tlim);
+	    ppp_meter_add(check_idle, NULL, tlim * 1000, 0);
 
 	/*
 	 * Set a timeout to close the connection once the maximum
@@ -1200,8 +1209,10 @@ np_up(int unit, int proto)
 	 * Configure a check to see if session has outlived it's limit
 	 *   in terms of octets
 	 */
-	if (maxoctets > 0)
-	    TIMEOUT(check_maxoctets, NULL, maxoctets_timeout);
+	if (maxoctets > 0) {
+	    mo_last_valid = 0;
+	    ppp_meter_add(check_maxoctets, NULL, maxoctets_timeout * 1000, 0);
+	}
 
 	/*
 	 * Detach now, if the updetach option was given.
@@ -1226,9 +1237,9 @@ void
 np_down(int unit, int proto)
 {
     if (--num_np_up == 0) {
-	UNTIMEOUT(check_idle, NULL);
+	ppp_meter_remove(check_idle, NULL);
 	UNTIMEOUT(connect_time_expired, NULL);
-	UNTIMEOUT(check_maxoctets, NULL);
+	ppp_meter_remove(check_maxoctets, NULL);
 	new_phase(PHASE_NETWORK);
     }
 }
@@ -1246,59 +1257,78 @@ np_finished(int unit, int proto)
 }
 
 /*
- * Periodic callback to check if session has reached its limit. The period defaults
- * to 1 second and is configurable by setting "mo-timeout" in configuration
+ * Meter client to check if session has reached its limit.  It is called
+ * every mo-timeout seconds (default 1), or sooner if the traffic since
+ * the last check would reach the limit before then.
  */
-static void
-check_maxoctets(void *arg)
+static int
+check_maxoctets(const struct ppp_meter_sample *m, void *arg)
 {
-    unsigned int used = 0;
-    ppp_link_stats_st stats;
+    uint64_t used = 0;
+    long period, dt;
 
-    if (ppp_get_link_stats(&stats)) {
+    if (m->stats_valid) {
         switch(maxoctets_dir) {
             case PPP_OCTETS_DIRECTION_IN:
-                used = stats.bytes_in;
+                used = m->stats.bytes_in;
                 break;
             case PPP_OCTETS_DIRECTION_OUT:
-                used = stats.bytes_out;
+                used = m->stats.bytes_out;
                 break;
             case PPP_OCTETS_DIRECTION_MAXOVERAL:
             case PPP_OCTETS_DIRECTION_MAXSESSION:
-                used = (stats.bytes_in > stats.bytes_out)
-                                ? stats.bytes_in
-                                : stats.bytes_out;
+                used = (m->stats.bytes_in > m->stats.bytes_out)
+                                ? m->stats.bytes_in
+                                : m->stats.bytes_out;
                 break;
             default:
-                used = stats.bytes_in+stats.bytes_out;
+                used = m->stats.bytes_in + m->stats.bytes_out;
                 break;
         }
     }
 
     if (used > maxoctets) {
-	notice("Traffic limit reached. Limit: %u Used: %u", maxoctets, used);
+	notice("Traffic limit reached. Limit: %u Used: %llu", maxoctets,
+	       (unsigned long long) used);
 	ppp_set_status(EXIT_TRAFFIC_LIMIT);
 	lcp_close(0, "Traffic limit");
 	link_stats_print = 0;
 	need_holdoff = 0;
-    } else {
-        TIMEOUT(check_maxoctets, NULL, maxoctets_timeout);
+	return 0;
+    }
+
+    /* when would the limit be passed at the recent rate? */
+    period = maxoctets_timeout * 1000L;
+    dt = (m->when.tv_sec - mo_last_when.tv_sec) * 1000L
+	+ (m->when.tv_usec - mo_last_when.tv_usec) / 1000;
+    if (mo_last_valid && dt > 0 && used > mo_last_used) {
+	uint64_t left = maxoctets - used + 1;
+	uint64_t rate = used - mo_last_used;
+
+	if (left * dt / rate < (uint64_t) period)
+	    period = left * dt / rate + 1;
     }
+    mo_last_used = used;
+    mo_last_when = m->when;
+    mo_last_valid = 1;
+    return period;
 }
 
 /*
  * check_idle - check whether the link has been idle for long
  * enough that we can shut it down.
  */
-static void
-check_idle(void *arg)
+static int
+check_idle(const struct ppp_meter_sample *m, void *arg)
 {
     struct ppp_idle idle;
     time_t itime;
     int tlim;
 
-    if (!get_idle_time(0, &idle))
-	return;
+    if (!m->idle_valid)
+	return 0;
+    idle.xmit_idle = m->xmit_idle;
+    idle.recv_idle = m->recv_idle;
     if (idle_time_hook != 0) {
 	tlim = idle_time_hook(&idle);
     } else {
@@ -1311,9 +1341,9 @@ check_idle(void *arg)
 	ppp_set_status(EXIT_IDLE_TIMEOUT);
 	lcp_close(0, "Link inactive");
 	need_holdoff = 0;
-    } else {
-	TIMEOUT(check_idle, NULL, tlim);
+	return 0;
     }
+    return tlim * 1000;
 }
 
 /*
@@ -1505,7 +1535,7 @@ check_passwd(int unit,
 {
     int ret;
     char *filename;
-    FILE *f;
+    struct secrets_index *sf;
     struct wordlist *addrs = NULL, *opts = NULL;
     char passwd[256], user[256];
     char secret[MAXWORDLEN];
@@ -1547,13 +1577,12 @@ check_passwd(int unit,
 	    return UPAP_AUTHNAK;
     addrs = opts = NULL;
     ret = UPAP_AUTHNAK;
-    f = fopen(filename, "r");
-    if (f == NULL) {
+    sf = secrets_open(filename);
+    if (sf == NULL) {
 	error("Can't open PAP password file %s: %m", filename);
 
     } else {
-	check_access(f, filename);
-	if (scan_authfile(f, user, our_name, secret, &addrs, &opts, filename, 0) < 0) {
+	if (secrets_lookup(sf, user, our_name, secret, &addrs, &opts, 0) < 0) {
 	    warn("no PAP secret found for %s", user);
 	} else {
 	    /*
@@ -1584,7 +1613,6 @@ check_passwd(int unit,
 		}
 	    }
 	}
-	fclose(f);
     }
     free(filename);
 
@@ -1630,7 +1658,7 @@ static int
 null_login(int unit)
 {
     char *filename;
-    FILE *f;
+    struct secrets_index *sf;
     int i, ret;
     struct wordlist *addrs, *opts;
     char secret[MAXWORDLEN];
@@ -1649,17 +1677,15 @@ null_login(int unit)
 	if (!ppp_check_access(path_upapfile, &filename, 0, 0))
 	    return 0;
 	addrs = NULL;
-	f = fopen(filename, "r");
-	if (f == NULL) {
+	sf = secrets_open(filename);
+	if (sf == NULL) {
 	    free(filename);
 	    return 0;
 	}
-	check_access(f, filename);
 
-	i = scan_authfile(f, "", our_name, secret, &addrs, &opts, filename, 0);
+	i = secrets_lookup(sf, "", our_name, secret, &addrs, &opts, 0);
 	ret = i >= 0 && secret[0] == 0;
 	BZERO(secret, sizeof(secret));
-	fclose(f);
 	free(filename);
     }
 
@@ -1683,8 +1709,7 @@ null_login(int unit)
 static int
 get_pap_passwd(char *passwd)
 {
-    char *filename;
-    FILE *f;
+    struct secrets_index *sf;
     int ret;
     char secret[MAXWORDLEN];
 
@@ -1697,15 +1722,12 @@ get_pap_passwd(char *passwd)
 	    return ret;
     }
 
-    filename = path_upapfile;
-    f = fopen(filename, "r");
-    if (f == NULL)
+    sf = secrets_open(path_upapfile);
+    if (sf == NULL)
 	return 0;
-    check_access(f, filename);
-    ret = scan_authfile(f, user,
-			(remote_name[0]? remote_name: NULL),
-			secret, NULL, NULL, filename, 0);
-    fclose(f);
+    ret = secrets_lookup(sf, user,
+			 (remote_name[0]? remote_name: NULL),
+			 secret, NULL, NULL, 0);
     if (ret < 0)
 	return 0;
     if (passwd != NULL)
@@ -1722,7 +1744,7 @@ get_pap_passwd(char *passwd)
 static int
 have_pap_secret(int *lacks_ipp)
 {
-    FILE *f;
+    struct secrets_index *sf;
     int ret;
     char *filename;
     struct wordlist *addrs;
@@ -1736,16 +1758,13 @@ have_pap_secret(int *lacks_ipp)
 
     if (!ppp_check_access(path_upapfile, &filename, 0, 0))
 	return 0;
-    f = fopen(filename, "r");
-    if (f == NULL) {
-	free(filename);
+    sf = secrets_open(filename);
+    free(filename);
+    if (sf == NULL)
 	return 0;
-    }
 
-    ret = scan_authfile(f, (explicit_remote? remote_name: NULL), our_name,
-			NULL, &addrs, NULL, filename, 0);
-    fclose(f);
-    free(filename);
+    ret = secrets_lookup(sf, (explicit_remote? remote_name: NULL), our_name,
+			 NULL, &addrs, NULL, 0);
     if (ret >= 0 && !some_ip_ok(addrs)) {
 	if (lacks_ipp != 0)
 	    *lacks_ipp = 1;
@@ -1768,7 +1787,7 @@ static int
 have_chap_secret(char *client, char *server,
 		 int need_ip, int *lacks_ipp)
 {
-    FILE *f;
+    struct secrets_index *sf;
     int ret;
     char *filename;
     struct wordlist *addrs;
@@ -1782,20 +1801,17 @@ have_chap_secret(char *client, char *server,
 
     if (!ppp_check_access(path_chapfile, &filename, 0, 0))
 	    return 0;
-    f = fopen(filename, "r");
-    if (f == NULL) {
-	free(filename);
+    sf = secrets_open(filename);
+    free(filename);
+    if (sf == NULL)
 	return 0;
-    }
 
     if (client != NULL && client[0] == 0)
 	client = NULL;
     else if (server != NULL && server[0] == 0)
 	server = NULL;
 
-    ret = scan_authfile(f, client, server, NULL, &addrs, NULL, filename, 0);
-    fclose(f);
-    free(filename);
+    ret = secrets_lookup(sf, client, server, NULL, &addrs, NULL, 0);
     if (ret >= 0 && need_ip && !some_ip_ok(addrs)) {
 	if (lacks_ipp != 0)
 	    *lacks_ipp = 1;
@@ -1817,27 +1833,24 @@ have_chap_secret(char *client, char *server,
 static int
 have_srp_secret(char *client, char *server, int need_ip, int *lacks_ipp)
 {
-    FILE *f;
+    struct secrets_index *sf;
     int ret;
     char *filename;
     struct wordlist *addrs;
 
     if (!ppp_check_access(PPP_PATH_SRPFILE, &filename, 0, 0))
 	return 0;
-    f = fopen(filename, "r");
-    if (f == NULL) {
-	free(filename);
+    sf = secrets_open(filename);
+    free(filename);
+    if (sf == NULL)
 	return 0;
-    }
 
     if (client != NULL && client[0] == 0)
 	client = NULL;
     else if (server != NULL && server[0] == 0)
 	server = NULL;
 
-    ret = scan_authfile(f, client, server, NULL, &addrs, NULL, filename, 0);
-    fclose(f);
-    free(filename);
+    ret = secrets_lookup(sf, client, server, NULL, &addrs, NULL, 0);
     if (ret >= 0 && need_ip && !some_ip_ok(addrs)) {
 	if (lacks_ipp != 0)
 	    *lacks_ipp = 1;
@@ -1859,7 +1872,7 @@ int
 get_secret(int unit, char *client, char *server,
 	   char *secret, int *secret_len, int am_server)
 {
-    FILE *f;
+    struct secrets_index *sf;
     int ret, len;
     char *filename;
     struct wordlist *addrs, *opts;
@@ -1879,17 +1892,15 @@ get_secret(int unit, char *client, char *server,
 	addrs = NULL;
 	secbuf[0] = 0;
 
-	f = fopen(filename, "r");
-	if (f == NULL) {
+	sf = secrets_open(filename);
+	if (sf == NULL) {
 	    error("Can't open chap secret file %s: %m", filename);
 	    free(filename);
 	    return 0;
 	}
-	check_access(f, filename);
-
-	ret = scan_authfile(f, client, server, secbuf, &addrs, &opts, filename, 0);
-	fclose(f);
 	free(filename);
+
+	ret = secrets_lookup(sf, client, server, secbuf, &addrs, &opts, 0);
 	if (ret < 0)
 	    return 0;
 
@@ -1923,7 +1934,7 @@ int
 get_srp_secret(int unit, char *client, char *server,
 	       char *secret, int am_server)
 {
-    FILE *fp;
+    struct secrets_index *sf;
     int ret;
     char *filename;
     struct wordlist *addrs, *opts;
@@ -1935,19 +1946,17 @@ get_srp_secret(int unit, char *client, char *server,
 	    return 0;
 	addrs = NULL;
 
-	fp = fopen(filename, "r");
-	if (fp == NULL) {
+	sf = secrets_open(filename);
+	if (sf == NULL) {
 	    error("Can't open srp secret file %s: %m", filename);
 	    free(filename);
 	    return 0;
 	}
-	check_access(fp, filename);
+	free(filename);
 
 	secret[0] = '\0';
-	ret = scan_authfile(fp, client, server, secret, &addrs, &opts,
-	    filename, am_server);
-	fclose(fp);
-	free(filename);
+	ret = secrets_lookup(sf, client, server, secret, &addrs, &opts,
+	    am_server);
 	if (ret < 0)
 	    return 0;
 
@@ -2228,8 +2237,358 @@ check_access(FILE *f, char *filename)
 
 
 /*
- * scan_authfile - Scan an authorization file for a secret suitable
- * for authenticating `client' on `server'.  The return value is -1
+ * Secrets files are parsed once into an in-memory index and kept for
+ * the life of the process.  Each entry is chained into three hash
+ * tables, keyed on (client, server), on client and on server, so that
+ * a lookup only examines the entries which could possibly match.
+ * Chains are kept in file order, which lets secrets_lookup apply the
+ * same "first best match wins" rule as a sequential scan.  The index
+ * is rebuilt whenever the file's identity, size or timestamps change.
+ */
+struct secret_entry {
+    char		*client;
+    char		*server;
+    char		*secret;
+    char		**words;	/* address and option words */
+    int			nwords;
+    unsigned		order;		/* position in the file */
+    unsigned		reject;		/* lookup which rejected this */
+    struct secret_entry	*next_pair;
+    struct secret_entry	*next_client;
+    struct secret_entry	*next_server;
+};
+
+struct secrets_index {
+    struct secrets_index *next;
+    char		*filename;
+    dev_t		dev;
+    ino_t		ino;
+    off_t		size;
+    struct timespec	mtim;		/* to the nanosecond, so that a */
+    struct timespec	ctim;		/* rewrite within a second shows */
+    struct secret_entry	*entries;
+    unsigned		nentries;
+    unsigned		mask;		/* hash table size - 1 */
+    struct secret_entry	**by_pair;
+    struct secret_entry	**by_client;
+    struct secret_entry	**by_server;
+    unsigned		gen;		/* lookup generation */
+};
+
+static struct secrets_index *secrets_cache;
+
+/*
+ * secrets_hash - FNV-1a hash of one or two strings.
+ */
+static unsigned
+secrets_hash(const char *a, const char *b)
+{
+    unsigned h = 2166136261u;
+
+    for (; *a != 0; ++a)
+	h = (h ^ (unsigned char) *a) * 16777619u;
+    if (b != NULL) {
+	h = (h ^ 0xff) * 16777619u;
+	for (; *b != 0; ++b)
+	    h = (h ^ (unsigned char) *b) * 16777619u;
+    }
+    return h;
+}
+
+/*
+ * secrets_free - release an index, wiping the secrets it holds.
+ */
+static void
+secrets_free(struct secrets_index *idx)
+{
+    struct secret_entry *e;
+    unsigned i;
+    int j;
+
+    for (i = 0; i < idx->nentries; ++i) {
+	e = &idx->entries[i];
+	BZERO(e->secret, strlen(e->secret));
+	free(e->client);
+	free(e->server);
+	free(e->secret);
+	for (j = 0; j < e->nwords; ++j)
+	    free(e->words[j]);
+	free(e->words);
+    }
+    free(idx->entries);
+    free(idx->by_pair);
+    free(idx->by_client);
+    free(idx->by_server);
+    free(idx->filename);
+    free(idx);
+}
+
+static char *
+secrets_strdup(char *word)
+{
+    char *p = strdup(word);
+
+    if (p == NULL)
+	novm("secrets index");
+    return p;
+}
+
+/*
+ * secrets_parse - read the entries of a secrets file into idx.
+ * Lines are split into entries exactly as scan_authfile used to:
+ * a client word at the start of a line, then a server and a secret on
+ * the same line, then any further words up to the end of the line.
+ * Lines with fewer than three words are ignored.
+ */
+static void
+secrets_parse(struct secrets_index *idx, FILE *f, char *filename)
+{
+    int newline, n, max;
+    char word[MAXWORDLEN];
+    struct secret_entry *e;
+    char *client, *server;
+    char **words;
+
+    max = 0;
+    if (!getword(f, word, &newline, filename))
+	return;			/* file is empty??? */
+    newline = 1;
+    for (;;) {
+	/*
+	 * Skip until we find a word at the start of a line.
+	 */
+	while (!newline && getword(f, word, &newline, filename))
+	    ;
+	if (!newline)
+	    break;		/* got to end of file */
+
+	client = secrets_strdup(word);
+	if (!getword(f, word, &newline, filename) || newline) {
+	    free(client);
+	    if (!newline)
+		break;
+	    continue;
+	}
+	server = secrets_strdup(word);
+	if (!getword(f, word, &newline, filename) || newline) {
+	    free(client);
+	    free(server);
+	    if (!newline)
+		break;
+	    continue;
+	}
+
+	if (idx->nentries == max) {
+	    max = max? max * 2: 64;
+	    e = realloc(idx->entries, max * sizeof(*e));
+	    if (e == NULL)
+		novm("secrets index");
+	    idx->entries = e;
+	}
+	e = &idx->entries[idx->nentries];
+	memset(e, 0, sizeof(*e));
+	e->client = client;
+	e->server = server;
+	e->secret = secrets_strdup(word);
+	e->order = idx->nentries++;
+
+	/*
+	 * Now read address authorization info and options.
+	 */
+	n = 0;
+	words = NULL;
+	for (;;) {
+	    if (!getword(f, word, &newline, filename) || newline)
+		break;
+	    if ((n & 7) == 0) {
+		words = realloc(words, (n + 8) * sizeof(char *));
+		if (words == NULL)
+		    novm("secrets index");
+	    }
+	    words[n++] = secrets_strdup(word);
+	}
+	e->words = words;
+	e->nwords = n;
+
+	if (!newline)
+	    break;
+    }
+}
+
+/*
+ * secrets_open - return the index for a secrets file, building it
+ * if it is not cached or the file has changed since it was built.
+ * Returns NULL with errno set if the file can't be opened.
+ */
+static struct secrets_index *
+secrets_open(char *filename)
+{
+    struct secrets_index *idx, **ipp;
+    struct secret_entry *e;
+    struct stat sbuf;
+    FILE *f;
+    unsigned size, h;
+    int i;
+
+    for (ipp = &secrets_cache; (idx = *ipp) != NULL; ipp = &idx->next)
+	if (strcmp(idx->filename, filename) == 0)
+	    break;
+    if (idx != NULL) {
+	if (stat(filename, &sbuf) == 0 && sbuf.st_dev == idx->dev
+	    && sbuf.st_ino == idx->ino && sbuf.st_size == idx->size
+	    && sbuf.st_mtim.tv_sec == idx->mtim.tv_sec
+	    && sbuf.st_mtim.tv_nsec == idx->mtim.tv_nsec
+	    && sbuf.st_ctim.tv_sec == idx->ctim.tv_sec
+	    && sbuf.st_ctim.tv_nsec == idx->ctim.tv_nsec)
+	    return idx;
+	*ipp = idx->next;
+	secrets_free(idx);
+    }
+
+    f = fopen(filename, "r");
+    if (f == NULL)
+	return NULL;
+    check_access(f, filename);
+
+    idx = calloc(1, sizeof(*idx));
+    if (idx == NULL)
+	novm("secrets index");
+    idx->filename = secrets_strdup(filename);
+    if (fstat(fileno(f), &sbuf) == 0) {
+	idx->dev = sbuf.st_dev;
+	idx->ino = sbuf.st_ino;
+	idx->size = sbuf.st_size;
+	idx->mtim = sbuf.st_mtim;
+	idx->ctim = sbuf.st_ctim;
+    }
+    secrets_parse(idx, f, filename);
+    fclose(f);
+
+    for (size = 16; size < idx->nentries; size <<= 1)
+	;
+    idx->mask = size - 1;
+    idx->by_pair = calloc(size, sizeof(struct secret_entry *));
+    idx->by_client = calloc(size, sizeof(struct secret_entry *));
+    idx->by_server = calloc(size, sizeof(struct secret_entry *));
+    if (idx->by_pair == NULL || idx->by_client == NULL
+	|| idx->by_server == NULL)
+	novm("secrets index");
+
+    /* insert in reverse so that each chain ends up in file order */
+    for (i = idx->nentries - 1; i >= 0; --i) {
+	e = &idx->entries[i];
+	h = secrets_hash(e->client, e->server) & idx->mask;
+	e->next_pair = idx->by_pair[h];
+	idx->by_pair[h] = e;
+	h = secrets_hash(e->client, NULL) & idx->mask;
+	e->next_client = idx->by_client[h];
+	idx->by_client[h] = e;
+	h = secrets_hash(e->server, NULL) & idx->mask;
+	e->next_server = idx->by_server[h];
+	idx->by_server[h] = e;
+    }
+
+    idx->next = secrets_cache;
+    secrets_cache = idx;
+    return idx;
+}
+
+/*
+ * secrets_match - check whether an entry can be used for
+ * authenticating `client' on `server'.  Returns -1 if not, otherwise
+ * the NONWILD_* bits describing the match.
+ */
+static int
+secrets_match(struct secret_entry *e, char *client, char *server)
+{
+    int got_flag = 0;
+
+    if (!ISWILD(e->client)) {
+	if (client != NULL && strcmp(e->client, client) != 0)
+	    return -1;
+	got_flag = NONWILD_CLIENT;
+    }
+    if (!ISWILD(e->server)) {
+	if (server != NULL && strcmp(e->server, server) != 0)
+	    return -1;
+	got_flag |= NONWILD_SERVER;
+    }
+    return got_flag;
+}
+
+/*
+ * secrets_consider - update *bestp and *best_flag if e is a better
+ * match than the best found so far.  An entry is better if it has
+ * more non-wildcard fields, or as many and comes earlier in the file.
+ */
+static void
+secrets_consider(struct secrets_index *idx, struct secret_entry *e,
+		 char *client, char *server,
+		 struct secret_entry **bestp, int *best_flag)
+{
+    int got_flag;
+
+    if (e->reject == idx->gen)
+	return;
+    got_flag = secrets_match(e, client, server);
+    if (got_flag < 0 || got_flag < *best_flag)
+	return;
+    if (got_flag == *best_flag && (*bestp)->order < e->order)
+	return;
+    *bestp = e;
+    *best_flag = got_flag;
+}
+
+/*
+ * secrets_find - find the best entry for `client' on `server' that
+ * hasn't been rejected by the current lookup.
+ */
+static struct secret_entry *
+secrets_find(struct secrets_index *idx, char *client, char *server,
+	     int *best_flag)
+{
+    struct secret_entry *e, *best = NULL;
+    unsigned i;
+
+    *best_flag = -1;
+    if (client != NULL && server != NULL) {
+	char *cl[2], *sv[2];
+	int c, s;
+
+	cl[0] = client;
+	cl[1] = "*";
+	sv[0] = server;
+	sv[1] = "*";
+	for (c = 0; c < 2; ++c)
+	    for (s = 0; s < 2; ++s)
+		for (e = idx->by_pair[secrets_hash(cl[c], sv[s]) & idx->mask];
+		     e != NULL; e = e->next_pair)
+		    secrets_consider(idx, e, client, server, &best, best_flag);
+    } else if (client != NULL) {
+	for (e = idx->by_client[secrets_hash(client, NULL) & idx->mask];
+	     e != NULL; e = e->next_client)
+	    secrets_consider(idx, e, client, server, &best, best_flag);
+	for (e = idx->by_client[secrets_hash("*", NULL) & idx->mask];
+	     e != NULL; e = e->next_client)
+	    secrets_consider(idx, e, client, server, &best, best_flag);
+    } else if (server != NULL) {
+	for (e = idx->by_server[secrets_hash(server, NULL) & idx->mask];
+	     e != NULL; e = e->next_server)
+	    secrets_consider(idx, e, client, server, &best, best_flag);
+	for (e = idx->by_server[secrets_hash("*", NULL) & idx->mask];
+	     e != NULL; e = e->next_server)
+	    secrets_consider(idx, e, client, server, &best, best_flag);
+    } else {
+	for (i = 0; i < idx->nentries; ++i)
+	    secrets_consider(idx, &idx->entries[i], client, server,
+			     &best, best_flag);
+    }
+    return best;
+}
+
+/*
+ * secrets_lookup - Look up a secret suitable for authenticating
+ * `client' on `server' in a secrets index.  The return value is -1
  * if no secret is found, otherwise >= 0.  The return value has
  * NONWILD_CLIENT set if the secret didn't have "*" for the client, and
  * NONWILD_SERVER set if the secret didn't have "*" for the server.
@@ -2242,145 +2601,100 @@ check_access(FILE *f, char *filename)
  * match.
  */
 static int
-scan_authfile(FILE *f, char *client, char *server,
-	      char *secret, struct wordlist **addrs,
-	      struct wordlist **opts, char *filename,
-	      int flags)
+secrets_lookup(struct secrets_index *idx, char *client, char *server,
+	       char *secret, struct wordlist **addrs,
+	       struct wordlist **opts, int flags)
 {
-    int newline, xxx;
-    int got_flag, best_flag;
+    int xxx, best_flag, j;
+    unsigned i;
     FILE *sf;
-    struct wordlist *ap, *addr_list, *alist, **app;
+    struct secret_entry *e;
+    struct wordlist *ap, *addr_list, **app;
     char word[MAXWORDLEN];
     char atfile[MAXWORDLEN];
-    char lsecret[MAXWORDLEN];
     char *cp;
 
     if (addrs != NULL)
 	*addrs = NULL;
     if (opts != NULL)
 	*opts = NULL;
-    addr_list = NULL;
-    if (!getword(f, word, &newline, filename))
-	return -1;		/* file is empty??? */
-    newline = 1;
-    best_flag = -1;
-    for (;;) {
-	/*
-	 * Skip until we find a word at the start of a line.
-	 */
-	while (!newline && getword(f, word, &newline, filename))
-	    ;
-	if (!newline)
-	    break;		/* got to end of file */
 
-	/*
-	 * Got a client - check if it's a match or a wildcard.
-	 */
-	got_flag = 0;
-	if (client != NULL && strcmp(word, client) != 0 && !ISWILD(word)) {
-	    newline = 0;
-	    continue;
-	}
-	if (!ISWILD(word))
-	    got_flag = NONWILD_CLIENT;
+    /* a new generation clears all the rejections of previous lookups */
+    if (++idx->gen == 0) {
+	for (i = 0; i < idx->nentries; ++i)
+	    idx->entries[i].reject = 0;
+	idx->gen = 1;
+    }
 
-	/*
-	 * Now get a server and check if it matches.
-	 */
-	if (!getword(f, word, &newline, filename))
-	    break;
-	if (newline)
-	    continue;
-	if (!ISWILD(word)) {
-	    if (server != NULL && strcmp(word, server) != 0)
-		continue;
-	    got_flag |= NONWILD_SERVER;
-	}
+    for (;;) {
+	e = secrets_find(idx, client, server, &best_flag);
+	if (e == NULL)
+	    return -1;
 
 	/*
-	 * Got some sort of a match - see if it's better than what
-	 * we have already.
+	 * SRP-SHA1 authenticator should never be reading secrets from
+	 * a file.  (Authenticatee may, though.)
 	 */
-	if (got_flag <= best_flag)
+	if (flags && ((cp = strchr(e->secret, ':')) == NULL ||
+	    strchr(cp + 1, ':') == NULL)) {
+	    e->reject = idx->gen;
 	    continue;
+	}
 
-	/*
-	 * Get the secret.
-	 */
-	if (!getword(f, word, &newline, filename))
+	if (secret == NULL)
 	    break;
-	if (newline)
-	    continue;
 
+	strlcpy(word, e->secret, sizeof(word));
 	/*
-	 * SRP-SHA1 authenticator should never be reading secrets from
-	 * a file.  (Authenticatee may, though.)
+	 * Special syntax: @/pathname means read secret from file.
 	 */
-	if (flags && ((cp = strchr(word, ':')) == NULL ||
-	    strchr(cp + 1, ':') == NULL))
-	    continue;
+	if (word[0] == '@' && word[1] == '/') {
+	    char *realname;
 
-	if (secret != NULL) {
-	    /*
-	     * Special syntax: @/pathname means read secret from file.
-	     */
-	    if (word[0] == '@' && word[1] == '/') {
-		char *realname;
-
-		strlcpy(atfile, word+1, sizeof(atfile));
-		if (!ppp_check_access(atfile, &realname, 0, 0))
-		    continue;
-		if ((sf = fopen(realname, "r")) == NULL) {
-		    warn("can't open indirect secret file %s", atfile);
-		    free(realname);
-		    continue;
-		}
-		check_access(sf, atfile);
-		if (!getword(sf, word, &xxx, atfile)) {
-		    warn("no secret in indirect secret file %s", atfile);
-		    fclose(sf);
-		    free(realname);
-		    continue;
-		}
+	    strlcpy(atfile, word+1, sizeof(atfile));
+	    if (!ppp_check_access(atfile, &realname, 0, 0)) {
+		e->reject = idx->gen;
+		continue;
+	    }
+	    if ((sf = fopen(realname, "r")) == NULL) {
+		warn("can't open indirect secret file %s", atfile);
+		free(realname);
+		e->reject = idx->gen;
+		continue;
+	    }
+	    check_access(sf, atfile);
+	    if (!getword(sf, word, &xxx, atfile)) {
+		warn("no secret in indirect secret file %s", atfile);
 		fclose(sf);
 		free(realname);
+		e->reject = idx->gen;
+		continue;
 	    }
-	    strlcpy(lsecret, word, sizeof(lsecret));
-	}
-
-	/*
-	 * Now read address authorization info and make a wordlist.
-	 */
-	app = &alist;
-	for (;;) {
-	    if (!getword(f, word, &newline, filename) || newline)
-		break;
-	    ap = (struct wordlist *)
-		    malloc(sizeof(struct wordlist) + strlen(word) + 1);
-	    if (ap == NULL)
-		novm("authorized addresses");
-	    ap->word = (char *) (ap + 1);
-	    strcpy(ap->word, word);
-	    *app = ap;
-	    app = &ap->next;
+	    fclose(sf);
+	    free(realname);
 	}
-	*app = NULL;
-
-	/*
-	 * This is the best so far; remember it.
-	 */
-	best_flag = got_flag;
-	if (addr_list)
-	    free_wordlist(addr_list);
-	addr_list = alist;
-	if (secret != NULL)
-	    strlcpy(secret, lsecret, MAXWORDLEN);
-
-	if (!newline)
-	    break;
+	strlcpy(secret, word, MAXWORDLEN);
+	BZERO(word, sizeof(word));
+	break;
     }
 
+    /*
+     * Now make a wordlist of the address authorization info.
+     */
+    addr_list = NULL;
+    app = &addr_list;
+    for (j = 0; j < e->nwords; ++j) {
+	ap = (struct wordlist *)
+		malloc(sizeof(struct wordlist) + strlen(e->words[j]) + 1);
+	if (ap == NULL)
+	    novm("authorized addresses");
+	ap->word = (char *) (ap + 1);
+	strcpy(ap->word, e->words[j]);
+	*app = ap;
+	app = &ap->next;
+    }
+    *app = NULL;
+
     /* scan for a -- word indicating the start of options */
     for (app = &addr_list; (ap = *app) != NULL; app = &ap->next)
 	if (strcmp(ap->word, "--") == 0)
@@ -107,12 +107,13 @@
 static void	ascii2unicode (char[], int, u_char[]);
 static void	NTPasswordHash (u_char *, int, unsigned char *);
 static int	ChallengeResponse (u_char *, u_char *, u_char*);
-static void	ChapMS_NT (u_char *, char *, int, u_char[24]);
-static void	ChapMS2_NT (u_char *, u_char[16], char *, char *, int,
-				u_char[24]);
-static void	GenerateAuthenticatorResponsePlain
-			(char*, int, u_char[24], u_char[16], u_char *,
-			 char *, u_char[41]);
+static void	NTPasswordHashSecret (char *, int, u_char[16]);
+static void	ChapMS2_NT (u_char *, u_char[16], char *, u_char[16],
+				u_char[8], u_char[24]);
+static void	ChapMS2_Finish (u_char[16], u_char[24], u_char[8],
+				u_char *, int);
+static void	AuthenticatorResponse (u_char[16], u_char[24], u_char[8],
+				       u_char *);
 #ifdef PPP_WITH_MSLANMAN
 static void	ChapMS_LANMan (u_char *, char *, int, u_char *);
 #endif
@@ -236,19 +237,31 @@ chapms2_verify_response(int id, char *name,
 			unsigned char *challenge, unsigned char *response,
 			char *message, int message_space)
 {
-	unsigned char md[MS_CHAP2_RESPONSE_LEN];
+	unsigned char md[MS_CHAP2_NTRESP_LEN];
 	char saresponse[MS_AUTH_RESPONSE_LENGTH+1];
-	int challenge_len, response_len;
+	u_char PasswordHash[MD4_DIGEST_LENGTH];
+	u_char Challenge[8];
+	int challenge_len, response_len, diff;
 
 	challenge_len = *challenge++;	/* skip length, is 16 */
 	response_len = *response++;
 	if (response_len != MS_CHAP2_RESPONSE_LEN)
 		goto bad;	/* not even the right length */
 
-	/* Generate the expected response and our mutual auth. */
-	ChapMS2(challenge, &response[MS_CHAP2_PEER_CHALLENGE], name,
-		(char *)secret, secret_len, md,
-		(unsigned char *)saresponse, MS_CHAP2_AUTHENTICATOR);
+	/*
+	 * Generate the expected NT-Response.  Our mutual auth and the
+	 * MPPE keys are only worked out once the peer has proved it
+	 * knows the password.
+	 */
+	NTPasswordHashSecret((char *)secret, secret_len, PasswordHash);
+	ChapMS2_NT(challenge, &response[MS_CHAP2_PEER_CHALLENGE], name,
+		   PasswordHash, Challenge, md);
+	diff = memcmp(md, &response[MS_CHAP2_NTRESP], MS_CHAP2_NTRESP_LEN);
+	if (diff == 0)
+		ChapMS2_Finish(PasswordHash, md, Challenge,
+			       (unsigned char *)saresponse,
+			       MS_CHAP2_AUTHENTICATOR);
+	BZERO(PasswordHash, sizeof(PasswordHash));
 
 	/* compare MDs and send the appropriate status */
 	/*
@@ -270,8 +283,7 @@ chapms2_verify_response(int id, char *name,
 	 * Special thanks to Alex Swiridov <say@real.kharkov.ua> for
 	 * help debugging this.
 	 */
-	if (memcmp(&md[MS_CHAP2_NTRESP], &response[MS_CHAP2_NTRESP],
-		   MS_CHAP2_NTRESP_LEN) == 0) {
+	if (diff == 0) {
 		if (response[MS_CHAP2_FLAGS])
 			slprintf(message, message_space, "S=%s", saresponse);
 		else
@@ -606,34 +618,31 @@ NTPasswordHash(u_char *secret, int secret_len, unsigned char* hash)
     }
 }
 
+/*
+ * Hash the Unicode version of the secret (== password).  The result
+ * is computed once per response and handed to everything that needs it.
+ */
 static void
-ChapMS_NT(u_char *rchallenge, char *secret, int secret_len,
-	  u_char NTResponse[24])
+NTPasswordHashSecret(char *secret, int secret_len,
+		     u_char PasswordHash[MD4_DIGEST_LENGTH])
 {
     u_char	unicodePassword[MAX_NT_PASSWORD * 2];
-    u_char	PasswordHash[MD4_DIGEST_LENGTH];
 
-    /* Hash the Unicode version of the secret (== password). */
     ascii2unicode(secret, secret_len, unicodePassword);
     NTPasswordHash(unicodePassword, secret_len * 2, PasswordHash);
-
-    ChallengeResponse(rchallenge, PasswordHash, NTResponse);
+    BZERO(unicodePassword, sizeof(unicodePassword));
 }
 
+/*
+ * Compute the MS-CHAPv2 NT-Response.  The 8-byte challenge hash is
+ * returned in Challenge so the Authenticator Response can reuse it.
+ */
 static void
 ChapMS2_NT(u_char *rchallenge, u_char PeerChallenge[16], char *username,
-	   char *secret, int secret_len, u_char NTResponse[24])
+	   u_char PasswordHash[MD4_DIGEST_LENGTH], u_char Challenge[8],
+	   u_char NTResponse[24])
 {
-    u_char	unicodePassword[MAX_NT_PASSWORD * 2];
-    u_char	PasswordHash[MD4_DIGEST_LENGTH];
-    u_char	Challenge[8];
-
     ChallengeHash(PeerChallenge, rchallenge, username, Challenge);
-
-    /* Hash the Unicode version of the secret (== password). */
-    ascii2unicode(secret, secret_len, unicodePassword);
-    NTPasswordHash(unicodePassword, secret_len * 2, PasswordHash);
-
     ChallengeResponse(Challenge, PasswordHash, NTResponse);
 }
 
@@ -667,6 +676,18 @@ GenerateAuthenticatorResponse(unsigned char* PasswordHashHash,
 			      unsigned char *NTResponse, unsigned char *PeerChallenge,
 			      unsigned char *rchallenge, char *username,
 			      unsigned char *authResponse)
+{
+    u_char	Challenge[8];
+
+    ChallengeHash(PeerChallenge, rchallenge, username, Challenge);
+    AuthenticatorResponse(PasswordHashHash, NTResponse, Challenge,
+			  authResponse);
+}
+
+static void
+AuthenticatorResponse(u_char PasswordHashHash[MD4_DIGEST_LENGTH],
+		      u_char NTResponse[24], u_char Challenge[8],
+		      u_char *authResponse)
 {
     /*
      * "Magic" constants used in response generation, from RFC 2759.
@@ -687,7 +708,6 @@ GenerateAuthenticatorResponse(unsigned char* PasswordHashHash,
     PPP_MD_CTX *ctx;
     u_char	Digest[SHA_DIGEST_LENGTH] = {};
     int     hash_len;
-    u_char	Challenge[8];
 
     ctx = PPP_MD_CTX_new();
     if (ctx != NULL) {
@@ -708,8 +728,6 @@ GenerateAuthenticatorResponse(unsigned char* PasswordHashHash,
         }
         PPP_MD_CTX_free(ctx);
     }
-    
-    ChallengeHash(PeerChallenge, rchallenge, username, Challenge);
 
     ctx = PPP_MD_CTX_new();
     if (ctx != NULL) {
@@ -718,7 +736,7 @@ GenerateAuthenticatorResponse(unsigned char* PasswordHashHash,
 
             if (PPP_DigestUpdate(ctx, Digest, sizeof(Digest))) {
 
-                if (PPP_DigestUpdate(ctx, Challenge, sizeof(Challenge))) {
+                if (PPP_DigestUpdate(ctx, Challenge, 8)) {
 
                     if (PPP_DigestUpdate(ctx, Magic2, sizeof(Magic2))) {
                         
@@ -739,62 +757,19 @@ GenerateAuthenticatorResponse(unsigned char* PasswordHashHash,
 }
 
 
-static void
-GenerateAuthenticatorResponsePlain
-		(char *secret, int secret_len,
-		 u_char NTResponse[24], u_char PeerChallenge[16],
-		 u_char *rchallenge, char *username,
-		 u_char authResponse[MS_AUTH_RESPONSE_LENGTH+1])
-{
-    u_char	unicodePassword[MAX_NT_PASSWORD * 2];
-    u_char	PasswordHash[MD4_DIGEST_LENGTH];
-    u_char	PasswordHashHash[MD4_DIGEST_LENGTH];
-
-    /* Hash (x2) the Unicode version of the secret (== password). */
-    ascii2unicode(secret, secret_len, unicodePassword);
-    NTPasswordHash(unicodePassword, secret_len * 2, PasswordHash);
-    NTPasswordHash(PasswordHash, sizeof(PasswordHash),
-		   PasswordHashHash);
-
-    GenerateAuthenticatorResponse(PasswordHashHash, NTResponse, PeerChallenge,
-				  rchallenge, username, authResponse);
-}
-
-
 #ifdef PPP_WITH_MPPE
 
 /*
  * Set mppe_xxxx_key from MS-CHAP credentials. (see RFC 3079)
  */
 static void
-Set_Start_Key(u_char *rchallenge, char *secret, int secret_len)
+Set_Start_Key(u_char *rchallenge, u_char PasswordHash[MD4_DIGEST_LENGTH])
 {
-    u_char	unicodePassword[MAX_NT_PASSWORD * 2];
-    u_char	PasswordHash[MD4_DIGEST_LENGTH];
     u_char	PasswordHashHash[MD4_DIGEST_LENGTH];
 
-    /* Hash (x2) the Unicode version of the secret (== password). */
-    ascii2unicode(secret, secret_len, unicodePassword);
-    NTPasswordHash(unicodePassword, secret_len * 2, PasswordHash);
-    NTPasswordHash(PasswordHash, sizeof(PasswordHash), PasswordHashHash);
-
+    NTPasswordHash(PasswordHash, MD4_DIGEST_LENGTH, PasswordHashHash);
     mppe_set_chapv1(rchallenge, PasswordHashHash);
-}
-
-/*
- * Set mppe_xxxx_key from MS-CHAPv2 credentials. (see RFC 3079)
- */
-static void
-SetMasterKeys(char *secret, int secret_len, u_char NTResponse[24], int IsServer)
-{
-    u_char	unicodePassword[MAX_NT_PASSWORD * 2];
-    u_char	PasswordHash[MD4_DIGEST_LENGTH];
-    u_char	PasswordHashHash[MD4_DIGEST_LENGTH];
-    /* Hash (x2) the Unicode version of the secret (== password). */
-    ascii2unicode(secret, secret_len, unicodePassword);
-    NTPasswordHash(unicodePassword, secret_len * 2, PasswordHash);
-    NTPasswordHash(PasswordHash, sizeof(PasswordHash), PasswordHashHash);
-    mppe_set_chapv2(PasswordHashHash, NTResponse, IsServer);
+    BZERO(PasswordHashHash, sizeof(PasswordHashHash));
 }
 
 #endif /* PPP_WITH_MPPE */
@@ -804,9 +779,12 @@ void
 ChapMS(u_char *rchallenge, char *secret, int secret_len,
        unsigned char *response)
 {
+    u_char	PasswordHash[MD4_DIGEST_LENGTH];
+
     BZERO(response, MS_CHAP_RESPONSE_LEN);
 
-    ChapMS_NT(rchallenge, secret, secret_len, &response[MS_CHAP_NTRESP]);
+    NTPasswordHashSecret(secret, secret_len, PasswordHash);
+    ChallengeResponse(rchallenge, PasswordHash, &response[MS_CHAP_NTRESP]);
 
 #ifdef PPP_WITH_MSLANMAN
     ChapMS_LANMan(rchallenge, secret, secret_len,
@@ -819,8 +797,9 @@ ChapMS(u_char *rchallenge, char *secret, int secret_len,
 #endif
 
 #ifdef PPP_WITH_MPPE
-    Set_Start_Key(rchallenge, secret, secret_len);
+    Set_Start_Key(rchallenge, PasswordHash);
 #endif
+    BZERO(PasswordHash, sizeof(PasswordHash));
 }
 
 
@@ -841,6 +820,8 @@ ChapMS2(unsigned char *rchallenge, unsigned char *PeerChallenge,
 {
     /* ARGSUSED */
     u_char *p = &response[MS_CHAP2_PEER_CHALLENGE];
+    u_char PasswordHash[MD4_DIGEST_LENGTH];
+    u_char Challenge[8];
     int i;
 
     BZERO(response, MS_CHAP2_RESPONSE_LEN);
@@ -854,19 +835,34 @@ ChapMS2(unsigned char *rchallenge, unsigned char *PeerChallenge,
 	      MS_CHAP2_PEER_CHAL_LEN);
 
     /* Generate the NT-Response */
+    NTPasswordHashSecret(secret, secret_len, PasswordHash);
     ChapMS2_NT(rchallenge, &response[MS_CHAP2_PEER_CHALLENGE], user,
-	       secret, secret_len, &response[MS_CHAP2_NTRESP]);
+	       PasswordHash, Challenge, &response[MS_CHAP2_NTRESP]);
+
+    /* Generate the Authenticator Response and the MPPE keys. */
+    ChapMS2_Finish(PasswordHash, &response[MS_CHAP2_NTRESP], Challenge,
+		   authResponse, authenticator);
+    BZERO(PasswordHash, sizeof(PasswordHash));
+}
 
-    /* Generate the Authenticator Response. */
-    GenerateAuthenticatorResponsePlain(secret, secret_len,
-				       &response[MS_CHAP2_NTRESP],
-				       &response[MS_CHAP2_PEER_CHALLENGE],
-				       rchallenge, user, authResponse);
+/*
+ * Given the password hash and challenge hash behind an NT-Response,
+ * generate the Authenticator Response and set the MPPE master keys.
+ * (see RFC 2759 and RFC 3079)
+ */
+static void
+ChapMS2_Finish(u_char PasswordHash[MD4_DIGEST_LENGTH], u_char NTResponse[24],
+	       u_char Challenge[8], u_char *authResponse, int authenticator)
+{
+    u_char	PasswordHashHash[MD4_DIGEST_LENGTH];
 
+    NTPasswordHash(PasswordHash, MD4_DIGEST_LENGTH, PasswordHashHash);
+    AuthenticatorResponse(PasswordHashHash, NTResponse, Challenge,
+			  authResponse);
 #ifdef PPP_WITH_MPPE
-    SetMasterKeys(secret, secret_len,
-		  &response[MS_CHAP2_NTRESP], authenticator);
+    mppe_set_chapv2(PasswordHashHash, NTResponse, authenticator);
 #endif
+    BZERO(PasswordHashHash, sizeof(PasswordHashHash));
 }
 
 
@@ -0,0 +1,509 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*
+ * control.c - answer requests on a unix control socket.
+ *
+ * With the "control" option, pppd listens on a unix SOCK_SEQPACKET
+ * socket and serves requests from its main loop: status, counters,
+ * negotiated options, LCP echo state and pending timers can be read,
+ * and the echo interval and debug level changed, without signals or
+ * external tools.  The message formats are in control.h.
+ *
+ * Copyright (c) 2026 The pppd Project. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THE AUTHORS OF THIS SOFTWARE DISCLAIM ALL WARRANTIES WITH REGARD TO
+ * THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+ * AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "pppd-private.h"
+#include "fsm.h"
+#include "lcp.h"
+#include "ipcp.h"
+#ifdef PPP_WITH_IPV6CP
+#include "ipv6cp.h"
+#endif
+#include "ccp.h"
+#include "control.h"
+#include "meter.h"
+
+#define CONTROL_MAX_CLIENTS	8
+
+char *control_path = NULL;	/* unix socket for control requests */
+
+static int control_fd = -1;
+static int control_clients[CONTROL_MAX_CLIENTS];
+static int control_nclients;
+
+static unsigned char control_buf[PPP_CTL_MAXMSG];
+
+static void control_accept(int, void *);
+static void control_request(int, void *);
+
+/*
+ * control_init - start listening on the control socket, if one
+ * was asked for.
+ */
+void
+control_init(void)
+{
+    struct sockaddr_un sun;
+    mode_t mask;
+    int fd;
+
+    if (control_path == NULL || control_fd >= 0)
+	return;
+    if (strlen(control_path) >= sizeof(sun.sun_path)) {
+	error("Control socket path %s is too long", control_path);
+	return;
+    }
+    memset(&sun, 0, sizeof(sun));
+    sun.sun_family = AF_UNIX;
+    strlcpy(sun.sun_path, control_path, sizeof(sun.sun_path));
+
+    fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (fd < 0) {
+	error("Couldn't create control socket: %m");
+	return;
+    }
+    unlink(control_path);
+    mask = umask(0177);
+    if (bind(fd, (struct sockaddr *) &sun, sizeof(sun)) < 0
+	|| listen(fd, CONTROL_MAX_CLIENTS) < 0) {
+	error("Couldn't listen on control socket %s: %m", control_path);
+	umask(mask);
+	close(fd);
+	return;
+    }
+    umask(mask);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    control_fd = fd;
+    add_fd_callback(fd, control_accept, NULL);
+}
+
+/*
+ * control_cleanup - close the control socket and its connections.
+ */
+void
+control_cleanup(void)
+{
+    int i;
+
+    for (i = 0; i < control_nclients; ++i)
+	close(control_clients[i]);
+    control_nclients = 0;
+    if (control_fd >= 0) {
+	close(control_fd);
+	unlink(control_path);
+	control_fd = -1;
+    }
+}
+
+/*
+ * control_forked - in a child that carries on as a pppd of its own,
+ * let go of the control socket, which stays with the parent.
+ */
+void
+control_forked(void)
+{
+    int i;
+
+    for (i = 0; i < control_nclients; ++i) {
+	remove_fd(control_clients[i]);
+	close(control_clients[i]);
+    }
+    control_nclients = 0;
+    if (control_fd >= 0) {
+	remove_fd(control_fd);
+	close(control_fd);
+	control_fd = -1;
+    }
+}
+
+const char *
+ppp_control_path(void)
+{
+    return control_path;
+}
+
+static void
+control_accept(int fd, void *ctx)
+{
+    int cfd;
+
+    cfd = accept(fd, NULL, NULL);
+    if (cfd < 0) {
+	if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+	    error("Control socket accept: %m");
+	return;
+    }
+    if (control_nclients >= CONTROL_MAX_CLIENTS) {
+	warn("Too many control connections");
+	close(cfd);
+	return;
+    }
+    fcntl(cfd, F_SETFD, FD_CLOEXEC);
+    fcntl(cfd, F_SETFL, fcntl(cfd, F_GETFL) | O_NONBLOCK);
+    control_clients[control_nclients++] = cfd;
+    add_fd_callback(cfd, control_request, NULL);
+}
+
+static void
+control_drop(int fd)
+{
+    int i;
+
+    remove_fd(fd);
+    close(fd);
+    for (i = 0; i < control_nclients; ++i)
+	if (control_clients[i] == fd) {
+	    control_clients[i] = control_clients[--control_nclients];
+	    break;
+	}
+}
+
+/*
+ * control_put - append len bytes to a reply, if there is room.
+ */
+static int
+control_put(int *pos, const void *data, size_t len)
+{
+    if (*pos + len > sizeof(control_buf))
+	return 0;
+    memcpy(control_buf + *pos, data, len);
+    *pos += len;
+    return 1;
+}
+
+static void
+control_put_options(int *pos, int protocol, int which, const void *opts,
+		    size_t len)
+{
+    struct ppp_ctl_options rec;
+
+    rec.protocol = protocol;
+    rec.which = which;
+    rec.len = len;
+    if (*pos + sizeof(rec) + len <= sizeof(control_buf)) {
+	control_put(pos, &rec, sizeof(rec));
+	control_put(pos, opts, len);
+    }
+}
+
+static int
+control_get_status(int *pos)
+{
+    struct ppp_ctl_status st;
+
+    memset(&st, 0, sizeof(st));
+    st.version = PPP_CTL_VERSION;
+    st.pid = getpid();
+    st.phase = ppp_get_phase();
+    st.debug = debug;
+    st.ifunit = ifunit;
+    strlcpy(st.ifname, ifname, sizeof(st.ifname));
+    control_put(pos, &st, sizeof(st));
+    return 0;
+}
+
+static int
+control_get_stats(int *pos)
+{
+    struct ppp_ctl_stats st;
+    const struct ppp_meter_sample *m;
+
+    memset(&st, 0, sizeof(st));
+    st.xmit_idle = st.recv_idle = -1;
+    if (in_phase(PHASE_RUNNING) && (m = ppp_meter_read())->stats_valid) {
+	st.bytes_in = m->stats.bytes_in;
+	st.bytes_out = m->stats.bytes_out;
+	st.pkts_in = m->stats.pkts_in;
+	st.pkts_out = m->stats.pkts_out;
+	st.errors_in = m->stats.errors_in;
+	st.errors_out = m->stats.errors_out;
+	st.dropped_in = m->stats.dropped_in;
+	st.dropped_out = m->stats.dropped_out;
+	st.connect_time = m->connect_time;
+	st.valid = 1;
+	if (m->idle_valid) {
+	    st.xmit_idle = m->xmit_idle;
+	    st.recv_idle = m->recv_idle;
+	}
+    }
+    control_put(pos, &st, sizeof(st));
+    return 0;
+}
+
+#define FLAG(cond, bit)	((cond)? (bit): 0)
+
+static void
+control_put_lcp(int *pos, int which, const lcp_options *o)
+{
+    struct ppp_ctl_lcp w;
+
+    memset(&w, 0, sizeof(w));
+    w.flags = FLAG(o->neg_mru, PPP_CTL_LCP_MRU)
+	| FLAG(o->neg_asyncmap, PPP_CTL_LCP_ASYNCMAP)
+	| FLAG(o->neg_upap, PPP_CTL_LCP_UPAP)
+	| FLAG(o->neg_chap, PPP_CTL_LCP_CHAP)
+	| FLAG(o->neg_eap, PPP_CTL_LCP_EAP)
+	| FLAG(o->neg_magicnumber, PPP_CTL_LCP_MAGIC)
+	| FLAG(o->neg_pcompression, PPP_CTL_LCP_PCOMP)
+	| FLAG(o->neg_accompression, PPP_CTL_LCP_ACCOMP)
+	| FLAG(o->neg_lqr, PPP_CTL_LCP_LQR)
+	| FLAG(o->neg_cbcp, PPP_CTL_LCP_CBCP)
+	| FLAG(o->neg_mrru, PPP_CTL_LCP_MRRU)
+	| FLAG(o->neg_ssnhf, PPP_CTL_LCP_SSNHF)
+	| FLAG(o->neg_endpoint, PPP_CTL_LCP_ENDPOINT);
+    w.mru = o->mru;
+    w.mrru = o->mrru;
+    w.asyncmap = o->asyncmap;
+    w.magic = o->magicnumber;
+    w.lqr_period = o->lqr_period;
+    w.chap_mdtype = o->chap_mdtype;
+    control_put_options(pos, PPP_LCP, which, &w, sizeof(w));
+}
+
+static void
+control_put_ipcp(int *pos, int which, const ipcp_options *o)
+{
+    struct ppp_ctl_ipcp w;
+
+    memset(&w, 0, sizeof(w));
+    w.flags = FLAG(o->neg_addr, PPP_CTL_IPCP_ADDR)
+	| FLAG(o->neg_vj, PPP_CTL_IPCP_VJ)
+	| FLAG(o->cflag, PPP_CTL_IPCP_VJ_CFLAG)
+	| FLAG(o->req_dns1, PPP_CTL_IPCP_DNS1)
+	| FLAG(o->req_dns2, PPP_CTL_IPCP_DNS2)
+	| FLAG(o->req_wins1, PPP_CTL_IPCP_WINS1)
+	| FLAG(o->req_wins2, PPP_CTL_IPCP_WINS2);
+    w.ouraddr = o->ouraddr;
+    w.hisaddr = o->hisaddr;
+    w.dns[0] = o->dnsaddr[0];
+    w.dns[1] = o->dnsaddr[1];
+    w.wins[0] = o->winsaddr[0];
+    w.wins[1] = o->winsaddr[1];
+    w.vj_protocol = o->vj_protocol;
+    w.vj_maxslot = o->maxslotindex;
+    control_put_options(pos, PPP_IPCP, which, &w, sizeof(w));
+}
+
+#ifdef PPP_WITH_IPV6CP
+static void
+control_put_ipv6cp(int *pos, int which, const ipv6cp_options *o)
+{
+    struct ppp_ctl_ipv6cp w;
+
+    memset(&w, 0, sizeof(w));
+    w.flags = FLAG(o->neg_ifaceid, PPP_CTL_IPV6CP_IFACEID)
+	| FLAG(o->neg_vj, PPP_CTL_IPV6CP_VJ);
+    memcpy(w.ourid, &o->ourid, sizeof(w.ourid));
+    memcpy(w.hisid, &o->hisid, sizeof(w.hisid));
+    w.vj_protocol = o->vj_protocol;
+    control_put_options(pos, PPP_IPV6CP, which, &w, sizeof(w));
+}
+#endif
+
+static void
+control_put_ccp(int *pos, int which, const ccp_options *o)
+{
+    struct ppp_ctl_ccp w;
+
+    memset(&w, 0, sizeof(w));
+    w.flags = FLAG(o->bsd_compress, PPP_CTL_CCP_BSD)
+	| FLAG(o->deflate, PPP_CTL_CCP_DEFLATE)
+	| FLAG(o->predictor_1, PPP_CTL_CCP_PRED1)
+	| FLAG(o->predictor_2, PPP_CTL_CCP_PRED2)
+	| FLAG(o->mppe, PPP_CTL_CCP_MPPE);
+    w.mppe = o->mppe;
+    w.method = o->method;
+    w.bsd_bits = o->bsd_bits;
+    w.deflate_size = o->deflate_size;
+    control_put_options(pos, PPP_CCP, which, &w, sizeof(w));
+}
+
+/*
+ * control_get_options - the negotiated options, copied field by field
+ * into the fixed layouts of control.h rather than sent as pppd's own
+ * structures, which change with the build.
+ */
+static int
+control_get_options(int *pos)
+{
+    control_put_lcp(pos, PPP_CTL_GOT, &lcp_gotoptions[0]);
+    control_put_lcp(pos, PPP_CTL_HIS, &lcp_hisoptions[0]);
+    control_put_ipcp(pos, PPP_CTL_GOT, &ipcp_gotoptions[0]);
+    control_put_ipcp(pos, PPP_CTL_HIS, &ipcp_hisoptions[0]);
+#ifdef PPP_WITH_IPV6CP
+    control_put_ipv6cp(pos, PPP_CTL_GOT, &ipv6cp_gotoptions[0]);
+    control_put_ipv6cp(pos, PPP_CTL_HIS, &ipv6cp_hisoptions[0]);
+#endif
+    control_put_ccp(pos, PPP_CTL_GOT, &ccp_gotoptions[0]);
+    control_put_ccp(pos, PPP_CTL_HIS, &ccp_hisoptions[0]);
+    return 0;
+}
+
+static int
+control_get_echo(int *pos)
+{
+    struct ppp_ctl_echo e;
+    int pending;
+    long srtt, rttvar;
+
+    lcp_echo_stats(&pending, &srtt, &rttvar);
+    e.interval = lcp_echo_interval;
+    e.interval_ms = lcp_echo_interval_ms;
+    e.fails = lcp_echo_fails;
+    e.pending = pending;
+    e.srtt = srtt;
+    e.rttvar = rttvar;
+    control_put(pos, &e, sizeof(e));
+    return 0;
+}
+
+static void
+control_add_timer(void *ctx, void (*func)(void *), void *arg, long usecs)
+{
+    struct ppp_ctl_timer t;
+
+    t.usecs = usecs;
+    control_put((int *) ctx, &t, sizeof(t));
+}
+
+static int
+control_get_timers(int *pos)
+{
+    ppp_timer_walk(control_add_timer, pos);
+    return 0;
+}
+
+static int
+control_set_echo(unsigned char *data, int len)
+{
+    struct ppp_ctl_echo e;
+
+    if (len < sizeof(e))
+	return EINVAL;
+    memcpy(&e, data, sizeof(e));
+    if (e.interval < -1 || e.interval_ms < -1 || e.fails < -1)
+	return EINVAL;
+    if (e.interval >= 0)
+	lcp_echo_interval = e.interval;
+    if (e.interval_ms >= 0)
+	lcp_echo_interval_ms = e.interval_ms;
+    if (e.fails >= 0)
+	lcp_echo_fails = e.fails;
+    notice("LCP echo interval set to %d s, %d ms, failure count %d",
+	   lcp_echo_interval, lcp_echo_interval_ms, lcp_echo_fails);
+    lcp_echo_restart(0);
+    return 0;
+}
+
+static int
+control_set_debug(unsigned char *data, int len)
+{
+    int32_t level;
+
+    if (len < sizeof(level))
+	return EINVAL;
+    memcpy(&level, data, sizeof(level));
+    if (level < 0)
+	return EINVAL;
+    debug = level;
+    setlogmask(LOG_UPTO(debug? LOG_DEBUG: LOG_WARNING));
+    return 0;
+}
+
+/*
+ * control_request - read a request from a client and answer it.
+ */
+static void
+control_request(int fd, void *ctx)
+{
+    struct ppp_ctl_msg req, rep;
+    unsigned char data[PPP_CTL_MAXMSG];
+    int n, pos, status;
+
+    n = recv(fd, data, sizeof(data), 0);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+	return;
+    if (n < (int) sizeof(req)) {
+	/* end of file, error or garbage */
+	control_drop(fd);
+	return;
+    }
+    memcpy(&req, data, sizeof(req));
+    n -= sizeof(req);
+    if (req.len < (uint32_t) n)
+	n = req.len;
+
+    pos = sizeof(rep);
+    switch (req.type) {
+    case PPP_CTL_GET_STATUS:
+	status = control_get_status(&pos);
+	break;
+    case PPP_CTL_GET_STATS:
+	status = control_get_stats(&pos);
+	break;
+    case PPP_CTL_GET_OPTIONS:
+	status = control_get_options(&pos);
+	break;
+    case PPP_CTL_GET_ECHO:
+	status = control_get_echo(&pos);
+	break;
+    case PPP_CTL_GET_TIMERS:
+	status = control_get_timers(&pos);
+	break;
+    case PPP_CTL_SET_ECHO:
+	status = control_set_echo(data + sizeof(req), n);
+	break;
+    case PPP_CTL_SET_DEBUG:
+	status = control_set_debug(data + sizeof(req), n);
+	break;
+    default:
+	status = EINVAL;
+    }
+    if (status != 0)
+	pos = sizeof(rep);
+
+    rep.type = req.type;
+    rep.status = status;
+    rep.len = pos - sizeof(rep);
+    memcpy(control_buf, &rep, sizeof(rep));
+    if (send(fd, control_buf, pos, MSG_DONTWAIT) < 0) {
+	if (errno != EAGAIN && errno != EWOULDBLOCK)
+	    dbglog("Control socket send: %m");
+	control_drop(fd);
+    }
+}
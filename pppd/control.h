@@ -0,0 +1,197 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*
+ * control.h - Messages on the pppd control socket.
+ *
+ * Copyright (c) 2026 The pppd Project. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THE AUTHORS OF THIS SOFTWARE DISCLAIM ALL WARRANTIES WITH REGARD TO
+ * THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+ * AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef PPP_CONTROL_H
+#define PPP_CONTROL_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * The "control" option makes pppd listen on a unix SOCK_SEQPACKET
+ * socket.  Each request is one message, a ppp_ctl_msg header followed
+ * by len bytes of data, and gets one reply message of the same type.
+ * Everything is in host byte order; the socket is local to the machine.
+ */
+struct ppp_ctl_msg {
+    uint16_t	type;		/* PPP_CTL_* */
+    uint16_t	status;		/* in replies, 0 or an errno value */
+    uint32_t	len;		/* length of the data that follows */
+};
+
+#define PPP_CTL_VERSION		1	/* ppp_ctl_status.version */
+#define PPP_CTL_MAXMSG		4096	/* largest request or reply */
+
+/* Requests with no data */
+#define PPP_CTL_GET_STATUS	1	/* reply: struct ppp_ctl_status */
+#define PPP_CTL_GET_STATS	2	/* reply: struct ppp_ctl_stats */
+#define PPP_CTL_GET_OPTIONS	3	/* reply: ppp_ctl_options records */
+#define PPP_CTL_GET_ECHO	4	/* reply: struct ppp_ctl_echo */
+#define PPP_CTL_GET_TIMERS	5	/* reply: struct ppp_ctl_timer array */
+
+/* Requests that change something; the reply has no data */
+#define PPP_CTL_SET_ECHO	16	/* data: struct ppp_ctl_echo */
+#define PPP_CTL_SET_DEBUG	17	/* data: int32_t debug level */
+
+struct ppp_ctl_status {
+    uint32_t	version;	/* PPP_CTL_VERSION */
+    int32_t	pid;
+    int32_t	phase;		/* ppp_phase_t */
+    int32_t	debug;
+    int32_t	ifunit;		/* -1 before the interface exists */
+    char	ifname[32];
+};
+
+/*
+ * Counters since IPCP came up (as in the BYTES_SENT etc. given to the
+ * ip-down script), and how long ago data last went each way.
+ */
+struct ppp_ctl_stats {
+    uint64_t	bytes_in;
+    uint64_t	bytes_out;
+    uint64_t	pkts_in;
+    uint64_t	pkts_out;
+    uint32_t	connect_time;	/* seconds since IPCP came up */
+    int32_t	xmit_idle;	/* seconds, or -1 if unknown */
+    int32_t	recv_idle;
+    uint32_t	valid;		/* 0 if the link isn't up */
+    uint32_t	errors_in;	/* 0 where the system doesn't count */
+    uint32_t	errors_out;
+    uint32_t	dropped_in;
+    uint32_t	dropped_out;
+};
+
+/*
+ * The GET_OPTIONS reply is a sequence of records, each this header
+ * followed by len bytes of the structure for the protocol below.  A
+ * client should skip records it doesn't know, and use only the first
+ * len bytes of those it does, so that fields can be added at the end.
+ */
+struct ppp_ctl_options {
+    uint16_t	protocol;	/* PPP_LCP, PPP_IPCP, PPP_IPV6CP, PPP_CCP */
+    uint16_t	which;		/* PPP_CTL_GOT or PPP_CTL_HIS */
+    uint32_t	len;
+};
+#define PPP_CTL_GOT	0	/* what the peer agreed we do */
+#define PPP_CTL_HIS	1	/* what we agreed the peer does */
+
+/* PPP_LCP */
+struct ppp_ctl_lcp {
+    uint32_t	flags;		/* PPP_CTL_LCP_* */
+    uint32_t	mru;
+    uint32_t	mrru;
+    uint32_t	asyncmap;
+    uint32_t	magic;
+    uint32_t	lqr_period;	/* 1/100 s */
+    uint32_t	chap_mdtype;	/* MDTYPE_* from chap.h */
+};
+#define PPP_CTL_LCP_MRU		0x0001
+#define PPP_CTL_LCP_ASYNCMAP	0x0002
+#define PPP_CTL_LCP_UPAP	0x0004
+#define PPP_CTL_LCP_CHAP	0x0008
+#define PPP_CTL_LCP_EAP		0x0010
+#define PPP_CTL_LCP_MAGIC	0x0020
+#define PPP_CTL_LCP_PCOMP	0x0040
+#define PPP_CTL_LCP_ACCOMP	0x0080
+#define PPP_CTL_LCP_LQR		0x0100
+#define PPP_CTL_LCP_CBCP	0x0200
+#define PPP_CTL_LCP_MRRU	0x0400
+#define PPP_CTL_LCP_SSNHF	0x0800
+#define PPP_CTL_LCP_ENDPOINT	0x1000
+
+/* PPP_IPCP; addresses are in network byte order */
+struct ppp_ctl_ipcp {
+    uint32_t	flags;		/* PPP_CTL_IPCP_* */
+    uint32_t	ouraddr;
+    uint32_t	hisaddr;
+    uint32_t	dns[2];
+    uint32_t	wins[2];
+    uint16_t	vj_protocol;
+    uint16_t	vj_maxslot;
+};
+#define PPP_CTL_IPCP_ADDR	0x0001
+#define PPP_CTL_IPCP_VJ		0x0002
+#define PPP_CTL_IPCP_VJ_CFLAG	0x0004
+#define PPP_CTL_IPCP_DNS1	0x0008
+#define PPP_CTL_IPCP_DNS2	0x0010
+#define PPP_CTL_IPCP_WINS1	0x0020
+#define PPP_CTL_IPCP_WINS2	0x0040
+
+/* PPP_IPV6CP */
+struct ppp_ctl_ipv6cp {
+    uint32_t	flags;		/* PPP_CTL_IPV6CP_* */
+    uint8_t	ourid[8];	/* interface identifiers */
+    uint8_t	hisid[8];
+    uint16_t	vj_protocol;
+    uint16_t	pad;
+};
+#define PPP_CTL_IPV6CP_IFACEID	0x0001
+#define PPP_CTL_IPV6CP_VJ	0x0002
+
+/* PPP_CCP */
+struct ppp_ctl_ccp {
+    uint32_t	flags;		/* PPP_CTL_CCP_* */
+    uint32_t	mppe;		/* MPPE_OPT_* from mppe.h */
+    int32_t	method;		/* compression option type in use, or 0 */
+    uint16_t	bsd_bits;
+    uint16_t	deflate_size;
+};
+#define PPP_CTL_CCP_BSD		0x0001
+#define PPP_CTL_CCP_DEFLATE	0x0002
+#define PPP_CTL_CCP_PRED1	0x0004
+#define PPP_CTL_CCP_PRED2	0x0008
+#define PPP_CTL_CCP_MPPE	0x0010
+
+/*
+ * LCP echo settings and state.  SET_ECHO sets interval, interval_ms and
+ * fails, except for those given as -1, and ignores the other fields.
+ */
+struct ppp_ctl_echo {
+    int32_t	interval;	/* lcp-echo-interval, seconds */
+    int32_t	interval_ms;	/* lcp-echo-interval-ms */
+    int32_t	fails;		/* lcp-echo-failure */
+    int32_t	pending;	/* unanswered echo-requests */
+    int32_t	srtt;		/* smoothed echo RTT, us */
+    int32_t	rttvar;		/* its variation, us */
+};
+
+/*
+ * Each pending timer, soonest first.  Only the time is given: the
+ * routine and its argument are pointers, which mean nothing outside
+ * this pppd.
+ */
+struct ppp_ctl_timer {
+    int64_t	usecs;		/* until it is due */
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PPP_CONTROL_H */
@@ -0,0 +1,343 @@
+/*
+ * Talk to control.c over a real unix socket, with the rest of pppd
+ * replaced by stubs, and check the replies against control.h.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+
+#include "pppd-private.h"
+#include "fsm.h"
+#include "lcp.h"
+#include "ipcp.h"
+#ifdef PPP_WITH_IPV6CP
+#include "ipv6cp.h"
+#endif
+#include "ccp.h"
+#include "control.h"
+#include "meter.h"
+
+/* globals and routines normally provided by the rest of pppd */
+int debug;
+int error_count;
+int unsuccess;
+int ifunit = 3;
+char ifname[IFNAMSIZ] = "ppp3";
+lcp_options lcp_gotoptions[NUM_PPP], lcp_hisoptions[NUM_PPP];
+ipcp_options ipcp_gotoptions[NUM_PPP], ipcp_hisoptions[NUM_PPP];
+#ifdef PPP_WITH_IPV6CP
+ipv6cp_options ipv6cp_gotoptions[NUM_PPP], ipv6cp_hisoptions[NUM_PPP];
+#endif
+ccp_options ccp_gotoptions[NUM_PPP], ccp_hisoptions[NUM_PPP];
+int lcp_echo_interval = 30;
+int lcp_echo_interval_ms = 0;
+int lcp_echo_fails = 4;
+
+static int echo_restarts;
+
+void lcp_echo_restart(int unit) { ++echo_restarts; }
+void lcp_echo_stats(int *pending, long *srtt, long *rttvar)
+{
+    *pending = 1;
+    *srtt = 2500;
+    *rttvar = 300;
+}
+bool in_phase(ppp_phase_t p) { return p == PHASE_RUNNING; }
+ppp_phase_t ppp_get_phase(void) { return PHASE_RUNNING; }
+
+const struct ppp_meter_sample *
+ppp_meter_read(void)
+{
+    static struct ppp_meter_sample m;
+
+    m.stats_valid = 1;
+    m.stats.bytes_in = 5000000000ULL;
+    m.stats.pkts_out = 7;
+    m.stats.errors_in = 2;
+    m.connect_time = 60;
+    m.idle_valid = 1;
+    m.xmit_idle = 5;
+    m.recv_idle = 6;
+    return &m;
+}
+
+void
+ppp_timer_walk(void (*fn)(void *, void (*)(void *), void *, long), void *ctx)
+{
+    (*fn)(ctx, NULL, NULL, 1000);
+    (*fn)(ctx, NULL, NULL, 250000);
+}
+
+/* The one fd callback control.c has registered most recently */
+static int cb_fd = -1;
+static event_cb cb_func;
+static int removed_fd = -1;
+
+void
+add_fd_callback(int fd, event_cb func, void *ctx)
+{
+    cb_fd = fd;
+    cb_func = func;
+}
+
+void remove_fd(int fd) { removed_fd = fd; }
+
+/*
+ * Send a request and let control.c answer it; returns the length of
+ * the reply's data, or -1 with the status in *status.
+ */
+static int
+request(int fd, int type, const void *data, int len, void *reply, int max,
+	int *status)
+{
+    unsigned char buf[PPP_CTL_MAXMSG];
+    struct ppp_ctl_msg msg;
+    int n;
+
+    msg.type = type;
+    msg.status = 0;
+    msg.len = len;
+    memcpy(buf, &msg, sizeof(msg));
+    memcpy(buf + sizeof(msg), data, len);
+    if (send(fd, buf, sizeof(msg) + len, 0) < 0) {
+	perror("control: send");
+	exit(1);
+    }
+    (*cb_func)(cb_fd, NULL);
+    n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+    if (n < (int) sizeof(msg)) {
+	printf("control: no reply to request %d\n", type);
+	return -2;
+    }
+    memcpy(&msg, buf, sizeof(msg));
+    *status = msg.status;
+    if (msg.type != type || msg.len != n - sizeof(msg)) {
+	printf("control: reply type %d len %u for request %d of %d bytes\n",
+	       msg.type, msg.len, type, n);
+	return -2;
+    }
+    if (msg.status != 0)
+	return -1;
+    if (msg.len > max)
+	msg.len = max;
+    memcpy(reply, buf + sizeof(msg), msg.len);
+    return msg.len;
+}
+
+static int
+status_test(int fd)
+{
+    struct ppp_ctl_status st;
+    struct ppp_ctl_stats stats;
+    int status, failed = 0;
+
+    if (request(fd, PPP_CTL_GET_STATUS, NULL, 0, &st, sizeof(st), &status)
+	!= sizeof(st) || st.version != PPP_CTL_VERSION || st.pid != getpid()
+	|| st.ifunit != 3 || strcmp(st.ifname, "ppp3") != 0) {
+	printf("control: bad status reply\n");
+	++failed;
+    }
+    if (request(fd, PPP_CTL_GET_STATS, NULL, 0, &stats, sizeof(stats),
+		&status) != sizeof(stats)
+	|| !stats.valid || stats.bytes_in != 5000000000ULL
+	|| stats.pkts_out != 7 || stats.errors_in != 2
+	|| stats.connect_time != 60 || stats.xmit_idle != 5
+	|| stats.recv_idle != 6) {
+	printf("control: bad stats reply\n");
+	++failed;
+    }
+    return failed;
+}
+
+/*
+ * The options come as fixed records: look for the ones we set and
+ * check that every record is accounted for.
+ */
+static int
+options_test(int fd)
+{
+    unsigned char buf[PPP_CTL_MAXMSG], *p;
+    struct ppp_ctl_options rec;
+    struct ppp_ctl_lcp lcp;
+    struct ppp_ctl_ipcp ipcp;
+    int n, status, nrec = 0, seen = 0, failed = 0;
+
+    lcp_gotoptions[0].neg_magicnumber = 1;
+    lcp_gotoptions[0].magicnumber = 0xdeadbeef;
+    lcp_gotoptions[0].neg_pcompression = 1;
+    lcp_hisoptions[0].neg_mru = 1;
+    lcp_hisoptions[0].mru = 1492;
+    ipcp_gotoptions[0].neg_addr = 1;
+    ipcp_gotoptions[0].ouraddr = htonl(0x0a000001);
+    ipcp_hisoptions[0].hisaddr = htonl(0x0a000002);
+
+    n = request(fd, PPP_CTL_GET_OPTIONS, NULL, 0, buf, sizeof(buf), &status);
+    for (p = buf; n >= (int) sizeof(rec); p += rec.len, n -= rec.len) {
+	memcpy(&rec, p, sizeof(rec));
+	p += sizeof(rec);
+	n -= sizeof(rec);
+	if (rec.len > n)
+	    break;
+	++nrec;
+	if (rec.protocol == PPP_LCP && rec.len == sizeof(lcp)) {
+	    memcpy(&lcp, p, sizeof(lcp));
+	    if (rec.which == PPP_CTL_GOT
+		&& lcp.flags == (PPP_CTL_LCP_MAGIC | PPP_CTL_LCP_PCOMP)
+		&& lcp.magic == 0xdeadbeef)
+		seen |= 1;
+	    if (rec.which == PPP_CTL_HIS && lcp.flags == PPP_CTL_LCP_MRU
+		&& lcp.mru == 1492)
+		seen |= 2;
+	}
+	if (rec.protocol == PPP_IPCP && rec.len == sizeof(ipcp)) {
+	    memcpy(&ipcp, p, sizeof(ipcp));
+	    if (rec.which == PPP_CTL_GOT && ipcp.flags == PPP_CTL_IPCP_ADDR
+		&& ipcp.ouraddr == htonl(0x0a000001))
+		seen |= 4;
+	    if (rec.which == PPP_CTL_HIS && ipcp.flags == 0
+		&& ipcp.hisaddr == htonl(0x0a000002))
+		seen |= 8;
+	}
+    }
+    if (n != 0 || seen != 15) {
+	printf("control: options reply has %d bytes left over, found %x"
+	       " of the options set\n", n, seen);
+	++failed;
+    }
+#ifdef PPP_WITH_IPV6CP
+    if (nrec != 8) {
+#else
+    if (nrec != 6) {
+#endif
+	printf("control: %d options records\n", nrec);
+	++failed;
+    }
+    return failed;
+}
+
+static int
+echo_test(int fd)
+{
+    struct ppp_ctl_echo e;
+    struct ppp_ctl_timer t[4];
+    int32_t level;
+    int n, status, failed = 0;
+
+    if (request(fd, PPP_CTL_GET_ECHO, NULL, 0, &e, sizeof(e), &status)
+	!= sizeof(e) || e.interval != 30 || e.fails != 4 || e.pending != 1
+	|| e.srtt != 2500 || e.rttvar != 300) {
+	printf("control: bad echo reply\n");
+	++failed;
+    }
+
+    e.interval = -1;
+    e.interval_ms = 200;
+    e.fails = 10;
+    if (request(fd, PPP_CTL_SET_ECHO, &e, sizeof(e), NULL, 0, &status) != 0
+	|| lcp_echo_interval != 30 || lcp_echo_interval_ms != 200
+	|| lcp_echo_fails != 10 || echo_restarts != 1) {
+	printf("control: set echo gave %d s, %d ms, %d fails, %d restarts\n",
+	       lcp_echo_interval, lcp_echo_interval_ms, lcp_echo_fails,
+	       echo_restarts);
+	++failed;
+    }
+    e.fails = -2;
+    if (request(fd, PPP_CTL_SET_ECHO, &e, sizeof(e), NULL, 0, &status) != -1
+	|| status != EINVAL || echo_restarts != 1) {
+	printf("control: set echo with fails -2 was not refused\n");
+	++failed;
+    }
+
+    level = -1;
+    if (request(fd, PPP_CTL_SET_DEBUG, &level, sizeof(level), NULL, 0,
+		&status) != -1 || status != EINVAL || debug != 0) {
+	printf("control: set debug -1 was not refused\n");
+	++failed;
+    }
+    if (request(fd, 999, NULL, 0, NULL, 0, &status) != -1
+	|| status != EINVAL) {
+	printf("control: unknown request was not refused\n");
+	++failed;
+    }
+
+    n = request(fd, PPP_CTL_GET_TIMERS, NULL, 0, t, sizeof(t), &status);
+    if (n != 2 * sizeof(t[0]) || t[0].usecs != 1000
+	|| t[1].usecs != 250000) {
+	printf("control: bad timers reply of %d bytes\n", n);
+	++failed;
+    }
+    return failed;
+}
+
+int
+main(int argc, char *argv[])
+{
+    char dir[] = "/tmp/control_utest.XXXXXX";
+    char path[sizeof(dir) + 8];
+    struct sockaddr_un sun;
+    struct stat sb;
+    char c;
+    int fd, lfd, failed = 0;
+
+    if (mkdtemp(dir) == NULL) {
+	perror("control: mkdtemp");
+	return 1;
+    }
+    slprintf(path, sizeof(path), "%s/ctl", dir);
+    control_path = path;
+    control_init();
+    lfd = cb_fd;
+    if (lfd < 0 || stat(path, &sb) < 0 || (sb.st_mode & 0777) != 0600) {
+	printf("control: socket not created with mode 0600\n");
+	return 1;
+    }
+
+    memset(&sun, 0, sizeof(sun));
+    sun.sun_family = AF_UNIX;
+    strlcpy(sun.sun_path, path, sizeof(sun.sun_path));
+    fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *) &sun, sizeof(sun)) < 0) {
+	perror("control: connect");
+	return 1;
+    }
+    (*cb_func)(lfd, NULL);
+    if (cb_fd == lfd) {
+	printf("control: connection not accepted\n");
+	return 1;
+    }
+
+    failed += status_test(fd);
+    failed += options_test(fd);
+    failed += echo_test(fd);
+
+    /* a runt message closes the connection */
+    send(fd, "x", 1, 0);
+    (*cb_func)(cb_fd, NULL);
+    if (removed_fd != cb_fd || recv(fd, &c, 1, 0) != 0) {
+	printf("control: connection not dropped after a runt message\n");
+	++failed;
+    }
+
+    close(fd);
+    control_cleanup();
+    if (access(path, F_OK) == 0) {
+	printf("control: socket left behind\n");
+	++failed;
+    }
+    rmdir(dir);
+    if (failed)
+	return -1;
+    printf("Success\n");
+    return 0;
+}
@@ -249,6 +249,8 @@ int PPP_crypto_deinit()
 
 #ifdef UNIT_TEST
 
+#include <time.h>
+
 int debug;
 int error_count;
 int unsuccess;
@@ -526,6 +528,151 @@ int test_des_decrypt()
     return success;
 }
 
+/*
+ * Hash a million 'a's in one update, then in runs of assorted lengths
+ * so that partial blocks must be carried from one update to the next,
+ * and check both against the published digest.
+ */
+static int test_md_chained(const PPP_MD *md, const unsigned char *result,
+                           unsigned int result_len)
+{
+    static unsigned char data[1000000];
+    static const size_t runs[] = { 1, 3, 55, 63, 64, 65, 127, 1000 };
+    unsigned char hash[64];
+    unsigned int hash_len;
+    PPP_MD_CTX *ctx;
+    size_t off, n;
+    int pass, i, success = 1;
+
+    memset(data, 'a', sizeof(data));
+    for (pass = 0; pass < 2; ++pass) {
+        ctx = PPP_MD_CTX_new();
+        if (!ctx || !PPP_DigestInit(ctx, md)) {
+            PPP_MD_CTX_free(ctx);
+            return 0;
+        }
+        for (off = 0, i = 0; off < sizeof(data); off += n, ++i) {
+            n = pass ? runs[i % (sizeof(runs) / sizeof(runs[0]))]
+                     : sizeof(data);
+            if (n > sizeof(data) - off)
+                n = sizeof(data) - off;
+            if (!PPP_DigestUpdate(ctx, data + off, n))
+                success = 0;
+        }
+        hash_len = sizeof(hash);
+        if (!PPP_DigestFinal(ctx, hash, &hash_len)
+            || memcmp(hash, result, result_len) != 0)
+            success = 0;
+        PPP_MD_CTX_free(ctx);
+    }
+    return success;
+}
+
+int test_md_updates()
+{
+    static const unsigned char md4[MD4_DIGEST_LENGTH] = {
+        0xbb, 0xce, 0x80, 0xcc, 0x6b, 0xb6, 0x5e, 0x5c,
+        0x67, 0x45, 0xe3, 0x0d, 0x4e, 0xec, 0xa9, 0xa4
+    };
+    static const unsigned char md5[MD5_DIGEST_LENGTH] = {
+        0x77, 0x07, 0xd6, 0xae, 0x4e, 0x02, 0x7c, 0x70,
+        0xee, 0xa2, 0xa9, 0x35, 0xc2, 0x29, 0x6f, 0x21
+    };
+    static const unsigned char sha[SHA_DIGEST_LENGTH] = {
+        0x34, 0xaa, 0x97, 0x3c, 0xd4, 0xc4, 0xda, 0xa4, 0xf6, 0x1e,
+        0xeb, 0x2b, 0xdb, 0xad, 0x27, 0x31, 0x65, 0x34, 0x01, 0x6f
+    };
+    int success = 1;
+
+    if (!test_md_chained(PPP_md4(), md4, sizeof(md4))) {
+        printf("MD4 chained updates gave the wrong digest\n");
+        success = 0;
+    }
+    if (!test_md_chained(PPP_md5(), md5, sizeof(md5))) {
+        printf("MD5 chained updates gave the wrong digest\n");
+        success = 0;
+    }
+    if (!test_md_chained(PPP_sha1(), sha, sizeof(sha))) {
+        printf("SHA chained updates gave the wrong digest\n");
+        success = 0;
+    }
+    return success;
+}
+
+/*
+ * Time the primitives the way a login uses them: a fresh context for
+ * each short message, as in NTPasswordHash(), ChallengeHash() and the
+ * MPPE key derivation.  Run with "utest_crypto bench [count]".
+ */
+static double bench_elapsed(struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void bench_md(const char *name, const PPP_MD *md, int count)
+{
+    static unsigned char data[4096];
+    unsigned char hash[64];
+    unsigned int hash_len;
+    struct timespec start;
+    PPP_MD_CTX *ctx;
+    double t;
+    int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < count; ++i) {
+        ctx = PPP_MD_CTX_new();
+        PPP_DigestInit(ctx, md);
+        PPP_DigestUpdate(ctx, data, 64);
+        hash_len = sizeof(hash);
+        PPP_DigestFinal(ctx, hash, &hash_len);
+        PPP_MD_CTX_free(ctx);
+    }
+    t = bench_elapsed(&start);
+    printf("%-6s %10.0f digests/s (64 bytes)", name, count / t);
+
+    ctx = PPP_MD_CTX_new();
+    PPP_DigestInit(ctx, md);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < count / 16; ++i)
+        PPP_DigestUpdate(ctx, data, sizeof(data));
+    t = bench_elapsed(&start);
+    hash_len = sizeof(hash);
+    PPP_DigestFinal(ctx, hash, &hash_len);
+    PPP_MD_CTX_free(ctx);
+    printf("  %8.1f MB/s\n", (count / 16) * (double) sizeof(data) / t / 1e6);
+}
+
+static void bench_des(int count)
+{
+    unsigned char key[8] = { 0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef };
+    unsigned char plain[8] = { 0 }, cipher[8];
+    struct timespec start;
+    PPP_CIPHER_CTX *ctx;
+    int i, len;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < count; ++i) {
+        ctx = PPP_CIPHER_CTX_new();
+        PPP_CipherInit(ctx, PPP_des_ecb(), key, NULL, 1);
+        PPP_CipherUpdate(ctx, cipher, &len, plain, sizeof(plain));
+        PPP_CIPHER_CTX_free(ctx);
+        key[0] ^= cipher[0];
+    }
+    printf("%-6s %10.0f keys+blocks/s\n", "DES", count / bench_elapsed(&start));
+}
+
+static void bench(int count)
+{
+    bench_md("MD4", PPP_md4(), count);
+    bench_md("MD5", PPP_md5(), count);
+    bench_md("SHA1", PPP_sha1(), count);
+    bench_des(count);
+}
+
 int main(int argc, char *argv[])
 {
     int failure = 0;
@@ -535,6 +682,12 @@ int main(int argc, char *argv[])
         return -1;
     }
 
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        bench(argc > 2 ? atoi(argv[2]) : 100000);
+        PPP_crypto_deinit();
+        return 0;
+    }
+
     if (!test_md4()) {
         printf("MD4 test failed\n");
         failure++;
@@ -550,6 +703,11 @@ int main(int argc, char *argv[])
         failure++;
     }
 
+    if (!test_md_updates()) {
+        printf("Digest update test failed\n");
+        failure++;
+    }
+
     if (!test_des_encrypt()) {
         printf("DES encryption test failed\n");
         failure++;
@@ -81,6 +81,41 @@ static ENGINE *pkey_engine = NULL;
 /* TLSv1.3 do we have a session ticket ? */
 static int have_session_ticket = 0;
 
+/*
+ * Building an SSL_CTX means reading and parsing the CA, CRL, certificate
+ * and key files, so contexts are cached for the life of the process,
+ * keyed on the files they were built from, and rebuilt when any of
+ * those files changes.  Each cache entry holds a reference to its
+ * SSL_CTX and every session takes another.  A client context also
+ * remembers the last session it negotiated, so that it can offer it
+ * for resumption the next time it talks to the same peer.
+ *
+ * The cache only pays off in a pppd that authenticates more than once:
+ * a client that reconnects with persist or demand, where the saved
+ * session also makes the reconnection cheaper, or a server on a link
+ * that stays up for several calls.  An access server running one pppd
+ * per session builds the context once per process as before; what
+ * saves it work is the tls-ticket-keys option, which lets a client
+ * resume with any server process that shares the key file.
+ */
+#define EAPTLS_TICKET_LIFETIME  3600    /* seconds a ticket can be used */
+
+#define EAPTLS_CTX_FILES        8
+
+struct eaptls_ctx_entry
+{
+    struct eaptls_ctx_entry *next;
+    int init_server;
+    char *files[EAPTLS_CTX_FILES];
+    time_t mtime[EAPTLS_CTX_FILES];
+    ino_t ino[EAPTLS_CTX_FILES];
+    SSL_CTX *ctx;
+    SSL_SESSION *session;       /* client: last session negotiated */
+    char *session_peer;         /* client: the peer it was with */
+};
+
+static struct eaptls_ctx_entry *eaptls_ctx_cache = NULL;
+
 void ssl_msg_callback(int write_p, int version, int ct, const void *buf,
               size_t len, SSL * ssl, void *arg);
 int ssl_new_session_cb(SSL *s, SSL_SESSION *sess);
@@ -251,11 +286,95 @@ static int eaptls_UI_reader(UI *ui, UI_STRING *uis) {
 }
 #endif
 
+/*
+ * Load the session ticket keys from a file shared by every pppd acting
+ * as an EAP-TLS server, so that a ticket issued by one of them can be
+ * used to resume the session with any of the others.  The file holds
+ * the raw key name, HMAC and AES keys OpenSSL expects, e.g. 80 bytes
+ * from "openssl rand 80".
+ */
+static int eaptls_set_ticket_keys(SSL_CTX *ctx, const char *file)
+{
+    unsigned char keys[128];
+    struct stat sbuf;
+    long keylen;
+    int fd, n;
+
+    keylen = SSL_CTX_get_tlsext_ticket_keys(ctx, NULL, 0);
+    if (keylen <= 0 || keylen > (long) sizeof(keys)) {
+        error("EAP-TLS: Session tickets are not supported");
+        return -1;
+    }
+
+    fd = open(file, O_RDONLY);
+    if (fd < 0) {
+        error("EAP-TLS: Cannot open ticket key file %s: %m", file);
+        return -1;
+    }
+    if (fstat(fd, &sbuf) < 0) {
+        error("EAP-TLS: Cannot stat ticket key file %s: %m", file);
+        close(fd);
+        return -1;
+    }
+    if ((sbuf.st_mode & (S_IRWXG | S_IRWXO)) != 0)
+        warn("Warning - ticket key file %s has world and/or group access",
+             file);
+    n = read(fd, keys, keylen);
+    close(fd);
+    if (n != keylen || sbuf.st_size != keylen) {
+        error("EAP-TLS: Ticket key file %s must hold exactly %ld bytes",
+              file, keylen);
+        OPENSSL_cleanse(keys, sizeof(keys));
+        return -1;
+    }
+
+    n = SSL_CTX_set_tlsext_ticket_keys(ctx, keys, keylen);
+    OPENSSL_cleanse(keys, sizeof(keys));
+    if (n != 1) {
+        error("EAP-TLS: Cannot set session ticket keys");
+        return -1;
+    }
+
+#ifdef SSL_OP_NO_TICKET
+    SSL_CTX_clear_options(ctx, SSL_OP_NO_TICKET);
+#endif
+    SSL_CTX_set_timeout(ctx, EAPTLS_TICKET_LIFETIME);
+    dbglog("EAP-TLS: Issuing session tickets with keys from %s", file);
+    return 0;
+}
+
+/*
+ * Tie the server's sessions to the peer name and the certificates the
+ * peer was checked against, so that a ticket issued to one peer can't
+ * be used to resume as another, or under a different CA.
+ */
+static int eaptls_set_sid_ctx(SSL *ssl, char **names, int n)
+{
+    unsigned char buf[6 * MAXWORDLEN];
+    unsigned char md[EVP_MAX_MD_SIZE];
+    unsigned int mdlen;
+    size_t len = 0, l;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        l = strlen(names[i]) + 1;
+        if (len + l > sizeof(buf))
+            return -1;
+        memcpy(buf + len, names[i], l);
+        len += l;
+    }
+    if (!EVP_Digest(buf, len, md, &mdlen, EVP_sha1(), NULL)
+            || mdlen > SSL_MAX_SID_CTX_LENGTH
+            || !SSL_set_session_id_context(ssl, md, mdlen))
+        return -1;
+    return 0;
+}
+
 /*
  * Initialize the SSL stacks and tests if certificates, key and crl
  * for client or server use can be loaded.
  */
-SSL_CTX *eaptls_init_ssl(int init_server, char *cacertfile, char *capath,
+static SSL_CTX *eaptls_new_ctx(int init_server, char *cacertfile, char *capath,
             char *certfile, char *privkeyfile, char *pkcs12)
 {
 #ifndef OPENSSL_NO_ENGINE
@@ -589,6 +708,18 @@ SSL_CTX *eaptls_init_ssl(int init_server, char *cacertfile, char *capath,
     SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
     SSL_CTX_sess_set_new_cb(ctx, ssl_new_session_cb);
 
+    /*
+     * A client accepts session tickets, so that it can resume with a
+     * server that issues them.  A server only issues them when it has
+     * been given keys that other pppd processes share.
+     */
+    if (!init_server) {
+#ifdef SSL_OP_NO_TICKET
+        SSL_CTX_clear_options(ctx, SSL_OP_NO_TICKET);
+#endif
+    } else if (tls_ticket_keys && eaptls_set_ticket_keys(ctx, tls_ticket_keys))
+        goto fail;
+
     /* Configure the maximum SSL version */
     tls_set_version(ctx, max_tls_version);
 
@@ -620,6 +751,120 @@ fail:
     return NULL;
 }
 
+/*
+ * eaptls_ctx_stat - record the identity and modification time of each
+ * file a context is built from.  Names that aren't files, such as
+ * engine URIs, just record zeroes.
+ */
+static void eaptls_ctx_stat(char **files, time_t *mtime, ino_t *ino)
+{
+    struct stat sbuf;
+    int i;
+
+    for (i = 0; i < EAPTLS_CTX_FILES; i++) {
+        mtime[i] = 0;
+        ino[i] = 0;
+        if (files[i] && files[i][0] && stat(files[i], &sbuf) == 0) {
+            mtime[i] = sbuf.st_mtime;
+            ino[i] = sbuf.st_ino;
+        }
+    }
+}
+
+static void eaptls_ctx_release(struct eaptls_ctx_entry *ent)
+{
+    int i;
+
+    for (i = 0; i < EAPTLS_CTX_FILES; i++)
+        free(ent->files[i]);
+    if (ent->session)
+        SSL_SESSION_free(ent->session);
+    free(ent->session_peer);
+    SSL_CTX_free(ent->ctx);
+    free(ent);
+}
+
+static struct eaptls_ctx_entry *eaptls_ctx_find(SSL_CTX *ctx)
+{
+    struct eaptls_ctx_entry *ent;
+
+    for (ent = eaptls_ctx_cache; ent; ent = ent->next)
+        if (ent->ctx == ctx)
+            return ent;
+    return NULL;
+}
+
+/*
+ * Return an SSL_CTX for the given files, from the cache if one has
+ * already been built from them and none of them has changed since.
+ * The caller gets its own reference and releases it with SSL_CTX_free.
+ */
+SSL_CTX *eaptls_init_ssl(int init_server, char *cacertfile, char *capath,
+            char *certfile, char *privkeyfile, char *pkcs12)
+{
+    struct eaptls_ctx_entry *ent, **entp;
+    char *files[EAPTLS_CTX_FILES];
+    time_t mtime[EAPTLS_CTX_FILES];
+    ino_t ino[EAPTLS_CTX_FILES];
+    SSL_CTX *ctx;
+    int i;
+
+    files[0] = cacertfile;
+    files[1] = capath;
+    files[2] = certfile;
+    files[3] = privkeyfile;
+    files[4] = pkcs12;
+    files[5] = crl_dir;
+    files[6] = crl_file;
+    files[7] = init_server? tls_ticket_keys: NULL;
+    eaptls_ctx_stat(files, mtime, ino);
+
+    for (entp = &eaptls_ctx_cache; (ent = *entp) != NULL; entp = &ent->next) {
+        if (ent->init_server != init_server)
+            continue;
+        for (i = 0; i < EAPTLS_CTX_FILES; i++)
+            if (strcmp(ent->files[i], files[i]? files[i]: "") != 0)
+                break;
+        if (i < EAPTLS_CTX_FILES)
+            continue;
+        for (i = 0; i < EAPTLS_CTX_FILES; i++)
+            if (ent->mtime[i] != mtime[i] || ent->ino[i] != ino[i])
+                break;
+        if (i == EAPTLS_CTX_FILES) {
+            dbglog("EAP-TLS: Using cached SSL context");
+            SSL_CTX_up_ref(ent->ctx);
+            return ent->ctx;
+        }
+        dbglog("EAP-TLS: Certificate files changed, reloading");
+        *entp = ent->next;
+        eaptls_ctx_release(ent);
+        break;
+    }
+
+    ctx = eaptls_new_ctx(init_server, cacertfile, capath, certfile,
+                         privkeyfile, pkcs12);
+    if (!ctx)
+        return NULL;
+
+    ent = calloc(1, sizeof(*ent));
+    if (!ent)
+        novm("EAP-TLS context cache");
+    ent->init_server = init_server;
+    for (i = 0; i < EAPTLS_CTX_FILES; i++) {
+        ent->files[i] = strdup(files[i]? files[i]: "");
+        if (!ent->files[i])
+            novm("EAP-TLS context cache");
+        ent->mtime[i] = mtime[i];
+        ent->ino[i] = ino[i];
+    }
+    ent->ctx = ctx;
+    ent->next = eaptls_ctx_cache;
+    eaptls_ctx_cache = ent;
+
+    SSL_CTX_up_ref(ctx);
+    return ctx;
+}
+
 /*
  * Determine the maximum packet size by looking at the LCP handshake
  */
@@ -654,6 +899,7 @@ int eaptls_init_ssl_server(eap_state * esp)
     char capath[MAXWORDLEN];
     char pkfile[MAXWORDLEN];
     char pkcs12[MAXWORDLEN];
+    char *sid_names[6];
 
     /*
      * Allocate new eaptls session 
@@ -690,6 +936,17 @@ int eaptls_init_ssl_server(eap_state * esp)
             clicertfile, 0, &ets->info))
         goto fail;
 
+    sid_names[0] = esp->es_server.ea_peer;
+    sid_names[1] = clicertfile;
+    sid_names[2] = cacertfile;
+    sid_names[3] = capath;
+    sid_names[4] = tls_verify_method? tls_verify_method: "";
+    sid_names[5] = tls_verify_key_usage? "key-usage": "";
+    if (eaptls_set_sid_ctx(ets->ssl, sid_names, 6)) {
+        error("EAP-TLS: Cannot set the session id context");
+        goto fail;
+    }
+
     /*
      * Set auto-retry to avoid timeouts on BIO_read
      */
@@ -726,6 +983,7 @@ fail:
 int eaptls_init_ssl_client(eap_state * esp)
 {
     struct eaptls_session *ets;
+    struct eaptls_ctx_entry *ent;
     char servcertfile[MAXWORDLEN];
     char clicertfile[MAXWORDLEN];
     char cacertfile[MAXWORDLEN];
@@ -764,6 +1022,17 @@ int eaptls_init_ssl_client(eap_state * esp)
             servcertfile, 0, &ets->info))
         goto fail;
 
+    /*
+     * Offer the session we last had with this peer for resumption.
+     */
+    ent = eaptls_ctx_find(ets->ctx);
+    if (ent && ent->session && ent->session_peer && esp->es_client.ea_peer
+            && strcmp(ent->session_peer, esp->es_client.ea_peer) == 0) {
+        dbglog("EAP-TLS: Offering previous session for resumption");
+        SSL_set_session(ets->ssl, ent->session);
+    }
+    have_session_ticket = 0;
+
     /*
      * Initialize the BIOs we use to read/write to ssl engine 
      */
@@ -793,8 +1062,17 @@ fail:
 
 void eaptls_free_session(struct eaptls_session *ets)
 {
-    if (ets->ssl)
+    if (ets->ssl) {
+        /*
+         * There's no close_notify to exchange over EAP; mark a
+         * completed session as properly shut down, or SSL_free takes
+         * it to be broken and makes it unresumable.
+         */
+        if (SSL_is_init_finished(ets->ssl))
+            SSL_set_shutdown(ets->ssl,
+                             SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
         SSL_free(ets->ssl);
+    }
 
     if (ets->ctx)
         SSL_CTX_free(ets->ctx);
@@ -819,6 +1097,17 @@ int eaptls_is_init_finished(struct eaptls_session *ets)
     return 0;
 }
 
+/*
+ * Whether the ssl engine has written data we haven't sent yet.  A
+ * resumed TLS 1.2 handshake finishes with the client's Finished, so
+ * there the client still has to send it and the server has nothing
+ * more to send once it has read it.
+ */
+int eaptls_has_pending(struct eaptls_session *ets)
+{
+    return ets->from_ssl && BIO_ctrl_pending(ets->from_ssl) > 0;
+}
+
 /*
  * Handle a received packet, reassembling fragmented messages and
  * passing them to the ssl engine
@@ -1186,10 +1475,28 @@ ssl_msg_callback(int write_p, int version, int content_type,
 int 
 ssl_new_session_cb(SSL *s, SSL_SESSION *sess)
 {
+    struct eaptls_ctx_entry *ent;
+    const char *peer;
+
     dbglog("EAP-TLS: Post-Handshake New Session Ticket arrived:");
     have_session_ticket = 1;
 
-    /* always return success */
+    if (SSL_is_server(s))
+        return 0;
+
+    /*
+     * Keep the session for resumption; returning 1 means we hold
+     * the reference to it.
+     */
+    ent = eaptls_ctx_find(SSL_get_SSL_CTX(s));
+    peer = tls_get_peer_name(s);
+    if (!ent || !peer || !SSL_SESSION_is_resumable(sess))
+        return 0;
+    if (ent->session)
+        SSL_SESSION_free(ent->session);
+    free(ent->session_peer);
+    ent->session = sess;
+    ent->session_peer = strdup(peer);
     return 1;
 }
 
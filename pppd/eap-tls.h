@@ -78,6 +78,7 @@ int eaptls_init_ssl_client(eap_state * esp);
 void eaptls_free_session(struct eaptls_session *ets);
 
 int eaptls_is_init_finished(struct eaptls_session *ets);
+int eaptls_has_pending(struct eaptls_session *ets);
 
 int eaptls_receive(struct eaptls_session *ets, u_char * inp, int len);
 int eaptls_send(struct eaptls_session *ets, u_char ** outp);
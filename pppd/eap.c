@@ -1876,6 +1876,12 @@ eap_request(eap_state *esp, u_char *inp, int id, int len)
 
 		case eapTlsRecvAck:
 			eap_tls_response(esp, id);
+			if (!ets->frag && eaptls_is_init_finished(ets)) {
+				/* That was the last of our Finished flight */
+				eaptls_free_session(ets);
+				esp->es_client.ea_state = eapTlsRecvSuccess;
+				break;
+			}
 			esp->es_client.ea_state = (ets->frag ? eapTlsRecvAck : eapTlsRecv);
 			break;
 
@@ -1904,8 +1910,19 @@ eap_request(eap_state *esp, u_char *inp, int id, int len)
 #ifdef PPP_WITH_MPPE
 				eaptls_gen_mppe_keys(ets, 1);
 #endif
+				/*
+				 * When the server resumed our session, our
+				 * Finished still has to go to it.
+				 */
+				if (eaptls_has_pending(ets)) {
+					eap_tls_response(esp, id);
+					if (ets->frag) {
+						esp->es_client.ea_state = eapTlsRecvAck;
+						break;
+					}
+				} else
+					eap_tls_sendack(esp, id);
 				eaptls_free_session(ets);
-				eap_tls_sendack(esp, id);
 				esp->es_client.ea_state = eapTlsRecvSuccess;
 				break;
 			}
@@ -2414,6 +2431,24 @@ eap_response(eap_state *esp, u_char *inp, int id, int len)
 				eap_send_failure(esp);
 				break;
 			}
+
+			/*
+			 * A resumed session ends with the client's Finished,
+			 * which leaves us nothing more to send.
+			 */
+			if (esp->es_server.ea_state == eapTlsSend &&
+			    SSL_is_init_finished(ets->ssl) &&
+			    !eaptls_has_pending(ets)) {
+				dbglog("EAP-TLS: Resumed session with peer %q",
+				    esp->es_server.ea_peer);
+#ifdef PPP_WITH_MPPE
+				eaptls_gen_mppe_keys(ets, 0);
+#endif
+				eaptls_free_session(ets);
+				esp->es_server.ea_session = NULL;
+				esp->es_server.ea_state = eapOpen;
+				eap_send_success(esp);
+			}
 			break;
 
 		case eapTlsRecvAck:
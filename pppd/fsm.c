@@ -51,6 +51,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
 
@@ -88,6 +89,7 @@ fsm_init(fsm *f)
     f->maxtermtransmits = DEFMAXTERMREQS;
     f->maxnakloops = DEFMAXNAKLOOPS;
     f->term_reason_len = 0;
+    f->reqci_len = -1;
 }
 
 
@@ -470,8 +472,13 @@ fsm_rconfack(fsm *f, int id, u_char *inp, int len)
 {
     if (id != f->reqid || f->seen_ack)		/* Expected id? */
 	return;					/* Nope, toss... */
-    if( !(f->callbacks->ackci? (*f->callbacks->ackci)(f, inp, len):
-	  (len == 0)) ){
+    /*
+     * An Ack normally echoes our request exactly; only when it doesn't
+     * do we need the protocol to pick it apart.
+     */
+    if ((len != f->reqci_len || (len > 0 && memcmp(inp, f->reqci, len) != 0))
+	&& !(f->callbacks->ackci? (*f->callbacks->ackci)(f, inp, len):
+	     (len == 0))) {
 	/* Ack is bad - ignore it */
 	error("Received bad configure-ack: %P", inp, len);
 	return;
@@ -744,6 +751,21 @@ fsm_sconfreq(fsm *f, int retransmit)
     } else
 	cilen = 0;
 
+    /* Remember what we asked for, to check the Ack against */
+    if (cilen > f->reqci_size) {
+	free(f->reqci);
+	f->reqci_size = 0;
+	f->reqci = malloc(cilen);
+	if (f->reqci != NULL)
+	    f->reqci_size = cilen;
+    }
+    if (cilen <= f->reqci_size) {
+	if (cilen > 0)
+	    memcpy(f->reqci, outp, cilen);
+	f->reqci_len = cilen;
+    } else
+	f->reqci_len = -1;
+
     /* send the request to our peer */
     fsm_sdata(f, CONFREQ, f->reqid, outp, cilen);
 
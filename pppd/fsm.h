@@ -86,6 +86,9 @@ typedef struct fsm {
     struct fsm_callbacks *callbacks;	/* Callback routines */
     char *term_reason;		/* Reason for closing protocol */
     int term_reason_len;	/* Length of term_reason */
+    unsigned char *reqci;	/* Options in our last Configure-Request */
+    int reqci_len;		/* Their length, -1 if not saved */
+    int reqci_size;		/* Space allocated at reqci */
 } fsm;
 
 
@@ -1954,7 +1954,7 @@ ipcp_up(fsm *f)
 	ipcp_script(path_ippreup, 1);
 
 	/* check if preup script renamed the interface */
-	if (!if_indextoname(ifindex, ifname)) {
+	if (!sys_ops_hook && !if_indextoname(ifindex, ifname)) {
             error("Interface index %d failed to get renamed by a pre-up script", ifindex);
 	    ipcp_close(f->unit, "Interface configuration failed");
 	    return;
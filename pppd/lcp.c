@@ -55,6 +55,7 @@
 
 #include "pppd-private.h"
 #include "options.h"
+#include "meter.h"
 #include "fsm.h"
 #include "lcp.h"
 #include "eap.h"
@@ -81,16 +82,42 @@ static void lcp_delayed_up(void *);
 #define LCP_RTT_FILE_SIZE 8192
 #define LCP_RTT_ELEMENTS (LCP_RTT_FILE_SIZE / sizeof(u_int32_t) - LCP_RTT_HEADER_LENGTH) / 2
 
+/*
+ * Version 2 of the file: a header with summary statistics, guarded by
+ * a sequence count, then a histogram of the RTTs in the ring, then the
+ * ring itself.  See lcp_rtt_update_v2() for the layout.
+ */
+enum {
+    LCP_RTT_H_MAGIC, LCP_RTT_H_STATUS, LCP_RTT_H_INDEX, LCP_RTT_H_INTERVAL,
+    LCP_RTT_H_VERSION, LCP_RTT_H_SEQ, LCP_RTT_H_SAMPLES, LCP_RTT_H_LOST,
+    LCP_RTT_H_LAST, LCP_RTT_H_MIN, LCP_RTT_H_MAX, LCP_RTT_H_SRTT,
+    LCP_RTT_H_JITTER, LCP_RTT_H_P50, LCP_RTT_H_P95, LCP_RTT_H_P99,
+    LCP_RTT_H_LOSS, LCP_RTT_H_TIME, LCP_RTT_H_NBUCKETS, LCP_RTT_H_ELEMENTS,
+    LCP_RTT_V2_HEADER_LENGTH
+};
+#define LCP_RTT_V2_MAGIC 0x19450426
+#define LCP_RTT_SUB_BITS 3		/* 8 histogram buckets per octave */
+#define LCP_RTT_SUB (1 << LCP_RTT_SUB_BITS)
+#define LCP_RTT_BUCKETS ((32 - LCP_RTT_SUB_BITS + 1) * LCP_RTT_SUB)
+#define LCP_RTT_V2_ELEMENTS ((LCP_RTT_FILE_SIZE / sizeof(u_int32_t) \
+	- LCP_RTT_V2_HEADER_LENGTH - LCP_RTT_BUCKETS) / 3)
+
 /*
  * LCP-related command-line options.
  */
 int	lcp_echo_interval = 0; 	/* Interval between LCP echo-requests */
 int	lcp_echo_fails = 0;	/* Tolerance to unanswered echo-requests */
+int	lcp_echo_interval_ms = 0; /* Same in ms, with fast failure detection */
+int	lcp_echo_recover = 1;	/* Replies in a row to clear echo failures */
 bool	lcp_echo_adaptive = 0;	/* request echo only if the link was idle */
 char	*lcp_rtt_file = NULL;	/* measure the RTT of LCP echo-requests */
+int	lcp_rtt_version = 1;	/* layout of lcp_rtt_file */
 bool	lax_recv = 0;		/* accept control chars in asyncmap */
 bool	noendpoint = 0;		/* don't send/accept endpoint discriminator */
 
+/* Notifier for when LCP comes up */
+struct notifier *lcp_up_notifier = NULL;
+
 static int noopt(char **);
 
 #ifdef PPP_WITH_MULTILINK
@@ -165,11 +192,19 @@ static struct option lcp_option_list[] = {
       OPT_PRIO },
     { "lcp-echo-interval", o_int, &lcp_echo_interval,
       "Set time in seconds between LCP echo requests", OPT_PRIO },
+    { "lcp-echo-interval-ms", o_int, &lcp_echo_interval_ms,
+      "Set time in milliseconds between LCP echo requests", OPT_PRIO },
+    { "lcp-echo-recover", o_int, &lcp_echo_recover,
+      "Set number of echo replies in a row needed to clear echo failures",
+      OPT_PRIO },
     { "lcp-echo-adaptive", o_bool, &lcp_echo_adaptive,
       "Suppress LCP echo requests if traffic was received", 1 },
     { "lcp-rtt-file", o_string, &lcp_rtt_file,
       "Filename for logging the round-trip time of LCP echo requests",
       OPT_PRIO | OPT_PRIV },
+    { "lcp-rtt-file-version", o_int, &lcp_rtt_version,
+      "Set the layout of the LCP RTT file (1 or 2)",
+      OPT_PRIO | OPT_LIMITS, NULL, 2, 1 },
     { "lcp-restart", o_int, &lcp_fsm[0].timeouttime,
       "Set time in seconds between LCP retransmissions", OPT_PRIO },
     { "lcp-max-terminate", o_int, &lcp_fsm[0].maxtermtransmits,
@@ -215,7 +250,13 @@ lcp_options lcp_hisoptions[NUM_PPP];	/* Options that we ack'd */
 static int lcp_echos_pending = 0;	/* Number of outstanding echo msgs */
 static int lcp_echo_number   = 0;	/* ID number of next echo frame */
 static int lcp_echo_timer_running = 0;  /* set if a timer is running */
+static int lcp_echo_idle_wait = 0;	/* s until idle for an interval */
 static int lcp_rtt_file_fd = 0;		/* fd for the opened LCP RTT file */
+static int lcp_echo_good = 0;		/* Replies in a row since a miss */
+static int lcp_echo_last_reply = 0;	/* ID of the last echo answered */
+static struct timeval lcp_echo_alive;	/* Peer last known to be alive */
+static long lcp_echo_srtt = 0;		/* Smoothed echo RTT in us */
+static long lcp_echo_rttvar = 0;	/* Echo RTT variation in us */
 static u_int32_t *lcp_rtt_buffer = NULL; /* the mmap'ed LCP RTT file */
 
 static u_char nak_buffer[PPP_MRU];	/* where we construct a nak packet */
@@ -1722,6 +1763,8 @@ lcp_reqci(fsm *f, u_char *inp, int *lenp, int reject_if_disagree)
 		PUTLONG(ao->lqr_period, nakp);
 		break;
 	    }
+	    ho->neg_lqr = 1;
+	    ho->lqr_period = cilong;
 	    break;
 
 	case CI_MAGICNUMBER:
@@ -1906,6 +1949,8 @@ lcp_up(fsm *f)
 
     lcp_echo_lowerup(f->unit);  /* Enable echo messages */
 
+    notify(lcp_up_notifier, 0);
+
     link_established(f->unit);
 }
 
@@ -2224,14 +2269,101 @@ LcpEchoCheck (fsm *f)
 	return;
 
     /*
-     * Start the timer for the next interval.
+     * Start the timer for the next interval.  Millisecond intervals
+     * are shortened by a random 0-25%, as BFD does, so that the
+     * echoes of many links don't fall into step.
      */
     if (lcp_echo_timer_running)
 	warn("assertion lcp_echo_timer_running==0 failed");
-    TIMEOUT (LcpEchoTimeout, f, lcp_echo_interval);
+    if (lcp_echo_idle_wait) {
+	TIMEOUT (LcpEchoTimeout, f, lcp_echo_idle_wait);
+	lcp_echo_idle_wait = 0;
+    } else if (lcp_echo_interval_ms) {
+	long us = lcp_echo_interval_ms * 1000L;
+
+	us -= magic() % (us / 4 + 1);
+	ppp_timeout(LcpEchoTimeout, f, us / 1000000, us % 1000000);
+    } else
+	TIMEOUT (LcpEchoTimeout, f, lcp_echo_interval);
     lcp_echo_timer_running = 1;
 }
 
+/*
+ * lcp_echo_restart - start the echo timer again after lcp_echo_interval
+ * or lcp_echo_interval_ms has been changed while the link is up.
+ */
+void
+lcp_echo_restart (int unit)
+{
+    fsm *f = &lcp_fsm[unit];
+
+    if (lcp_echo_timer_running != 0) {
+        UNTIMEOUT (LcpEchoTimeout, f);
+        lcp_echo_timer_running = 0;
+    }
+    if (f->state == OPENED && (lcp_echo_interval != 0
+			       || lcp_echo_interval_ms != 0))
+	LcpEchoCheck (f);
+}
+
+/*
+ * lcp_echo_stats - get the number of unanswered echo-requests and the
+ * smoothed echo RTT and its variation in microseconds.
+ */
+void
+lcp_echo_stats (int *pending, long *srtt, long *rttvar)
+{
+    *pending = lcp_echos_pending;
+    *srtt = lcp_echo_srtt;
+    *rttvar = lcp_echo_rttvar;
+}
+
+/*
+ * lcp_echo_elapsed - microseconds from *then to *now.
+ */
+static long
+lcp_echo_elapsed (struct timeval *then, struct timeval *now)
+{
+    return (now->tv_sec - then->tv_sec) * 1000000L
+	+ (now->tv_usec - then->tv_usec);
+}
+
+/*
+ * lcp_echo_rto - how long an echo may go unanswered before it counts
+ * as missed in millisecond mode: one interval, or the retransmission
+ * timeout RFC 6298 derives from the measured RTT if that is longer.
+ */
+static long
+lcp_echo_rto (void)
+{
+    long rto = lcp_echo_srtt + 4 * lcp_echo_rttvar;
+
+    return MAX(rto, lcp_echo_interval_ms * 1000L);
+}
+
+/*
+ * lcp_echo_rtt_sample - fold a measured echo RTT into the smoothed
+ * RTT and its variation, as RFC 6298 does for TCP.
+ */
+static void
+lcp_echo_rtt_sample (long rtt)
+{
+    long delta;
+
+    if (rtt < 0)
+	return;
+    if (lcp_echo_srtt == 0) {
+	lcp_echo_srtt = rtt;
+	lcp_echo_rttvar = rtt / 2;
+	return;
+    }
+    delta = lcp_echo_srtt - rtt;
+    if (delta < 0)
+	delta = -delta;
+    lcp_echo_rttvar += (delta - lcp_echo_rttvar) / 4;
+    lcp_echo_srtt += (rtt - lcp_echo_srtt) / 8;
+}
+
 /*
  * LcpEchoTimeout - Timer expired on the LCP echo
  */
@@ -2313,6 +2445,161 @@ lcp_rtt_update_buffer (unsigned long rtt)
 	error("msync() for %s failed: %m", lcp_rtt_file);
 }
 
+/*
+ * lcp_rtt_bucket - histogram bucket for an RTT in microseconds.  Below
+ * LCP_RTT_SUB each value has its own bucket; above that each power of
+ * two is split into LCP_RTT_SUB buckets, so a bucket is never wider
+ * than 1/LCP_RTT_SUB of the values in it.
+ */
+static int
+lcp_rtt_bucket (u_int32_t v)
+{
+    int e;
+
+    if (v < LCP_RTT_SUB)
+	return v;
+    for (e = LCP_RTT_SUB_BITS; (v >> e) > 1; ++e)
+	;
+    return (e - LCP_RTT_SUB_BITS + 1) * LCP_RTT_SUB
+	+ ((v >> (e - LCP_RTT_SUB_BITS)) & (LCP_RTT_SUB - 1));
+}
+
+/*
+ * lcp_rtt_bucket_value - the middle of the range of a bucket.
+ */
+static u_int32_t
+lcp_rtt_bucket_value (int b)
+{
+    int shift;
+
+    if (b < LCP_RTT_SUB)
+	return b;
+    shift = b / LCP_RTT_SUB - 1;
+    return ((u_int32_t) (LCP_RTT_SUB + b % LCP_RTT_SUB) << shift)
+	+ ((1U << shift) >> 1);
+}
+
+/*
+ * lcp_rtt_percentile - the RTT that pct% of those in the histogram
+ * are no larger than.
+ */
+static u_int32_t
+lcp_rtt_percentile (volatile u_int32_t *hist, u_int32_t n, int pct)
+{
+    u_int32_t rank = (n * pct + 99) / 100, seen = 0;
+    int b;
+
+    for (b = 0; b < LCP_RTT_BUCKETS; ++b) {
+	seen += ntohl(hist[b]);
+	if (seen >= rank && seen > 0)
+	    return lcp_rtt_bucket_value(b);
+    }
+    return 0;
+}
+
+/*
+ * Log the RTT of the received LCP echo-reply in a version 2 file.
+ *
+ * All fields are u_int32_t in network byte order.  The header has
+ * LCP_RTT_V2_HEADER_LENGTH fields, indexed by the LCP_RTT_H_* names:
+ *  MAGIC	LCP_RTT_V2_MAGIC
+ *  STATUS	1 while the file is open and being written
+ *  INDEX	the most recently updated ring element
+ *  INTERVAL	the echo interval in milliseconds
+ *  VERSION	2
+ *  SEQ		sequence count, odd while the file is being updated
+ *  SAMPLES	echo-replies logged, and LOST echo-requests lost, in total
+ *  LAST, MIN, MAX, SRTT
+ *		RTTs in microseconds; SRTT is the smoothed RTT (RFC 6298)
+ *  JITTER	mean difference between successive RTTs (RFC 3550), in us
+ *  P50, P95, P99
+ *		percentiles of the RTTs in the ring, in us, accurate
+ *		to 1/LCP_RTT_SUB of their value
+ *  LOSS	moving average of echo-requests lost, in parts per million
+ *  TIME	UNIX time of the last update
+ *  NBUCKETS, ELEMENTS
+ *		the number of histogram buckets and ring elements
+ *
+ * The header is followed by the histogram, one count per bucket of the
+ * RTTs in the ring, then by the ring of ELEMENTS triples of
+ * (UNIX timestamp, RTT in microseconds, echo-requests lost before it),
+ * where a timestamp of 0 marks an unused element.
+ *
+ * A reader wanting a consistent snapshot reads SEQ, then the fields it
+ * wants, then SEQ again, and retries if the two differ or are odd.
+ * The file is not msync'ed: readers see the shared mapping directly.
+ */
+static void
+lcp_rtt_update_v2 (unsigned long rtt)
+{
+    volatile u_int32_t *const h = lcp_rtt_buffer;
+    volatile u_int32_t *const hist = h + LCP_RTT_V2_HEADER_LENGTH;
+    volatile u_int32_t *const ring = hist + LCP_RTT_BUCKETS;
+    volatile u_int32_t *e;
+    u_int32_t seq, i, n, lost, samples, loss;
+    long jitter, d;
+    int b;
+
+    if (rtt > 0xFFFFFFFFUL)
+	rtt = 0xFFFFFFFFUL;
+    lost = lcp_echos_pending > 1? lcp_echos_pending - 1: 0;
+
+    seq = ntohl(h[LCP_RTT_H_SEQ]);
+    h[LCP_RTT_H_SEQ] = htonl(seq + 1);
+    __sync_synchronize();
+
+    /* replace the oldest ring element, and its histogram entry */
+    i = ntohl(h[LCP_RTT_H_INDEX]) + 1;
+    if (i >= LCP_RTT_V2_ELEMENTS)
+	i = 0;
+    e = ring + i * 3;
+    if (e[0] != 0) {
+	b = lcp_rtt_bucket(ntohl(e[1]));
+	hist[b] = htonl(ntohl(hist[b]) - 1);
+    }
+    e[0] = htonl((u_int32_t) time(NULL));
+    e[1] = htonl(rtt);
+    e[2] = htonl(lost);
+    b = lcp_rtt_bucket(rtt);
+    hist[b] = htonl(ntohl(hist[b]) + 1);
+    h[LCP_RTT_H_INDEX] = htonl(i);
+
+    samples = ntohl(h[LCP_RTT_H_SAMPLES]);
+    if (samples > 0) {
+	jitter = ntohl(h[LCP_RTT_H_JITTER]);
+	d = (long) rtt - (long) ntohl(h[LCP_RTT_H_LAST]);
+	if (d < 0)
+	    d = -d;
+	jitter += (d - jitter) / 16;
+	h[LCP_RTT_H_JITTER] = htonl(jitter);
+    }
+    if (samples == 0 || rtt < ntohl(h[LCP_RTT_H_MIN]))
+	h[LCP_RTT_H_MIN] = htonl(rtt);
+    if (rtt > ntohl(h[LCP_RTT_H_MAX]))
+	h[LCP_RTT_H_MAX] = htonl(rtt);
+    h[LCP_RTT_H_LAST] = htonl(rtt);
+    h[LCP_RTT_H_SRTT] = htonl(lcp_echo_srtt);
+    h[LCP_RTT_H_SAMPLES] = htonl(samples + 1);
+    h[LCP_RTT_H_LOST] = htonl(ntohl(h[LCP_RTT_H_LOST]) + lost);
+
+    /* weight 1/16 per echo-request, lost or answered */
+    loss = ntohl(h[LCP_RTT_H_LOSS]);
+    for (n = 0; n < lost && n < 64; ++n)
+	loss += (1000000 - loss) / 16;
+    loss -= loss / 16;
+    h[LCP_RTT_H_LOSS] = htonl(loss);
+
+    for (n = 0, b = 0; b < LCP_RTT_BUCKETS; ++b)
+	n += ntohl(hist[b]);
+    h[LCP_RTT_H_P50] = htonl(lcp_rtt_percentile(hist, n, 50));
+    h[LCP_RTT_H_P95] = htonl(lcp_rtt_percentile(hist, n, 95));
+    h[LCP_RTT_H_P99] = htonl(lcp_rtt_percentile(hist, n, 99));
+    h[LCP_RTT_H_TIME] = htonl((u_int32_t) time(NULL));
+
+    __sync_synchronize();
+    h[LCP_RTT_H_SEQ] = htonl(seq + 2);
+}
+
 /*
  * LcpEchoReply - LCP has received a reply to the echo
  */
@@ -2334,7 +2621,7 @@ lcp_received_echo_reply (fsm *f, int id, u_char *inp, int len)
 	return;
     }
 
-    if (lcp_rtt_file_fd && len >= 16) {
+    if ((lcp_rtt_file_fd || lcp_echo_interval_ms) && len >= 16) {
 	long lcp_rtt_magic;
 
 	/*
@@ -2353,13 +2640,28 @@ lcp_received_echo_reply (fsm *f, int id, u_char *inp, int len)
 	    /* compute the RTT in microseconds */
 	    rtt = (ts.tv_sec - req_sec) * 1000000
 		+ (ts.tv_nsec / 1000 - req_nsec / 1000);
+	    lcp_echo_rtt_sample((long) rtt);
 	    /* log the RTT */
-	    lcp_rtt_update_buffer(rtt);
+	    if (lcp_rtt_file_fd && lcp_rtt_version == 2)
+		lcp_rtt_update_v2(rtt);
+	    else if (lcp_rtt_file_fd)
+		lcp_rtt_update_buffer(rtt);
 	}
     }
 
-    /* Reset the number of outstanding echo frames */
-    lcp_echos_pending = 0;
+    /*
+     * Reset the number of outstanding echo frames, once the peer has
+     * answered lcp_echo_recover echoes in a row since it last missed one.
+     * The echoes are numbered in turn, so a gap in the IDs answered
+     * means that one was missed.
+     */
+    if (id != ((lcp_echo_last_reply + 1) & 0xFF))
+	lcp_echo_good = 0;
+    lcp_echo_last_reply = id;
+    if (++lcp_echo_good >= lcp_echo_recover) {
+	lcp_echos_pending = 0;
+	ppp_get_time(&lcp_echo_alive);
+    }
 }
 
 /*
@@ -2371,30 +2673,64 @@ LcpSendEchoRequest (fsm *f)
 {
     u_int32_t lcp_magic;
     u_char pkt[16], *pktp;
+    struct timeval now;
 
     /*
-     * Detect the failure of the peer at this point.
+     * Detect the failure of the peer at this point.  In millisecond
+     * mode the peer is given lcp_echo_fails intervals (3 by default)
+     * to answer, or longer if the measured RTT calls for it.
      */
-    if (lcp_echo_fails != 0) {
-        if (lcp_echos_pending >= lcp_echo_fails) {
-            LcpLinkFailure(f);
-	    lcp_echos_pending = 0;
+    ppp_get_time(&now);
+    if (lcp_echo_interval_ms) {
+	if (lcp_echos_pending > 0) {
+	    long detect = (lcp_echo_fails? lcp_echo_fails: 3)
+		* lcp_echo_interval_ms * 1000L;
+
+	    if (lcp_echo_elapsed(&lcp_echo_alive, &now)
+		>= MAX(detect, lcp_echo_rto())) {
+		LcpLinkFailure(f);
+		lcp_echos_pending = 0;
+	    }
+	}
+    } else {
+	if (lcp_echo_fails != 0) {
+	    if (lcp_echos_pending >= lcp_echo_fails) {
+		LcpLinkFailure(f);
+		lcp_echos_pending = 0;
+	    }
 	}
     }
 
     /*
      * If adaptive echos have been enabled, only send the echo request if
-     * no traffic was received since the last one.
+     * no traffic was received since the last one.  The kernel's idle
+     * time is only good to a second, so millisecond intervals look at
+     * the packet count in the shared meter reading instead.
      */
     if (lcp_echo_adaptive) {
-	static unsigned int last_pkts_in = 0;
-	struct pppd_stats cur_stats;
-
-	if (get_ppp_stats(f->unit, &cur_stats) && cur_stats.pkts_in != last_pkts_in) {
-	    last_pkts_in = cur_stats.pkts_in;
-	    /* receipt of traffic indicates the link is working... */
-	    lcp_echos_pending = 0;
-	    return;
+	if (lcp_echo_interval_ms) {
+	    static unsigned int last_pkts_in = 0;
+	    const struct ppp_meter_sample *m = ppp_meter_read();
+
+	    if (m->stats_valid && m->stats.pkts_in != last_pkts_in) {
+		last_pkts_in = m->stats.pkts_in;
+		/* receipt of traffic indicates the link is working... */
+		lcp_echos_pending = 0;
+		lcp_echo_alive = now;
+		return;
+	    }
+	} else {
+	    struct ppp_idle idle;
+
+	    if (get_idle_time(f->unit, &idle)
+		&& idle.recv_idle < lcp_echo_interval) {
+		lcp_echos_pending = 0;
+		lcp_echo_alive = now;
+		lcp_echo_alive.tv_sec -= idle.recv_idle;
+		/* look again once it has been idle for an interval */
+		lcp_echo_idle_wait = lcp_echo_interval - idle.recv_idle;
+		return;
+	    }
 	}
     }
 
@@ -2407,7 +2743,7 @@ LcpSendEchoRequest (fsm *f)
 	PUTLONG(lcp_magic, pktp);
 
 	/* Put a timestamp in the data section of the frame */
-	if (lcp_rtt_file_fd) {
+	if (lcp_rtt_file_fd || lcp_echo_interval_ms) {
 	    struct timespec ts;
 
 	    PUTLONG(LCP_RTT_MAGIC, pktp);
@@ -2444,6 +2780,26 @@ lcp_rtt_open_file (void)
 	fatal("mmap() of %s failed: %m", lcp_rtt_file);
     ring_header = lcp_rtt_buffer;
 
+    if (lcp_rtt_version == 2) {
+	/* start afresh unless the layout matches and wasn't torn */
+	if (ring_header[LCP_RTT_H_MAGIC] != htonl(LCP_RTT_V2_MAGIC)
+	    || ring_header[LCP_RTT_H_VERSION] != htonl(2)
+	    || ring_header[LCP_RTT_H_NBUCKETS] != htonl(LCP_RTT_BUCKETS)
+	    || ring_header[LCP_RTT_H_ELEMENTS] != htonl(LCP_RTT_V2_ELEMENTS)
+	    || (ntohl(ring_header[LCP_RTT_H_SEQ]) & 1)) {
+	    memset(lcp_rtt_buffer, 0, LCP_RTT_FILE_SIZE);
+	    ring_header[LCP_RTT_H_MAGIC] = htonl(LCP_RTT_V2_MAGIC);
+	    ring_header[LCP_RTT_H_VERSION] = htonl(2);
+	    ring_header[LCP_RTT_H_NBUCKETS] = htonl(LCP_RTT_BUCKETS);
+	    ring_header[LCP_RTT_H_ELEMENTS] = htonl(LCP_RTT_V2_ELEMENTS);
+	    ring_header[LCP_RTT_H_INDEX] = htonl(LCP_RTT_V2_ELEMENTS - 1);
+	}
+	ring_header[LCP_RTT_H_INTERVAL] = htonl(lcp_echo_interval_ms?
+		lcp_echo_interval_ms: lcp_echo_interval * 1000);
+	ring_header[LCP_RTT_H_STATUS] = htonl(1);
+	return;
+    }
+
     /* initialize the ring buffer */
     if (ring_header[0] != htonl(LCP_RTT_MAGIC)) {
 	memset(lcp_rtt_buffer, 0, LCP_RTT_FILE_SIZE);
@@ -2485,12 +2841,18 @@ lcp_echo_lowerup (int unit)
     lcp_echos_pending      = 0;
     lcp_echo_number        = 0;
     lcp_echo_timer_running = 0;
+    lcp_echo_idle_wait     = 0;
+    lcp_echo_good          = 0;
+    lcp_echo_last_reply    = 0xFF;	/* the first echo is number 0 */
+    lcp_echo_srtt          = 0;
+    lcp_echo_rttvar        = 0;
+    ppp_get_time(&lcp_echo_alive);
 
     /* Open the file where the LCP RTT data will be logged */
     lcp_rtt_open_file();
   
     /* If a timeout interval is specified then start the timer */
-    if (lcp_echo_interval != 0)
+    if (lcp_echo_interval != 0 || lcp_echo_interval_ms != 0)
         LcpEchoCheck (f);
 }
 
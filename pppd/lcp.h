@@ -133,6 +133,12 @@ extern lcp_options lcp_gotoptions[];
 extern lcp_options lcp_allowoptions[];
 extern lcp_options lcp_hisoptions[];
 
+extern int lcp_echo_interval;		/* seconds between echo requests */
+extern int lcp_echo_interval_ms;	/* same in ms, overrides the above */
+extern int lcp_echo_fails;		/* missed echoes before giving up */
+extern int lcp_echo_recover;		/* replies in a row to forgive misses */
+extern bool lcp_echo_adaptive;		/* echo only if the link was idle */
+
 #define DEFMRU	1500		/* Try for this */
 #define MINMRU	128		/* No MRUs below this */
 #define MAXMRU	16384		/* Normally limit MRU to this */
@@ -142,6 +148,8 @@ void lcp_close(int, char *);
 void lcp_lowerup(int);
 void lcp_lowerdown(int);
 void lcp_sprotrej(int, unsigned char *, int);	/* send protocol reject */
+void lcp_echo_restart(int);	/* pick up a new echo interval */
+void lcp_echo_stats(int *pending, long *srtt, long *rttvar);
 
 extern struct protent lcp_protent;
 
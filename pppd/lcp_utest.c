@@ -0,0 +1,864 @@
+/*
+ * Drive LCP through complete negotiations against a scripted peer,
+ * with the system layer and the rest of pppd replaced by stubs.
+ *
+ *   utest_lcp                          self-test, as run by make check,
+ *                                      including echo failure detection
+ *   utest_lcp bench [count [naks]]     negotiations per second against a
+ *                                      peer that Naks our magic number
+ *                                      `naks' times
+ *   utest_lcp replay file...           feed the received LCP packets of
+ *                                      pppd `record' files to LCP
+ *
+ * Built with -DFUZZER, this provides LLVMFuzzerTestOneInput() for
+ * libFuzzer instead of main().
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include "pppd-private.h"
+#include "meter.h"
+#include "fsm.h"
+#include "lcp.h"
+#include "chap.h"
+#include "magic.h"
+#include "multilink.h"
+
+/* globals and routines normally provided by main.c, auth.c and sys-*.c */
+int debug;
+int error_count;
+int unsuccess;
+int listen_time;
+bool multilink;
+int chap_mdtype_all = MDTYPE_MD5;
+unsigned char outpacket_buf[PPP_MRU+PPP_HDRLEN];
+struct protent *protocols[] = { &lcp_protent, NULL };
+
+static ppp_phase_t phase;
+static int established;
+
+void new_phase(ppp_phase_t p) { phase = p; }
+bool in_phase(ppp_phase_t p) { return phase == p; }
+void link_required(int unit) { }
+void link_established(int unit) { established = 1; }
+void link_down(int unit) { }
+void link_terminated(int unit) { }
+void auth_reset(int unit) { }
+void notify(struct notifier *notif, int val) { }
+int ppp_send_config(int unit, int mtu, u_int32_t accm, int pc, int acc) { return 0; }
+int ppp_recv_config(int unit, int mru, u_int32_t accm, int pc, int acc) { return 0; }
+void ppp_set_mtu(int unit, int mtu) { }
+const char *protocol_name(int proto) { return NULL; }
+void ppp_set_status(ppp_exit_code_t code) { }
+bool ppp_signaled(int sig) { return 0; }
+void die(int status) { exit(status); }
+int get_host_seed(void) { return 17; }
+#ifdef PPP_WITH_MULTILINK
+char *epdisc_to_str(struct epdisc *ep) { return "?"; }
+int str_to_epdisc(struct epdisc *ep, char *str) { return 0; }
+void ppp_option_error(char *fmt, ...) { }
+#endif
+
+int
+get_ppp_stats(int unit, struct pppd_stats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    return 1;
+}
+
+/*
+ * A fake clock, and the timers pending against it.
+ */
+#define NTIMERS	8
+
+static struct timeval now;
+
+/*
+ * The fake link's receive idle time: data last came in at recv_at on
+ * the clock, or is always coming in if recv_busy is set.
+ */
+static time_t recv_at = -1;
+static int recv_busy;
+
+int
+get_idle_time(int u, struct ppp_idle *ip)
+{
+    if (!recv_busy && recv_at < 0)
+	return 0;
+    ip->xmit_idle = 0;
+    ip->recv_idle = recv_busy? 0: now.tv_sec - recv_at;
+    return 1;
+}
+
+const struct ppp_meter_sample *
+ppp_meter_read(void)
+{
+    static struct ppp_meter_sample m;
+
+    return &m;
+}
+static struct {
+    ppp_timer_cb func;
+    void *arg;
+    struct timeval when;
+} timers[NTIMERS];
+
+int
+ppp_get_time(struct timeval *tv)
+{
+    *tv = now;
+    return 0;
+}
+
+void
+ppp_timeout(ppp_timer_cb func, void *arg, int s, int us)
+{
+    int i;
+
+    for (i = 0; i < NTIMERS; ++i) {
+	if (timers[i].func == NULL) {
+	    timers[i].func = func;
+	    timers[i].arg = arg;
+	    timers[i].when.tv_sec = now.tv_sec + s + (now.tv_usec + us) / 1000000;
+	    timers[i].when.tv_usec = (now.tv_usec + us) % 1000000;
+	    return;
+	}
+    }
+}
+
+void
+ppp_untimeout(void (*func)(void *), void *arg)
+{
+    int i;
+
+    for (i = 0; i < NTIMERS; ++i)
+	if (timers[i].func == func && timers[i].arg == arg)
+	    timers[i].func = NULL;
+}
+
+/* Advance the clock to the next timer and run it, 0 if there is none */
+static int
+run_timer(void)
+{
+    ppp_timer_cb func;
+    int i, t = -1;
+
+    for (i = 0; i < NTIMERS; ++i)
+	if (timers[i].func != NULL
+	    && (t < 0 || timers[i].when.tv_sec < timers[t].when.tv_sec
+		|| (timers[i].when.tv_sec == timers[t].when.tv_sec
+		    && timers[i].when.tv_usec < timers[t].when.tv_usec)))
+	    t = i;
+    if (t < 0)
+	return 0;
+    now = timers[t].when;
+    func = timers[t].func;
+    timers[t].func = NULL;
+    (*func)(timers[t].arg);
+    return 1;
+}
+
+/*
+ * Packets pppd sends are queued here until the peer gets to them.
+ */
+#define QLEN	16
+
+static struct {
+    u_char buf[PPP_MRU+PPP_HDRLEN];
+    int len;
+} queue[QLEN];
+static int qhead, qtail;
+static long npackets;
+
+void
+output(int unit, unsigned char *p, int len)
+{
+    ++npackets;
+    if ((qtail + 1) % QLEN == qhead || len > sizeof(queue[0].buf))
+	return;
+    memcpy(queue[qtail].buf, p, len);
+    queue[qtail].len = len;
+    qtail = (qtail + 1) % QLEN;
+}
+
+/*
+ * Hand a packet to LCP.  It is copied first since fsm_rconfreq()
+ * rewrites the request in place to build its reply.
+ */
+static void
+lcp_packet(const u_char *p, int len)
+{
+    u_char buf[PPP_MRU];
+
+    if (len > sizeof(buf))
+	len = sizeof(buf);
+    memcpy(buf, p, len);
+    ++npackets;
+    (*lcp_protent.input)(0, buf, len);
+}
+
+/*
+ * The scripted peer.  It asks for a silly MRU (which we Nak), an
+ * option we don't know (which we Reject), and Naks our magic number
+ * `naks' times before acking our request.  It answers one echo
+ * request in `echo_every', or none if that is 0.
+ */
+#define PEER_MAGIC	0x5eed1e55
+#define CI_UNKNOWN	0x42
+
+#define ACK_ECHO	0	/* echo our request exactly */
+#define ACK_REORDER	1	/* with the first two options swapped */
+#define ACK_ALTER	2	/* with our magic number changed */
+
+struct peer {
+    int naks;			/* Naks still to send */
+    int ack_mode;		/* ACK_* - how it acks our request */
+    int acked;			/* we have acked its request */
+    int echo_every;		/* answer one echo request in this many */
+    int echoes;			/* echo requests seen */
+    u_char id;
+    u_char opts[64];
+    int optlen;
+};
+
+static void
+peer_reset(struct peer *peer, int naks)
+{
+    u_char *p = peer->opts;
+
+    peer->naks = naks;
+    peer->acked = 0;
+    peer->echoes = 0;
+    peer->id = 0;
+    PUTCHAR(CI_MRU, p); PUTCHAR(4, p); PUTSHORT(100, p);
+    PUTCHAR(CI_ASYNCMAP, p); PUTCHAR(6, p); PUTLONG(0, p);
+    PUTCHAR(CI_MAGICNUMBER, p); PUTCHAR(6, p); PUTLONG(PEER_MAGIC, p);
+    PUTCHAR(CI_PCOMPRESSION, p); PUTCHAR(2, p);
+    PUTCHAR(CI_ACCOMPRESSION, p); PUTCHAR(2, p);
+    PUTCHAR(CI_UNKNOWN, p); PUTCHAR(3, p); PUTCHAR(0, p);
+    peer->optlen = p - peer->opts;
+}
+
+static void
+peer_send(int code, int id, const u_char *data, int len)
+{
+    u_char pkt[PPP_MRU];
+    u_char *p = pkt;
+
+    PUTCHAR(code, p);
+    PUTCHAR(id, p);
+    PUTSHORT(len + HEADERLEN, p);
+    memcpy(p, data, len);
+    lcp_packet(pkt, len + HEADERLEN);
+}
+
+/* Find option `type' in a list of options, or return NULL */
+static u_char *
+find_ci(u_char *p, int len, int type)
+{
+    while (len >= 2 && p[1] >= 2 && p[1] <= len) {
+	if (p[0] == type)
+	    return p;
+	len -= p[1];
+	p += p[1];
+    }
+    return NULL;
+}
+
+/* Take the values we suggested in a Nak, drop what we Rejected */
+static void
+peer_update(struct peer *peer, int code, u_char *p, int len)
+{
+    u_char *ci;
+
+    while (len >= 2 && p[1] >= 2 && p[1] <= len) {
+	ci = find_ci(peer->opts, peer->optlen, p[0]);
+	if (ci != NULL) {
+	    if (code == CONFREJ) {
+		peer->optlen -= ci[1];
+		memmove(ci, ci + ci[1], peer->opts + peer->optlen - ci);
+	    } else if (ci[1] == p[1])
+		memcpy(ci, p, p[1]);
+	}
+	len -= p[1];
+	p += p[1];
+    }
+    peer_send(CONFREQ, ++peer->id, peer->opts, peer->optlen);
+}
+
+/* Ack our request, mangled as peer->ack_mode says */
+static void
+peer_ack(struct peer *peer, int id, u_char *p, int len)
+{
+    u_char ack[PPP_MRU];
+    u_char *ci;
+    int n;
+
+    memcpy(ack, p, len);
+    if (peer->ack_mode == ACK_REORDER && len >= 2 && ack[1] >= 2
+	&& ack[1] < len && ack[ack[1] + 1] >= 2
+	&& ack[1] + ack[ack[1] + 1] <= len) {
+	n = ack[1];
+	memcpy(ack, p + n, p[n + 1]);
+	memcpy(ack + p[n + 1], p, n);
+    } else if (peer->ack_mode == ACK_ALTER
+	       && (ci = find_ci(ack, len, CI_MAGICNUMBER)) != NULL
+	       && ci[1] == 6)
+	ci[5] ^= 1;
+    peer_send(CONFACK, id, ack, len);
+}
+
+static void
+peer_input(struct peer *peer, u_char *p, int len)
+{
+    u_char nak[6], rep[PPP_MRU];
+    u_char *q;
+    int proto, code, id, plen;
+
+    if (len < PPP_HDRLEN + HEADERLEN)
+	return;
+    p += 2;
+    GETSHORT(proto, p);
+    if (proto != PPP_LCP)
+	return;
+    GETCHAR(code, p);
+    GETCHAR(id, p);
+    GETSHORT(plen, p);
+    if (plen < HEADERLEN || plen > len - PPP_HDRLEN)
+	return;
+    plen -= HEADERLEN;
+
+    switch (code) {
+    case CONFREQ:
+	if (peer->naks > 0
+	    && find_ci(p, plen, CI_MAGICNUMBER) != NULL) {
+	    --peer->naks;
+	    q = nak;
+	    PUTCHAR(CI_MAGICNUMBER, q);
+	    PUTCHAR(6, q);
+	    PUTLONG(PEER_MAGIC, q);
+	    peer_send(CONFNAK, id, nak, sizeof(nak));
+	} else
+	    peer_ack(peer, id, p, plen);
+	break;
+    case CONFACK:
+	if (id == peer->id)
+	    peer->acked = 1;
+	break;
+    case CONFNAK:
+    case CONFREJ:
+	if (id == peer->id)
+	    peer_update(peer, code, p, plen);
+	break;
+    case TERMREQ:
+	peer_send(TERMACK, id, NULL, 0);
+	break;
+    case ECHOREQ:
+	if (peer->echo_every && ++peer->echoes % peer->echo_every == 0
+	    && plen >= 4) {
+	    q = rep;
+	    PUTLONG(PEER_MAGIC, q);
+	    memcpy(q, p + 4, plen - 4);
+	    peer_send(ECHOREP, id, rep, plen);
+	}
+	break;
+    }
+}
+
+static void
+lcp_reset(void)
+{
+    (*lcp_protent.lowerdown)(0);
+    lcp_close(0, "reset");
+    qhead = qtail = 0;
+}
+
+/* Let the peer answer what we have sent */
+static void
+peer_run(struct peer *peer)
+{
+    int i;
+
+    for (i = 0; i < 100 && qhead != qtail; ++i) {
+	int n = qhead;
+
+	qhead = (qhead + 1) % QLEN;
+	peer_input(peer, queue[n].buf, queue[n].len);
+    }
+}
+
+/*
+ * Run one negotiation to completion and leave LCP in whatever state
+ * it got to, returns 1 if both sides got to the Opened state.
+ */
+static int
+negotiate_open(struct peer *peer, int naks)
+{
+    established = 0;
+    peer_reset(peer, naks);
+    lcp_lowerup(0);
+    lcp_open(0);
+    peer_send(CONFREQ, peer->id, peer->opts, peer->optlen);
+    peer_run(peer);
+    return established && peer->acked && lcp_fsm[0].state == OPENED;
+}
+
+static int
+negotiate(struct peer *peer, int naks)
+{
+    int ok;
+
+    ok = negotiate_open(peer, naks);
+    lcp_reset();
+    return ok;
+}
+
+/*
+ * Open the link with echoes every `interval' ms, or every
+ * lcp_echo_interval seconds if `interval' is 0, and let up to `ticks'
+ * of them go by against a peer answering one in `every'.  Returns the
+ * time in ms at which LCP gave up on the peer, or -1 if it didn't.
+ * The shortest and longest gaps between echoes are left in *gap.
+ */
+static long
+echo_run(struct peer *peer, int interval, int every, int ticks, long gap[2])
+{
+    struct timeval start, last;
+    long t;
+    int i;
+
+    lcp_echo_interval_ms = interval;
+    peer->echo_every = every;
+    t = -1;
+    if (negotiate_open(peer, 0)) {
+	start = last = now;
+	gap[0] = LONG_MAX;
+	gap[1] = 0;
+	for (i = 0; i < ticks && lcp_fsm[0].state == OPENED; ++i) {
+	    if (!run_timer())
+		break;
+	    t = (now.tv_sec - last.tv_sec) * 1000000L
+		+ now.tv_usec - last.tv_usec;
+	    gap[0] = MIN(gap[0], t);
+	    gap[1] = MAX(gap[1], t);
+	    last = now;
+	    peer_run(peer);
+	}
+	t = -1;
+	if (lcp_fsm[0].state != OPENED)
+	    t = ((now.tv_sec - start.tv_sec) * 1000000L
+		 + now.tv_usec - start.tv_usec) / 1000;
+    }
+    lcp_reset();
+    lcp_echo_interval_ms = 0;
+    peer->echo_every = 0;
+    return t;
+}
+
+/*
+ * Check that fast echoes are jittered, that a silent peer is given
+ * up on after lcp_echo_fails intervals, and that lcp_echo_recover
+ * stops a peer that answers every other echo from keeping the link.
+ */
+static int
+echo_test(struct peer *peer)
+{
+    long t, gap[2];
+    int failed = 0;
+
+    lcp_echo_fails = 3;
+    t = echo_run(peer, 100, 1, 50, gap);
+    if (t >= 0 || gap[0] < 75000 || gap[1] > 100000) {
+	printf("echo: answering peer dropped at %ldms, or gaps %ld-%ldus"
+	       " are not 75-100ms\n", t, gap[0], gap[1]);
+	++failed;
+    }
+    t = echo_run(peer, 100, 0, 50, gap);
+    if (t < 300 || t >= 400) {
+	printf("echo: silent peer dropped at %ldms, not in 300-400ms\n", t);
+	++failed;
+    }
+    t = echo_run(peer, 100, 2, 50, gap);
+    if (t >= 0) {
+	printf("echo: peer answering every other echo dropped at %ldms\n",
+	       t);
+	++failed;
+    }
+    lcp_echo_recover = 2;
+    t = echo_run(peer, 100, 2, 50, gap);
+    if (t < 0) {
+	printf("echo: peer answering every other echo kept the link"
+	       " with lcp-echo-recover 2\n");
+	++failed;
+    }
+    t = echo_run(peer, 100, 1, 50, gap);
+    if (t >= 0) {
+	printf("echo: answering peer dropped at %ldms with"
+	       " lcp-echo-recover 2\n", t);
+	++failed;
+    }
+    lcp_echo_interval = 1;
+    t = echo_run(peer, 0, 1, 20, gap);
+    if (t >= 0) {
+	printf("echo: answering peer dropped at %ldms with"
+	       " lcp-echo-interval 1 and lcp-echo-recover 2\n", t);
+	++failed;
+    }
+    t = echo_run(peer, 0, 0, 20, gap);
+    if (t < 0) {
+	printf("echo: silent peer kept the link with"
+	       " lcp-echo-interval 1 and lcp-echo-recover 2\n");
+	++failed;
+    }
+    lcp_echo_interval = 0;
+    lcp_echo_recover = 1;
+    lcp_echo_fails = 0;
+    return failed;
+}
+
+/*
+ * Check that lcp-echo-adaptive sends nothing while data is coming in,
+ * looks again just as the link has been idle for an interval, and
+ * then gives up on a silent peer as usual.
+ */
+static int
+echo_adaptive_test(struct peer *peer)
+{
+    time_t last, drop = -1, echo = -1;
+    long sent;
+    int i, busy_gap = 1, failed = 0;
+
+    lcp_echo_interval = 10;
+    lcp_echo_fails = 3;
+    lcp_echo_adaptive = 1;
+    peer->echo_every = 0;
+    recv_busy = 1;
+    if (!negotiate_open(peer, 0)) {
+	printf("echo-adaptive: negotiation failed\n");
+	++failed;
+    } else {
+	sent = npackets;
+	for (i = 0; i < 20; ++i) {
+	    last = now.tv_sec;
+	    run_timer();
+	    if (now.tv_sec - last != 10)
+		busy_gap = 0;
+	    peer_run(peer);
+	}
+	if (npackets != sent || !busy_gap) {
+	    printf("echo-adaptive: busy link sent %ld echoes, or was not"
+		   " looked at every 10s\n", npackets - sent);
+	    ++failed;
+	}
+
+	/* data stops 6s into the next interval */
+	recv_busy = 0;
+	recv_at = now.tv_sec + 6;
+	for (i = 0; i < 10 && lcp_fsm[0].state == OPENED; ++i) {
+	    run_timer();
+	    peer_run(peer);
+	    if (echo < 0 && npackets != sent)
+		echo = now.tv_sec - recv_at;
+	}
+	if (lcp_fsm[0].state != OPENED)
+	    drop = now.tv_sec - recv_at;
+	if (echo != 10 || drop != 40) {
+	    printf("echo-adaptive: first echo %lds and drop %lds after the"
+		   " last data, not 10s and 40s\n", (long) echo, (long) drop);
+	    ++failed;
+	}
+    }
+    lcp_reset();
+    lcp_echo_adaptive = 0;
+    lcp_echo_fails = 0;
+    lcp_echo_interval = 0;
+    recv_at = -1;
+    return failed;
+}
+
+/*
+ * Count the Acks that fsm_rconfack() hands on to LCP's ackci().
+ */
+static int (*real_ackci)(fsm *, u_char *, int);
+static int ackci_calls;
+
+static int
+counting_ackci(fsm *f, u_char *p, int len)
+{
+    ++ackci_calls;
+    return (*real_ackci)(f, p, len);
+}
+
+/*
+ * Check that an Ack which echoes our request opens the link without
+ * a call to ackci(), and that one with the options reordered or a
+ * value altered still goes to ackci() and is refused.
+ */
+static int
+ack_test(struct peer *peer)
+{
+    static const struct {
+	int mode;
+	const char *name;
+	int opens;
+    } cases[] = {
+	{ ACK_ECHO, "exact echo", 1 },
+	{ ACK_REORDER, "reordered", 0 },
+	{ ACK_ALTER, "altered", 0 },
+    };
+    struct fsm_callbacks *saved, counting;
+    unsigned int i;
+    int ok, failed = 0;
+
+    saved = lcp_fsm[0].callbacks;
+    counting = *saved;
+    real_ackci = counting.ackci;
+    counting.ackci = counting_ackci;
+    lcp_fsm[0].callbacks = &counting;
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+	ackci_calls = 0;
+	peer->ack_mode = cases[i].mode;
+	ok = negotiate(peer, 0);
+	if (ok != cases[i].opens
+	    || (cases[i].opens? ackci_calls != 0: ackci_calls == 0)) {
+	    printf("ack: %s Ack %s the link with %d calls to ackci\n",
+		   cases[i].name, ok? "opened": "did not open", ackci_calls);
+	    ++failed;
+	}
+    }
+    peer->ack_mode = ACK_ECHO;
+    lcp_fsm[0].callbacks = saved;
+    return failed;
+}
+
+static double
+elapsed(struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static long
+heap_in_use(void)
+{
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 33)
+    return mallinfo2().uordblks;
+#else
+    return 0;
+#endif
+}
+
+static int
+bench(int count, int naks)
+{
+    struct peer peer;
+    struct timespec start;
+    long heap;
+    double t;
+    int i, failed = 0;
+
+    peer.ack_mode = ACK_ECHO;
+    npackets = 0;
+    heap = heap_in_use();
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < count; ++i)
+	if (!negotiate(&peer, naks))
+	    ++failed;
+    t = elapsed(&start);
+    printf("%d negotiations, %d Naks each: %.0f negotiations/s,"
+	   " %.1f packets each, %.0f ns/packet, heap +%ld bytes\n",
+	   count, naks, count / t, (double) npackets / count,
+	   t * 1e9 / npackets, heap_in_use() - heap);
+    if (failed)
+	printf("%d negotiations failed\n", failed);
+    return failed;
+}
+
+/*
+ * Replay the packets received in a pppd record file.  The file holds
+ * the raw async HDLC byte stream in each direction; see pppdump.
+ */
+static u_short
+fcs16(u_short fcs, const u_char *p, int len)
+{
+    int i;
+
+    while (len-- > 0) {
+	fcs ^= *p++;
+	for (i = 0; i < 8; ++i)
+	    fcs = (fcs & 1)? (fcs >> 1) ^ 0x8408: fcs >> 1;
+    }
+    return fcs;
+}
+
+static void
+replay_frame(u_char *p, int len, long *nlcp)
+{
+    int proto;
+
+    if (len < 4 || fcs16(0xffff, p, len) != 0xf0b8)
+	return;
+    len -= 2;
+    if (p[0] == PPP_ALLSTATIONS && p[1] == PPP_UI) {
+	p += 2;
+	len -= 2;
+    }
+    if (len < 1)
+	return;
+    proto = *p++;
+    --len;
+    if ((proto & 1) == 0 && len > 0) {
+	proto = (proto << 8) + *p++;
+	--len;
+    }
+    if (proto == PPP_LCP) {
+	lcp_packet(p, len);
+	++*nlcp;
+    }
+}
+
+static int
+replay(char *file)
+{
+    u_char frame[PPP_MRU * 2];
+    struct timespec start;
+    FILE *f;
+    long nlcp = 0;
+    int c, n, cnt = 0, esc = 0;
+
+    f = fopen(file, "r");
+    if (f == NULL) {
+	perror(file);
+	return 1;
+    }
+    lcp_lowerup(0);
+    lcp_open(0);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while ((c = getc(f)) != EOF) {
+	switch (c) {
+	case 1:			/* data sent */
+	case 2:			/* data received */
+	    n = getc(f);
+	    n = (n << 8) + getc(f);
+	    for (; n > 0 && (c == 1 || !feof(f)); --n) {
+		int b = getc(f);
+
+		if (c == 1)
+		    continue;
+		if (b == PPP_FLAG) {
+		    if (!esc && cnt <= sizeof(frame))
+			replay_frame(frame, cnt, &nlcp);
+		    cnt = esc = 0;
+		} else if (b == PPP_ESCAPE) {
+		    esc = 1;
+		} else {
+		    if (esc)
+			b ^= PPP_TRANS;
+		    esc = 0;
+		    if (cnt < sizeof(frame))
+			frame[cnt] = b;
+		    ++cnt;
+		}
+		qhead = qtail;		/* our replies go nowhere */
+	    }
+	    break;
+	case 5:			/* time stamps */
+	    getc(f);
+	    getc(f);
+	    getc(f);
+	    /* fall through */
+	case 6:
+	    getc(f);
+	    break;
+	case 7:
+	    for (n = 0; n < 4; ++n)
+		getc(f);
+	    break;
+	}
+    }
+    fclose(f);
+    printf("%s: %ld LCP packets, %.0f ns/packet, LCP %s\n", file, nlcp,
+	   nlcp? elapsed(&start) * 1e9 / nlcp: 0.0,
+	   lcp_fsm[0].state == OPENED? "opened": "not opened");
+    lcp_reset();
+    return 0;
+}
+
+#ifdef FUZZER
+/*
+ * Each packet in the input is a length byte followed by that many
+ * bytes of LCP packet.
+ */
+int
+LLVMFuzzerTestOneInput(const u_char *data, size_t size)
+{
+    static int initialized;
+    int n;
+
+    if (!initialized) {
+	magic_init();
+	(*lcp_protent.init)(0);
+	initialized = 1;
+    }
+    lcp_lowerup(0);
+    lcp_open(0);
+    while (size > 0) {
+	n = *data++;
+	--size;
+	if (n > size)
+	    n = size;
+	lcp_packet(data, n);
+	data += n;
+	size -= n;
+	qhead = qtail;
+    }
+    lcp_reset();
+    return 0;
+}
+
+#else /* FUZZER */
+
+int
+main(int argc, char *argv[])
+{
+    struct peer peer;
+    int i, failed = 0;
+
+    magic_init();
+    (*lcp_protent.init)(0);
+
+    if (argc > 1 && strcmp(argv[1], "bench") == 0)
+	return bench(argc > 2? atoi(argv[2]): 100000,
+		     argc > 3? atoi(argv[3]): 0) != 0;
+
+    if (argc > 1 && strcmp(argv[1], "replay") == 0) {
+	for (i = 2; i < argc; ++i)
+	    failed += replay(argv[i]);
+	return failed != 0;
+    }
+
+    peer.ack_mode = ACK_ECHO;
+    for (i = 0; i < 6; ++i) {
+	if (!negotiate(&peer, i)) {
+	    printf("LCP negotiation with %d Naks failed\n", i);
+	    ++failed;
+	}
+    }
+    failed += ack_test(&peer);
+    failed += echo_test(&peer);
+    failed += echo_adaptive_test(&peer);
+    if (failed)
+	return -1;
+    printf("Success\n");
+    return 0;
+}
+
+#endif /* FUZZER */
@@ -0,0 +1,446 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*
+ * lqr.c - PPP Link Quality Report protocol (RFC 1989).
+ *
+ * LCP negotiates the Quality-Protocol option; this module does the
+ * rest.  While LCP is open we send Link-Quality-Reports at the period
+ * the peer asked for (or in reply to each of its reports if it asked
+ * for period 0), and work out from each report the peer sends how many
+ * packets went missing in each direction since the previous one.
+ *
+ * Packet and octet counts come from the kernel interface statistics,
+ * plus the frames pppd itself sends and receives over the channel
+ * (LCP, authentication, the LQRs themselves), which the kernel
+ * counters leave out; the peer counts every frame on the link.  We have no count of discarded or errored
+ * frames to offer, so those fields are always sent as zero.
+ *
+ * Copyright (c) 2026 The pppd Project. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THE AUTHORS OF THIS SOFTWARE DISCLAIM ALL WARRANTIES WITH REGARD TO
+ * THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+ * AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "pppd-private.h"
+#include "options.h"
+#include "fsm.h"
+#include "lcp.h"
+#include "lqr.h"
+
+int lqr_threshold = 0;		/* % loss counted as a bad report */
+int lqr_fails = 3;		/* bad reports before we close the link */
+
+void (*lqr_quality_hook)(int unit, const struct lqr_quality *q) = NULL;
+
+static struct option lqr_option_list[] = {
+    { "lqr-period", o_int, &lcp_wantoptions[0].lqr_period,
+      "Ask the peer for Link-Quality-Reports (1/100 s)",
+      OPT_PRIO | OPT_LLIMIT, &lcp_wantoptions[0].neg_lqr, 0, 0 },
+    { "lqr", o_bool, &lcp_allowoptions[0].neg_lqr,
+      "Send Link-Quality-Reports if the peer asks for them", 1 },
+    { "nolqr", o_bool, &lcp_wantoptions[0].neg_lqr,
+      "Disable Link-Quality-Reports",
+      OPT_A2CLR, &lcp_allowoptions[0].neg_lqr },
+    { "lqr-threshold", o_int, &lqr_threshold,
+      "Set % packet loss that makes a Link-Quality-Report bad",
+      OPT_PRIO | OPT_LIMITS, NULL, 100, 0 },
+    { "lqr-fails", o_int, &lqr_fails,
+      "Set number of bad Link-Quality-Reports to indicate link failure",
+      OPT_PRIO | OPT_LLIMIT, NULL, 0, 1 },
+
+    { NULL }
+};
+
+/*
+ * Protocol entry points from main code.
+ */
+static void lqr_init(int unit);
+static void lqr_input(int unit, u_char *p, int len);
+static void lqr_protrej(int unit);
+static void lqr_lowerup(int unit);
+static void lqr_lowerdown(int unit);
+static int  lqr_printpkt(u_char *p, int plen,
+			 void (*printer)(void *, char *, ...), void *arg);
+
+struct protent lqr_protent = {
+    PPP_LQR,
+    lqr_init,
+    lqr_input,
+    lqr_protrej,
+    lqr_lowerup,
+    lqr_lowerdown,
+    NULL,
+    NULL,
+    lqr_printpkt,
+    NULL,
+    1,
+    "LQR",
+    NULL,
+    lqr_option_list,
+    NULL,
+    NULL,
+    NULL
+};
+
+/* The counters carried in a Link-Quality-Report, in packet order */
+struct lqr_report {
+    uint32_t magic;
+    uint32_t last_out_lqrs;
+    uint32_t last_out_packets;
+    uint32_t last_out_octets;
+    uint32_t peer_in_lqrs;
+    uint32_t peer_in_packets;
+    uint32_t peer_in_discards;
+    uint32_t peer_in_errors;
+    uint32_t peer_in_octets;
+    uint32_t peer_out_lqrs;
+    uint32_t peer_out_packets;
+    uint32_t peer_out_octets;
+};
+
+typedef struct lqr_state {
+    int unit;
+    bool sending;		/* we send a report every period */
+    bool expecting;		/* the peer should send one every period */
+    bool have_last;		/* last and save_in_* are valid */
+    int bad;			/* consecutive bad reports */
+    uint32_t out_lqrs;		/* OutLQRs */
+    uint32_t in_lqrs;		/* InLQRs */
+    struct lqr_report last;	/* the peer's last report */
+    uint32_t save_in_lqrs;	/* our counts when it arrived */
+    uint32_t save_in_packets;
+    uint32_t save_in_octets;
+} lqr_state;
+
+static lqr_state lqr[NUM_PPP];
+
+static void lqr_send(lqr_state *);
+static void lqr_timeout(void *);
+static void lqr_missing(void *);
+
+/*
+ * lqr_init - initialize LQR.
+ */
+static void
+lqr_init(int unit)
+{
+    lqr_state *ls = &lqr[unit];
+
+    memset(ls, 0, sizeof(*ls));
+    ls->unit = unit;
+}
+
+/*
+ * lqr_counts - get our packet and octet counts in each direction,
+ * including the channel frames (LQRs among them) so far.
+ */
+static void
+lqr_counts(lqr_state *ls, uint32_t *in_packets, uint32_t *in_octets,
+	   uint32_t *out_packets, uint32_t *out_octets)
+{
+    struct pppd_stats st;
+
+    memset(&st, 0, sizeof(st));
+    if (!get_ppp_stats(ls->unit, &st))
+	memset(&st, 0, sizeof(st));
+    *in_packets = st.pkts_in + chan_stats.pkts_in;
+    *in_octets = st.bytes_in + chan_stats.bytes_in;
+    *out_packets = st.pkts_out + chan_stats.pkts_out;
+    *out_octets = st.bytes_out + chan_stats.bytes_out;
+}
+
+/*
+ * lqr_arm - start a timer for a period in hundredths of a second.
+ */
+static void
+lqr_arm(void (*func)(void *), lqr_state *ls, uint32_t period)
+{
+    ppp_timeout(func, ls, period / 100, (period % 100) * 10000);
+}
+
+/*
+ * lqr_lowerup - LCP has come up; start sending and/or expecting
+ * reports as negotiated.
+ */
+static void
+lqr_lowerup(int unit)
+{
+    lqr_state *ls = &lqr[unit];
+    lcp_options *go = &lcp_gotoptions[unit];
+    lcp_options *ho = &lcp_hisoptions[unit];
+
+    lqr_init(unit);
+    if (ho->neg_lqr) {
+	/* send one straight away so the peer has a starting point */
+	lqr_send(ls);
+	if (ho->lqr_period != 0) {
+	    ls->sending = 1;
+	    lqr_arm(lqr_timeout, ls, ho->lqr_period);
+	}
+    }
+    if (go->neg_lqr && go->lqr_period != 0) {
+	ls->expecting = 1;
+	lqr_arm(lqr_missing, ls, 2 * go->lqr_period);
+    }
+}
+
+/*
+ * lqr_lowerdown - LCP has gone down; stop everything.
+ */
+static void
+lqr_lowerdown(int unit)
+{
+    lqr_state *ls = &lqr[unit];
+
+    if (ls->sending)
+	UNTIMEOUT(lqr_timeout, ls);
+    if (ls->expecting)
+	UNTIMEOUT(lqr_missing, ls);
+    ls->sending = ls->expecting = 0;
+}
+
+/*
+ * lqr_protrej - the peer doesn't understand LQR after all.
+ */
+static void
+lqr_protrej(int unit)
+{
+    warn("LQR protocol rejected by peer");
+    lqr_lowerdown(unit);
+    lcp_hisoptions[unit].neg_lqr = 0;
+    lcp_gotoptions[unit].neg_lqr = 0;
+}
+
+/*
+ * lqr_send - send a Link-Quality-Report.
+ */
+static void
+lqr_send(lqr_state *ls)
+{
+    lcp_options *go = &lcp_gotoptions[ls->unit];
+    uint32_t in_packets, in_octets, out_packets, out_octets;
+    u_char *outp;
+
+    ++ls->out_lqrs;
+    lqr_counts(ls, &in_packets, &in_octets, &out_packets, &out_octets);
+    /* this report counts, but output() has yet to see it */
+    ++out_packets;
+    out_octets += PPP_HDRLEN + LQR_LEN;
+
+    outp = outpacket_buf;
+    MAKEHEADER(outp, PPP_LQR);
+    PUTLONG(go->neg_magicnumber? go->magicnumber: 0, outp);
+    PUTLONG(ls->last.peer_out_lqrs, outp);
+    PUTLONG(ls->last.peer_out_packets, outp);
+    PUTLONG(ls->last.peer_out_octets, outp);
+    PUTLONG(ls->save_in_lqrs, outp);
+    PUTLONG(ls->save_in_packets, outp);
+    PUTLONG(0, outp);			/* InDiscards */
+    PUTLONG(0, outp);			/* InErrors */
+    PUTLONG(ls->save_in_octets, outp);
+    PUTLONG(ls->out_lqrs, outp);
+    PUTLONG(out_packets, outp);
+    PUTLONG(out_octets, outp);
+    output(ls->unit, outpacket_buf, PPP_HDRLEN + LQR_LEN);
+}
+
+/*
+ * lqr_timeout - time to send another report.
+ */
+static void
+lqr_timeout(void *arg)
+{
+    lqr_state *ls = arg;
+
+    lqr_send(ls);
+    lqr_arm(lqr_timeout, ls, lcp_hisoptions[ls->unit].lqr_period);
+}
+
+/*
+ * lqr_judge - count a good or bad report, and close the link after
+ * lqr_fails bad ones in a row.
+ */
+static void
+lqr_judge(lqr_state *ls, int good)
+{
+    if (good) {
+	ls->bad = 0;
+	return;
+    }
+    if (++ls->bad < lqr_fails || lcp_fsm[ls->unit].state != OPENED)
+	return;
+    notice("Link quality too poor for %d reports", ls->bad);
+    ppp_set_status(EXIT_PEER_DEAD);
+    lcp_close(ls->unit, "Link quality too poor");
+}
+
+/*
+ * lqr_missing - the peer hasn't sent a report for two periods.
+ */
+static void
+lqr_missing(void *arg)
+{
+    lqr_state *ls = arg;
+
+    dbglog("LQR: no report from peer in %u/100 s",
+	   2 * lcp_gotoptions[ls->unit].lqr_period);
+    if (lqr_threshold > 0)
+	lqr_judge(ls, 0);
+    if (ls->expecting)
+	lqr_arm(lqr_missing, ls, 2 * lcp_gotoptions[ls->unit].lqr_period);
+}
+
+/*
+ * lqr_loss - percentage of sent packets lost.
+ */
+static int
+lqr_loss(uint32_t sent, uint32_t lost)
+{
+    if (sent == 0)
+	return 0;
+    return (int)(((uint64_t) lost * 100) / sent);
+}
+
+/*
+ * lqr_lost - sent less received, allowing for counters that went
+ * backwards (e.g. the peer reset its statistics).
+ */
+static uint32_t
+lqr_lost(uint32_t sent, uint32_t received)
+{
+    int32_t d = sent - received;
+
+    return d > 0? d: 0;
+}
+
+/*
+ * lqr_input - a Link-Quality-Report has arrived.
+ */
+static void
+lqr_input(int unit, u_char *p, int len)
+{
+    lqr_state *ls = &lqr[unit];
+    lcp_options *go = &lcp_gotoptions[unit];
+    lcp_options *ho = &lcp_hisoptions[unit];
+    struct lqr_report r;
+    struct lqr_quality q;
+    uint32_t in_packets, in_octets, out_packets, out_octets;
+    uint32_t prev_last_out;
+    int loss;
+
+    if (len < LQR_LEN) {
+	dbglog("LQR: short packet (%d bytes)", len);
+	return;
+    }
+    GETLONG(r.magic, p);
+    GETLONG(r.last_out_lqrs, p);
+    GETLONG(r.last_out_packets, p);
+    GETLONG(r.last_out_octets, p);
+    GETLONG(r.peer_in_lqrs, p);
+    GETLONG(r.peer_in_packets, p);
+    GETLONG(r.peer_in_discards, p);
+    GETLONG(r.peer_in_errors, p);
+    GETLONG(r.peer_in_octets, p);
+    GETLONG(r.peer_out_lqrs, p);
+    GETLONG(r.peer_out_packets, p);
+    GETLONG(r.peer_out_octets, p);
+
+    if (go->neg_magicnumber && r.magic == go->magicnumber
+	&& r.magic != 0) {
+	warn("LQR: received our own report; link may be looped back");
+	return;
+    }
+
+    ++ls->in_lqrs;
+    lqr_counts(ls, &in_packets, &in_octets, &out_packets, &out_octets);
+
+    if (ls->have_last && r.peer_out_lqrs != ls->last.peer_out_lqrs) {
+	memset(&q, 0, sizeof(q));
+	q.reports = r.peer_out_lqrs - ls->last.peer_out_lqrs;
+	if (r.last_out_lqrs != ls->last.last_out_lqrs) {
+	    q.out_sent = r.last_out_packets - ls->last.last_out_packets;
+	    q.out_lost = lqr_lost(q.out_sent,
+				  r.peer_in_packets - ls->last.peer_in_packets);
+	    q.out_errors = (r.peer_in_errors - ls->last.peer_in_errors)
+		+ (r.peer_in_discards - ls->last.peer_in_discards);
+	}
+	q.in_sent = r.peer_out_packets - ls->last.peer_out_packets;
+	q.in_lost = lqr_lost(q.in_sent, in_packets - ls->save_in_packets);
+
+	loss = MAX(lqr_loss(q.out_sent, q.out_lost + q.out_errors),
+		   lqr_loss(q.in_sent, q.in_lost));
+	if (debug)
+	    dbglog("LQR: out %u/%u lost, %u errors; in %u/%u lost",
+		   q.out_lost, q.out_sent, q.out_errors, q.in_lost, q.in_sent);
+	if (lqr_quality_hook)
+	    (*lqr_quality_hook)(unit, &q);
+	if (lqr_threshold > 0)
+	    lqr_judge(ls, loss < lqr_threshold);
+    }
+
+    prev_last_out = ls->have_last? ls->last.last_out_lqrs: 0;
+    ls->last = r;
+    ls->save_in_lqrs = ls->in_lqrs;
+    ls->save_in_packets = in_packets;
+    ls->save_in_octets = in_octets;
+    ls->have_last = 1;
+
+    if (ls->expecting) {
+	UNTIMEOUT(lqr_missing, ls);
+	lqr_arm(lqr_missing, ls, 2 * go->lqr_period);
+    }
+
+    /*
+     * With a reporting period of 0, the peer wants a report back.  If
+     * we asked the peer for the same, its reports may themselves be
+     * answers to ours, and answering those would have the two of us
+     * reply to each other forever; so only answer a report if the
+     * peer hasn't had one of ours since its last.
+     */
+    if (ho->neg_lqr && ho->lqr_period == 0 && lcp_fsm[unit].state == OPENED
+	&& !(go->neg_lqr && go->lqr_period == 0
+	     && r.last_out_lqrs != prev_last_out))
+	lqr_send(ls);
+}
+
+/*
+ * lqr_printpkt - print the contents of a Link-Quality-Report.
+ */
+static int
+lqr_printpkt(u_char *p, int plen,
+	     void (*printer)(void *, char *, ...), void *arg)
+{
+    uint32_t v[LQR_LEN / 4];
+    int i;
+
+    if (plen < LQR_LEN)
+	return 0;
+    for (i = 0; i < LQR_LEN / 4; ++i)
+	GETLONG(v[i], p);
+    printer(arg, " magic=0x%x lastout=%u/%u/%u", v[0], v[1], v[2], v[3]);
+    printer(arg, " in=%u/%u/%u/%u/%u", v[4], v[5], v[6], v[7], v[8]);
+    printer(arg, " out=%u/%u/%u", v[9], v[10], v[11]);
+    return LQR_LEN;
+}
@@ -0,0 +1,73 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*
+ * lqr.h - Link Quality Report protocol definitions.
+ *
+ * Copyright (c) 2026 The pppd Project. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THE AUTHORS OF THIS SOFTWARE DISCLAIM ALL WARRANTIES WITH REGARD TO
+ * THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+ * AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef PPP_LQR_H
+#define PPP_LQR_H
+
+#include <stdint.h>
+
+#include "pppdconf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef PPP_LQR
+#define PPP_LQR	0xc025
+#endif
+
+#define LQR_LEN		48	/* Link-Quality-Report, without protocol */
+
+/*
+ * Link quality over the interval between two consecutive reports
+ * from the peer.  Counts are in packets; "out" is the direction from
+ * us to the peer, "in" from the peer to us.
+ */
+struct lqr_quality {
+    uint32_t out_sent;		/* packets we sent */
+    uint32_t out_lost;		/* ... that the peer did not receive */
+    uint32_t out_errors;	/* ... received by the peer with errors */
+    uint32_t in_sent;		/* packets the peer sent */
+    uint32_t in_lost;		/* ... that we did not receive */
+    uint32_t reports;		/* reports the peer sent, normally 1 */
+};
+
+/*
+ * Called with each new quality sample, e.g. so that a plugin can
+ * reweight or drop a multilink member.
+ */
+extern void (*lqr_quality_hook)(int unit, const struct lqr_quality *q);
+
+extern int lqr_threshold;	/* % loss counted as a bad report */
+extern int lqr_fails;		/* bad reports before we close the link */
+
+extern struct protent lqr_protent;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PPP_LQR_H */
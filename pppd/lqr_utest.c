@@ -0,0 +1,338 @@
+/*
+ * Exchange Link-Quality-Reports with a scripted peer, with LCP, the
+ * system layer and the rest of pppd replaced by stubs, and check the
+ * reply rule and the loss worked out from the peer's reports.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pppd-private.h"
+#include "fsm.h"
+#include "lcp.h"
+#include "lqr.h"
+
+int debug;
+fsm lcp_fsm[NUM_PPP];
+lcp_options lcp_wantoptions[NUM_PPP];
+lcp_options lcp_gotoptions[NUM_PPP];
+lcp_options lcp_allowoptions[NUM_PPP];
+lcp_options lcp_hisoptions[NUM_PPP];
+u_char outpacket_buf[PPP_MRU+PPP_HDRLEN];
+
+static int closed;
+
+void dbglog(const char *fmt, ...) { }
+void notice(const char *fmt, ...) { }
+void warn(const char *fmt, ...) { }
+void ppp_set_status(ppp_exit_code_t code) { }
+void lcp_close(int unit, char *reason) { closed = 1; }
+void ppp_timeout(ppp_timer_cb func, void *arg, int s, int us) { }
+void ppp_untimeout(ppp_timer_cb func, void *arg) { }
+
+/* Our data packets, as the kernel would count them */
+static unsigned int data_in, data_out;
+
+/* Our channel frames, as get_input() and output() would count them */
+struct pppd_stats chan_stats;
+
+int
+get_ppp_stats(int unit, struct pppd_stats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->pkts_in = data_in;
+    stats->pkts_out = data_out;
+    return 1;
+}
+
+/*
+ * The peer keeps its counters as RFC 1989 describes, and sends a
+ * report when asked to.  Reports we send are queued until the peer
+ * gets to them.
+ */
+#define PEER_MAGIC	0x5eed1e55
+#define QLEN		16
+
+struct peer {
+    uint32_t out_lqrs, out_packets;
+    uint32_t in_lqrs, in_packets, in_discards, in_errors;
+    uint32_t last_out_lqrs, last_out_packets;	/* from our last report */
+    uint32_t save_in_lqrs, save_in_packets;	/* when it came */
+    uint32_t save_in_discards, save_in_errors;
+};
+
+static u_char queue[QLEN][LQR_LEN];
+static int qhead, qtail;
+static long nsent;
+
+void
+output(int unit, unsigned char *p, int len)
+{
+    ++chan_stats.pkts_out;
+    chan_stats.bytes_out += len;
+    if (((p[2] << 8) | p[3]) != PPP_LQR)
+	return;
+    ++nsent;
+    if ((qtail + 1) % QLEN == qhead || len != PPP_HDRLEN + LQR_LEN)
+	return;
+    memcpy(queue[qtail], p + PPP_HDRLEN, LQR_LEN);
+    qtail = (qtail + 1) % QLEN;
+}
+
+/* The peer takes our oldest report off the queue, 0 if there is none */
+static int
+peer_recv(struct peer *peer)
+{
+    u_char *p;
+    uint32_t v[LQR_LEN / 4];
+    int i;
+
+    if (qhead == qtail)
+	return 0;
+    p = queue[qhead];
+    qhead = (qhead + 1) % QLEN;
+    for (i = 0; i < LQR_LEN / 4; ++i)
+	GETLONG(v[i], p);
+    ++peer->in_lqrs;
+    ++peer->in_packets;
+    peer->last_out_lqrs = v[9];
+    peer->last_out_packets = v[10];
+    peer->save_in_lqrs = peer->in_lqrs;
+    peer->save_in_packets = peer->in_packets;
+    peer->save_in_discards = peer->in_discards;
+    peer->save_in_errors = peer->in_errors;
+    return 1;
+}
+
+static void
+peer_send(struct peer *peer)
+{
+    u_char pkt[LQR_LEN], *p = pkt;
+
+    ++peer->out_lqrs;
+    ++peer->out_packets;
+    PUTLONG(PEER_MAGIC, p);
+    PUTLONG(peer->last_out_lqrs, p);
+    PUTLONG(peer->last_out_packets, p);
+    PUTLONG(0, p);
+    PUTLONG(peer->save_in_lqrs, p);
+    PUTLONG(peer->save_in_packets, p);
+    PUTLONG(peer->save_in_discards, p);
+    PUTLONG(peer->save_in_errors, p);
+    PUTLONG(0, p);
+    PUTLONG(peer->out_lqrs, p);
+    PUTLONG(peer->out_packets, p);
+    PUTLONG(0, p);
+    ++chan_stats.pkts_in;
+    chan_stats.bytes_in += PPP_HDRLEN + LQR_LEN;
+    (*lqr_protent.input)(0, pkt, LQR_LEN);
+}
+
+/*
+ * The peer sends an LCP Echo-Request and we answer it; both frames
+ * go over the channel, so only pppd and the peer count them.
+ */
+static void
+peer_echo(struct peer *peer)
+{
+    u_char pkt[PPP_HDRLEN + 8], *p = pkt;
+
+    ++peer->out_packets;
+    ++chan_stats.pkts_in;
+    chan_stats.bytes_in += sizeof(pkt);
+
+    MAKEHEADER(p, PPP_LCP);
+    PUTCHAR(ECHOREP, p);
+    PUTCHAR(1, p);
+    PUTSHORT(8, p);
+    PUTLONG(0x12345678, p);
+    output(0, pkt, sizeof(pkt));
+    ++peer->in_packets;
+}
+
+static struct lqr_quality quality[8];
+static int nquality;
+
+static void
+quality_hook(int unit, const struct lqr_quality *q)
+{
+    if (nquality < 8)
+	quality[nquality++] = *q;
+}
+
+/*
+ * Bring LQR up with each side asked to report at the given period (in
+ * 1/100 s, 0 for only in reply).
+ */
+static void
+lqr_start(struct peer *peer, int our_period, int his_period)
+{
+    memset(peer, 0, sizeof(*peer));
+    qhead = qtail = 0;
+    nsent = nquality = closed = 0;
+    data_in = data_out = 0;
+    memset(&chan_stats, 0, sizeof(chan_stats));
+    lcp_fsm[0].state = OPENED;
+    lcp_gotoptions[0].neg_magicnumber = 1;
+    lcp_gotoptions[0].magicnumber = 0x12345678;
+    lcp_gotoptions[0].neg_lqr = 1;
+    lcp_gotoptions[0].lqr_period = his_period;
+    lcp_hisoptions[0].neg_lqr = 1;
+    lcp_hisoptions[0].lqr_period = our_period;
+    (*lqr_protent.init)(0);
+    (*lqr_protent.lowerup)(0);
+}
+
+/*
+ * Both sides asked to report only in reply, against a peer that sends
+ * its first report straight away, as we do, and then answers every
+ * report of ours.  Without care the two answer each other forever.
+ */
+static int
+reply_loop_test(void)
+{
+    struct peer peer;
+    int i, failed = 0;
+
+    lqr_start(&peer, 0, 0);
+    peer_send(&peer);
+    for (i = 0; i < 100 && peer_recv(&peer); ++i)
+	peer_send(&peer);
+    if (i >= 100 || nsent > 2) {
+	printf("lqr: with both periods 0, %ld reports sent, %d answered"
+	       " by the peer\n", nsent, i);
+	++failed;
+    }
+    (*lqr_protent.lowerdown)(0);
+    return failed;
+}
+
+/*
+ * The peer reports on a timer and we are asked to answer each one;
+ * check that we do, and the packets lost and in error that we work
+ * out from its reports.
+ */
+static int
+loss_test(void)
+{
+    struct peer peer;
+    struct lqr_quality *q;
+    int i, failed = 0;
+
+    lqr_threshold = 10;
+    lqr_fails = 1;
+    lqr_quality_hook = quality_hook;
+    lqr_start(&peer, 0, 100);
+    peer_recv(&peer);
+    for (i = 0; i < 2; ++i) {
+	peer_send(&peer);
+	peer_recv(&peer);
+    }
+
+    /* we send 100, of which 90 arrive and 3 more are bad */
+    data_out += 100;
+    peer.in_packets += 90;
+    peer.in_errors += 2;
+    peer.in_discards += 1;
+    /* the peer sends 50, of which 45 arrive */
+    peer.out_packets += 50;
+    data_in += 45;
+
+    peer_send(&peer);
+    peer_recv(&peer);
+    if (closed) {
+	printf("lqr: link closed at 9%% loss with lqr-threshold 10\n");
+	++failed;
+    }
+    peer_send(&peer);
+    peer_recv(&peer);
+
+    if (nsent != 5 || nquality != 3) {
+	printf("lqr: %ld reports sent and %d quality samples, not 5 and 3\n",
+	       nsent, nquality);
+	++failed;
+    } else {
+	q = &quality[1];
+	if (q->in_sent != 51 || q->in_lost != 5 || q->out_lost != 0
+	    || q->reports != 1) {
+	    printf("lqr: in %u/%u lost, out %u lost, not 5/51 and 0\n",
+		   q->in_lost, q->in_sent, q->out_lost);
+	    ++failed;
+	}
+	q = &quality[2];
+	if (q->out_sent != 101 || q->out_lost != 10 || q->out_errors != 3
+	    || q->in_sent != 1 || q->in_lost != 0) {
+	    printf("lqr: out %u/%u lost, %u errors, in %u/%u lost,"
+		   " not 10/101, 3, 0/1\n", q->out_lost, q->out_sent,
+		   q->out_errors, q->in_lost, q->in_sent);
+	    ++failed;
+	}
+    }
+    if (!closed) {
+	printf("lqr: link not closed at 12%% loss with lqr-threshold 10\n");
+	++failed;
+    }
+    (*lqr_protent.lowerdown)(0);
+    lqr_quality_hook = NULL;
+    lqr_threshold = 0;
+    lqr_fails = 3;
+    return failed;
+}
+
+/*
+ * A link with no data traffic but LCP echoes every so often.  The peer
+ * counts the echoes and our replies, the kernel doesn't, and the link
+ * must not look lossy for it.
+ */
+static int
+echo_test(void)
+{
+    struct peer peer;
+    int i, j, failed = 0;
+
+    lqr_threshold = 10;
+    lqr_fails = 1;
+    lqr_quality_hook = quality_hook;
+    lqr_start(&peer, 0, 100);
+    peer_recv(&peer);
+    for (i = 0; i < 5; ++i) {
+	for (j = 0; j <= i; ++j)
+	    peer_echo(&peer);
+	peer_send(&peer);
+	peer_recv(&peer);
+    }
+
+    for (i = 0; i < nquality; ++i) {
+	if (quality[i].in_lost != 0 || quality[i].out_lost != 0) {
+	    printf("lqr: with only echoes, %u/%u lost in, %u/%u out\n",
+		   quality[i].in_lost, quality[i].in_sent,
+		   quality[i].out_lost, quality[i].out_sent);
+	    ++failed;
+	    break;
+	}
+    }
+    if (nquality != 4 || closed) {
+	printf("lqr: with only echoes, %d quality samples, link %s\n",
+	       nquality, closed? "closed": "open");
+	++failed;
+    }
+    (*lqr_protent.lowerdown)(0);
+    lqr_quality_hook = NULL;
+    lqr_threshold = 0;
+    lqr_fails = 3;
+    return failed;
+}
+
+int
+main(int argc, char *argv[])
+{
+    int failed = 0;
+
+    failed += reply_loop_test();
+    failed += loss_test();
+    failed += echo_test();
+    if (failed)
+	return -1;
+    printf("Success\n");
+    return 0;
+}
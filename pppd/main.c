@@ -89,13 +89,18 @@
 #include <arpa/inet.h>
 #include <limits.h>
 #include <inttypes.h>
+#include <time.h>
 #include <net/if.h>
+#ifdef HAVE_SPAWN_H
+#include <spawn.h>
+#endif
 
 #include "pppd-private.h"
 #include "options.h"
 #include "magic.h"
 #include "fsm.h"
 #include "lcp.h"
+#include "lqr.h"
 #include "ipcp.h"
 #ifdef PPP_WITH_IPV6CP
 #include "ipv6cp.h"
@@ -121,6 +126,17 @@
 #include "atcp.h"
 #endif
 
+/*
+ * Scripts are started with posix_spawn where the C library can also
+ * close the inherited descriptors and change directory for us.
+ */
+#if defined(HAVE_SPAWN_H) && defined(POSIX_SPAWN_SETSID) && !defined(BSD) \
+    && defined(HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCLOSEFROM_NP) \
+    && defined(HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCHDIR_NP)
+#define USE_SPAWN	1
+extern char **environ;
+#endif
+
 /* interface vars */
 char ifname[IFNAMSIZ];		/* Interface name */
 int ifunit;			/* Interface unit number */
@@ -160,6 +176,7 @@ int (*holdoff_hook)(void) = NULL;
 int (*new_phase_hook)(int) = NULL;
 void (*snoop_recv_hook)(unsigned char *p, int len) = NULL;
 void (*snoop_send_hook)(unsigned char *p, int len) = NULL;
+const struct ppp_sys_ops *sys_ops_hook = NULL;
 
 static int conn_running;	/* we have a [dis]connector running */
 static int fd_loop;		/* fd for getting demand-dial packets */
@@ -203,6 +220,7 @@ struct pppd_stats link_stats;
 unsigned link_connect_time;
 int link_stats_valid;
 int link_stats_print;
+struct pppd_stats chan_stats;	/* frames the unit's counters leave out */
 
 int error_count;
 
@@ -347,6 +365,7 @@ struct protent *protocols[] = {
     &atcp_protent,
 #endif
     &eap_protent,
+    &lqr_protent,
     NULL
 };
 
@@ -547,6 +566,8 @@ main(int argc, char *argv[])
 
     create_linkpidfile(getpid());
 
+    control_init();
+
     waiting = 0;
 
     /*
@@ -842,6 +863,7 @@ void
 set_ifunit(int iskey)
 {
     char ifkey[32];
+    unsigned int ifindex;
 
     if (req_ifname[0] != '\0')
 	slprintf(ifname, sizeof(ifname), "%s", req_ifname);
@@ -855,6 +877,11 @@ set_ifunit(int iskey)
 #endif
     slprintf(ifkey, sizeof(ifkey), "%d", ifunit);
     ppp_script_setenv("UNIT", ifkey, iskey);
+    ifindex = if_nametoindex(ifname);
+    if (ifindex != 0) {
+	slprintf(ifkey, sizeof(ifkey), "%u", ifindex);
+	ppp_script_setenv("IFINDEX", ifkey, 0);
+    }
     if (iskey) {
 	create_pidfile(getpid());	/* write pid to file */
 	create_linkpidfile(getpid());
@@ -912,6 +939,39 @@ detach(void)
     close(pipefd[0]);
 }
 
+/*
+ * ppp_forked - we are a child that a plugin forked from a pppd which
+ * had not yet started its link, and we are to be a pppd of our own.
+ * Change what depends on our pid, and let our parent keep its own
+ * database entry and control socket.
+ */
+void
+ppp_forked(void)
+{
+    char numbuf[16];
+#ifdef PPP_WITH_TDB
+    char *p;
+    int i;
+
+    if (pppdb != NULL) {
+	/*
+	 * We share our parent's file offset on the database, so open
+	 * it afresh.  The lookup keys we inherited are our parent's.
+	 */
+	tdb_close(pppdb);
+	pppdb = tdb_open(PPP_PATH_PPPDB, 0, 0, O_RDWR|O_CREAT, 0644);
+	for (i = 0; script_env != NULL && (p = script_env[i]) != NULL; ++i)
+	    p[-1] = 0;
+	slprintf(db_key, sizeof(db_key), "pppd%d", getpid());
+    }
+#endif
+    magic_init();
+    control_forked();
+    slprintf(numbuf, sizeof(numbuf), "%d", getpid());
+    ppp_script_setenv("PPPD_PID", numbuf, 1);
+    notify(pidchange, getpid());
+}
+
 /*
  * reopen_log - (re)open our connection to syslog.
  */
@@ -1173,6 +1233,7 @@ get_input(void)
 
     dump_packet("rcvd", p, len);
     if (snoop_recv_hook) snoop_recv_hook(p, len);
+    count_chan_frame(p, len, 0);
 
     p += 2;				/* Skip address and control */
     GETSHORT(protocol, p);
@@ -1224,6 +1285,35 @@ get_input(void)
     lcp_sprotrej(0, p - PPP_HDRLEN, len + PPP_HDRLEN);
 }
 
+#ifndef PPP_CCPFRAG
+#define PPP_CCPFRAG	0x80fb	/* CCP below the multilink bundle */
+#endif
+
+/*
+ * count_chan_frame - count a frame pppd itself sends or receives, if
+ * it is one that goes over the channel (LCP, authentication, LQR and
+ * the like, protocol 0xc000 and up) and so is left out of the unit's
+ * statistics.
+ */
+void
+count_chan_frame(unsigned char *p, int len, int out)
+{
+    int proto;
+
+    if (len < PPP_HDRLEN)
+	return;
+    proto = (p[2] << 8) + p[3];
+    if (proto < 0xc000 && proto != PPP_CCPFRAG)
+	return;
+    if (out) {
+	++chan_stats.pkts_out;
+	chan_stats.bytes_out += len;
+    } else {
+	++chan_stats.pkts_in;
+	chan_stats.bytes_in += len;
+    }
+}
+
 /*
  * ppp_send_config - configure the transmit-side characteristics of
  * the ppp interface.  Returns -1, indicating an error, if the channel
@@ -1295,6 +1385,12 @@ in_phase(ppp_phase_t p)
     return (phase == p);
 }
 
+ppp_phase_t
+ppp_get_phase(void)
+{
+    return phase;
+}
+
 /*
  * die - clean up state and exit with the specified status.
  */
@@ -1324,6 +1420,7 @@ cleanup(void)
     if (the_channel->cleanup)
 	(*the_channel->cleanup)();
     remove_pidfiles();
+    control_cleanup();
 
 #ifdef PPP_WITH_TDB
     if (pppdb != NULL)
@@ -1353,9 +1450,38 @@ print_link_stats(void)
 void
 reset_link_stats(int u)
 {
+    char numbuf[32];
+
     get_ppp_stats(u, &old_link_stats);
     ppp_get_time(&start_time);
     link_stats_print = 1;
+    slprintf(numbuf, sizeof(numbuf), "%ld", (long) time(NULL));
+    ppp_script_setenv("CONNECT_START", numbuf, 0);
+}
+
+/*
+ * get_link_counters - read the counters since the link went up,
+ * without recording them anywhere.
+ */
+bool
+get_link_counters(int u, ppp_link_stats_st *stats, unsigned int *connect_time)
+{
+    struct timeval now;
+
+    if (!get_ppp_stats(u, stats)
+	|| ppp_get_time(&now) < 0)
+	return false;
+    *connect_time = now.tv_sec - start_time.tv_sec;
+
+    stats->bytes_in  -= old_link_stats.bytes_in;
+    stats->bytes_out -= old_link_stats.bytes_out;
+    stats->pkts_in   -= old_link_stats.pkts_in;
+    stats->pkts_out  -= old_link_stats.pkts_out;
+    stats->errors_in   -= old_link_stats.errors_in;
+    stats->errors_out  -= old_link_stats.errors_out;
+    stats->dropped_in  -= old_link_stats.dropped_in;
+    stats->dropped_out -= old_link_stats.dropped_out;
+    return true;
 }
 
 /*
@@ -1364,20 +1490,12 @@ reset_link_stats(int u)
 void
 update_link_stats(int u)
 {
-    struct timeval now;
     char numbuf[32];
 
-    if (!get_ppp_stats(u, &link_stats)
-	|| ppp_get_time(&now) < 0)
+    if (!get_link_counters(u, &link_stats, &link_connect_time))
 	return;
-    link_connect_time = now.tv_sec - start_time.tv_sec;
     link_stats_valid = 1;
 
-    link_stats.bytes_in  -= old_link_stats.bytes_in;
-    link_stats.bytes_out -= old_link_stats.bytes_out;
-    link_stats.pkts_in   -= old_link_stats.pkts_in;
-    link_stats.pkts_out  -= old_link_stats.pkts_out;
-
     slprintf(numbuf, sizeof(numbuf), "%u", link_connect_time);
     ppp_script_setenv("CONNECT_TIME", numbuf, 0);
     snprintf(numbuf, sizeof(numbuf), "%" PRIu64, link_stats.bytes_out);
@@ -1386,17 +1504,24 @@ update_link_stats(int u)
     ppp_script_setenv("BYTES_RCVD", numbuf, 0);
 }
 
+/*
+ * ppp_get_link_stats - with a NULL argument, take the final stats and
+ * put them in the script environment.  Otherwise just read the current
+ * counters, as the metering code does.
+ */
 bool
 ppp_get_link_stats(ppp_link_stats_st *stats)
 {
-    update_link_stats(0);
-    if (stats != NULL &&
-        link_stats_valid) {
+    unsigned int connect_time;
 
-        memcpy(stats, &link_stats, sizeof(*stats));
-        return true;
+    if (stats == NULL) {
+	update_link_stats(0);
+	return false;
     }
-    return false;
+    if (!get_link_counters(0, stats, &connect_time))
+	return false;
+    link_connect_time = connect_time;
+    return true;
 }
 
 
@@ -1466,6 +1591,25 @@ ppp_untimeout(void (*func)(void *), void *arg)
 }
 
 
+/*
+ * ppp_timer_walk - call fn for each pending timeout, soonest first,
+ * with the number of microseconds until it is due.
+ */
+void
+ppp_timer_walk(void (*fn)(void *, void (*)(void *), void *, long),
+	       void *ctx)
+{
+    struct callout *p;
+
+    if (ppp_get_time(&timenow) < 0)
+	return;
+    for (p = callout; p != NULL; p = p->c_next)
+	(*fn)(ctx, p->c_func, p->c_arg,
+	      (p->c_time.tv_sec - timenow.tv_sec) * 1000000L
+	      + (p->c_time.tv_usec - timenow.tv_usec));
+}
+
+
 /*
  * calltimeout - Call any timeout routines which are now due.
  */
@@ -1808,6 +1952,124 @@ update_system_environment(void)
     }
 }
 
+#ifdef USE_SPAWN
+/*
+ * spawn_envp - make a copy of an environment with the set/unset
+ * options applied.  The strings for the set options are stored in
+ * the same block as the pointers, so the result is freed with a
+ * single free().
+ */
+static char **
+spawn_envp(char **base)
+{
+    struct userenv *uep;
+    char **envp, *sp, *p;
+    size_t size;
+    int i, n, nlen;
+
+    n = 0;
+    size = 0;
+    if (base != NULL)
+	while (base[n] != NULL)
+	    ++n;
+    for (uep = userenv_list; uep != NULL; uep = uep->ue_next) {
+	++n;
+	if (uep->ue_isset)
+	    size += strlen(uep->ue_name) + strlen(uep->ue_value) + 2;
+    }
+    envp = malloc((n + 1) * sizeof(char *) + size);
+    if (envp == NULL)
+	return NULL;
+    sp = (char *) (envp + n + 1);
+
+    n = 0;
+    if (base != NULL)
+	for (; base[n] != NULL; ++n)
+	    envp[n] = base[n];
+    envp[n] = NULL;
+
+    for (uep = userenv_list; uep != NULL; uep = uep->ue_next) {
+	nlen = strlen(uep->ue_name);
+	for (i = 0; (p = envp[i]) != NULL; i++) {
+	    if (strncmp(p, uep->ue_name, nlen) == 0 && p[nlen] == '=')
+		break;
+	}
+	if (uep->ue_isset) {
+	    size = nlen + strlen(uep->ue_value) + 2;
+	    slprintf(sp, size, "%s=%s", uep->ue_name, uep->ue_value);
+	    envp[i] = sp;
+	    sp += size;
+	    if (p == NULL)
+		envp[++n] = NULL;
+	} else if (p != NULL) {
+	    while ((envp[i] = envp[i + 1]) != NULL)
+		i++;
+	    --n;
+	}
+    }
+    return envp;
+}
+
+/*
+ * spawn_script - start a program with posix_spawn, so that we don't
+ * copy the whole pppd image just to exec a script.  The child gets
+ * infd, outfd and errfd as fds 0, 1 and 2 and all other fds are
+ * closed.  If detach is set, the child also gets a new session,
+ * "/" as its current directory and a umask of 077.
+ * Returns the pid, -1 with errno set on failure, or -2 if the
+ * program has to be started with ppp_safe_fork instead.
+ */
+static pid_t
+spawn_script(char *path, char * const *args, char **base_env,
+	     int infd, int outfd, int errfd, int detach)
+{
+    posix_spawn_file_actions_t fa;
+    posix_spawnattr_t attr;
+    char **envp;
+    pid_t pid;
+    mode_t mask = 0;
+    int err;
+
+    /*
+     * Plugins that hook fork_notifier expect to run in the child,
+     * and the dup2 actions below can't untangle overlapping fds.
+     */
+    if (fork_notifier != NULL || (infd != 0 && (outfd == 0 || errfd == 0))
+	|| (outfd != 1 && errfd == 1))
+	return -2;
+
+    envp = spawn_envp(base_env);
+    if (envp == NULL) {
+	errno = ENOMEM;
+	return -1;
+    }
+    posix_spawn_file_actions_init(&fa);
+    posix_spawn_file_actions_adddup2(&fa, infd, 0);
+    posix_spawn_file_actions_adddup2(&fa, outfd, 1);
+    posix_spawn_file_actions_adddup2(&fa, errfd, 2);
+    posix_spawn_file_actions_addclosefrom_np(&fa, 3);
+    posix_spawnattr_init(&attr);
+    if (detach) {
+	posix_spawn_file_actions_addchdir_np(&fa, "/");
+	posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSID);
+	mask = umask(S_IRWXG|S_IRWXO);
+    }
+
+    err = posix_spawn(&pid, path, &fa, &attr, args, envp);
+
+    if (detach)
+	umask(mask);
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&fa);
+    free(envp);
+    if (err != 0) {
+	errno = err;
+	return -1;
+    }
+    return pid;
+}
+#endif /* USE_SPAWN */
+
 /*
  * device_script - run a program to talk to the specified fds
  * (e.g. to run the connector or disconnector script).
@@ -1827,7 +2089,16 @@ device_script(char *program, int in, int out, int dont_wait)
 	errfd = open(PPP_PATH_CONNERRS, O_WRONLY | O_APPEND | O_CREAT, 0644);
 
     ++conn_running;
-    pid = ppp_safe_fork(in, out, errfd);
+    pid = -2;
+#ifdef USE_SPAWN
+    if (getuid() == uid && geteuid() == uid && getgid() == getegid()) {
+	char *argv[] = { "sh", "-c", program, NULL };
+
+	pid = spawn_script("/bin/sh", argv, environ, in, out, errfd, 0);
+    }
+    if (pid == -2)
+#endif
+	pid = ppp_safe_fork(in, out, errfd);
 
     if (pid != 0 && log_to_fd < 0)
 	close(errfd);
@@ -1933,7 +2204,22 @@ run_program(char *prog, char * const *args, int must_exist, void (*done)(void *)
     if (!ppp_check_access(prog, &rpath, must_exist, 1))
 	return 0;
 
-    pid = ppp_safe_fork(fd_devnull, fd_devnull, fd_devnull);
+    pid = -2;
+#ifdef USE_SPAWN
+    if (getuid() == 0 && getgid() == getegid()) {
+	/*
+	 * If posix_spawn fails, fork instead: the child reports why
+	 * the exec failed and exits, and done() is still called when
+	 * it is reaped, just as if posix_spawn had never been tried.
+	 */
+	pid = spawn_script(rpath, args, script_env,
+			   fd_devnull, fd_devnull, fd_devnull, 1);
+	if (pid == -1)
+	    pid = -2;
+    }
+    if (pid == -2)
+#endif
+	pid = ppp_safe_fork(fd_devnull, fd_devnull, fd_devnull);
     if (pid == -1) {
 	error("Failed to create child process for %s: %m", prog);
 	return -1;
@@ -2100,6 +2386,7 @@ struct notifier **get_notifier_by_type(ppp_notify_t type)
         [NF_AUTH_UP     ] = &auth_up_notifier,
         [NF_LINK_DOWN   ] = &link_down_notifier,
         [NF_FORK        ] = &fork_notifier,
+        [NF_LCP_UP      ] = &lcp_up_notifier,
     };
     return list[type];
 }
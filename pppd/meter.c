@@ -0,0 +1,225 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*
+ * meter.c - Shared sampling of the link counters.
+ *
+ * Copyright (c) 2026 The pppd Project. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THE AUTHORS OF THIS SOFTWARE DISCLAIM ALL WARRANTIES WITH REGARD TO
+ * THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+ * AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Rather than each of the traffic limit, the idle timeout, interim
+ * accounting and so on reading the counters on a timer of its own,
+ * they register here.  There is one timer, set for whichever client is
+ * due first; when it fires, the counters and idle times are read once
+ * and handed to every client that is due.  Clients due within a short
+ * time of each other are served by the same reading.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "pppd-private.h"
+#include "magic.h"
+#include "meter.h"
+
+#define METER_BATCH	50	/* ms early a client may be served */
+
+int stats_max_age = 100;	/* ms for which a reading is shared */
+
+struct meter_client {
+    struct meter_client	*next;
+    ppp_meter_fn	*fn;
+    void		*arg;
+    struct timeval	due;
+    bool		dead;	/* removed while clients were being called */
+};
+
+static struct meter_client *meter_clients;
+static bool meter_calling;
+static struct ppp_meter_sample meter_last;
+static bool meter_have_last;
+
+static void meter_sample(void *);
+
+static long
+ms_between(const struct timeval *from, const struct timeval *to)
+{
+    return (to->tv_sec - from->tv_sec) * 1000
+	+ (to->tv_usec - from->tv_usec) / 1000;
+}
+
+static void
+set_due(struct timeval *due, const struct timeval *from, int ms)
+{
+    due->tv_sec = from->tv_sec + ms / 1000;
+    due->tv_usec = from->tv_usec + (ms % 1000) * 1000;
+    if (due->tv_usec >= 1000000) {
+	due->tv_usec -= 1000000;
+	++due->tv_sec;
+    }
+}
+
+static void
+meter_take(struct ppp_meter_sample *m)
+{
+    struct ppp_idle idle;
+
+    ppp_get_time(&m->when);
+    m->stats_valid = get_link_counters(0, &m->stats, &m->connect_time);
+    m->idle_valid = get_idle_time(0, &idle);
+    if (m->idle_valid) {
+	m->xmit_idle = idle.xmit_idle;
+	m->recv_idle = idle.recv_idle;
+    }
+}
+
+const struct ppp_meter_sample *
+ppp_meter_read(void)
+{
+    struct timeval now;
+
+    ppp_get_time(&now);
+    if (!meter_have_last || ms_between(&meter_last.when, &now) >= stats_max_age) {
+	meter_take(&meter_last);
+	meter_have_last = true;
+    }
+    return &meter_last;
+}
+
+/*
+ * meter_arm - set the timer for the client due first.
+ */
+static void
+meter_arm(void)
+{
+    struct meter_client *c;
+    struct timeval now, *first = NULL;
+    long ms;
+
+    UNTIMEOUT(meter_sample, NULL);
+    for (c = meter_clients; c != NULL; c = c->next)
+	if (!c->dead && (first == NULL || timercmp(&c->due, first, <)))
+	    first = &c->due;
+    if (first == NULL)
+	return;
+    ppp_get_time(&now);
+    ms = ms_between(&now, first);
+    if (ms < 0)
+	ms = 0;
+    ppp_timeout(meter_sample, NULL, ms / 1000, (ms % 1000) * 1000);
+}
+
+static void
+meter_sweep(void)
+{
+    struct meter_client *c, **cp;
+
+    for (cp = &meter_clients; (c = *cp) != NULL; ) {
+	if (c->dead) {
+	    *cp = c->next;
+	    free(c);
+	} else
+	    cp = &c->next;
+    }
+}
+
+/*
+ * meter_sample - timer callback: take a reading and give it to the
+ * clients that are due.  The reading is always a fresh one, since a
+ * shared one from up to stats-max-age ago could be too old for the
+ * client that set the timer, which would then never be served.
+ * Clients may add or remove clients, and close the link, while we are
+ * calling them.
+ */
+static void
+meter_sample(void *arg)
+{
+    const struct ppp_meter_sample *m = &meter_last;
+    struct meter_client *c;
+    int next;
+
+    meter_take(&meter_last);
+    meter_have_last = true;
+    meter_calling = true;
+    for (c = meter_clients; c != NULL; c = c->next) {
+	if (c->dead || ms_between(&m->when, &c->due) > METER_BATCH)
+	    continue;
+	next = (*c->fn)(m, c->arg);
+	if (next <= 0) {
+	    c->dead = true;
+	    continue;
+	}
+	set_due(&c->due, &m->when, next);
+    }
+    meter_calling = false;
+    meter_sweep();
+    meter_arm();
+}
+
+void
+ppp_meter_add(ppp_meter_fn *fn, void *arg, int delay, int jitter)
+{
+    struct meter_client *c;
+    struct timeval now;
+
+    for (c = meter_clients; c != NULL; c = c->next)
+	if (!c->dead && c->fn == fn && c->arg == arg)
+	    break;
+    if (c == NULL) {
+	c = malloc(sizeof(*c));
+	if (c == NULL)
+	    novm("meter client");
+	c->fn = fn;
+	c->arg = arg;
+	c->dead = false;
+	c->next = meter_clients;
+	meter_clients = c;
+    }
+
+    if (jitter > 0)
+	delay -= magic() % (jitter + 1);
+    if (delay < 0)
+	delay = 0;
+    ppp_get_time(&now);
+    set_due(&c->due, &now, delay);
+    if (!meter_calling)
+	meter_arm();
+}
+
+void
+ppp_meter_remove(ppp_meter_fn *fn, void *arg)
+{
+    struct meter_client *c;
+
+    for (c = meter_clients; c != NULL; c = c->next)
+	if (c->fn == fn && c->arg == arg)
+	    c->dead = true;
+    if (!meter_calling) {
+	meter_sweep();
+	meter_arm();
+    }
+}
@@ -0,0 +1,85 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*
+ * meter.h - Shared sampling of the link counters.
+ *
+ * Copyright (c) 2026 The pppd Project. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THE AUTHORS OF THIS SOFTWARE DISCLAIM ALL WARRANTIES WITH REGARD TO
+ * THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+ * AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef PPP_METER_H
+#define PPP_METER_H
+
+#include <time.h>
+#include <sys/time.h>
+
+#include "pppdconf.h"
+#include "pppd.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * One reading of the link, shared by everything that watches the
+ * traffic: the traffic limit, the idle timeout, interim accounting
+ * and so on.  The counters are since the link went up.
+ */
+struct ppp_meter_sample {
+    struct timeval	when;		/* pppd's time of the reading */
+    bool		stats_valid;
+    ppp_link_stats_st	stats;
+    unsigned int	connect_time;	/* seconds since the link went up */
+    bool		idle_valid;
+    time_t		xmit_idle;	/* seconds since a data packet went */
+    time_t		recv_idle;	/* ... or came */
+};
+
+/*
+ * A meter client is called with a new reading when it is due, and
+ * returns how many milliseconds until it next wants one, or 0 if it
+ * has finished and should be removed.
+ */
+typedef int (ppp_meter_fn)(const struct ppp_meter_sample *, void *arg);
+
+/*
+ * Add a client, first due in delay milliseconds less a random part of
+ * jitter milliseconds.  Clients which do the same thing in every pppd
+ * on a host should give some jitter so that they do not all sample at
+ * once.
+ */
+void ppp_meter_add(ppp_meter_fn *fn, void *arg, int delay, int jitter);
+
+/*
+ * Remove a client.
+ */
+void ppp_meter_remove(ppp_meter_fn *fn, void *arg);
+
+/*
+ * Get a reading on demand.  Readings less than stats-max-age ms old
+ * (a tenth of a second by default) are shared.
+ */
+const struct ppp_meter_sample *ppp_meter_read(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PPP_METER_H */
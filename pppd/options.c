@@ -319,6 +319,14 @@ struct option general_options[] = {
       "Set PPP interface name",
       OPT_PRIO | OPT_PRIV | OPT_STATIC, NULL, IFNAMSIZ },
 
+    { "control", o_string, &control_path,
+      "Listen for control requests on this unix socket",
+      OPT_PRIO | OPT_PRIV },
+
+    { "stats-max-age", o_int, &stats_max_age,
+      "Reuse link counters read within this many ms",
+      OPT_PRIO | OPT_LIMITS, 0, 1000, 0 },
+
 #ifdef __linux__
     { "vrf", o_string, req_vrf,
       "Bind PPP interface to the specified VRF and install routes in its routing table",
@@ -764,37 +772,123 @@ match_option(char *name, struct option *opt, int dowild)
 }
 
 /*
- * find_option - scan the option lists for the various protocols
- * looking for an entry with the given name.
- * This could be optimized by using a hash table.
+ * Hash index of option names, so that find_option doesn't have to
+ * scan every option table for each word it is given.  Each name maps
+ * to the first non-wildcard option with that name, in the order in
+ * which the tables were searched before; wildcard options are kept
+ * in a separate list in the same order.  The index is rebuilt when
+ * an option table is added or the channel changes.
+ */
+static struct option **option_hash;
+static unsigned option_hash_mask;
+static struct option **wild_options;
+static int n_wild_options;
+static int option_hash_valid;
+static struct channel *option_hash_channel;
+
+static unsigned
+option_name_hash(char *name)
+{
+	unsigned h = 2166136261u;
+
+	for (; *name != 0; ++name)
+		h = (h ^ (unsigned char) *name) * 16777619u;
+	return h;
+}
+
+/*
+ * option_table_insert - add the options in a table to the index,
+ * or just count them if the index hasn't been allocated yet.
+ */
+static void
+option_table_insert(struct option *opt, int *countp)
+{
+	unsigned h;
+
+	for (; opt->name != NULL; ++opt) {
+		if (option_hash == NULL) {
+			++*countp;
+			continue;
+		}
+		if (opt->type == o_wild) {
+			wild_options[n_wild_options++] = opt;
+			continue;
+		}
+		for (h = option_name_hash(opt->name) & option_hash_mask;
+		     option_hash[h] != NULL; h = (h + 1) & option_hash_mask)
+			if (strcmp(option_hash[h]->name, opt->name) == 0)
+				break;
+		if (option_hash[h] == NULL)
+			option_hash[h] = opt;
+	}
+}
+
+/*
+ * option_tables_insert - pass each option table to option_table_insert
+ * in search order.
+ */
+static void
+option_tables_insert(int *countp)
+{
+	struct option_list *list;
+	int i;
+
+	option_table_insert(general_options, countp);
+	option_table_insert(auth_options, countp);
+	for (list = extra_options; list != NULL; list = list->next)
+		option_table_insert(list->options, countp);
+	option_table_insert(the_channel->options, countp);
+	for (i = 0; protocols[i] != NULL; ++i)
+		if (protocols[i]->options != NULL)
+			option_table_insert(protocols[i]->options, countp);
+}
+
+static void
+build_option_hash(void)
+{
+	int count = 0;
+	unsigned size;
+
+	free(option_hash);
+	free(wild_options);
+	option_hash = NULL;
+	option_tables_insert(&count);
+
+	for (size = 256; size < 2 * (unsigned) count; size <<= 1)
+		;
+	option_hash = calloc(size, sizeof(struct option *));
+	wild_options = malloc((count + 1) * sizeof(struct option *));
+	if (option_hash == NULL || wild_options == NULL)
+		novm("option hash");
+	option_hash_mask = size - 1;
+	n_wild_options = 0;
+	option_tables_insert(&count);
+
+	option_hash_valid = 1;
+	option_hash_channel = the_channel;
+}
+
+/*
+ * find_option - look up the option with the given name, falling back
+ * to the wildcard options if there is no exact match.
  */
 static struct option *
 find_option(char *name)
 {
 	struct option *opt;
-	struct option_list *list;
-	int i, dowild;
-
-	for (dowild = 0; dowild <= 1; ++dowild) {
-		for (opt = general_options; opt->name != NULL; ++opt)
-			if (match_option(name, opt, dowild))
-				return opt;
-		for (opt = auth_options; opt->name != NULL; ++opt)
-			if (match_option(name, opt, dowild))
-				return opt;
-		for (list = extra_options; list != NULL; list = list->next)
-			for (opt = list->options; opt->name != NULL; ++opt)
-				if (match_option(name, opt, dowild))
-					return opt;
-		for (opt = the_channel->options; opt->name != NULL; ++opt)
-			if (match_option(name, opt, dowild))
-				return opt;
-		for (i = 0; protocols[i] != NULL; ++i)
-			if ((opt = protocols[i]->options) != NULL)
-				for (; opt->name != NULL; ++opt)
-					if (match_option(name, opt, dowild))
-						return opt;
-	}
+	unsigned h;
+	int i;
+
+	if (!option_hash_valid || option_hash_channel != the_channel)
+		build_option_hash();
+
+	for (h = option_name_hash(name) & option_hash_mask;
+	     (opt = option_hash[h]) != NULL; h = (h + 1) & option_hash_mask)
+		if (strcmp(opt->name, name) == 0)
+			return opt;
+	for (i = 0; i < n_wild_options; ++i)
+		if (match_option(name, wild_options[i], 1))
+			return wild_options[i];
 	return NULL;
 }
 
@@ -1039,6 +1133,7 @@ ppp_add_options(struct option *opt)
     list->options = opt;
     list->next = extra_options;
     extra_options = list;
+    option_hash_valid = 0;
 }
 
 /*
@@ -1352,9 +1447,10 @@ readable(int fd)
  * Words are delimited by white-space or by quotes (" or ').
  * Quotes, white-space and \ may be escaped with \.
  * \<newline> is ignored.
+ * The caller must hold the lock on f.
  */
-int
-getword(FILE *f, char *word, int *newlinep, char *filename)
+static int
+getword_unlocked(FILE *f, char *word, int *newlinep, char *filename)
 {
     int c, len, escape;
     int quoted, comment;
@@ -1372,7 +1468,7 @@ getword(FILE *f, char *word, int *newlinep, char *filename)
      * First skip white-space and comments.
      */
     for (;;) {
-	c = getc(f);
+	c = getc_unlocked(f);
 	if (c == EOF)
 	    break;
 
@@ -1436,7 +1532,7 @@ getword(FILE *f, char *word, int *newlinep, char *filename)
 	     */
 	    escape = 0;
 	    if (c == '\n') {
-	        c = getc(f);
+	        c = getc_unlocked(f);
 		continue;
 	    }
 
@@ -1472,7 +1568,7 @@ getword(FILE *f, char *word, int *newlinep, char *filename)
 		    value = 0;
 		    for (n = 0; n < 3 && isoctal(c); ++n) {
 			value = (value << 3) + (c & 07);
-			c = getc(f);
+			c = getc_unlocked(f);
 		    }
 		    got = 1;
 		    break;
@@ -1483,13 +1579,13 @@ getword(FILE *f, char *word, int *newlinep, char *filename)
 		     * \x<hex_string> sequence
 		     */
 		    value = 0;
-		    c = getc(f);
+		    c = getc_unlocked(f);
 		    for (n = 0; n < 2 && isxdigit(c); ++n) {
 			digit = toupper(c) - '0';
 			if (digit > 10)
 			    digit += '0' + 10 - 'A';
 			value = (value << 4) + digit;
-			c = getc (f);
+			c = getc_unlocked(f);
 		    }
 		    got = 1;
 		    break;
@@ -1511,7 +1607,7 @@ getword(FILE *f, char *word, int *newlinep, char *filename)
 	    }
 
 	    if (!got)
-		c = getc(f);
+		c = getc_unlocked(f);
 	    continue;
 	}
 
@@ -1520,7 +1616,7 @@ getword(FILE *f, char *word, int *newlinep, char *filename)
 	 */
 	if (c == '\\') {
 	    escape = 1;
-	    c = getc(f);
+	    c = getc_unlocked(f);
 	    continue;
 	}
 
@@ -1531,12 +1627,12 @@ getword(FILE *f, char *word, int *newlinep, char *filename)
 	if (quoted) {
 	    if (c == quoted) {
 		quoted = 0;
-		c = getc(f);
+		c = getc_unlocked(f);
 		continue;
 	    }
 	} else if (c == '"' || c == '\'') {
 	    quoted = c;
-	    c = getc(f);
+	    c = getc_unlocked(f);
 	    continue;
 	} else if (isspace(c) || c == '#') {
 	    ungetc (c, f);
@@ -1551,7 +1647,7 @@ getword(FILE *f, char *word, int *newlinep, char *filename)
 	    ++len;
 	}
 
-	c = getc(f);
+	c = getc_unlocked(f);
     }
     word[MAXWORDLEN-1] = 0;	/* make sure word is null-terminated */
 
@@ -1592,6 +1688,21 @@ getword(FILE *f, char *word, int *newlinep, char *filename)
 
 }
 
+/*
+ * getword - read a word from a file, taking the stdio lock once per
+ * word rather than once per character.
+ */
+int
+getword(FILE *f, char *word, int *newlinep, char *filename)
+{
+    int ret;
+
+    flockfile(f);
+    ret = getword_unlocked(f, word, newlinep, filename);
+    funlockfile(f);
+    return ret;
+}
+
 /*
  * number_option - parse an unsigned numeric parameter for an option.
  */
@@ -0,0 +1,442 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*
+ * dhcpv6-broker.c - Shared upstream for the DHCPv6 relay plugin.
+ *
+ * A single broker process owns the one UDP socket towards the DHCPv6
+ * server.  Each pppd running the dhcpv6relay plugin with the
+ * dhcpv6-broker option hands its relay-forw messages to the broker over
+ * a local datagram socket, tagged with an interface-id option.  The
+ * server echoes the interface-id back in its relay-repl, which the
+ * broker uses to route the reply back to the right pppd.
+ *
+ * Copyright (c) 2026 The pppd Project. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THE AUTHORS OF THIS SOFTWARE DISCLAIM ALL WARRANTIES WITH REGARD TO
+ * THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+ * AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include "dhcpv6relay.h"
+
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+/* Sessions that haven't forwarded anything for this long are forgotten */
+#define BROKER_SESSION_TTL	3600
+#define BROKER_HASH_SIZE	4096
+#define BROKER_MAX_IFID		64
+
+struct broker_session {
+    struct broker_session *next;
+    time_t last_seen;
+    struct sockaddr_un addr;
+    socklen_t addrlen;
+    uint16_t ifid_len;
+    unsigned char ifid[BROKER_MAX_IFID];
+};
+
+static struct broker_session *sessions[BROKER_HASH_SIZE];
+static unsigned nsessions = 0;
+static int debug = 0;
+static volatile sig_atomic_t got_sigterm = 0;
+
+static void
+error(const char *fmt, ...)
+{
+    va_list pvar;
+    va_start(pvar, fmt);
+    vfprintf(stderr, fmt, pvar);
+    fputc('\n', stderr);
+    va_end(pvar);
+}
+
+static void
+dbglog(const char *fmt, ...)
+{
+    va_list pvar;
+    if (!debug)
+	return;
+    va_start(pvar, fmt);
+    vfprintf(stderr, fmt, pvar);
+    fputc('\n', stderr);
+    va_end(pvar);
+}
+
+static void
+term(int sig)
+{
+    got_sigterm = 1;
+}
+
+static unsigned
+ifid_hash(const unsigned char *ifid, uint16_t len)
+{
+    /* FNV-1a */
+    uint32_t h = 2166136261u;
+    while (len--) {
+	h ^= *ifid++;
+	h *= 16777619u;
+    }
+    return h % BROKER_HASH_SIZE;
+}
+
+static struct broker_session **
+session_find(const unsigned char *ifid, uint16_t len)
+{
+    struct broker_session **s = &sessions[ifid_hash(ifid, len)];
+    while (*s) {
+	if ((*s)->ifid_len == len && memcmp((*s)->ifid, ifid, len) == 0)
+	    return s;
+	s = &(*s)->next;
+    }
+    return s;
+}
+
+static void
+session_remove(struct broker_session **s)
+{
+    struct broker_session *t = *s;
+    *s = t->next;
+    free(t);
+    --nsessions;
+}
+
+static void
+session_expire(time_t now)
+{
+    int i;
+    for (i = 0; i < BROKER_HASH_SIZE; ++i) {
+	struct broker_session **s = &sessions[i];
+	while (*s) {
+	    if (now - (*s)->last_seen > BROKER_SESSION_TTL)
+		session_remove(s);
+	    else
+		s = &(*s)->next;
+	}
+    }
+}
+
+/*
+ * Locate the interface-id option in a relay-forw/relay-repl message.
+ */
+static const unsigned char *
+find_ifid(const unsigned char *bfr, ssize_t len, uint16_t *ifid_len)
+{
+    if (len < 34)
+	return NULL;
+    bfr += 34;
+    len -= 34;
+    while (len >= 4) {
+	uint16_t type = ntohs(*(uint16_t*)bfr);
+	uint16_t optlen = ntohs(*(uint16_t*)(bfr + 2));
+	bfr += 4;
+	len -= 4;
+	if (optlen > len)
+	    return NULL;
+	if (type == DHCPv6_OPTION_INTERFACE_ID) {
+	    *ifid_len = optlen;
+	    return bfr;
+	}
+	bfr += optlen;
+	len -= optlen;
+    }
+    return NULL;
+}
+
+static void
+client_event(int sock, int upstream, uint16_t sport)
+{
+    /* room for the largest forward the plugin builds plus our relay-port */
+    unsigned char bfr[2048];
+    struct sockaddr_un sa;
+    socklen_t slen;
+    const unsigned char *ifid;
+    uint16_t ifid_len;
+    struct broker_session **s, *t;
+    ssize_t r;
+
+    for (;;) {
+	slen = sizeof(sa);
+	r = recvfrom(sock, bfr, sizeof(bfr) - 6, MSG_DONTWAIT | MSG_TRUNC,
+		(struct sockaddr*)&sa, &slen);
+	if (r < 0) {
+	    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+		error("Failed to read from broker socket: %s", strerror(errno));
+	    return;
+	}
+	if (r > sizeof(bfr) - 6) {
+	    error("Discarding oversized message of %zd bytes from pppd.", r);
+	    continue;
+	}
+	if (r < 34 || bfr[0] != DHCPv6_MSGTYPE_RELAY_FORW) {
+	    error("Discarding message from pppd that isn't a relay-forw.");
+	    continue;
+	}
+	ifid = find_ifid(bfr, r, &ifid_len);
+	if (!ifid || !ifid_len || ifid_len > BROKER_MAX_IFID) {
+	    error("Discarding relay-forw without a usable interface-id.");
+	    continue;
+	}
+
+	s = session_find(ifid, ifid_len);
+	if (!*s) {
+	    t = calloc(1, sizeof(*t));
+	    if (!t) {
+		error("Out of memory tracking new session.");
+		continue;
+	    }
+	    t->ifid_len = ifid_len;
+	    memcpy(t->ifid, ifid, ifid_len);
+	    *s = t;
+	    ++nsessions;
+	    dbglog("New session %.*s (%u active)", ifid_len, ifid, nsessions);
+	}
+	t = *s;
+	t->addr = sa;
+	t->addrlen = slen;
+	t->last_seen = time(NULL);
+
+	/* the plugin can't know our source port, so add relay-port here */
+	bfr[r++] = DHCPv6_OPTION_RELAY_PORT >> 8;
+	bfr[r++] = DHCPv6_OPTION_RELAY_PORT & 0xFF;
+	bfr[r++] = 0;
+	bfr[r++] = 2;
+	memcpy(&bfr[r], &sport, 2);
+	r += 2;
+
+	if (send(upstream, bfr, r, 0) < 0)
+	    error("Failed to transmit relay-forw to server: %s", strerror(errno));
+    }
+}
+
+static void
+server_event(int upstream, int sock)
+{
+    unsigned char bfr[2048];
+    const unsigned char *ifid;
+    uint16_t ifid_len;
+    struct broker_session **s;
+    ssize_t r;
+
+    for (;;) {
+	r = recv(upstream, bfr, sizeof(bfr), MSG_DONTWAIT | MSG_TRUNC);
+	if (r < 0) {
+	    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+		error("Failed to read from upstream socket: %s", strerror(errno));
+	    return;
+	}
+	if (r > sizeof(bfr)) {
+	    error("Discarding oversized message of %zd bytes from server.", r);
+	    continue;
+	}
+	if (r < 34 || bfr[0] != DHCPv6_MSGTYPE_RELAY_REPL) {
+	    error("Discarding message from server that isn't a relay-repl.");
+	    continue;
+	}
+	ifid = find_ifid(bfr, r, &ifid_len);
+	if (!ifid) {
+	    error("Discarding relay-repl without interface-id.");
+	    continue;
+	}
+	s = session_find(ifid, ifid_len);
+	if (!*s) {
+	    dbglog("Discarding relay-repl for unknown session %.*s", ifid_len, ifid);
+	    continue;
+	}
+
+	if (sendto(sock, bfr, r, MSG_DONTWAIT, (struct sockaddr*)&(*s)->addr,
+		    (*s)->addrlen) < 0) {
+	    if (errno == ECONNREFUSED || errno == ENOENT) {
+		/* pppd has gone away */
+		dbglog("Session %.*s is gone", ifid_len, ifid);
+		session_remove(s);
+	    } else {
+		error("Failed to pass relay-repl to pppd: %s", strerror(errno));
+	    }
+	}
+    }
+}
+
+static int
+open_upstream(const char *server, uint16_t *sport)
+{
+    struct addrinfo *ai = NULL, *i, *use = NULL, hint = {
+	.ai_socktype = SOCK_DGRAM,
+    };
+    struct sockaddr_storage ss;
+    socklen_t slen = sizeof(ss);
+    int r, fd;
+
+    r = getaddrinfo(server, "dhcpv6-server", &hint, &ai);
+    if (r != 0) {
+	error("Unable to resolve %s: %s", server, gai_strerror(r));
+	return -1;
+    }
+    /* we *prefer* IPv6, but will accept IPv4 */
+    for (i = ai; i; i = i->ai_next) {
+	if (!use || i->ai_family == AF_INET6)
+	    use = i;
+	if (use->ai_family == AF_INET6)
+	    break;
+    }
+
+    fd = socket(use->ai_family, SOCK_DGRAM, 0);
+    if (fd < 0) {
+	error("Failed to create upstream socket: %s", strerror(errno));
+    } else if (connect(fd, use->ai_addr, use->ai_addrlen) < 0) {
+	error("Failed to connect upstream socket: %s", strerror(errno));
+	close(fd);
+	fd = -1;
+    } else if (getsockname(fd, (struct sockaddr*)&ss, &slen) < 0) {
+	error("Unable to determine local sending port: %s", strerror(errno));
+	close(fd);
+	fd = -1;
+    } else {
+	*sport = ss.ss_family == AF_INET ?
+	    ((struct sockaddr_in*)&ss)->sin_port :
+	    ((struct sockaddr_in6*)&ss)->sin6_port;
+    }
+    freeaddrinfo(ai);
+    return fd;
+}
+
+static int
+open_broker(const char *path)
+{
+    struct sockaddr_un sa;
+    mode_t mask;
+    int fd;
+
+    if (strlen(path) >= sizeof(sa.sun_path)) {
+	error("Socket path %s is too long.", path);
+	return -1;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    strcpy(sa.sun_path, path);
+
+    fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (fd < 0) {
+	error("Failed to create broker socket: %s", strerror(errno));
+	return -1;
+    }
+    unlink(path);
+    /* create it 0600 from the start, a chmod() after bind() leaves a gap */
+    mask = umask(0177);
+    if (bind(fd, (struct sockaddr*)&sa, sizeof(sa)) < 0) {
+	error("Failed to bind broker socket to %s: %s", path, strerror(errno));
+	umask(mask);
+	close(fd);
+	return -1;
+    }
+    umask(mask);
+    return fd;
+}
+
+static void
+usage(const char *argv0)
+{
+    fprintf(stderr, "Usage: %s [-d] -s <socket> <dhcpv6-server>\n"
+	    "   -d           -- Log debug information to stderr.\n"
+	    "   -s <socket>  -- Local socket that pppd connects to (dhcpv6-broker option).\n",
+	    argv0);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const char *path = NULL;
+    struct pollfd pfd[2];
+    struct sigaction sa;
+    uint16_t sport = 0;
+    time_t last_expire;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "ds:h")) > 0) {
+	switch (opt) {
+	case 'd':
+	    debug = 1;
+	    break;
+	case 's':
+	    path = optarg;
+	    break;
+	case 'h':
+	default:
+	    usage(argv[0]);
+	    exit(opt == 'h' ? 0 : 1);
+	}
+    }
+
+    if (!path || optind != argc - 1) {
+	usage(argv[0]);
+	exit(1);
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = term;
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+
+    pfd[0].fd = open_broker(path);
+    if (pfd[0].fd < 0)
+	exit(1);
+    pfd[1].fd = open_upstream(argv[optind], &sport);
+    if (pfd[1].fd < 0) {
+	unlink(path);
+	exit(1);
+    }
+    pfd[0].events = pfd[1].events = POLLIN;
+
+    last_expire = time(NULL);
+    while (!got_sigterm) {
+	time_t now;
+
+	if (poll(pfd, 2, 60000) < 0) {
+	    if (errno == EINTR)
+		continue;
+	    error("poll: %s", strerror(errno));
+	    break;
+	}
+	if (pfd[0].revents & POLLIN)
+	    client_event(pfd[0].fd, pfd[1].fd, sport);
+	if (pfd[1].revents & POLLIN)
+	    server_event(pfd[1].fd, pfd[0].fd);
+
+	now = time(NULL);
+	if (now - last_expire >= 60) {
+	    session_expire(now);
+	    last_expire = now;
+	}
+    }
+
+    unlink(path);
+    return 0;
+}
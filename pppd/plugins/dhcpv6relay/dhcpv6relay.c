@@ -24,6 +24,7 @@
  * AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
  * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
+#define _GNU_SOURCE 1
 #include "dhcpv6relay.h"
 
 #include <pppd/pppd.h>
@@ -40,6 +41,7 @@
 #include <net/if.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/un.h>
 #include <netinet/icmp6.h>
 #include <stdio.h>
 
@@ -50,6 +52,7 @@ static int dhcpv6relay_setserver(const char** argv);
 static bool dhcpv6relay_trusted = false;
 static unsigned dhcpv6relay_metric = 0;
 static unsigned dhcpv6relay_ra_interval = 0;
+static char* dhcpv6relay_broker = NULL;
 
 static struct option options[] = {
     { "dhcpv6-server", o_special, (void*) &dhcpv6relay_setserver,
@@ -67,6 +70,9 @@ static struct option options[] = {
     { "dhcpv6-ra-intvl", o_int, &dhcpv6relay_ra_interval,
       "How frequently to send unsolicited Router Advertisement frames (default off)",
       OPT_PRIV|OPT_LLIMIT, NULL, 0, 0 },
+    { "dhcpv6-broker", o_string, &dhcpv6relay_broker,
+      "Relay via a dhcpv6-broker listening on this local socket",
+      OPT_PRIV },
     { NULL }
 };
 
@@ -76,7 +82,26 @@ static int dhcpv6relay_sock_mc = -1;
 static int dhcpv6relay_upstream = -1;
 static int dhcpv6relay_sock_rsra = -1;
 static struct sockaddr_storage dhcpv6relay_sa;
-static struct dhcpv6relay_route_entry *dhcpv6relay_delegations = NULL;
+
+/* Delegated prefixes, hashed on prefix and length.  Expiry is driven by a
+ * single timer for the entry at the top of a min-heap on valid_until. */
+#define DHCPv6_ROUTE_HASH	256
+static struct dhcpv6relay_route_entry *dhcpv6relay_delegations[DHCPv6_ROUTE_HASH];
+static struct dhcpv6relay_route_entry **dhcpv6relay_heap = NULL;
+static unsigned dhcpv6relay_heap_len = 0, dhcpv6relay_heap_size = 0;
+
+/* Route changes are collected while parsing a packet and then handed to
+ * the kernel as a batch. */
+static struct dhcpv6relay_route_op *dhcpv6relay_pending_add = NULL;
+static unsigned dhcpv6relay_pending_add_len = 0, dhcpv6relay_pending_add_size = 0;
+static struct dhcpv6relay_route_entry **dhcpv6relay_pending_del = NULL;
+static unsigned dhcpv6relay_pending_del_len = 0, dhcpv6relay_pending_del_size = 0;
+
+/* Resolved once in dhcpv6relay_up() so that the per-packet path doesn't
+ * need to go back to /etc/services or the interface tables. */
+static uint16_t dhcpv6relay_port_server = 0;	/* network byte order */
+static uint16_t dhcpv6relay_port_client = 0;	/* network byte order */
+static unsigned dhcpv6relay_ifindex = 0;
 
 static
 const char* dhcpv6_type2string(int msg_type)
@@ -170,141 +195,347 @@ int dhcpv6relay_setserver(const char** argv)
 }
 
 static
-void routes_remove_all()
+unsigned dhcpv6relay_route_hash(const struct in6_addr* addr, uint8_t prefixlen)
 {
-    char in6addr[INET6_ADDRSTRLEN];
-    struct dhcpv6relay_route_entry* c = dhcpv6relay_delegations;
+    /* FNV-1a over the prefix and its length */
+    uint32_t h = 2166136261u;
+    unsigned i;
 
-    while (c) {
-	struct dhcpv6relay_route_entry* n = c->next;
+    for (i = 0; i < sizeof(*addr); ++i) {
+	h ^= addr->s6_addr[i];
+	h *= 16777619u;
+    }
+    h ^= prefixlen;
+    h *= 16777619u;
 
-	if (!sifdelroute(AF_INET6, &c->prefix, c->len, dhcpv6relay_metric))
-	    error("DHCPv6 relay: failed to remove route for %s/%d",
-		    inet_ntop(AF_INET6, &c->prefix, in6addr, sizeof(in6addr)), c->len);
+    return h % DHCPv6_ROUTE_HASH;
+}
 
-	free(c);
-	c = n;
+static
+struct dhcpv6relay_route_entry** dhcpv6relay_find_route_entry(const struct in6_addr* addr, uint8_t prefixlen)
+{
+    struct dhcpv6relay_route_entry** s = &dhcpv6relay_delegations[dhcpv6relay_route_hash(addr, prefixlen)];
+    while (*s) {
+	if (memcmp(&(*s)->prefix, addr, sizeof(*addr)) == 0 && (*s)->len == prefixlen)
+	    return s;
+	s = &(*s)->next;
     }
+    return NULL;
+}
 
-    dhcpv6relay_delegations = NULL;
+static
+void dhcpv6relay_heap_set(unsigned i, struct dhcpv6relay_route_entry* r)
+{
+    dhcpv6relay_heap[i] = r;
+    r->heap_idx = i;
 }
 
 static
-void dhcpv6relay_down(void*, int)
+void dhcpv6relay_heap_fix(unsigned i)
 {
-    routes_remove_all();
-    if (dhcpv6relay_sock_ll >= 0) {
-	remove_fd(dhcpv6relay_sock_ll);
-	close(dhcpv6relay_sock_ll);
-	dhcpv6relay_sock_ll = -1;
-    }
-    if (dhcpv6relay_sock_mc >= 0) {
-	remove_fd(dhcpv6relay_sock_mc);
-	close(dhcpv6relay_sock_mc);
-	dhcpv6relay_sock_mc = -1;
+    struct dhcpv6relay_route_entry* r = dhcpv6relay_heap[i];
+
+    /* sift up */
+    while (i > 0 && dhcpv6relay_heap[(i - 1) / 2]->valid_until > r->valid_until) {
+	dhcpv6relay_heap_set(i, dhcpv6relay_heap[(i - 1) / 2]);
+	i = (i - 1) / 2;
     }
-    if (dhcpv6relay_upstream >= 0) {
-	remove_fd(dhcpv6relay_upstream);
-	close(dhcpv6relay_upstream);
-	dhcpv6relay_upstream = -1;
+
+    /* sift down */
+    for (;;) {
+	unsigned c = 2 * i + 1;
+	if (c >= dhcpv6relay_heap_len)
+	    break;
+	if (c + 1 < dhcpv6relay_heap_len &&
+		dhcpv6relay_heap[c + 1]->valid_until < dhcpv6relay_heap[c]->valid_until)
+	    ++c;
+	if (dhcpv6relay_heap[c]->valid_until >= r->valid_until)
+	    break;
+	dhcpv6relay_heap_set(i, dhcpv6relay_heap[c]);
+	i = c;
     }
-    if (dhcpv6relay_sock_rsra >= 0) {
-	remove_fd(dhcpv6relay_sock_rsra);
-	close(dhcpv6relay_sock_rsra);
-	dhcpv6relay_sock_rsra = -1;
+
+    dhcpv6relay_heap_set(i, r);
+}
+
+static
+int dhcpv6relay_heap_push(struct dhcpv6relay_route_entry* r)
+{
+    if (dhcpv6relay_heap_len == dhcpv6relay_heap_size) {
+	unsigned n = dhcpv6relay_heap_size ? 2 * dhcpv6relay_heap_size : 16;
+	struct dhcpv6relay_route_entry** h = realloc(dhcpv6relay_heap, n * sizeof(*h));
+	if (!h)
+	    return 0;
+	dhcpv6relay_heap = h;
+	dhcpv6relay_heap_size = n;
     }
+    dhcpv6relay_heap_set(dhcpv6relay_heap_len++, r);
+    dhcpv6relay_heap_fix(r->heap_idx);
+    return 1;
 }
 
 static
-struct dhcpv6relay_route_entry** dhcpv6relay_find_route_entry(const struct in6_addr* addr, uint8_t prefixlen)
+void dhcpv6relay_heap_remove(struct dhcpv6relay_route_entry* r)
 {
-    struct dhcpv6relay_route_entry** s = &dhcpv6relay_delegations;
-    while (*s) {
-	if (memcmp(&(*s)->prefix, addr, sizeof(*addr)) == 0 && (*s)->len == prefixlen)
-	    return s;
-	s = &(*s)->next;
+    unsigned i = r->heap_idx;
+
+    if (i != --dhcpv6relay_heap_len) {
+	dhcpv6relay_heap_set(i, dhcpv6relay_heap[dhcpv6relay_heap_len]);
+	dhcpv6relay_heap_fix(i);
     }
-    return NULL;
 }
 
-static void dhcpv6relay_route_timeout(void* _r);
+static void dhcpv6relay_route_timeout(void*);
 
 static
-void dhcpv6relay_real_release_route(struct dhcpv6relay_route_entry** _r)
+void dhcpv6relay_schedule_expiry()
+{
+    time_t delay;
+
+    ppp_untimeout(dhcpv6relay_route_timeout, NULL);
+    if (!dhcpv6relay_heap_len)
+	return;
+
+    delay = dhcpv6relay_heap[0]->valid_until - time(NULL);
+    if (delay < 0)
+	delay = 0;
+    else if (delay > 86400)
+	delay = 86400; /* just re-check, ppp_timeout() only takes an int */
+
+    ppp_timeout(dhcpv6relay_route_timeout, NULL, delay, 0);
+}
+
+/*
+ * Unlink a route from the table and the heap, and queue it for removal
+ * from the kernel with the next dhcpv6relay_flush_routes().
+ */
+static
+int dhcpv6relay_queue_release(struct dhcpv6relay_route_entry** _r)
 {
-    char in6addr[INET6_ADDRSTRLEN];
     struct dhcpv6relay_route_entry* r = *_r;
 
-    if (!sifdelroute(AF_INET6, &r->prefix, r->len, dhcpv6relay_metric))
-	error("DHCPv6 relay: failed to remove route for %s/%d",
-		inet_ntop(AF_INET6, &r->prefix, in6addr, sizeof(in6addr)), r->len);
-    else
-	notice("DHCPv6 relay: removed route %s/%d",
-		inet_ntop(AF_INET6, &r->prefix, in6addr, sizeof(in6addr)), r->len);
+    if (dhcpv6relay_pending_del_len == dhcpv6relay_pending_del_size) {
+	unsigned n = dhcpv6relay_pending_del_size ? 2 * dhcpv6relay_pending_del_size : 16;
+	struct dhcpv6relay_route_entry** d = realloc(dhcpv6relay_pending_del, n * sizeof(*d));
+	if (!d) {
+	    error("DHCPv6 relay: out of memory queueing route removal.");
+	    return 0;
+	}
+	dhcpv6relay_pending_del = d;
+	dhcpv6relay_pending_del_size = n;
+    }
 
-    ppp_untimeout(dhcpv6relay_route_timeout, r);
     *_r = r->next;
-    free(r);
+    dhcpv6relay_heap_remove(r);
+    dhcpv6relay_pending_del[dhcpv6relay_pending_del_len++] = r;
+    return 1;
 }
 
 static
-void dhcpv6relay_route_timeout(void* _r)
+void dhcpv6relay_flush_routes()
 {
-    struct dhcpv6relay_route_entry** s = &dhcpv6relay_delegations;
-    while (*s && *s != _r)
-	s = &(*s)->next;
+    char in6addr[INET6_ADDRSTRLEN];
+    struct ppp_route_req* req;
+    unsigned i, n = dhcpv6relay_pending_add_len > dhcpv6relay_pending_del_len ?
+	dhcpv6relay_pending_add_len : dhcpv6relay_pending_del_len;
+    time_t now = time(NULL);
 
-    if (!*s) {
-	error("DHCPv6 relay: timeout on already released route delegation.");
-    } else {
-	dhcpv6relay_real_release_route(s);
+    if (!n)
+	return;
+
+    req = malloc(n * sizeof(*req));
+    if (!req) {
+	error("DHCPv6 relay: out of memory updating routes.");
+	return;
+    }
+
+    if (dhcpv6relay_pending_del_len) {
+	for (i = 0; i < dhcpv6relay_pending_del_len; ++i) {
+	    req[i].prefix = &dhcpv6relay_pending_del[i]->prefix;
+	    req[i].len = dhcpv6relay_pending_del[i]->len;
+	}
+
+	sifdelroutes(AF_INET6, req, dhcpv6relay_pending_del_len, dhcpv6relay_metric);
+
+	for (i = 0; i < dhcpv6relay_pending_del_len; ++i) {
+	    struct dhcpv6relay_route_entry* r = dhcpv6relay_pending_del[i];
+	    if (!req[i].result)
+		error("DHCPv6 relay: failed to remove route for %s/%d",
+			inet_ntop(AF_INET6, &r->prefix, in6addr, sizeof(in6addr)), r->len);
+	    else
+		notice("DHCPv6 relay: removed route %s/%d",
+			inet_ntop(AF_INET6, &r->prefix, in6addr, sizeof(in6addr)), r->len);
+	    free(r);
+	}
+	dhcpv6relay_pending_del_len = 0;
     }
+
+    if (dhcpv6relay_pending_add_len) {
+	for (i = 0; i < dhcpv6relay_pending_add_len; ++i) {
+	    req[i].prefix = &dhcpv6relay_pending_add[i].prefix;
+	    req[i].len = dhcpv6relay_pending_add[i].len;
+	}
+
+	sifaddroutes(AF_INET6, req, dhcpv6relay_pending_add_len, dhcpv6relay_metric);
+
+	for (i = 0; i < dhcpv6relay_pending_add_len; ++i) {
+	    struct dhcpv6relay_route_op* op = &dhcpv6relay_pending_add[i];
+	    struct dhcpv6relay_route_entry* r;
+	    unsigned h;
+
+	    if (!req[i].result) {
+		error("DHCPv6 relay: failed to install route for %s/%d",
+			inet_ntop(AF_INET6, &op->prefix, in6addr, sizeof(in6addr)), op->len);
+		continue;
+	    }
+
+	    notice("DHCPv6 relay: installed route %s/%d",
+		    inet_ntop(AF_INET6, &op->prefix, in6addr, sizeof(in6addr)), op->len);
+
+	    r = malloc(sizeof(*r));
+	    if (r) {
+		r->prefix = op->prefix;
+		r->len = op->len;
+		r->valid_until = now + op->lifetime;
+	    }
+	    if (!r || !dhcpv6relay_heap_push(r)) {
+		error("DHCPv6 relay: out of memory tracking route %s/%d",
+			inet_ntop(AF_INET6, &op->prefix, in6addr, sizeof(in6addr)), op->len);
+		free(r);
+		continue;
+	    }
+
+	    h = dhcpv6relay_route_hash(&r->prefix, r->len);
+	    r->next = dhcpv6relay_delegations[h];
+	    dhcpv6relay_delegations[h] = r;
+	}
+	dhcpv6relay_pending_add_len = 0;
+    }
+
+    free(req);
+    dhcpv6relay_schedule_expiry();
+}
+
+static
+void routes_remove_all()
+{
+    unsigned i;
+
+    dhcpv6relay_pending_add_len = 0;
+    for (i = 0; i < DHCPv6_ROUTE_HASH; ++i)
+	while (dhcpv6relay_delegations[i] &&
+		dhcpv6relay_queue_release(&dhcpv6relay_delegations[i]))
+	    ;
+
+    dhcpv6relay_flush_routes();
+    ppp_untimeout(dhcpv6relay_route_timeout, NULL);
+}
+
+static
+void dhcpv6relay_route_timeout(void*)
+{
+    time_t now = time(NULL);
+
+    while (dhcpv6relay_heap_len && dhcpv6relay_heap[0]->valid_until <= now) {
+	struct dhcpv6relay_route_entry* r = dhcpv6relay_heap[0];
+	if (!dhcpv6relay_queue_release(dhcpv6relay_find_route_entry(&r->prefix, r->len)))
+	    break;
+    }
+
+    dhcpv6relay_flush_routes();
+    dhcpv6relay_schedule_expiry();
 }
 
 static
 void dhcpv6relay_release_route(const struct in6_addr* addr, uint8_t prefixlen, uint32_t /* lifetime */)
 {
     char in6addr[INET6_ADDRSTRLEN];
+    unsigned i;
 
     struct dhcpv6relay_route_entry** r = dhcpv6relay_find_route_entry(addr, prefixlen);
 
+    /* added earlier in the same packet, so not yet in the kernel: just
+     * drop the pending add. */
+    for (i = 0; !r && i < dhcpv6relay_pending_add_len; ++i) {
+	struct dhcpv6relay_route_op* op = &dhcpv6relay_pending_add[i];
+	if (op->len == prefixlen && memcmp(&op->prefix, addr, sizeof(*addr)) == 0) {
+	    *op = dhcpv6relay_pending_add[--dhcpv6relay_pending_add_len];
+	    return;
+	}
+    }
+
     if (!r) {
 	error("DHCPv6 relay: Release of route %s/%d that was never delegated.",
 		inet_ntop(AF_INET6, addr, in6addr, sizeof(in6addr)), prefixlen);
     } else {
-	dhcpv6relay_real_release_route(r);
+	dhcpv6relay_queue_release(r);
     }
 }
 
 static
 void dhcpv6relay_add_route(const struct in6_addr* addr, uint8_t prefixlen, uint32_t lifetime)
 {
-    char in6addr[INET6_ADDRSTRLEN];
     struct dhcpv6relay_route_entry** _r = dhcpv6relay_find_route_entry(addr, prefixlen);
-    struct dhcpv6relay_route_entry* r = _r ? *_r : NULL;
-    if (r) {
+    struct dhcpv6relay_route_op* op;
+    unsigned i;
+
+    if (_r) {
 	/* route is already installed, just update valid lifetime. */
-	r->valid_until = time(NULL) + lifetime;
-	ppp_untimeout(dhcpv6relay_route_timeout, r);
-	ppp_timeout(dhcpv6relay_route_timeout, r, lifetime, 0);
+	(*_r)->valid_until = time(NULL) + lifetime;
+	dhcpv6relay_heap_fix((*_r)->heap_idx);
+	dhcpv6relay_schedule_expiry();
 	return;
     }
 
-    if (!sifaddroute(AF_INET6, addr, prefixlen, dhcpv6relay_metric))
-	return error("DHCPv6 relay: failed to install route for %s/%d",
-		inet_ntop(AF_INET6, addr, in6addr, sizeof(in6addr)), prefixlen);
+    for (i = 0; i < dhcpv6relay_pending_add_len; ++i) {
+	op = &dhcpv6relay_pending_add[i];
+	if (op->len == prefixlen && memcmp(&op->prefix, addr, sizeof(*addr)) == 0) {
+	    op->lifetime = lifetime;
+	    return;
+	}
+    }
 
-    notice("DHCPv6 relay: installed route %s/%d",
-	    inet_ntop(AF_INET6, addr, in6addr, sizeof(in6addr)), prefixlen);
+    if (dhcpv6relay_pending_add_len == dhcpv6relay_pending_add_size) {
+	unsigned n = dhcpv6relay_pending_add_size ? 2 * dhcpv6relay_pending_add_size : 16;
+	op = realloc(dhcpv6relay_pending_add, n * sizeof(*op));
+	if (!op) {
+	    error("DHCPv6 relay: out of memory queueing route installation.");
+	    return;
+	}
+	dhcpv6relay_pending_add = op;
+	dhcpv6relay_pending_add_size = n;
+    }
 
-    r = malloc(sizeof(*r));
-    r->next = dhcpv6relay_delegations;
-    r->prefix = *addr;
-    r->len = prefixlen;
-    r->valid_until = time(NULL) + lifetime;
-    ppp_timeout(dhcpv6relay_route_timeout, r, lifetime, 0);
+    op = &dhcpv6relay_pending_add[dhcpv6relay_pending_add_len++];
+    op->prefix = *addr;
+    op->len = prefixlen;
+    op->lifetime = lifetime;
+}
 
-    dhcpv6relay_delegations = r;
+static
+void dhcpv6relay_down(void*, int)
+{
+    routes_remove_all();
+    if (dhcpv6relay_sock_ll >= 0) {
+	remove_fd(dhcpv6relay_sock_ll);
+	close(dhcpv6relay_sock_ll);
+	dhcpv6relay_sock_ll = -1;
+    }
+    if (dhcpv6relay_sock_mc >= 0) {
+	remove_fd(dhcpv6relay_sock_mc);
+	close(dhcpv6relay_sock_mc);
+	dhcpv6relay_sock_mc = -1;
+    }
+    if (dhcpv6relay_upstream >= 0) {
+	remove_fd(dhcpv6relay_upstream);
+	close(dhcpv6relay_upstream);
+	dhcpv6relay_upstream = -1;
+    }
+    if (dhcpv6relay_sock_rsra >= 0) {
+	remove_fd(dhcpv6relay_sock_rsra);
+	close(dhcpv6relay_sock_rsra);
+	dhcpv6relay_sock_rsra = -1;
+    }
 }
 
 static
@@ -387,7 +618,7 @@ void dhcpv6relay_process_ia_na(const unsigned char *bfr, uint16_t len, dhcpv6rel
 }
 
 static
-void dhcpv6relay_process_packet_for_routes(const unsigned char *bfr, uint16_t len)
+void dhcpv6relay_parse_routes(const unsigned char *bfr, uint16_t len)
 {
     if (len < 1)
 	return;
@@ -410,7 +641,7 @@ void dhcpv6relay_process_packet_for_routes(const unsigned char *bfr, uint16_t le
 	    if (optlen > len)
 		return;
 	    if (opttype == DHCPv6_OPTION_RELAY_MSG) {
-		dhcpv6relay_process_packet_for_routes(bfr, optlen);
+		dhcpv6relay_parse_routes(bfr, optlen);
 		return; /* there may be only one */
 	    }
 	    bfr += optlen;
@@ -460,50 +691,56 @@ void dhcpv6relay_process_packet_for_routes(const unsigned char *bfr, uint16_t le
 }
 
 static
-void dhcpv6relay_server_event(int fd, void*)
+void dhcpv6relay_process_packet_for_routes(const unsigned char *bfr, uint16_t len)
+{
+    dhcpv6relay_parse_routes(bfr, len);
+    dhcpv6relay_flush_routes();
+}
+
+static
+void dhcpv6relay_server_packet(unsigned char *buffer, ssize_t r, struct sockaddr_in6 *src)
 {
-    unsigned char buffer[1024];
     unsigned char *options = buffer + 34; /* skip fixed header */
     unsigned char *fwd_packet = NULL;
     uint16_t fwd_len = 0;
     char in6addr[INET6_ADDRSTRLEN];
     struct sockaddr_in6 sa;
-    socklen_t slen = sizeof(sa);
     bool valid_source = true;
     int hlim = 0;
-    ssize_t r = recvfrom(fd, buffer, sizeof(buffer), MSG_DONTWAIT | MSG_TRUNC,
-	    (struct sockaddr*)&sa, &slen);
-    if (r < 0) {
-	error("DHCPv6 relay: Failed to read from %s socket: %s",
-		fd == dhcpv6relay_sock_ll ? "LL" : "MC",
-		strerror(errno));
-	return;
-    }
-    if (r > sizeof(buffer)) {
-	error("DHCPv6 relay: buffer overrun receiving packet of length %db received with a buffer of size %ub from the DHCP server",
-		r, sizeof(buffer));
-	return;
-    }
-
-    /* notice("Received %d bytes from fd=%d (%s), with source [%s]:%d, packet type: %s", r, fd,
-	    "UPSTREAM",
-	    inet_ntop(sa.sin6_family, sa.sin6_family == AF_INET ?
-		(void*)&((struct sockaddr_in*)&sa)->sin_addr : (void*)&sa.sin6_addr,
-		in6addr, sizeof(in6addr)),
-	    ntohs(sa.sin6_port), r ? dhcpv6_type2string(buffer[0]) : "empty"); */
+    union {
+	struct cmsghdr align;
+	unsigned char buf[CMSG_SPACE(sizeof(int))];
+    } cmsg;
+    struct cmsghdr *cm;
+    struct iovec v = {
+	.iov_base = NULL,
+	.iov_len = 0,
+    };
+    struct msghdr wv = {
+	.msg_name = &sa,
+	.msg_namelen = sizeof(sa),
+	.msg_iov = &v,
+	.msg_iovlen = 1,
+	.msg_control = cmsg.buf,
+	.msg_controllen = sizeof(cmsg.buf),
+	.msg_flags = 0,
+    };
 
-    if (sa.sin6_family != dhcpv6relay_sa.ss_family) {
+    if (dhcpv6relay_broker) {
+	/* connected local socket, only the broker can send to us */
+	valid_source = true;
+    } else if (src->sin6_family != dhcpv6relay_sa.ss_family) {
 	valid_source = false;
-    } else if (sa.sin6_family == AF_INET6) {
-	valid_source = sa.sin6_port == ((struct sockaddr_in6*)&dhcpv6relay_sa)->sin6_port
+    } else if (src->sin6_family == AF_INET6) {
+	valid_source = src->sin6_port == ((struct sockaddr_in6*)&dhcpv6relay_sa)->sin6_port
 
-	    && memcmp(&sa.sin6_addr, &((struct sockaddr_in6*)&dhcpv6relay_sa)->sin6_addr,
-		    sizeof(sa.sin6_addr)) == 0;
-    } else if (sa.sin6_family == AF_INET) {
-	valid_source = ((struct sockaddr_in*)&sa)->sin_port ==
+	    && memcmp(&src->sin6_addr, &((struct sockaddr_in6*)&dhcpv6relay_sa)->sin6_addr,
+		    sizeof(src->sin6_addr)) == 0;
+    } else if (src->sin6_family == AF_INET) {
+	valid_source = ((struct sockaddr_in*)src)->sin_port ==
 	    ((struct sockaddr_in*)&dhcpv6relay_sa)->sin_port
 
-	    && ((struct sockaddr_in*)&sa)->sin_addr.s_addr ==
+	    && ((struct sockaddr_in*)src)->sin_addr.s_addr ==
 	    ((struct sockaddr_in*)&dhcpv6relay_sa)->sin_addr.s_addr;
     } else {
 	error("DHCv6 relay: Received non-IP packet on upstream socket.");
@@ -512,10 +749,10 @@ void dhcpv6relay_server_event(int fd, void*)
 
     if (!valid_source) {
 	error("DHCPv6 relay: Received packet from unexpected source [%s]:%d on upstream socket.",
-		inet_ntop(sa.sin6_family, sa.sin6_family == AF_INET ?
-		    (void*)&((struct sockaddr_in*)&sa)->sin_addr : (void*)&sa.sin6_addr,
+		inet_ntop(src->sin6_family, src->sin6_family == AF_INET ?
+		    (void*)&((struct sockaddr_in*)src)->sin_addr : (void*)&src->sin6_addr,
 		    in6addr, sizeof(in6addr)),
-		sa.sin6_family == AF_INET ? ((struct sockaddr_in*)&sa)->sin_port : sa.sin6_port);
+		src->sin6_family == AF_INET ? ((struct sockaddr_in*)src)->sin_port : src->sin6_port);
 	return;
     }
 
@@ -574,18 +811,26 @@ void dhcpv6relay_server_event(int fd, void*)
 	/* this should only ever happen towards "trusted" ports, wich is not the default. */
 	/* TODO: Honour option 135 towards downstream, would need to see an example, spec
 	 * is unclear and observed behaviour from KEA doesn't make sense. */
-	sa.sin6_port = getservbyname("dhcpv6-server", "udp")->s_port;
+	sa.sin6_port = dhcpv6relay_port_server;
 	hlim = 64;
     } else {
-	sa.sin6_port = getservbyname("dhcpv6-client", "udp")->s_port;
+	sa.sin6_port = dhcpv6relay_port_client;
     }
     memcpy(&sa.sin6_addr, buffer + 18 /* peer-link address */, sizeof(sa.sin6_addr));
-    sa.sin6_scope_id = if_nametoindex(ppp_ifname());
+    sa.sin6_scope_id = dhcpv6relay_ifindex;
 
-    setsockopt(dhcpv6relay_sock_ll, IPPROTO_IPV6, IPV6_UNICAST_HOPS, &hlim, sizeof(hlim));
-    r = sendto(dhcpv6relay_sock_ll, fwd_packet, fwd_len, 0,
-	    (struct sockaddr*)&sa, sizeof(sa));
-    if (r < 0) {
+    /* pass the hop limit along with the packet rather than changing the
+     * socket default before every transmission */
+    cm = CMSG_FIRSTHDR(&wv);
+    cm->cmsg_level = IPPROTO_IPV6;
+    cm->cmsg_type = IPV6_HOPLIMIT;
+    cm->cmsg_len = CMSG_LEN(sizeof(hlim));
+    memcpy(CMSG_DATA(cm), &hlim, sizeof(hlim));
+
+    v.iov_base = fwd_packet;
+    v.iov_len = fwd_len;
+
+    if (sendmsg(dhcpv6relay_sock_ll, &wv, 0) < 0) {
 	error("DHCPv6 relay: Error transmitting server response to client: %s",
 		strerror(errno));
     }
@@ -593,9 +838,96 @@ void dhcpv6relay_server_event(int fd, void*)
     dhcpv6relay_process_packet_for_routes(fwd_packet, fwd_len);
 }
 
+/* Maximum number of upstream responses to pick up per wakeup, a burst of
+ * these is typical when the server comes back after an outage. */
+#define DHCPv6_RELAY_BATCH	8
+
+static
+void dhcpv6relay_server_event(int fd, void*)
+{
+    unsigned char buffer[DHCPv6_RELAY_BATCH][1024];
+    struct sockaddr_in6 sa[DHCPv6_RELAY_BATCH];
+    struct iovec v[DHCPv6_RELAY_BATCH];
+    struct mmsghdr msgs[DHCPv6_RELAY_BATCH];
+    int i, n;
+
+    memset(msgs, 0, sizeof(msgs));
+    for (i = 0; i < DHCPv6_RELAY_BATCH; ++i) {
+	v[i].iov_base = buffer[i];
+	v[i].iov_len = sizeof(buffer[i]);
+	msgs[i].msg_hdr.msg_name = &sa[i];
+	msgs[i].msg_hdr.msg_namelen = sizeof(sa[i]);
+	msgs[i].msg_hdr.msg_iov = &v[i];
+	msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    n = recvmmsg(fd, msgs, DHCPv6_RELAY_BATCH, MSG_DONTWAIT, NULL);
+    if (n < 0) {
+	if (errno != EAGAIN)
+	    error("DHCPv6 relay: Failed to read from upstream socket: %s",
+		    strerror(errno));
+	return;
+    }
+
+    for (i = 0; i < n; ++i) {
+	if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+	    error("DHCPv6 relay: buffer overrun receiving packet with a buffer of size %ub from the DHCP server",
+		    sizeof(buffer[i]));
+	    continue;
+	}
+
+	dhcpv6relay_server_packet(buffer[i], msgs[i].msg_len, &sa[i]);
+    }
+}
+
+static
+int dhcpv6relay_init_broker()
+{
+    struct sockaddr_un sa;
+
+    if (strlen(dhcpv6relay_broker) >= sizeof(sa.sun_path)) {
+	error("DHCPv6 relay: Broker socket path %s is too long.", dhcpv6relay_broker);
+	return 0;
+    }
+
+    dhcpv6relay_upstream = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (dhcpv6relay_upstream < 0) {
+	error("DHCPv6 relay: Failed to create broker socket: %s",
+		strerror(errno));
+	return 0;
+    }
+    fcntl(dhcpv6relay_upstream, F_SETFD, FD_CLOEXEC);
+
+    /* autobind to an abstract address so the broker can send replies back */
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    if (bind(dhcpv6relay_upstream, (struct sockaddr*)&sa, sizeof(sa_family_t)) < 0) {
+	error("DHCPv6 relay: Failed to bind broker socket: %s",
+		strerror(errno));
+	close(dhcpv6relay_upstream);
+	dhcpv6relay_upstream = -1;
+	return 0;
+    }
+
+    strcpy(sa.sun_path, dhcpv6relay_broker);
+    if (connect(dhcpv6relay_upstream, (struct sockaddr*)&sa, sizeof(sa)) < 0) {
+	error("DHCPv6 relay: Failed to connect to broker at %s: %s",
+		dhcpv6relay_broker, strerror(errno));
+	close(dhcpv6relay_upstream);
+	dhcpv6relay_upstream = -1;
+	return 0;
+    }
+    add_fd_callback(dhcpv6relay_upstream, dhcpv6relay_server_event, NULL);
+
+    return 1;
+}
+
 static
 int dhcpv6relay_init_upstream()
 {
+    if (dhcpv6relay_broker)
+	return dhcpv6relay_init_broker();
+
     /* use family from sa so that we can do DHCPv6 / IPv4. */
     dhcpv6relay_upstream = socket(dhcpv6relay_sa.ss_family, SOCK_DGRAM, 0);
     if (dhcpv6relay_upstream < 0) {
@@ -696,34 +1028,50 @@ void dhcpv6relay_client_event(int fd, void*)
     memcpy(&fwd_head[18], &sa.sin6_addr, 16); /* peer-address */
     v[0].iov_len = 34;
 
-    slen = sizeof(sa);
-    if (getsockname(dhcpv6relay_upstream, (struct sockaddr*)&sa, &slen) < 0) {
-	error("DHCPv6 relay: Unable to determine local sending port: %s",
-		strerror(errno));
-	return;
-    }
-
 #define push_checkbytes(x) do { if ((x) + v[0].iov_len > sizeof(fwd_head)) { error("DHCPv6 relay: Buffer overlow avoidance pushing %d bytes, need %d.", (x), (x) + v[0].iov_len - sizeof(fwd_head)); return; }} while(0)
 #define push_uint16(val) do { push_checkbytes(2); uint16_t t = (val); fwd_head[v[0].iov_len++] = t >> 8; fwd_head[v[0].iov_len++] = t & 0xFF; } while(0);
 #define push_bytes(ptr, bytes) do { push_checkbytes(bytes); memcpy(&fwd_head[v[0].iov_len], (ptr), (bytes)); v[0].iov_len += (bytes); } while(0)
 
-    /* On Linux at least sin6_port and sin_port would refer the same
-     * data but I can't guarantee that for solaris (and others) */
-    switch (sa.sin6_family) {
-    case AF_INET:
-	sport = ((struct sockaddr_in*)&sa)->sin_port;
-	break;
-    case AF_INET6:
-	sport = sa.sin6_port;
-	break;
-    default:
-	error("DHCPv6 relay: Upstream socket is bound to something other than IP ... can't relay.");
-	return;
-    }
+    if (dhcpv6relay_broker) {
+	/* The broker shares one upstream socket between all sessions, it
+	 * adds the relay-port itself, and uses the interface-id to route
+	 * the server's reply back to us.  Interface names get reused, so
+	 * add our pid to keep a later session's replies apart from ours. */
+	char ifid[IFNAMSIZ + 12];
+
+	wv.msg_name = NULL;
+	wv.msg_namelen = 0;
+
+	r = slprintf(ifid, sizeof(ifid), "%s:%d", ppp_ifname(), getpid());
+	push_uint16(DHCPv6_OPTION_INTERFACE_ID);
+	push_uint16(r);
+	push_bytes(ifid, r);
+    } else {
+	slen = sizeof(sa);
+	if (getsockname(dhcpv6relay_upstream, (struct sockaddr*)&sa, &slen) < 0) {
+	    error("DHCPv6 relay: Unable to determine local sending port: %s",
+		    strerror(errno));
+	    return;
+	}
 
-    push_uint16(DHCPv6_OPTION_RELAY_PORT);
-    push_uint16(2);
-    push_uint16(ntohs(sport));
+	/* On Linux at least sin6_port and sin_port would refer the same
+	 * data but I can't guarantee that for solaris (and others) */
+	switch (sa.sin6_family) {
+	case AF_INET:
+	    sport = ((struct sockaddr_in*)&sa)->sin_port;
+	    break;
+	case AF_INET6:
+	    sport = sa.sin6_port;
+	    break;
+	default:
+	    error("DHCPv6 relay: Upstream socket is bound to something other than IP ... can't relay.");
+	    return;
+	}
+
+	push_uint16(DHCPv6_OPTION_RELAY_PORT);
+	push_uint16(2);
+	push_uint16(ntohs(sport));
+    }
 
     remote_id = ppp_get_remote_number();
     if (remote_id) {
@@ -776,7 +1124,7 @@ void dhcpv6relay_send_router_advertisement(const struct sockaddr* da)
 	 * option, for solicited responses it might be needed to send to the peer's
 	 * LL, but the spec is unclear and at least Mikrotik does multicast in
 	 * response to solicitation */
-	tda.sin6_scope_id = if_nametoindex(ppp_ifname());
+	tda.sin6_scope_id = dhcpv6relay_ifindex;
 	if (inet_pton(AF_INET6, "ff02::1", &tda.sin6_addr) < 0) {
 	    error("DHCPv6 relay: Unable to prepare multicast address for sending router advertisement: %s",
 		    strerror(errno));
@@ -863,7 +1211,7 @@ void dhcpv6relay_up(void*, int)
 
     /* no relay configured, so we can't work, simply don't listen
      * for DHCP solicitations */
-    if (!dhcpv6relay_server)
+    if (!dhcpv6relay_server && !dhcpv6relay_broker)
 	return;
 
     if (!dhcpv6relay_populate_ll(&sa))
@@ -877,6 +1225,17 @@ void dhcpv6relay_up(void*, int)
     }
 
     sa.sin6_port = se->s_port;
+    dhcpv6relay_port_server = se->s_port;
+
+    se = getservbyname("dhcpv6-client", "udp");
+    if (!se) {
+	error("DHCPv6 relay: Unable to determine UDP port number for dhcpv6-client: %s",
+		strerror(errno));
+	return;
+    }
+
+    dhcpv6relay_port_client = se->s_port;
+    dhcpv6relay_ifindex = sa.sin6_scope_id;
 
     dhcpv6relay_sock_ll = socket(AF_INET6, SOCK_DGRAM, 0);
     if (dhcpv6relay_sock_ll < 0) {
@@ -32,10 +32,18 @@
 #include <netinet/in.h>
 
 struct dhcpv6relay_route_entry {
-    struct dhcpv6relay_route_entry *next;
+    struct dhcpv6relay_route_entry *next;	/* hash chain */
     struct in6_addr prefix;
     uint8_t len;
     time_t valid_until;
+    unsigned heap_idx;				/* position in the expiry heap */
+};
+
+/* pending route change, collected while parsing a packet */
+struct dhcpv6relay_route_op {
+    struct in6_addr prefix;
+    uint8_t len;
+    uint32_t lifetime;
 };
 
 typedef void (*dhcpv6relay_route_func)(const struct in6_addr*, uint8_t, uint32_t);
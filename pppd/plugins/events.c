@@ -0,0 +1,453 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*
+ * events.c - pppd plugin with native handlers for state events.
+ *
+ * Handles the jobs that ip-up and ip-down scripts are most often
+ * written for, without the cost of fork, exec and a shell per event:
+ *
+ *   event-socket <dest>	send a one-line text record of each event
+ *				to a unix datagram socket (a path) or to
+ *				a UDP host:port
+ *   event-route-table <n>	add a host route to the peer in routing
+ *				table n when IPCP comes up, remove it
+ *				when it goes down
+ *   event-nft-set <f:t:s>	add the peer's address to the nftables
+ *				set s in table t of family f (ip or inet)
+ *				when IPCP comes up, remove it when it
+ *				goes down
+ *
+ * Copyright (c) 2026 The pppd Project. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THE AUTHORS OF THIS SOFTWARE DISCLAIM ALL WARRANTIES WITH REGARD TO
+ * THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+ * AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/netfilter.h>
+#include <linux/netfilter/nfnetlink.h>
+#include <linux/netfilter/nf_tables.h>
+
+#include <pppd/pppd.h>
+#include <pppd/options.h>
+
+char pppd_version[] = PPPD_VERSION;
+
+static char *event_socket;
+static int event_route_table;
+static char *event_nft_set;
+
+static struct option events_options[] = {
+    { "event-socket", o_string, &event_socket,
+      "Send state events to this unix socket path or UDP host:port",
+      OPT_PRIV },
+    { "event-route-table", o_int, &event_route_table,
+      "Add a host route to the peer in this routing table",
+      OPT_PRIV | OPT_LLIMIT, NULL, 0, 1 },
+    { "event-nft-set", o_string, &event_nft_set,
+      "Add the peer address to this nftables set (family:table:set)",
+      OPT_PRIV },
+    { NULL }
+};
+
+static int event_fd = -1;
+static bool event_fd_tried;
+
+static const char *event_names[PPP_EV_MAX] = {
+    [PPP_EV_AUTH_UP   ] = "auth-up",
+    [PPP_EV_IP_UP     ] = "ip-up",
+    [PPP_EV_IP_DOWN   ] = "ip-down",
+    [PPP_EV_IPV6_UP   ] = "ipv6-up",
+    [PPP_EV_IPV6_DOWN ] = "ipv6-down",
+    [PPP_EV_LINK_DOWN ] = "link-down",
+    [PPP_EV_LCP_UP    ] = "lcp-up",
+};
+
+/*
+ * events_open_socket - connect a datagram socket to the event-socket
+ * destination.  A destination starting with '/' is a unix socket,
+ * anything else is host:port for UDP.
+ */
+static int
+events_open_socket(char *dest)
+{
+    struct sockaddr_un sun;
+    struct addrinfo hints, *res, *ai;
+    char host[256], *port;
+    int fd, err;
+
+    if (dest[0] == '/') {
+	memset(&sun, 0, sizeof(sun));
+	sun.sun_family = AF_UNIX;
+	if (strlen(dest) >= sizeof(sun.sun_path)) {
+	    error("events: socket path %s is too long", dest);
+	    return -1;
+	}
+	strcpy(sun.sun_path, dest);
+	fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	if (fd < 0) {
+	    error("events: can't create socket: %m");
+	    return -1;
+	}
+	/* the listener may not be running yet; sends just fail until it is */
+	if (connect(fd, (struct sockaddr *) &sun, sizeof(sun)) < 0)
+	    warn("events: can't connect to %s: %m", dest);
+	return fd;
+    }
+
+    strlcpy(host, dest, sizeof(host));
+    port = strrchr(host, ':');
+    if (port == NULL) {
+	error("events: %s is not a path or host:port", dest);
+	return -1;
+    }
+    *port++ = 0;
+    if (host[0] == '[' && port[-2] == ']') {
+	port[-2] = 0;
+	memmove(host, host + 1, strlen(host));
+    }
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = AI_NUMERICSERV;
+    err = getaddrinfo(host, port, &hints, &res);
+    if (err != 0) {
+	error("events: can't resolve %s: %s", dest, gai_strerror(err));
+	return -1;
+    }
+    fd = -1;
+    for (ai = res; ai != NULL; ai = ai->ai_next) {
+	fd = socket(ai->ai_family, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK,
+		    0);
+	if (fd < 0)
+	    continue;
+	if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+	    break;
+	close(fd);
+	fd = -1;
+    }
+    freeaddrinfo(res);
+    if (fd < 0)
+	error("events: can't connect to %s: %m", dest);
+    return fd;
+}
+
+/*
+ * events_send - send a one-line record of an event.  The keys are the
+ * names of the environment variables a script would have been given.
+ */
+static void
+events_send(const struct ppp_state_event *ev)
+{
+    char buf[1024];
+    int n;
+
+    n = slprintf(buf, sizeof(buf), "event=%s IFNAME=%s DEVICE=%s PPPD_PID=%d",
+		 event_names[ev->type], ev->ifname, ev->devnam, getpid());
+    if (ev->peer_authname[0] != 0)
+	n += slprintf(buf + n, sizeof(buf) - n, " PEERNAME=%q",
+		      ev->peer_authname);
+    if (ev->remote_number[0] != 0)
+	n += slprintf(buf + n, sizeof(buf) - n, " REMOTENUMBER=%q",
+		      ev->remote_number);
+    if (ev->type == PPP_EV_IP_UP || ev->type == PPP_EV_IP_DOWN)
+	n += slprintf(buf + n, sizeof(buf) - n, " IPLOCAL=%I IPREMOTE=%I",
+		      ev->ouraddr, ev->hisaddr);
+    if (ev->stats != NULL)
+	n += slprintf(buf + n, sizeof(buf) - n,
+		      " BYTES_SENT=%llu BYTES_RCVD=%llu",
+		      (unsigned long long) ev->stats->bytes_out,
+		      (unsigned long long) ev->stats->bytes_in);
+    n += slprintf(buf + n, sizeof(buf) - n, "\n");
+
+    if (send(event_fd, buf, n, MSG_NOSIGNAL) < 0)
+	dbglog("events: can't send %s event: %m", event_names[ev->type]);
+}
+
+/*
+ * Netlink message building.  Each request is built in a buffer, sent,
+ * and the ack for its last message read back.
+ */
+struct nlbuf {
+    char	buf[1024];
+    size_t	len;
+};
+
+static struct nlmsghdr *
+nl_msg(struct nlbuf *b, int type, int flags)
+{
+    struct nlmsghdr *nlh = (struct nlmsghdr *) (b->buf + b->len);
+
+    memset(nlh, 0, NLMSG_HDRLEN);
+    nlh->nlmsg_len = NLMSG_HDRLEN;
+    nlh->nlmsg_type = type;
+    nlh->nlmsg_flags = NLM_F_REQUEST | flags;
+    nlh->nlmsg_seq = b->len + 1;
+    return nlh;
+}
+
+static void *
+nl_put(struct nlbuf *b, struct nlmsghdr *nlh, const void *data, size_t len)
+{
+    void *p = (char *) nlh + NLMSG_ALIGN(nlh->nlmsg_len);
+
+    memcpy(p, data, len);
+    nlh->nlmsg_len = NLMSG_ALIGN(nlh->nlmsg_len) + len;
+    return p;
+}
+
+static struct nlattr *
+nl_attr(struct nlbuf *b, struct nlmsghdr *nlh, int type,
+	const void *data, size_t len)
+{
+    struct nlattr *nla = (struct nlattr *)
+	((char *) nlh + NLMSG_ALIGN(nlh->nlmsg_len));
+
+    nla->nla_type = type;
+    nla->nla_len = NLA_HDRLEN + len;
+    if (len > 0)
+	memcpy((char *) nla + NLA_HDRLEN, data, len);
+    nlh->nlmsg_len = NLMSG_ALIGN(nlh->nlmsg_len) + NLA_ALIGN(nla->nla_len);
+    return nla;
+}
+
+static void
+nl_nest_end(struct nlmsghdr *nlh, struct nlattr *nla)
+{
+    nla->nla_len = (char *) nlh + nlh->nlmsg_len - (char *) nla;
+}
+
+static void
+nl_end(struct nlbuf *b, struct nlmsghdr *nlh)
+{
+    b->len += NLMSG_ALIGN(nlh->nlmsg_len);
+}
+
+/*
+ * nl_talk - send the messages in b and wait for the ack to the last
+ * one.  Returns 0 or a negative errno.
+ */
+static int
+nl_talk(int proto, struct nlbuf *b, struct nlmsghdr *last)
+{
+    struct sockaddr_nl nladdr;
+    struct nlmsghdr *nlh;
+    char rbuf[4096];
+    uint32_t seq = last->nlmsg_seq;
+    int fd, len, err;
+
+    fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, proto);
+    if (fd < 0)
+	return -errno;
+
+    memset(&nladdr, 0, sizeof(nladdr));
+    nladdr.nl_family = AF_NETLINK;
+    if (sendto(fd, b->buf, b->len, 0, (struct sockaddr *) &nladdr,
+	       sizeof(nladdr)) < 0) {
+	err = -errno;
+	close(fd);
+	return err;
+    }
+
+    for (;;) {
+	len = recv(fd, rbuf, sizeof(rbuf), 0);
+	if (len < 0) {
+	    if (errno == EINTR)
+		continue;
+	    err = -errno;
+	    break;
+	}
+	for (nlh = (struct nlmsghdr *) rbuf; NLMSG_OK(nlh, len);
+	     nlh = NLMSG_NEXT(nlh, len)) {
+	    struct nlmsgerr *nlerr;
+
+	    if (nlh->nlmsg_type != NLMSG_ERROR)
+		continue;
+	    nlerr = NLMSG_DATA(nlh);
+	    if (nlerr->error != 0 || nlh->nlmsg_seq == seq) {
+		close(fd);
+		return nlerr->error;
+	    }
+	}
+    }
+    close(fd);
+    return err;
+}
+
+/*
+ * events_route - add or remove the host route to the peer in the
+ * event-route-table table.
+ */
+static void
+events_route(const struct ppp_state_event *ev, bool add)
+{
+    struct nlbuf b;
+    struct nlmsghdr *nlh;
+    struct rtmsg rtm;
+    uint32_t table = event_route_table, oif;
+    int err;
+
+    oif = if_nametoindex(ev->ifname);
+    if (oif == 0 || ev->hisaddr == 0)
+	return;
+
+    b.len = 0;
+    nlh = nl_msg(&b, add? RTM_NEWROUTE: RTM_DELROUTE,
+		 NLM_F_ACK | (add? NLM_F_CREATE | NLM_F_REPLACE: 0));
+    memset(&rtm, 0, sizeof(rtm));
+    rtm.rtm_family = AF_INET;
+    rtm.rtm_dst_len = 32;
+    rtm.rtm_table = table < 256? table: RT_TABLE_UNSPEC;
+    rtm.rtm_protocol = RTPROT_BOOT;
+    rtm.rtm_scope = RT_SCOPE_LINK;
+    rtm.rtm_type = RTN_UNICAST;
+    nl_put(&b, nlh, &rtm, sizeof(rtm));
+    nl_attr(&b, nlh, RTA_TABLE, &table, sizeof(table));
+    nl_attr(&b, nlh, RTA_DST, &ev->hisaddr, sizeof(ev->hisaddr));
+    nl_attr(&b, nlh, RTA_OIF, &oif, sizeof(oif));
+    nl_end(&b, nlh);
+
+    err = nl_talk(NETLINK_ROUTE, &b, nlh);
+    if (err < 0 && (add || err != -ESRCH)) {
+	errno = -err;
+	error("events: can't %s route to %I in table %d: %m",
+	      add? "add": "delete", ev->hisaddr, event_route_table);
+    }
+}
+
+/*
+ * events_nft - add or remove the peer's address in the event-nft-set
+ * set.  nftables only accepts changes inside a batch.
+ */
+static void
+events_nft(const struct ppp_state_event *ev, bool add)
+{
+    char spec[256], *table, *set;
+    struct nlbuf b;
+    struct nlmsghdr *nlh, *elem;
+    struct nfgenmsg nfg;
+    struct nlattr *list, *item, *key;
+    int family, err;
+
+    if (ev->hisaddr == 0)
+	return;
+    strlcpy(spec, event_nft_set, sizeof(spec));
+    table = strchr(spec, ':');
+    set = table? strchr(table + 1, ':'): NULL;
+    if (set == NULL) {
+	error("events: event-nft-set %s is not family:table:set",
+	      event_nft_set);
+	return;
+    }
+    *table++ = 0;
+    *set++ = 0;
+    if (strcmp(spec, "ip") == 0)
+	family = NFPROTO_IPV4;
+    else if (strcmp(spec, "inet") == 0)
+	family = NFPROTO_INET;
+    else {
+	error("events: unsupported nftables family %s", spec);
+	return;
+    }
+
+    b.len = 0;
+    memset(&nfg, 0, sizeof(nfg));
+    nfg.version = NFNETLINK_V0;
+
+    nlh = nl_msg(&b, NFNL_MSG_BATCH_BEGIN, 0);
+    nfg.nfgen_family = AF_UNSPEC;
+    nfg.res_id = htons(NFNL_SUBSYS_NFTABLES);
+    nl_put(&b, nlh, &nfg, sizeof(nfg));
+    nl_end(&b, nlh);
+
+    elem = nl_msg(&b, (NFNL_SUBSYS_NFTABLES << 8)
+		  | (add? NFT_MSG_NEWSETELEM: NFT_MSG_DELSETELEM),
+		  NLM_F_ACK | (add? NLM_F_CREATE: 0));
+    nfg.nfgen_family = family;
+    nfg.res_id = 0;
+    nl_put(&b, elem, &nfg, sizeof(nfg));
+    nl_attr(&b, elem, NFTA_SET_ELEM_LIST_TABLE, table, strlen(table) + 1);
+    nl_attr(&b, elem, NFTA_SET_ELEM_LIST_SET, set, strlen(set) + 1);
+    list = nl_attr(&b, elem, NLA_F_NESTED | NFTA_SET_ELEM_LIST_ELEMENTS,
+		   NULL, 0);
+    item = nl_attr(&b, elem, NLA_F_NESTED | NFTA_LIST_ELEM, NULL, 0);
+    key = nl_attr(&b, elem, NLA_F_NESTED | NFTA_SET_ELEM_KEY, NULL, 0);
+    nl_attr(&b, elem, NFTA_DATA_VALUE, &ev->hisaddr, sizeof(ev->hisaddr));
+    nl_nest_end(elem, key);
+    nl_nest_end(elem, item);
+    nl_nest_end(elem, list);
+    nl_end(&b, elem);
+
+    nlh = nl_msg(&b, NFNL_MSG_BATCH_END, 0);
+    nfg.nfgen_family = AF_UNSPEC;
+    nfg.res_id = htons(NFNL_SUBSYS_NFTABLES);
+    nl_put(&b, nlh, &nfg, sizeof(nfg));
+    nl_end(&b, nlh);
+
+    err = nl_talk(NETLINK_NETFILTER, &b, elem);
+    if (err < 0 && (add || err != -ENOENT)) {
+	errno = -err;
+	error("events: can't %s %I %s nftables set %s: %m",
+	      add? "add": "delete", ev->hisaddr, add? "to": "from",
+	      event_nft_set);
+    }
+}
+
+static void
+events_handler(void *ctx, const struct ppp_state_event *ev)
+{
+    /* options are parsed after plugin_init, so connect on first use */
+    if (event_socket != NULL && event_fd < 0 && !event_fd_tried) {
+	event_fd = events_open_socket(event_socket);
+	event_fd_tried = true;
+    }
+    if (event_fd >= 0)
+	events_send(ev);
+
+    if (ev->type != PPP_EV_IP_UP && ev->type != PPP_EV_IP_DOWN)
+	return;
+    if (event_route_table > 0)
+	events_route(ev, ev->type == PPP_EV_IP_UP);
+    if (event_nft_set != NULL)
+	events_nft(ev, ev->type == PPP_EV_IP_UP);
+}
+
+void
+plugin_init(void)
+{
+    ppp_add_options(events_options);
+    ppp_add_state_handler(PPP_STATE_EVENT_VERSION, events_handler, NULL);
+}
@@ -26,6 +26,13 @@
  * PPP_UPDOWN_IND	- tells OpenL2TP of PPP session state changes.
  * PPP_ACCM_IND		- tells OpenL2TP of PPP ACCM negotiated options
  *
+ * A pppd started with the pppol2tp_pool option waits on a SOCK_SEQPACKET
+ * socket for messages of these types:-
+ * PPP_SPAWN_REQ	- asks for a pppd to run a session.  The PPPoL2TP
+ *			  socket is passed with the message (SCM_RIGHTS).
+ * PPP_SPAWN_RSP	- the reply, giving the pid of the new pppd or why
+ *			  there isn't one.
+ *
  * Non-GPL applications are permitted to use this API, provided that
  * any changes to this source file are made available under GPL terms.
  */
@@ -44,7 +51,9 @@
 #define OPENL2TP_MSG_TYPE_NULL			0
 #define OPENL2TP_MSG_TYPE_PPP_UPDOWN_IND	1
 #define OPENL2TP_MSG_TYPE_PPP_ACCM_IND		2
-#define OPENL2TP_MSG_TYPE_MAX			3
+#define OPENL2TP_MSG_TYPE_PPP_SPAWN_REQ		3
+#define OPENL2TP_MSG_TYPE_PPP_SPAWN_RSP		4
+#define OPENL2TP_MSG_TYPE_MAX			5
 
 enum {
 	OPENL2TP_TLV_TYPE_TUNNEL_ID,
@@ -53,9 +62,11 @@ enum {
 	OPENL2TP_TLV_TYPE_PPP_UNIT,
 	OPENL2TP_TLV_TYPE_PPP_IFNAME,
 	OPENL2TP_TLV_TYPE_PPP_USER_NAME,
-	OPENL2TP_TLV_TYPE_PPP_STATE
+	OPENL2TP_TLV_TYPE_PPP_STATE,
+	OPENL2TP_TLV_TYPE_PPP_PID,
+	OPENL2TP_TLV_TYPE_RESULT
 };
-#define OPENL2TP_TLV_TYPE_MAX		(OPENL2TP_TLV_TYPE_PPP_STATE + 1)
+#define OPENL2TP_TLV_TYPE_MAX		(OPENL2TP_TLV_TYPE_RESULT + 1)
 
 #define OPENL2TP_MSG_MAX_LEN		512
 #define OPENL2TP_MSG_SIGNATURE		0x6b6c7831
@@ -112,4 +123,12 @@ struct openl2tp_tlv_ppp_user_name {
 	char		user_name[0];
 };
 
+struct openl2tp_tlv_ppp_pid {
+	uint32_t	pid;
+};
+
+struct openl2tp_tlv_result {
+	int32_t		error;		/* 0 or an errno value */
+};
+
 #endif /* L2TP_EVENT_H */
@@ -156,7 +156,7 @@ static void openl2tp_send_accm_ind(int tunnel_id, int session_id,
 	msg->msg_len += sizeof(*tlv) + ALIGN32(tlv->tlv_len);
 
 	result = send(openl2tp_fd, msg, sizeof(*msg) + msg->msg_len,
-		      MSG_NOSIGNAL);
+		      MSG_NOSIGNAL | MSG_DONTWAIT);
 	if (result < 0) {
 		error("openl2tp send: %m");
 	}
@@ -243,7 +243,7 @@ static void openl2tp_ppp_updown_ind(int tunnel_id, int session_id, int up)
 	}
 
 	result = send(openl2tp_fd, msg, sizeof(*msg) + msg->msg_len,
-		      MSG_NOSIGNAL);
+		      MSG_NOSIGNAL | MSG_DONTWAIT);
 	if (result < 0) {
 		error("openl2tp send: %m");
 	}
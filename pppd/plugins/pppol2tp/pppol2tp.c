@@ -30,6 +30,10 @@
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <netinet/in.h>
 #include <signal.h>
 #include <stdbool.h>
@@ -59,6 +63,7 @@
 #include <pppd/ccp.h>
 #include <pppd/ipcp.h>
 
+#include "l2tp_event.h"
 
 /* should be added to system's socket.h... */
 #ifndef SOL_PPPOL2TP
@@ -68,9 +73,13 @@
 const char pppd_version[] = PPPD_VERSION;
 
 static int setdevname_pppol2tp(char **argv);
+static int setpool_pppol2tp(char **argv);
+static void pppol2tp_set_defaults(void);
 
 static int pppol2tp_fd = -1;
 static char *pppol2tp_fd_str;
+static char *pppol2tp_pool_path;
+static bool pppol2tp_pool_session = 0;	/* a child running a pool session */
 static bool pppol2tp_lns_mode = 0;
 static bool pppol2tp_recv_seq = 0;
 static bool pppol2tp_send_seq = 0;
@@ -83,10 +92,9 @@ int pppol2tp_session_id = 0;
 static int device_got_set = 0;
 struct channel pppol2tp_channel;
 
-static void (*old_snoop_recv_hook)(unsigned char *p, int len) = NULL;
-static void (*old_snoop_send_hook)(unsigned char *p, int len) = NULL;
 
-/* Hook provided to allow other plugins to handle ACCM changes */
+/* Hook provided to allow other plugins to handle ACCM changes.
+ * The ACCMs are passed in network byte order, as they appear in LCP. */
 void (*pppol2tp_send_accm_hook)(int tunnel_id, int session_id,
 				uint32_t send_accm, uint32_t recv_accm) = NULL;
 
@@ -97,6 +105,9 @@ static struct option pppol2tp_options[] = {
 	{ "pppol2tp", o_special, &setdevname_pppol2tp,
 	  "FD for PPPoL2TP socket", OPT_DEVNAM | OPT_A2STRVAL,
           &pppol2tp_fd_str },
+	{ "pppol2tp_pool", o_special, &setpool_pppol2tp,
+	  "Wait for PPPoL2TP sessions on this unix socket",
+	  OPT_DEVNAM | OPT_PRIV | OPT_A2STRVAL, &pppol2tp_pool_path },
 	{ "pppol2tp_lns_mode", o_bool, &pppol2tp_lns_mode,
 	  "PPPoL2TP LNS behavior. Default off.",
 	  OPT_PRIO | OPRIO_CFGFILE },
@@ -163,6 +174,25 @@ static int setdevname_pppol2tp(char **argv)
 	if (pppol2tp_fd_str == NULL)
 		novm("PPPoL2TP FD");
 
+	pppol2tp_set_defaults();
+	return 1;
+}
+
+static int setpool_pppol2tp(char **argv)
+{
+	if (device_got_set)
+		return 0;
+
+	pppol2tp_pool_path = strdup(*argv);
+	if (pppol2tp_pool_path == NULL)
+		novm("PPPoL2TP pool socket");
+
+	pppol2tp_set_defaults();
+	return 1;
+}
+
+static void pppol2tp_set_defaults(void)
+{
 	/* Setup option defaults. Compression options are disabled! */
 
 	ppp_set_modem(false);
@@ -184,12 +214,290 @@ static int setdevname_pppol2tp(char **argv)
 
 	the_channel = &pppol2tp_channel;
 	device_got_set = 1;
+}
 
-	return 1;
+/*****************************************************************************
+ * Pool mode.
+ * With pppol2tp_pool, pppd parses its options, loads its plugins and so on
+ * once, then waits on a unix socket for the L2TP daemon to hand it sessions.
+ * For each one it forks a child, which carries on from here as an ordinary
+ * pppd for that session, while the parent goes back to waiting.
+ *****************************************************************************/
+
+#define POOL_MAX_CLIENTS	8
+
+static void pool_reply(int cfd, int tunnel_id, int session_id, int pid,
+		       int err)
+{
+	uint8_t buf[OPENL2TP_MSG_MAX_LEN];
+	struct openl2tp_event_msg *msg = (void *) &buf[0];
+	struct openl2tp_event_tlv *tlv;
+	uint16_t tid = tunnel_id;
+	uint16_t sid = session_id;
+	struct openl2tp_tlv_ppp_pid tp;
+	struct openl2tp_tlv_result tr;
+
+	msg->msg_signature = OPENL2TP_MSG_SIGNATURE;
+	msg->msg_type = OPENL2TP_MSG_TYPE_PPP_SPAWN_RSP;
+	msg->msg_len = 0;
+
+	tlv = (void *) &msg->msg_data[msg->msg_len];
+	tlv->tlv_type = OPENL2TP_TLV_TYPE_TUNNEL_ID;
+	tlv->tlv_len = sizeof(tid);
+	memcpy(&tlv->tlv_value[0], &tid, tlv->tlv_len);
+	msg->msg_len += sizeof(*tlv) + ALIGN32(tlv->tlv_len);
+
+	tlv = (void *) &msg->msg_data[msg->msg_len];
+	tlv->tlv_type = OPENL2TP_TLV_TYPE_SESSION_ID;
+	tlv->tlv_len = sizeof(sid);
+	memcpy(&tlv->tlv_value[0], &sid, tlv->tlv_len);
+	msg->msg_len += sizeof(*tlv) + ALIGN32(tlv->tlv_len);
+
+	tp.pid = pid;
+	tlv = (void *) &msg->msg_data[msg->msg_len];
+	tlv->tlv_type = OPENL2TP_TLV_TYPE_PPP_PID;
+	tlv->tlv_len = sizeof(tp);
+	memcpy(&tlv->tlv_value[0], &tp, tlv->tlv_len);
+	msg->msg_len += sizeof(*tlv) + ALIGN32(tlv->tlv_len);
+
+	tr.error = err;
+	tlv = (void *) &msg->msg_data[msg->msg_len];
+	tlv->tlv_type = OPENL2TP_TLV_TYPE_RESULT;
+	tlv->tlv_len = sizeof(tr);
+	memcpy(&tlv->tlv_value[0], &tr, tlv->tlv_len);
+	msg->msg_len += sizeof(*tlv) + ALIGN32(tlv->tlv_len);
+
+	if (send(cfd, msg, sizeof(*msg) + msg->msg_len,
+		 MSG_NOSIGNAL | MSG_DONTWAIT) < 0)
+		warn("pppol2tp pool: couldn't send reply: %m");
+}
+
+/*
+ * Read a PPP_SPAWN_REQ and the socket that comes with it.  Returns the
+ * socket, or -1 with *err set; -2 means the connection has closed.
+ */
+static int pool_read_request(int cfd, int *tidp, int *sidp, char *ifname,
+			     int *err)
+{
+	uint8_t buf[OPENL2TP_MSG_MAX_LEN];
+	union {
+		char buf[CMSG_SPACE(sizeof(int))];
+		struct cmsghdr align;
+	} cbuf;
+	struct openl2tp_event_msg *msg = (void *) &buf[0];
+	struct openl2tp_event_tlv *tlv;
+	struct msghdr mh;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	union {
+		char buffer[128];
+		struct sockaddr sa;
+	} s;
+	socklen_t slen = sizeof(s);
+	uint16_t id;
+	int n, off, fd = -1;
+
+	iov.iov_base = buf;
+	iov.iov_len = sizeof(buf);
+	memset(&mh, 0, sizeof(mh));
+	mh.msg_iov = &iov;
+	mh.msg_iovlen = 1;
+	mh.msg_control = cbuf.buf;
+	mh.msg_controllen = sizeof(cbuf.buf);
+	n = recvmsg(cfd, &mh, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+	if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+		*err = EAGAIN;
+		return -1;
+	}
+	if (n <= 0)
+		return -2;
+	for (cmsg = CMSG_FIRSTHDR(&mh); cmsg != NULL;
+	     cmsg = CMSG_NXTHDR(&mh, cmsg))
+		if (cmsg->cmsg_level == SOL_SOCKET
+		    && cmsg->cmsg_type == SCM_RIGHTS
+		    && cmsg->cmsg_len == CMSG_LEN(sizeof(int)))
+			memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+
+	*err = EINVAL;
+	if (n < sizeof(*msg) || msg->msg_signature != OPENL2TP_MSG_SIGNATURE
+	    || msg->msg_type != OPENL2TP_MSG_TYPE_PPP_SPAWN_REQ
+	    || msg->msg_len > n - sizeof(*msg))
+		goto bad;
+
+	for (off = 0; off + sizeof(*tlv) <= msg->msg_len;
+	     off += sizeof(*tlv) + ALIGN32(tlv->tlv_len)) {
+		tlv = (void *) &msg->msg_data[off];
+		if (off + sizeof(*tlv) + tlv->tlv_len > msg->msg_len)
+			goto bad;
+		switch (tlv->tlv_type) {
+		case OPENL2TP_TLV_TYPE_TUNNEL_ID:
+		case OPENL2TP_TLV_TYPE_SESSION_ID:
+			if (tlv->tlv_len != sizeof(id))
+				goto bad;
+			memcpy(&id, &tlv->tlv_value[0], sizeof(id));
+			if (tlv->tlv_type == OPENL2TP_TLV_TYPE_TUNNEL_ID)
+				*tidp = id;
+			else
+				*sidp = id;
+			break;
+		case OPENL2TP_TLV_TYPE_PPP_IFNAME:
+			if (tlv->tlv_len >= IFNAMSIZ)
+				goto bad;
+			memcpy(ifname, &tlv->tlv_value[0], tlv->tlv_len);
+			ifname[tlv->tlv_len] = 0;
+			break;
+		}
+	}
+
+	if (fd < 0 || (pppol2tp_lns_mode && (*tidp == 0 || *sidp == 0)))
+		goto bad;
+	if (getsockname(fd, &s.sa, &slen) < 0 || s.sa.sa_family != AF_PPPOX) {
+		*err = ENOTSOCK;
+		goto bad;
+	}
+	return fd;
+
+bad:
+	if (fd >= 0)
+		close(fd);
+	return -1;
+}
+
+static int pool_listen(void)
+{
+	struct sockaddr_un addr;
+	mode_t mask;
+	int fd;
+
+	if (strlen(pppol2tp_pool_path) >= sizeof(addr.sun_path))
+		fatal("PPPoL2TP pool socket path %s too long",
+		      pppol2tp_pool_path);
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, pppol2tp_pool_path);
+
+	fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		fatal("PPPoL2TP pool socket: %m");
+	unlink(pppol2tp_pool_path);
+	mask = umask(077);
+	if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0
+	    || listen(fd, POOL_MAX_CLIENTS) < 0)
+		fatal("Couldn't listen on %s: %m", pppol2tp_pool_path);
+	umask(mask);
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	return fd;
+}
+
+/*
+ * Wait for sessions.  Returns the PPPoL2TP socket in a child that is to
+ * run a session, or -1 in the parent when pppd is told to stop.
+ */
+static int pool_wait(void)
+{
+	struct pollfd pfd[POOL_MAX_CLIENTS + 1];
+	int clients[POOL_MAX_CLIENTS];
+	int nclients = 0;
+	int lfd, cfd, fd, i, j, err, status, pid;
+	int tid, sid;
+	char ifname[IFNAMSIZ];
+
+	lfd = pool_listen();
+	notice("Waiting for PPPoL2TP sessions on %s", pppol2tp_pool_path);
+
+	for (;;) {
+		if (ppp_signaled(SIGTERM) || ppp_signaled(SIGHUP))
+			break;
+		while (waitpid(-1, &status, WNOHANG) > 0)
+			;
+
+		pfd[0].fd = lfd;
+		pfd[0].events = POLLIN;
+		for (i = 0; i < nclients; ++i) {
+			pfd[i+1].fd = clients[i];
+			pfd[i+1].events = POLLIN;
+		}
+		if (poll(pfd, nclients + 1, 1000) < 0) {
+			if (errno == EINTR)
+				continue;
+			fatal("PPPoL2TP pool: poll: %m");
+		}
+
+		for (i = nclients - 1; i >= 0; --i) {
+			if (!(pfd[i+1].revents & (POLLIN | POLLHUP | POLLERR)))
+				continue;
+			tid = sid = 0;
+			ifname[0] = 0;
+			fd = pool_read_request(clients[i], &tid, &sid, ifname,
+					       &err);
+			if (fd == -2) {
+				close(clients[i]);
+				clients[i] = clients[--nclients];
+				continue;
+			}
+			if (fd < 0) {
+				if (err != EAGAIN)
+					pool_reply(clients[i], tid, sid, 0, err);
+				continue;
+			}
+
+			pid = fork();
+			err = errno;
+			if (pid == 0) {
+				/* we run this session */
+				close(lfd);
+				for (j = 0; j < nclients; ++j)
+					close(clients[j]);
+				ppp_forked();
+				/* the pool stays with the parent */
+				pppol2tp_pool_path = NULL;
+				pppol2tp_pool_session = 1;
+				pppol2tp_fd = fd;
+				pppol2tp_tunnel_id = tid;
+				pppol2tp_session_id = sid;
+				if (ifname[0])
+					strlcpy(pppol2tp_ifname, ifname,
+						sizeof(pppol2tp_ifname));
+				return fd;
+			}
+			if (pid < 0)
+				error("PPPoL2TP pool: fork: %s", strerror(err));
+			else if (pppol2tp_debug_mask & PPPOL2TP_MSG_CONTROL)
+				dbglog("pppol2tp pool: pid %d has tunnel %d "
+				       "session %d", pid, tid, sid);
+			close(fd);
+			pool_reply(clients[i], tid, sid, pid < 0? 0: pid,
+				   pid < 0? err: 0);
+		}
+
+		if (pfd[0].revents & POLLIN) {
+			while ((cfd = accept(lfd, NULL, NULL)) >= 0) {
+				if (nclients >= POOL_MAX_CLIENTS) {
+					close(cfd);
+					continue;
+				}
+				fcntl(cfd, F_SETFD, FD_CLOEXEC);
+				clients[nclients++] = cfd;
+			}
+		}
+	}
+
+	for (i = 0; i < nclients; ++i)
+		close(clients[i]);
+	close(lfd);
+	unlink(pppol2tp_pool_path);
+	return -1;
 }
 
 static int connect_pppol2tp(void)
 {
+	if (pppol2tp_pool_path != NULL && pppol2tp_fd == -1)
+		return pool_wait();
+
+	/* e.g. redialling on demand after the session has gone */
+	if (pppol2tp_pool_session && pppol2tp_fd == -1)
+		fatal("A PPPoL2TP pool session can't be redialled");
+
 	if(pppol2tp_fd == -1) {
 		fatal("No PPPoL2TP FD specified");
 	}
@@ -300,151 +608,26 @@ static void recv_config_pppol2tp(int mru,
 }
 
 /*****************************************************************************
- * Snoop LCP message exchanges to capture negotiated ACCM values.
- * When asyncmap values have been seen from both sides, give the values to
- * L2TP.
- * This code is derived from Roaring Penguin L2TP.
+ * Give the ACCM values negotiated by LCP to L2TP.
  *****************************************************************************/
 
-static void pppol2tp_lcp_snoop(unsigned char *buf, int len, int incoming)
+static void pppol2tp_state_event(void *ctx, const struct ppp_state_event *ev)
 {
-	static bool got_send_accm = 0;
-	static bool got_recv_accm = 0;
-	static uint32_t recv_accm = 0xffffffff;
-	static uint32_t send_accm = 0xffffffff;
-	static bool snooping = 1;
-
-	uint16_t protocol;
-	uint16_t lcp_pkt_len;
-	int opt, opt_len;
-	int reject;
-	unsigned char const *opt_data;
-	uint32_t accm;
-
-	/* Skip HDLC header */
-	buf += 2;
-	len -= 2;
-
-	/* Unreasonably short frame?? */
-	if (len <= 0) return;
-
-	/* Get protocol */
-	if (buf[0] & 0x01) {
-		/* Compressed protcol field */
-		protocol = buf[0];
-	} else {
-		protocol = ((unsigned int) buf[0]) * 256 + buf[1];
-	}
-
-	/* If it's a network protocol, stop snooping */
-	if (protocol <= 0x3fff) {
-		if (pppol2tp_debug_mask & PPPOL2TP_MSG_DEBUG) {
-			dbglog("Turning off snooping: "
-			       "Network protocol %04x found.",
-			       protocol);
-		}
-		snooping = 0;
+	if (ev->type != PPP_EV_LCP_UP)
 		return;
-	}
 
-	/* If it's not LCP, do not snoop */
-	if (protocol != 0xc021) {
-		return;
+	if (pppol2tp_debug_mask & PPPOL2TP_MSG_CONTROL) {
+		dbglog("Telling L2TP: Send ACCM = %08x; "
+		       "Receive ACCM = %08x", ev->send_accm, ev->recv_accm);
 	}
-
-	/* Skip protocol; go to packet data */
-	buf += 2;
-	len -= 2;
-
-	/* Unreasonably short frame?? */
-	if (len <= 0) return;
-
-	/* Look for Configure-Ack or Configure-Reject code */
-	if (buf[0] != CONFACK && buf[0] != CONFREJ) return;
-
-	reject = (buf[0] == CONFREJ);
-
-	lcp_pkt_len = ((unsigned int) buf[2]) * 256 + buf[3];
-
-	/* Something fishy with length field? */
-	if (lcp_pkt_len > len) return;
-
-	/* Skip to options */
-	len = lcp_pkt_len - 4;
-	buf += 4;
-
-	while (len > 0) {
-		/* Pull off an option */
-		opt = buf[0];
-		opt_len = buf[1];
-		opt_data = &buf[2];
-		if (opt_len > len || opt_len < 2) break;
-		len -= opt_len;
-		buf += opt_len;
-		if (pppol2tp_debug_mask & PPPOL2TP_MSG_DEBUG) {
-			dbglog("Found option type %02x; len %d", opt, opt_len);
-		}
-
-		/* We are specifically interested in ACCM */
-		if (opt == CI_ASYNCMAP && opt_len == 0x06) {
-			if (reject) {
-				/* ACCM negotiation REJECTED; use default */
-				accm = 0xffffffff;
-				if (pppol2tp_debug_mask & PPPOL2TP_MSG_DATA) {
-					dbglog("Rejected ACCM negotiation; "
-					       "defaulting (%s)",
-					       incoming ? "incoming" : "outgoing");
-				}
-				recv_accm = accm;
-				send_accm = accm;
-				got_recv_accm = 1;
-				got_send_accm = 1;
-			} else {
-				memcpy(&accm, opt_data, sizeof(accm));
-				if (pppol2tp_debug_mask & PPPOL2TP_MSG_DATA) {
-					dbglog("Found ACCM of %08x (%s)", accm,
-					       incoming ? "incoming" : "outgoing");
-				}
-				if (incoming) {
-					recv_accm = accm;
-					got_recv_accm = 1;
-				} else {
-					send_accm = accm;
-					got_send_accm = 1;
-				}
-			}
-
-			if (got_recv_accm && got_send_accm) {
-				if (pppol2tp_debug_mask & PPPOL2TP_MSG_CONTROL) {
-					dbglog("Telling L2TP: Send ACCM = %08x; "
-					       "Receive ACCM = %08x", send_accm, recv_accm);
-				}
-				if (pppol2tp_send_accm_hook != NULL) {
-					(*pppol2tp_send_accm_hook)(pppol2tp_tunnel_id,
-								   pppol2tp_session_id,
-								   send_accm, recv_accm);
-				}
-				got_recv_accm = 0;
-				got_send_accm = 0;
-			}
-		}
+	if (pppol2tp_send_accm_hook != NULL) {
+		(*pppol2tp_send_accm_hook)(pppol2tp_tunnel_id,
+					   pppol2tp_session_id,
+					   htonl(ev->send_accm),
+					   htonl(ev->recv_accm));
 	}
 }
 
-static void pppol2tp_lcp_snoop_recv(unsigned char *p, int len)
-{
-	if (old_snoop_recv_hook != NULL)
-		(*old_snoop_recv_hook)(p, len);
-	pppol2tp_lcp_snoop(p, len, 1);
-}
-
-static void pppol2tp_lcp_snoop_send(unsigned char *p, int len)
-{
-	if (old_snoop_send_hook != NULL)
-		(*old_snoop_send_hook)(p, len);
-	pppol2tp_lcp_snoop(p, len, 0);
-}
-
 /*****************************************************************************
  * Interface up/down events
  *****************************************************************************/
@@ -473,19 +656,21 @@ static void pppol2tp_ip_down(void *opaque, int arg)
 
 static void pppol2tp_check_options(void)
 {
-	/* Enable LCP snooping for ACCM options only for LNS */
+	/* the pool never returns to pppd's main loop to serve it */
+	if (pppol2tp_pool_path != NULL && ppp_control_path() != NULL)
+		fatal("The control option can't be used with pppol2tp_pool");
+	/* a session child would wait for the same session again */
+	if (pppol2tp_pool_path != NULL && ppp_persist())
+		fatal("The persist option can't be used with pppol2tp_pool");
+
+	/* Report the negotiated ACCM values only for LNS */
 	if (pppol2tp_lns_mode) {
-		if ((pppol2tp_tunnel_id == 0) || (pppol2tp_session_id == 0)) {
+		/* in pool mode, each request gives the ids */
+		if (pppol2tp_pool_path == NULL &&
+		    ((pppol2tp_tunnel_id == 0) || (pppol2tp_session_id == 0))) {
 			fatal("tunnel_id/session_id values not specified");
 		}
-		if (pppol2tp_debug_mask & PPPOL2TP_MSG_CONTROL) {
-			dbglog("Enabling LCP snooping");
-		}
-		old_snoop_recv_hook = snoop_recv_hook;
-		old_snoop_send_hook = snoop_send_hook;
-
-		snoop_recv_hook = pppol2tp_lcp_snoop_recv;
-		snoop_send_hook = pppol2tp_lcp_snoop_send;
+		ppp_add_state_handler(2, pppol2tp_state_event, NULL);
 	}
 }
 
@@ -47,6 +47,7 @@
 #include <pppd/crypto.h>
 #include <pppd/fsm.h>
 #include <pppd/ipcp.h>
+#include <pppd/meter.h>
 
 #include "radiusclient.h"
 
@@ -87,7 +88,7 @@ static void radius_choose_ip(u_int32_t *addrp);
 static int radius_init(char *msg);
 static int get_client_port(const char *ifname);
 static int radius_allowed_address(u_int32_t addr);
-static void radius_acct_interim(void *);
+static int radius_acct_interim(const struct ppp_meter_sample *, void *);
 #ifdef PPP_WITH_MPPE
 static int radius_setmppekeys(VALUE_PAIR *vp, REQUEST_INFO *req_info,
 			      unsigned char *);
@@ -1051,9 +1052,15 @@ radius_acct_start(void)
 		"Accounting START failed for %s", rstate.user);
     }
 
-    /* Kick off periodic accounting reports */
+    /*
+     * Kick off periodic accounting reports.  The first comes somewhere
+     * in the second half of the interval, so that sessions which came
+     * up together don't all report together.
+     */
     if (rstate.acct_interim_interval) {
-	ppp_timeout(radius_acct_interim, NULL, rstate.acct_interim_interval, 0);
+	ppp_meter_add(radius_acct_interim, NULL,
+		      rstate.acct_interim_interval * 1000,
+		      rstate.acct_interim_interval * 500);
     }
 }
 
@@ -1083,7 +1090,7 @@ radius_acct_stop(void)
     }
 
     if (rstate.acct_interim_interval)
-	ppp_untimeout(radius_acct_interim, NULL);
+	ppp_meter_remove(radius_acct_interim, NULL);
 
     rc_avpair_add(&send, PW_ACCT_SESSION_ID, rstate.session_id,
 		   0, VENDOR_NONE);
@@ -1223,14 +1230,15 @@ radius_acct_stop(void)
 /**********************************************************************
 * %FUNCTION: radius_acct_interim
 * %ARGUMENTS:
-*  None
+*  m -- the current link counters
+*  ignored -- ignored
 * %RETURNS:
-*  Nothing
+*  Milliseconds until the next report is due
 * %DESCRIPTION:
 *  Sends an interim accounting message to the RADIUS server
 ***********************************************************************/
-static void
-radius_acct_interim(void *ignored)
+static int
+radius_acct_interim(const struct ppp_meter_sample *m, void *ignored)
 {
     UINT4 av_type;
     VALUE_PAIR *send = NULL;
@@ -1239,10 +1247,9 @@ radius_acct_interim(void *ignored)
     int result;
     const char *remote_number;
     const char *ipparam;
-    ppp_link_stats_st stats;
 
     if (!rstate.initialized) {
-	return;
+	return 0;
     }
 
     rc_avpair_add(&send, PW_ACCT_SESSION_ID, rstate.session_id,
@@ -1266,31 +1273,32 @@ radius_acct_interim(void *ignored)
     av_type = PW_RADIUS;
     rc_avpair_add(&send, PW_ACCT_AUTHENTIC, &av_type, 0, VENDOR_NONE);
 
-    if (ppp_get_link_stats(&stats)) {
+    if (m->stats_valid) {
+	const ppp_link_stats_st *stats = &m->stats;
 
-	av_type = ppp_get_link_uptime();
+	av_type = m->connect_time;
 	rc_avpair_add(&send, PW_ACCT_SESSION_TIME, &av_type, 0, VENDOR_NONE);
 
-	av_type = stats.bytes_out & 0xFFFFFFFF;
+	av_type = stats->bytes_out & 0xFFFFFFFF;
 	rc_avpair_add(&send, PW_ACCT_OUTPUT_OCTETS, &av_type, 0, VENDOR_NONE);
 
-	if (stats.bytes_out > 0xFFFFFFFF) {
-	    av_type = stats.bytes_out >> 32;
+	if (stats->bytes_out > 0xFFFFFFFF) {
+	    av_type = stats->bytes_out >> 32;
 	    rc_avpair_add(&send, PW_ACCT_OUTPUT_GIGAWORDS, &av_type, 0, VENDOR_NONE);
 	}
 
-	av_type = stats.bytes_in & 0xFFFFFFFF;
+	av_type = stats->bytes_in & 0xFFFFFFFF;
 	rc_avpair_add(&send, PW_ACCT_INPUT_OCTETS, &av_type, 0, VENDOR_NONE);
 
-	if (stats.bytes_in > 0xFFFFFFFF) {
-	    av_type = stats.bytes_in >> 32;
+	if (stats->bytes_in > 0xFFFFFFFF) {
+	    av_type = stats->bytes_in >> 32;
 	    rc_avpair_add(&send, PW_ACCT_INPUT_GIGAWORDS, &av_type, 0, VENDOR_NONE);
 	}
 
-	av_type = stats.pkts_out;
+	av_type = stats->pkts_out;
 	rc_avpair_add(&send, PW_ACCT_OUTPUT_PACKETS, &av_type, 0, VENDOR_NONE);
 
-	av_type = stats.pkts_in;
+	av_type = stats->pkts_in;
 	rc_avpair_add(&send, PW_ACCT_INPUT_PACKETS, &av_type, 0, VENDOR_NONE);
     }
 
@@ -1328,7 +1336,7 @@ radius_acct_interim(void *ignored)
     rc_avpair_free(send);
 
     /* Schedule another one */
-    ppp_timeout(radius_acct_interim, NULL, rstate.acct_interim_interval, 0);
+    return rstate.acct_interim_interval * 1000;
 }
 
 /**********************************************************************
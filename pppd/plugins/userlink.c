@@ -0,0 +1,352 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*
+ * userlink.c - pppd plugin to run a PPP link without the kernel driver.
+ *
+ * Frames are carried over a unix SOCK_SEQPACKET socket, one frame per
+ * message with the 4-byte PPP header and no HDLC framing, and the
+ * interface state that pppd would normally push into the kernel is
+ * kept in memory here.  This needs neither /dev/ppp nor CAP_NET_ADMIN,
+ * so two pppds (or pppd and a scripted peer) can be linked together
+ * for testing and load generation:
+ *
+ *   userlink <path>	connect to a socket, or with userlink-listen,
+ *			listen on it and accept a single connection
+ *   userlink-fd <n>	use an already connected socket, e.g. one end
+ *			of a socketpair passed in by a test harness
+ *
+ * No network traffic flows; the interface only exists as far as pppd
+ * itself can tell.
+ *
+ * Copyright (c) 2026 The pppd Project. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THE AUTHORS OF THIS SOFTWARE DISCLAIM ALL WARRANTIES WITH REGARD TO
+ * THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+ * AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <linux/ppp_defs.h>
+
+#include <pppd/pppd.h>
+#include <pppd/options.h>
+
+char pppd_version[] = PPPD_VERSION;
+
+static char *userlink_path;
+static bool userlink_listen;
+static int userlink_fd = -1;
+static bool device_got_set;
+static char userlink_fdname[32];
+
+/* What the kernel would otherwise know about the interface */
+static struct {
+    int		up;
+    int		mtu;
+    uint32_t	ouraddr, hisaddr;
+    ppp_link_stats_st stats;
+    time_t	last_xmit, last_recv;	/* last network-protocol frames */
+} uif;
+
+static int setdevname_userlink(char **argv);
+static int setfd_userlink(char **argv);
+
+static struct option userlink_options[] = {
+    { "userlink", o_special, &setdevname_userlink,
+      "Run the link over a unix seqpacket socket", OPT_DEVNAM | OPT_A2STRVAL,
+      &userlink_path },
+    { "userlink-fd", o_special, &setfd_userlink,
+      "Run the link over this connected socket fd", OPT_DEVNAM },
+    { "userlink-listen", o_bool, &userlink_listen,
+      "Listen on the userlink socket rather than connecting", 1 },
+    { NULL }
+};
+
+static struct channel userlink_channel;
+static const struct ppp_sys_ops userlink_ops;
+
+static void userlink_select(const char *name)
+{
+    ppp_set_devnam(name);
+    ppp_set_pppdevnam(name);
+    ppp_set_modem(false);
+    the_channel = &userlink_channel;
+    sys_ops_hook = &userlink_ops;
+    device_got_set = 1;
+}
+
+static int setdevname_userlink(char **argv)
+{
+    if (device_got_set)
+	return 0;
+    if (strlen(*argv) >= sizeof(((struct sockaddr_un *)0)->sun_path)) {
+	ppp_option_error("userlink socket path too long");
+	return 0;
+    }
+    userlink_path = strdup(*argv);
+    if (userlink_path == NULL)
+	novm("userlink path");
+    userlink_select(userlink_path);
+    return 1;
+}
+
+static int setfd_userlink(char **argv)
+{
+    int type;
+    socklen_t len = sizeof(type);
+
+    if (device_got_set)
+	return 0;
+    if (!ppp_int_option(*argv, &userlink_fd))
+	return 0;
+    if (getsockopt(userlink_fd, SOL_SOCKET, SO_TYPE, &type, &len) < 0
+	|| type != SOCK_SEQPACKET) {
+	ppp_option_error("userlink-fd %d is not a seqpacket socket",
+			 userlink_fd);
+	return 0;
+    }
+    slprintf(userlink_fdname, sizeof(userlink_fdname), "userlink-fd %d",
+	     userlink_fd);
+    userlink_select(userlink_fdname);
+    return 1;
+}
+
+static int userlink_connect(void)
+{
+    struct sockaddr_un sun;
+    int fd, lfd;
+
+    if (userlink_path == NULL)
+	return userlink_fd;
+
+    memset(&sun, 0, sizeof(sun));
+    sun.sun_family = AF_UNIX;
+    strlcpy(sun.sun_path, userlink_path, sizeof(sun.sun_path));
+
+    fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+	error("userlink: socket: %m");
+	return -1;
+    }
+    if (!userlink_listen) {
+	if (connect(fd, (struct sockaddr *) &sun, sizeof(sun)) < 0) {
+	    error("userlink: connect(%s): %m", userlink_path);
+	    close(fd);
+	    return -1;
+	}
+	userlink_fd = fd;
+	return fd;
+    }
+
+    lfd = fd;
+    unlink(userlink_path);
+    if (bind(lfd, (struct sockaddr *) &sun, sizeof(sun)) < 0
+	|| listen(lfd, 1) < 0) {
+	error("userlink: bind(%s): %m", userlink_path);
+	close(lfd);
+	return -1;
+    }
+    fd = accept(lfd, NULL, NULL);
+    if (fd < 0)
+	error("userlink: accept(%s): %m", userlink_path);
+    else
+	(void) fcntl(fd, F_SETFD, FD_CLOEXEC);
+    close(lfd);
+    unlink(userlink_path);
+    userlink_fd = fd;
+    return fd;
+}
+
+static void userlink_disconnect(void)
+{
+    if (userlink_fd >= 0) {
+	remove_fd(userlink_fd);
+	close(userlink_fd);
+	userlink_fd = -1;
+    }
+    memset(&uif, 0, sizeof(uif));
+}
+
+static void userlink_close(void)
+{
+    if (userlink_fd >= 0)
+	close(userlink_fd);
+}
+
+static int userlink_proto(unsigned char *p)
+{
+    return (p[2] << 8) | p[3];
+}
+
+/*
+ * Network-layer protocols (0x0000-0x3fff) are what the kernel's idle
+ * timer counts; control traffic does not keep a link busy.
+ */
+static int userlink_is_data(unsigned char *p)
+{
+    return userlink_proto(p) < 0x4000;
+}
+
+/*
+ * LCP, authentication and LQR frames (0xc000 and up) go over the
+ * channel rather than the unit, so the kernel never counts them.
+ */
+static void userlink_count(unsigned char *p, int len, uint64_t *bytes,
+			   unsigned int *pkts)
+{
+    if (userlink_proto(p) >= 0xc000)
+	return;
+    *bytes += len;
+    ++*pkts;
+}
+
+static void userlink_output(unsigned char *p, int len)
+{
+    if (send(userlink_fd, p, len, MSG_DONTWAIT | MSG_NOSIGNAL) < 0) {
+	if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS
+	    || errno == EINTR)
+	    warn("userlink: send: %m");
+	else
+	    error("userlink: send: %m");
+	return;
+    }
+    userlink_count(p, len, &uif.stats.bytes_out, &uif.stats.pkts_out);
+    if (userlink_is_data(p))
+	uif.last_xmit = time(NULL);
+}
+
+static int userlink_read_packet(unsigned char *buf, int len)
+{
+    int nr;
+
+    nr = recv(userlink_fd, buf, len, MSG_DONTWAIT);
+    if (nr < 0) {
+	if (errno == ECONNRESET)
+	    return 0;
+	if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+	    error("userlink: recv: %m");
+	return -1;
+    }
+    if (nr == 0)
+	return 0;
+    if (nr < PPP_HDRLEN) {
+	/* not a frame; drop it without signalling end of file */
+	errno = EAGAIN;
+	return -1;
+    }
+    userlink_count(buf, nr, &uif.stats.bytes_in, &uif.stats.pkts_in);
+    if (userlink_is_data(buf))
+	uif.last_recv = time(NULL);
+    return nr;
+}
+
+static void userlink_set_mtu(int mtu)
+{
+    uif.mtu = mtu;
+    dbglog("userlink: mtu %d", mtu);
+}
+
+static int userlink_get_mtu(void)
+{
+    return uif.mtu;
+}
+
+static int userlink_set_ifstate(int up)
+{
+    if (uif.up != up)
+	dbglog("userlink: interface %s", up? "up": "down");
+    uif.up = up;
+    if (up && uif.last_xmit == 0)
+	uif.last_xmit = uif.last_recv = time(NULL);
+    return 1;
+}
+
+static int userlink_set_addr(uint32_t ouraddr, uint32_t hisaddr,
+			     uint32_t netmask)
+{
+    uif.ouraddr = ouraddr;
+    uif.hisaddr = hisaddr;
+    dbglog("userlink: address %I peer %I", ouraddr, hisaddr);
+    return 1;
+}
+
+static int userlink_clear_addr(uint32_t ouraddr, uint32_t hisaddr)
+{
+    uif.ouraddr = uif.hisaddr = 0;
+    return 1;
+}
+
+static int userlink_get_stats(ppp_link_stats_st *stats)
+{
+    *stats = uif.stats;
+    return 1;
+}
+
+static int userlink_get_idle(struct ppp_idle *ip)
+{
+    time_t now = time(NULL);
+
+    if (uif.last_xmit == 0)
+	return 0;
+    ip->xmit_idle = now - uif.last_xmit;
+    ip->recv_idle = now - uif.last_recv;
+    return 1;
+}
+
+static const struct ppp_sys_ops userlink_ops = {
+    .output = userlink_output,
+    .read_packet = userlink_read_packet,
+    .set_mtu = userlink_set_mtu,
+    .get_mtu = userlink_get_mtu,
+    .set_ifstate = userlink_set_ifstate,
+    .set_addr = userlink_set_addr,
+    .clear_addr = userlink_clear_addr,
+    .get_stats = userlink_get_stats,
+    .get_idle = userlink_get_idle,
+};
+
+static struct channel userlink_channel = {
+    .options = userlink_options,
+    .process_extra_options = NULL,
+    .check_options = NULL,
+    .connect = &userlink_connect,
+    .disconnect = &userlink_disconnect,
+    .establish_ppp = &ppp_generic_establish,
+    .disestablish_ppp = &ppp_generic_disestablish,
+    .send_config = NULL,
+    .recv_config = NULL,
+    .close = &userlink_close,
+    .cleanup = NULL
+};
+
+void plugin_init(void)
+{
+    ppp_add_options(userlink_options);
+}
@@ -34,6 +34,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "crypto-priv.h"
 
@@ -131,6 +132,8 @@ typedef struct {
 	unsigned int buffer[4]; /* Holds 4-word result of MD computation */
 	unsigned char count[8]; /* Number of bits processed so far */
 	unsigned int done;      /* Nonzero means MD computation finished */
+	unsigned char pending[64]; /* Bytes not yet making up a full block */
+	unsigned int npending;
 } MD4_CTX;
 
 
@@ -219,7 +222,7 @@ MDblock(MD4_CTX *MDp, unsigned char *Xb)
   int i;
 
   for (i = 0; i < 16; ++i) {
-    X[i] = Xb[0] + (Xb[1] << 8) + (Xb[2] << 16) + (Xb[3] << 24);
+    X[i] = Xb[0] | (Xb[1] << 8) | (Xb[2] << 16) | ((unsigned int) Xb[3] << 24);
     Xb += 4;
   }
 
@@ -398,26 +401,43 @@ static int md4_init(PPP_MD_CTX *ctx)
 
 static int md4_update(PPP_MD_CTX *ctx, const void *data, size_t len)
 {
-#if defined(__NetBSD__)
-    /* NetBSD uses the libc md4 routines which take bytes instead of bits */
-    int			mdlen = len;
-#else
-    int			mdlen = len * 8;
-#endif
-
-    /* Internal MD4Update can take at most 64 bytes at a time */
-    while (mdlen > 512) {
-        MD4Update((MD4_CTX*) ctx->priv, (unsigned char*) data, 512);
-        data += 64;
-        mdlen -= 512;
+    MD4_CTX *mctx = (MD4_CTX*) ctx->priv;
+    const unsigned char *p = data;
+    size_t n;
+
+    /*
+     * Internal MD4Update takes whole 64 byte blocks until the last one,
+     * so carry any partial block over to the next call.
+     */
+    if (mctx->npending) {
+        n = sizeof(mctx->pending) - mctx->npending;
+        if (n > len)
+            n = len;
+        memcpy(mctx->pending + mctx->npending, p, n);
+        mctx->npending += n;
+        p += n;
+        len -= n;
+        if (mctx->npending < sizeof(mctx->pending))
+            return 1;
+        MD4Update(mctx, mctx->pending, 512);
+        mctx->npending = 0;
     }
-    MD4Update((MD4_CTX*) ctx->priv, (unsigned char*) data, mdlen);
+    while (len >= 64) {
+        MD4Update(mctx, (unsigned char*) p, 512);
+        p += 64;
+        len -= 64;
+    }
+    memcpy(mctx->pending, p, len);
+    mctx->npending = len;
     return 1;
 }
 
 static int md4_final(PPP_MD_CTX *ctx, unsigned char *out, unsigned int *len)
 {
-    MD4Final(out, (MD4_CTX*) ctx->priv);
+    MD4_CTX *mctx = (MD4_CTX*) ctx->priv;
+
+    MD4Update(mctx, mctx->pending, mctx->npending * 8);
+    MD4Final(out, mctx);
     return 1;
 }
 
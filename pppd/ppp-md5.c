@@ -237,20 +237,34 @@ static void MD5_Update (MD5_CTX *mdContext, unsigned char *inBuf, unsigned int i
   mdContext->i[0] += ((UINT4)inLen << 3);
   mdContext->i[1] += ((UINT4)inLen >> 29);
 
-  while (inLen--) {
-    /* add new character to buffer, increment mdi */
-    mdContext->in[mdi++] = *inBuf++;
-
-    /* transform if necessary */
-    if (mdi == 0x40) {
-      for (i = 0, ii = 0; i < 16; i++, ii += 4)
-        in[i] = (((UINT4)mdContext->in[ii+3]) << 24) |
-                (((UINT4)mdContext->in[ii+2]) << 16) |
-                (((UINT4)mdContext->in[ii+1]) << 8) |
-                ((UINT4)mdContext->in[ii]);
-      Transform (mdContext->buf, in);
-      mdi = 0;
+  while (inLen > 0) {
+    const unsigned char *p;
+    unsigned int n;
+
+    if (mdi == 0 && inLen >= 0x40) {
+      /* hash whole blocks straight from the caller's buffer */
+      p = inBuf;
+      n = 0x40;
+    } else {
+      /* add new characters to buffer, transform if it fills up */
+      n = 0x40 - mdi;
+      if (n > inLen)
+        n = inLen;
+      memcpy(&mdContext->in[mdi], inBuf, n);
+      mdi += n;
+      if (mdi < 0x40)
+        break;
+      p = mdContext->in;
     }
+    for (i = 0, ii = 0; i < 16; i++, ii += 4)
+      in[i] = (((UINT4)p[ii+3]) << 24) |
+              (((UINT4)p[ii+2]) << 16) |
+              (((UINT4)p[ii+1]) << 8) |
+              ((UINT4)p[ii]);
+    Transform (mdContext->buf, in);
+    mdi = 0;
+    inBuf += n;
+    inLen -= n;
   }
 }
 
@@ -39,7 +39,6 @@
 #include "crypto-priv.h"
 
 
-/* #define SHA1HANDSOFF * Copies data before messing with it. */
 #ifdef OPENSSL_HAVE_SHA
 #include <openssl/evp.h>
 
@@ -106,8 +105,17 @@ static void sha1_clean(PPP_MD_CTX *ctx)
  * 34AA973C D4C4DAA4 F61EEB2B DBAD2731 6534016F
  */
 
+#include <stdint.h>
 #include <string.h>
-#include <netinet/in.h>	/* htonl() */
+
+#if defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__)) \
+    && (defined(__x86_64__) || defined(__i386__))
+#define SHA1_SHANI
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+typedef void (*SHA1_TRANSFORM)(uint32_t[5], const unsigned char *, size_t);
 
 typedef struct {
     uint32_t state[5];
@@ -116,16 +124,16 @@ typedef struct {
 } SHA1_CTX;
 
 
-static void
-SHA1_Transform(uint32_t[5], const unsigned char[64]);
-
 #define rol(value, bits) (((value) << (bits)) | ((value) >> (32 - (bits))))
 
+#define load32(p) (((uint32_t)(p)[0] << 24) | ((uint32_t)(p)[1] << 16) \
+    | ((uint32_t)(p)[2] << 8) | (uint32_t)(p)[3])
+
 /* blk0() and blk() perform the initial expand. */
 /* I got the idea of expanding during the round function from SSLeay */
-#define blk0(i) (block->l[i] = htonl(block->l[i]))
-#define blk(i) (block->l[i&15] = rol(block->l[(i+13)&15]^block->l[(i+8)&15] \
-    ^block->l[(i+2)&15]^block->l[i&15],1))
+#define blk0(i) (block[i] = load32(buffer + 4 * (i)))
+#define blk(i) (block[i&15] = rol(block[(i+13)&15]^block[(i+8)&15] \
+    ^block[(i+2)&15]^block[i&15],1))
 
 /* (R0+R1), R2, R3, R4 are the different operations used in SHA1 */
 #define R0(v,w,x,y,z,i) z+=((w&(x^y))^y)+blk0(i)+0x5A827999+rol(v,5);w=rol(w,30);
@@ -135,62 +143,197 @@ SHA1_Transform(uint32_t[5], const unsigned char[64]);
 #define R4(v,w,x,y,z,i) z+=(w^x^y)+blk(i)+0xCA62C1D6+rol(v,5);w=rol(w,30);
 
 
-/* Hash a single 512-bit block. This is the core of the algorithm. */
+/* Hash a run of 512-bit blocks. This is the core of the algorithm. */
 
 static void
-SHA1_Transform(uint32_t state[5], const unsigned char buffer[64])
+SHA1_Transform(uint32_t state[5], const unsigned char *buffer, size_t blocks)
 {
     uint32_t a, b, c, d, e;
-    typedef union {
-	unsigned char c[64];
-	uint32_t l[16];
-    } CHAR64LONG16;
-    CHAR64LONG16 *block;
-
-#ifdef SHA1HANDSOFF
-    static unsigned char workspace[64];
-    block = (CHAR64LONG16 *) workspace;
-    memcpy(block, buffer, 64);
-#else
-    block = (CHAR64LONG16 *) buffer;
-#endif
-    /* Copy context->state[] to working vars */
-    a = state[0];
-    b = state[1];
-    c = state[2];
-    d = state[3];
-    e = state[4];
-    /* 4 rounds of 20 operations each. Loop unrolled. */
-    R0(a,b,c,d,e, 0); R0(e,a,b,c,d, 1); R0(d,e,a,b,c, 2); R0(c,d,e,a,b, 3);
-    R0(b,c,d,e,a, 4); R0(a,b,c,d,e, 5); R0(e,a,b,c,d, 6); R0(d,e,a,b,c, 7);
-    R0(c,d,e,a,b, 8); R0(b,c,d,e,a, 9); R0(a,b,c,d,e,10); R0(e,a,b,c,d,11);
-    R0(d,e,a,b,c,12); R0(c,d,e,a,b,13); R0(b,c,d,e,a,14); R0(a,b,c,d,e,15);
-    R1(e,a,b,c,d,16); R1(d,e,a,b,c,17); R1(c,d,e,a,b,18); R1(b,c,d,e,a,19);
-    R2(a,b,c,d,e,20); R2(e,a,b,c,d,21); R2(d,e,a,b,c,22); R2(c,d,e,a,b,23);
-    R2(b,c,d,e,a,24); R2(a,b,c,d,e,25); R2(e,a,b,c,d,26); R2(d,e,a,b,c,27);
-    R2(c,d,e,a,b,28); R2(b,c,d,e,a,29); R2(a,b,c,d,e,30); R2(e,a,b,c,d,31);
-    R2(d,e,a,b,c,32); R2(c,d,e,a,b,33); R2(b,c,d,e,a,34); R2(a,b,c,d,e,35);
-    R2(e,a,b,c,d,36); R2(d,e,a,b,c,37); R2(c,d,e,a,b,38); R2(b,c,d,e,a,39);
-    R3(a,b,c,d,e,40); R3(e,a,b,c,d,41); R3(d,e,a,b,c,42); R3(c,d,e,a,b,43);
-    R3(b,c,d,e,a,44); R3(a,b,c,d,e,45); R3(e,a,b,c,d,46); R3(d,e,a,b,c,47);
-    R3(c,d,e,a,b,48); R3(b,c,d,e,a,49); R3(a,b,c,d,e,50); R3(e,a,b,c,d,51);
-    R3(d,e,a,b,c,52); R3(c,d,e,a,b,53); R3(b,c,d,e,a,54); R3(a,b,c,d,e,55);
-    R3(e,a,b,c,d,56); R3(d,e,a,b,c,57); R3(c,d,e,a,b,58); R3(b,c,d,e,a,59);
-    R4(a,b,c,d,e,60); R4(e,a,b,c,d,61); R4(d,e,a,b,c,62); R4(c,d,e,a,b,63);
-    R4(b,c,d,e,a,64); R4(a,b,c,d,e,65); R4(e,a,b,c,d,66); R4(d,e,a,b,c,67);
-    R4(c,d,e,a,b,68); R4(b,c,d,e,a,69); R4(a,b,c,d,e,70); R4(e,a,b,c,d,71);
-    R4(d,e,a,b,c,72); R4(c,d,e,a,b,73); R4(b,c,d,e,a,74); R4(a,b,c,d,e,75);
-    R4(e,a,b,c,d,76); R4(d,e,a,b,c,77); R4(c,d,e,a,b,78); R4(b,c,d,e,a,79);
-    /* Add the working vars back into context.state[] */
-    state[0] += a;
-    state[1] += b;
-    state[2] += c;
-    state[3] += d;
-    state[4] += e;
+    uint32_t block[16];
+
+    for (; blocks > 0; --blocks, buffer += 64) {
+	/* Copy context->state[] to working vars */
+	a = state[0];
+	b = state[1];
+	c = state[2];
+	d = state[3];
+	e = state[4];
+	/* 4 rounds of 20 operations each. Loop unrolled. */
+	R0(a,b,c,d,e, 0); R0(e,a,b,c,d, 1); R0(d,e,a,b,c, 2); R0(c,d,e,a,b, 3);
+	R0(b,c,d,e,a, 4); R0(a,b,c,d,e, 5); R0(e,a,b,c,d, 6); R0(d,e,a,b,c, 7);
+	R0(c,d,e,a,b, 8); R0(b,c,d,e,a, 9); R0(a,b,c,d,e,10); R0(e,a,b,c,d,11);
+	R0(d,e,a,b,c,12); R0(c,d,e,a,b,13); R0(b,c,d,e,a,14); R0(a,b,c,d,e,15);
+	R1(e,a,b,c,d,16); R1(d,e,a,b,c,17); R1(c,d,e,a,b,18); R1(b,c,d,e,a,19);
+	R2(a,b,c,d,e,20); R2(e,a,b,c,d,21); R2(d,e,a,b,c,22); R2(c,d,e,a,b,23);
+	R2(b,c,d,e,a,24); R2(a,b,c,d,e,25); R2(e,a,b,c,d,26); R2(d,e,a,b,c,27);
+	R2(c,d,e,a,b,28); R2(b,c,d,e,a,29); R2(a,b,c,d,e,30); R2(e,a,b,c,d,31);
+	R2(d,e,a,b,c,32); R2(c,d,e,a,b,33); R2(b,c,d,e,a,34); R2(a,b,c,d,e,35);
+	R2(e,a,b,c,d,36); R2(d,e,a,b,c,37); R2(c,d,e,a,b,38); R2(b,c,d,e,a,39);
+	R3(a,b,c,d,e,40); R3(e,a,b,c,d,41); R3(d,e,a,b,c,42); R3(c,d,e,a,b,43);
+	R3(b,c,d,e,a,44); R3(a,b,c,d,e,45); R3(e,a,b,c,d,46); R3(d,e,a,b,c,47);
+	R3(c,d,e,a,b,48); R3(b,c,d,e,a,49); R3(a,b,c,d,e,50); R3(e,a,b,c,d,51);
+	R3(d,e,a,b,c,52); R3(c,d,e,a,b,53); R3(b,c,d,e,a,54); R3(a,b,c,d,e,55);
+	R3(e,a,b,c,d,56); R3(d,e,a,b,c,57); R3(c,d,e,a,b,58); R3(b,c,d,e,a,59);
+	R4(a,b,c,d,e,60); R4(e,a,b,c,d,61); R4(d,e,a,b,c,62); R4(c,d,e,a,b,63);
+	R4(b,c,d,e,a,64); R4(a,b,c,d,e,65); R4(e,a,b,c,d,66); R4(d,e,a,b,c,67);
+	R4(c,d,e,a,b,68); R4(b,c,d,e,a,69); R4(a,b,c,d,e,70); R4(e,a,b,c,d,71);
+	R4(d,e,a,b,c,72); R4(c,d,e,a,b,73); R4(b,c,d,e,a,74); R4(a,b,c,d,e,75);
+	R4(e,a,b,c,d,76); R4(d,e,a,b,c,77); R4(c,d,e,a,b,78); R4(b,c,d,e,a,79);
+	/* Add the working vars back into context.state[] */
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+    }
     /* Wipe variables */
     a = b = c = d = e = 0;
+    memset(block, 0, sizeof(block));
+}
+
+#ifdef SHA1_SHANI
+
+/*
+ * The same transform using the SHA extensions (SHA-NI) found on
+ * recent x86 processors.  Each group below does four rounds; the
+ * message schedule for later groups is computed alongside.
+ */
+#define SHANI_LOAD(m, i) \
+    m = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(buffer + 16 * (i))), mask)
+#define SHANI_RNDS(en, eo, m, f) \
+    en = _mm_sha1nexte_epu32(en, m); \
+    eo = abcd; \
+    abcd = _mm_sha1rnds4_epu32(abcd, en, f)
+
+__attribute__((target("sha,sse4.1")))
+static void
+SHA1_Transform_shani(uint32_t state[5], const unsigned char *buffer, size_t blocks)
+{
+    __m128i abcd, abcd_save, e0, e0_save, e1;
+    __m128i m0, m1, m2, m3;
+    const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+
+    abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) state), 0x1B);
+    e0 = _mm_set_epi32(state[4], 0, 0, 0);
+
+    for (; blocks > 0; --blocks, buffer += 64) {
+	abcd_save = abcd;
+	e0_save = e0;
+
+	/* Rounds 0-15 */
+	SHANI_LOAD(m0, 0);
+	e0 = _mm_add_epi32(e0, m0);
+	e1 = abcd;
+	abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+	SHANI_LOAD(m1, 1);
+	SHANI_RNDS(e1, e0, m1, 0);
+	m0 = _mm_sha1msg1_epu32(m0, m1);
+	SHANI_LOAD(m2, 2);
+	SHANI_RNDS(e0, e1, m2, 0);
+	m1 = _mm_sha1msg1_epu32(m1, m2);
+	m0 = _mm_xor_si128(m0, m2);
+	SHANI_LOAD(m3, 3);
+	m0 = _mm_sha1msg2_epu32(m0, m3);
+	SHANI_RNDS(e1, e0, m3, 0);
+	m2 = _mm_sha1msg1_epu32(m2, m3);
+	m1 = _mm_xor_si128(m1, m3);
+
+	/* Rounds 16-63 */
+	m1 = _mm_sha1msg2_epu32(m1, m0);
+	SHANI_RNDS(e0, e1, m0, 0);
+	m3 = _mm_sha1msg1_epu32(m3, m0);
+	m2 = _mm_xor_si128(m2, m0);
+	m2 = _mm_sha1msg2_epu32(m2, m1);
+	SHANI_RNDS(e1, e0, m1, 1);
+	m0 = _mm_sha1msg1_epu32(m0, m1);
+	m3 = _mm_xor_si128(m3, m1);
+	m3 = _mm_sha1msg2_epu32(m3, m2);
+	SHANI_RNDS(e0, e1, m2, 1);
+	m1 = _mm_sha1msg1_epu32(m1, m2);
+	m0 = _mm_xor_si128(m0, m2);
+	m0 = _mm_sha1msg2_epu32(m0, m3);
+	SHANI_RNDS(e1, e0, m3, 1);
+	m2 = _mm_sha1msg1_epu32(m2, m3);
+	m1 = _mm_xor_si128(m1, m3);
+	m1 = _mm_sha1msg2_epu32(m1, m0);
+	SHANI_RNDS(e0, e1, m0, 1);
+	m3 = _mm_sha1msg1_epu32(m3, m0);
+	m2 = _mm_xor_si128(m2, m0);
+	m2 = _mm_sha1msg2_epu32(m2, m1);
+	SHANI_RNDS(e1, e0, m1, 1);
+	m0 = _mm_sha1msg1_epu32(m0, m1);
+	m3 = _mm_xor_si128(m3, m1);
+	m3 = _mm_sha1msg2_epu32(m3, m2);
+	SHANI_RNDS(e0, e1, m2, 2);
+	m1 = _mm_sha1msg1_epu32(m1, m2);
+	m0 = _mm_xor_si128(m0, m2);
+	m0 = _mm_sha1msg2_epu32(m0, m3);
+	SHANI_RNDS(e1, e0, m3, 2);
+	m2 = _mm_sha1msg1_epu32(m2, m3);
+	m1 = _mm_xor_si128(m1, m3);
+	m1 = _mm_sha1msg2_epu32(m1, m0);
+	SHANI_RNDS(e0, e1, m0, 2);
+	m3 = _mm_sha1msg1_epu32(m3, m0);
+	m2 = _mm_xor_si128(m2, m0);
+	m2 = _mm_sha1msg2_epu32(m2, m1);
+	SHANI_RNDS(e1, e0, m1, 2);
+	m0 = _mm_sha1msg1_epu32(m0, m1);
+	m3 = _mm_xor_si128(m3, m1);
+	m3 = _mm_sha1msg2_epu32(m3, m2);
+	SHANI_RNDS(e0, e1, m2, 2);
+	m1 = _mm_sha1msg1_epu32(m1, m2);
+	m0 = _mm_xor_si128(m0, m2);
+	m0 = _mm_sha1msg2_epu32(m0, m3);
+	SHANI_RNDS(e1, e0, m3, 3);
+	m2 = _mm_sha1msg1_epu32(m2, m3);
+	m1 = _mm_xor_si128(m1, m3);
+
+	/* Rounds 64-79 */
+	m1 = _mm_sha1msg2_epu32(m1, m0);
+	SHANI_RNDS(e0, e1, m0, 3);
+	m3 = _mm_sha1msg1_epu32(m3, m0);
+	m2 = _mm_xor_si128(m2, m0);
+	m2 = _mm_sha1msg2_epu32(m2, m1);
+	SHANI_RNDS(e1, e0, m1, 3);
+	m3 = _mm_xor_si128(m3, m1);
+	m3 = _mm_sha1msg2_epu32(m3, m2);
+	SHANI_RNDS(e0, e1, m2, 3);
+	SHANI_RNDS(e1, e0, m3, 3);
+
+	/* Add this block's result into the state */
+	e0 = _mm_sha1nexte_epu32(e0, e0_save);
+	abcd = _mm_add_epi32(abcd, abcd_save);
+    }
+
+    _mm_storeu_si128((__m128i *) state, _mm_shuffle_epi32(abcd, 0x1B));
+    state[4] = _mm_extract_epi32(e0, 3);
 }
 
+#endif /* SHA1_SHANI */
+
+/*
+ * Pick the fastest transform this CPU supports.  This is done once,
+ * the first time a SHA-1 context is set up.
+ */
+static SHA1_TRANSFORM
+SHA1_Select(void)
+{
+#ifdef SHA1_SHANI
+    unsigned int eax, ebx, ecx, edx;
+
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)
+	&& (ecx & bit_SSSE3) && (ecx & bit_SSE4_1)
+	&& __get_cpuid_max(0, NULL) >= 7) {
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+	if (ebx & bit_SHA)
+	    return SHA1_Transform_shani;
+    }
+#endif
+    return SHA1_Transform;
+}
+
+static SHA1_TRANSFORM sha1_transform;
+
 
 /* SHA1Init - Initialize new context */
 
@@ -210,24 +353,34 @@ SHA1_Init(SHA1_CTX *context)
 /* Run your data through this. */
 
 static void
-SHA1_Update(SHA1_CTX *context, const unsigned char *data, unsigned int len)
+SHA1_Update(SHA1_CTX *context, const unsigned char *data, size_t len)
 {
-    unsigned int i, j;
+    size_t i, j;
 
     j = (context->count[0] >> 3) & 63;
-    if ((context->count[0] += len << 3) < (len << 3)) context->count[1]++;
-    context->count[1] += (len >> 29);
-    i = 64 - j;
-    while (len >= i) {
+    if ((context->count[0] += (uint32_t) len << 3) < ((uint32_t) len << 3))
+	context->count[1]++;
+    context->count[1] += (uint32_t) ((uint64_t) len >> 29);
+    if (j > 0) {
+	i = 64 - j;
+	if (len < i) {
+	    memcpy(&context->buffer[j], data, len);
+	    return;
+	}
 	memcpy(&context->buffer[j], data, i);
-	SHA1_Transform(context->state, context->buffer);
+	sha1_transform(context->state, context->buffer, 1);
 	data += i;
 	len -= i;
-	i = 64;
-	j = 0;
     }
 
-    memcpy(&context->buffer[j], data, len);
+    /* Whole blocks are hashed straight from the caller's buffer */
+    if (len >= 64) {
+	sha1_transform(context->state, data, len / 64);
+	data += len & ~(size_t) 63;
+	len &= 63;
+    }
+
+    memcpy(context->buffer, data, len);
 }
 
 
@@ -237,17 +390,21 @@ static void
 SHA1_Final(unsigned char digest[20], SHA1_CTX *context)
 {
     uint32_t i, j;
-    unsigned char finalcount[8];
 
+    /* Append the 1 bit, zeros, and the bit count (big endian) */
+    j = (context->count[0] >> 3) & 63;
+    context->buffer[j++] = 0x80;
+    if (j > 56) {
+	memset(&context->buffer[j], 0, 64 - j);
+	sha1_transform(context->state, context->buffer, 1);
+	j = 0;
+    }
+    memset(&context->buffer[j], 0, 56 - j);
     for (i = 0; i < 8; i++) {
-        finalcount[i] = (unsigned char)((context->count[(i >= 4 ? 0 : 1)]
+        context->buffer[56 + i] = (unsigned char)((context->count[(i >= 4 ? 0 : 1)]
          >> ((3-(i & 3)) * 8) ) & 255);  /* Endian independent */
     }
-    SHA1_Update(context, (unsigned char *) "\200", 1);
-    while ((context->count[0] & 504) != 448) {
-	SHA1_Update(context, (unsigned char *) "\0", 1);
-    }
-    SHA1_Update(context, finalcount, 8);  /* Should cause a SHA1Transform() */
+    sha1_transform(context->state, context->buffer, 1);
     for (i = 0; i < 20; i++) {
 	digest[i] = (unsigned char)
 		     ((context->state[i>>2] >> ((3-(i & 3)) * 8) ) & 255);
@@ -257,10 +414,6 @@ SHA1_Final(unsigned char digest[20], SHA1_CTX *context)
     memset(context->buffer, 0, 64);
     memset(context->state, 0, 20);
     memset(context->count, 0, 8);
-    memset(&finalcount, 0, 8);
-#ifdef SHA1HANDSOFF  /* make SHA1Transform overwrite it's own static vars */
-    SHA1Transform(context->state, context->buffer);
-#endif
 }
 
 static int sha1_init(PPP_MD_CTX *ctx)
@@ -268,6 +421,8 @@ static int sha1_init(PPP_MD_CTX *ctx)
     if (ctx) {
         SHA1_CTX *mctx = calloc(1, sizeof(SHA1_CTX));
         if (mctx) {
+            if (!sha1_transform)
+                sha1_transform = SHA1_Select();
             SHA1_Init(mctx);
             ctx->priv = mctx;
             return 1;
@@ -278,7 +433,7 @@ static int sha1_init(PPP_MD_CTX *ctx)
 
 static int sha1_update(PPP_MD_CTX* ctx, const void *data, size_t len)
 {
-    SHA1_Update((SHA1_CTX*) ctx->priv, (void*) data, len);
+    SHA1_Update((SHA1_CTX*) ctx->priv, data, len);
     return 1;
 }
 
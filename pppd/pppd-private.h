@@ -112,6 +112,8 @@ extern GIDSET_TYPE groups[];	/* groups the user is in */
 extern int	ngroups;	/* How many groups valid in groups */
 extern int	link_stats_valid; /* set if link_stats is valid */
 extern int	link_stats_print; /* set if link_stats is to be printed on link termination */
+extern struct pppd_stats chan_stats; /* frames pppd sent and received itself
+				   on the channel, unseen by the unit */
 extern int	log_to_fd;	/* logging to this fd as well as syslog */
 extern bool	log_default;	/* log_to_fd is default (stdout) */
 extern char	*no_ppp_msg;	/* message to print if ppp not in kernel */
@@ -138,6 +140,7 @@ extern struct notifier *ipv6_down_notifier; /* IPV6CP has gone down */
 extern struct notifier *auth_up_notifier; /* peer has authenticated */
 extern struct notifier *link_down_notifier; /* link has gone down */
 extern struct notifier *fork_notifier;	/* we are a new child process */
+extern struct notifier *lcp_up_notifier; /* LCP has come up */
 
 
 /* Values for do_callback and doing_callback */
@@ -215,6 +218,8 @@ extern bool	dump_options;	/* print out option values */
 extern bool	show_options;	/* show all option names and descriptions */
 extern bool	dryrun;		/* check everything, print options, exit */
 extern int	child_wait;	/* # seconds to wait for children at end */
+extern char	*control_path;	/* unix socket for control requests */
+extern int	stats_max_age;	/* ms for which link counters are reused */
 extern char *current_option;    /* the name of the option being parsed */
 extern int  privileged_option;  /* set iff the current option came from root */
 extern char *option_source;     /* string saying where the option came from */
@@ -243,6 +248,7 @@ extern char *tls_verify_method;
 
 #ifdef PPP_WITH_EAPTLS
 extern char *pkcs12_file;
+extern char *tls_ticket_keys;
 #endif /* PPP_WITH_EAPTLS */
 
 typedef enum {
@@ -319,8 +325,13 @@ pid_t run_program(char *prog, char * const * args, int must_exist,
 void reopen_log(void);	/* (re)open the connection to syslog */
 void print_link_stats(void); /* Print stats, if available */
 void reset_link_stats(int); /* Reset (init) stats when link goes up */
+bool get_link_counters(int, ppp_link_stats_st *, unsigned int *);
+				/* Counters and seconds since link went up */
+void count_chan_frame(unsigned char *, int, int);
+				/* Add a frame to chan_stats if need be */
 void new_phase(ppp_phase_t);	/* signal start of new phase */
 bool in_phase(ppp_phase_t);
+ppp_phase_t ppp_get_phase(void);	/* where the link is at */
 void notify(struct notifier *, int);
 int  ppp_send_config(int, int, u_int32_t, int, int);
 int  ppp_recv_config(int, int, u_int32_t, int, int);
@@ -328,6 +339,13 @@ const char *protocol_name(int);
 void remove_pidfiles(void);
 void lock_db(void);
 void unlock_db(void);
+void ppp_timer_walk(void (*)(void *, void (*)(void *), void *, long),
+		    void *);	/* list pending timeouts */
+
+/* Procedures exported from control.c. */
+void control_init(void);	/* open the control socket */
+void control_cleanup(void);	/* close and remove it */
+void control_forked(void);	/* let go of it in a child */
 
 /* Procedures exported from tty.c. */
 void tty_init(void);
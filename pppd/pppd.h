@@ -130,6 +130,7 @@ typedef enum
     NF_AUTH_UP,
     NF_LINK_DOWN,
     NF_FORK,
+    NF_LCP_UP,
     NF_MAX_NOTIFY
 } ppp_notify_t;
 
@@ -153,6 +154,10 @@ struct pppd_stats
     uint64_t		bytes_out;
     unsigned int	pkts_in;
     unsigned int	pkts_out;
+    unsigned int	errors_in;	/* 0 where the system doesn't count */
+    unsigned int	errors_out;
+    unsigned int	dropped_in;
+    unsigned int	dropped_out;
 };
 typedef struct pppd_stats ppp_link_stats_st;
 
@@ -393,6 +398,17 @@ int ppp_get_session_number(void);
  */
 bool ppp_signaled(int sig);
 
+/*
+ * Called in a child which a plugin forked before the link was started,
+ * and which is to carry on as a pppd in its own right.
+ */
+void ppp_forked(void);
+
+/*
+ * Get the path of the control socket, or NULL if there is none
+ */
+const char *ppp_control_path(void);
+
 /*
  * Maximum connect time in seconds
  */
@@ -540,6 +556,74 @@ void ppp_add_notify(ppp_notify_t type, ppp_notify_fn *func, void *ctx);
  */
 void ppp_del_notify(ppp_notify_t type, ppp_notify_fn *func, void *ctx);
 
+/*
+ * State events: a versioned, in-process alternative to the ip-up,
+ * ip-down, ipv6-up, ipv6-down, auth-up and link-down scripts.  The
+ * events are delivered through the notifier lists above, before the
+ * corresponding script is run, with the values a script would get
+ * from its arguments and environment already filled in.
+ *
+ * New fields are only ever added at the end of struct ppp_state_event,
+ * and PPP_STATE_EVENT_VERSION is bumped when they are.  A handler
+ * registers with the version it was built against, and may use any
+ * field that existed in that version.
+ */
+#define PPP_STATE_EVENT_VERSION	2
+
+typedef enum
+{
+    PPP_EV_AUTH_UP,
+    PPP_EV_IP_UP,
+    PPP_EV_IP_DOWN,
+    PPP_EV_IPV6_UP,
+    PPP_EV_IPV6_DOWN,
+    PPP_EV_LINK_DOWN,
+    PPP_EV_LCP_UP,		/* version 2 */
+    PPP_EV_MAX
+} ppp_state_event_t;
+
+struct ppp_state_event
+{
+    int			version;	/* PPP_STATE_EVENT_VERSION */
+    ppp_state_event_t	type;
+    int			unit;		/* ppp unit number */
+    const char		*ifname;	/* e.g. ppp0 */
+    const char		*devnam;	/* e.g. /dev/ttyS0 */
+    const char		*peer_authname;	/* "" if the peer didn't authenticate */
+    const char		*remote_number;	/* "" if not known */
+    uint32_t		ouraddr;	/* IP events: local address, */
+    uint32_t		hisaddr;	/* and remote address, network order */
+    uint8_t		ourid[8];	/* IPv6 events: local interface id, */
+    uint8_t		hisid[8];	/* and remote interface id */
+    const ppp_link_stats_st *stats;	/* down events: NULL if not available */
+    /* version 2 */
+    int			mtu;		/* LCP up: MRU the peer asked for, */
+    int			mru;		/* and the one it agreed to */
+    uint32_t		send_accm;	/* asyncmap we send with, */
+    uint32_t		recv_accm;	/* and the one the peer sends with */
+};
+
+/*
+ * Definition for the state event callback function
+ *   ctx - contextual argument provided with the registration
+ *   ev  - the event, only valid for the duration of the call
+ */
+typedef void (ppp_state_event_fn)(void *ctx, const struct ppp_state_event *ev);
+
+/*
+ * Add a handler for state events.  Returns -1 if pppd doesn't support
+ * the requested version of the API.  Event types added in a later
+ * version than the handler's are not passed to it.  A handler may
+ * remove itself while it is being called, e.g. once it has seen the
+ * one event it was waiting for.
+ */
+int ppp_add_state_handler(int version, ppp_state_event_fn *func, void *ctx);
+
+/*
+ * Remove a handler previously added
+ */
+void ppp_del_state_handler(ppp_state_event_fn *func, void *ctx);
+
 /*
  * Get the path prefix in which a file is installed
  */
@@ -567,6 +651,44 @@ extern int  (*allowed_address_hook)(uint32_t addr);
 extern void (*snoop_recv_hook)(unsigned char *p, int len);
 extern void (*snoop_send_hook)(unsigned char *p, int len);
 
+/*
+ * Operations a plugin can supply to stand in for the kernel PPP driver
+ * and network interface, e.g. to run pppd entirely in userspace for
+ * testing.  When sys_ops_hook is set, the Linux system layer calls these
+ * instead of touching /dev/ppp, and demand and multilink are refused.
+ * A channel using them should use ppp_generic_establish and
+ * ppp_generic_disestablish, which then just hand back the channel fd.
+ *
+ * output and read_packet are required.  Frames include the 4-byte
+ * address/control/protocol header; read_packet returns the length,
+ * 0 on end of file, or -1 with errno set if there is nothing to read.
+ * Any other entry may be NULL: set operations then succeed without
+ * doing anything and queries report that nothing is available.
+ * Unless noted, the int functions return 1 for success, 0 for failure.
+ */
+struct ppp_sys_ops {
+    void (*output)(unsigned char *p, int len);
+    int  (*read_packet)(unsigned char *buf, int len);
+    void (*set_mtu)(int mtu);
+    int  (*get_mtu)(void);
+    int  (*set_ifstate)(int up);
+    int  (*set_npmode)(int proto, int mode);
+    int  (*set_vjcomp)(int vjcomp, int cidcomp, int maxcid);
+    int  (*set_addr)(uint32_t ouraddr, uint32_t hisaddr, uint32_t netmask);
+    int  (*clear_addr)(uint32_t ouraddr, uint32_t hisaddr);
+    int  (*set_addr6)(const uint8_t *ourid, const uint8_t *hisid);
+    int  (*clear_addr6)(const uint8_t *ourid, const uint8_t *hisid);
+    int  (*default_route)(int family, int add);
+    int  (*proxy_arp)(uint32_t hisaddr, int add);
+    /* 1 if acceptable, 0 if not, -1 on error, like ccp_test */
+    int  (*ccp_test)(unsigned char *opt, int len, int for_transmit);
+    void (*ccp_flags)(int isopen, int isup);
+    int  (*ccp_fatal_error)(void);
+    int  (*get_stats)(ppp_link_stats_st *stats);
+    int  (*get_idle)(struct ppp_idle *ip);
+};
+extern const struct ppp_sys_ops *sys_ops_hook;
+
 /* mechanism to setup event handlers */
 typedef void (*event_cb)(int fd, void* ctx); /* callback signature */
 void add_fd_callback(int, event_cb, void*); /* add fd with callback */
@@ -576,6 +698,15 @@ void remove_fd(int);	/* Remove fd from set to wait for */
 int sifaddroute(int family, const void* prefix, uint8_t len, unsigned metric);
 int sifdelroute(int family, const void* prefix, uint8_t len, unsigned metric);
 
+/* batched route management, result is set to 1 for each route that succeeded */
+struct ppp_route_req {
+    const void* prefix;
+    uint8_t len;
+    int result;
+};
+int sifaddroutes(int family, struct ppp_route_req *routes, int count, unsigned metric);
+int sifdelroutes(int family, struct ppp_route_req *routes, int count, unsigned metric);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,205 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*
+ * state-event.c - in-process delivery of state changes to plugins,
+ * as an alternative to running the ip-up etc. scripts.
+ *
+ * Copyright (c) 2026 The pppd Project. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THE AUTHORS OF THIS SOFTWARE DISCLAIM ALL WARRANTIES WITH REGARD TO
+ * THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+ * AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "pppd-private.h"
+#include "fsm.h"
+#include "lcp.h"
+#include "ipcp.h"
+#ifdef PPP_WITH_IPV6CP
+#include "eui64.h"
+#include "ipv6cp.h"
+#endif
+
+struct state_handler {
+    struct state_handler *next;
+    ppp_state_event_fn *func;
+    void *ctx;
+    int version;
+};
+
+static struct state_handler *state_handlers;
+
+/*
+ * The notifier each event is delivered from.
+ */
+static const ppp_notify_t state_notify_type[PPP_EV_MAX] = {
+    [PPP_EV_AUTH_UP   ] = NF_AUTH_UP,
+    [PPP_EV_IP_UP     ] = NF_IP_UP,
+    [PPP_EV_IP_DOWN   ] = NF_IP_DOWN,
+    [PPP_EV_IPV6_UP   ] = NF_IPV6_UP,
+    [PPP_EV_IPV6_DOWN ] = NF_IPV6_DOWN,
+    [PPP_EV_LINK_DOWN ] = NF_LINK_DOWN,
+    [PPP_EV_LCP_UP    ] = NF_LCP_UP,
+};
+
+/*
+ * The API version each event first appeared in, if later than 1.
+ */
+static const int state_event_version[PPP_EV_MAX] = {
+    [PPP_EV_LCP_UP    ] = 2,
+};
+
+/*
+ * state_notify - notifier callback; builds the event for the state
+ * change and passes it to each handler in turn.
+ */
+static void
+state_notify(void *ctx, int arg)
+{
+    struct state_handler *sh, *next;
+    struct ppp_state_event ev;
+    ppp_link_stats_st stats;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.version = PPP_STATE_EVENT_VERSION;
+    ev.type = (ppp_state_event_t) (intptr_t) ctx;
+    ev.unit = ifunit;
+    ev.ifname = ifname;
+    ev.devnam = devnam;
+    ev.peer_authname = peer_authname;
+    ev.remote_number = remote_number;
+
+    switch (ev.type) {
+    case PPP_EV_IP_UP:
+    case PPP_EV_IP_DOWN:
+	ev.ouraddr = ipcp_gotoptions[0].ouraddr;
+	ev.hisaddr = ipcp_hisoptions[0].hisaddr;
+	break;
+#ifdef PPP_WITH_IPV6CP
+    case PPP_EV_IPV6_UP:
+    case PPP_EV_IPV6_DOWN:
+	memcpy(ev.ourid, &ipv6cp_gotoptions[0].ourid, sizeof(ev.ourid));
+	memcpy(ev.hisid, &ipv6cp_hisoptions[0].hisid, sizeof(ev.hisid));
+	break;
+#endif
+    case PPP_EV_LCP_UP:
+	ev.mtu = lcp_hisoptions[0].neg_mru? lcp_hisoptions[0].mru: PPP_MRU;
+	ev.mru = lcp_gotoptions[0].neg_mru? lcp_gotoptions[0].mru: PPP_MRU;
+	ev.send_accm = lcp_hisoptions[0].neg_asyncmap?
+	    lcp_hisoptions[0].asyncmap: 0xffffffff;
+	ev.recv_accm = lcp_gotoptions[0].neg_asyncmap?
+	    lcp_gotoptions[0].asyncmap: 0xffffffff;
+	break;
+    default:
+	break;
+    }
+
+    switch (ev.type) {
+    case PPP_EV_IP_DOWN:
+    case PPP_EV_IPV6_DOWN:
+    case PPP_EV_LINK_DOWN:
+	if (ppp_get_link_stats(&stats))
+	    ev.stats = &stats;
+	break;
+    default:
+	break;
+    }
+
+    for (sh = state_handlers; sh != NULL; sh = next) {
+	next = sh->next;
+	if (sh->version >= state_event_version[ev.type])
+	    (*sh->func)(sh->ctx, &ev);
+    }
+}
+
+/*
+ * ppp_add_state_handler - add a function to be called with each
+ * state event.  The notifiers are hooked when the first handler is
+ * added.
+ */
+int
+ppp_add_state_handler(int version, ppp_state_event_fn *func, void *ctx)
+{
+    struct state_handler *sh, **shp;
+    int i;
+
+    if (version < 1 || version > PPP_STATE_EVENT_VERSION) {
+	error("State event API version %d is not supported", version);
+	return -1;
+    }
+
+    sh = malloc(sizeof(*sh));
+    if (sh == NULL)
+	novm("state event handler");
+    sh->next = NULL;
+    sh->func = func;
+    sh->ctx = ctx;
+    sh->version = version;
+
+    if (state_handlers == NULL) {
+	for (i = 0; i < PPP_EV_MAX; ++i) {
+#ifndef PPP_WITH_IPV6CP
+	    if (i == PPP_EV_IPV6_UP || i == PPP_EV_IPV6_DOWN)
+		continue;
+#endif
+	    ppp_add_notify(state_notify_type[i], state_notify,
+			   (void *) (intptr_t) i);
+	}
+    }
+
+    /* handlers are called in the order they were added */
+    for (shp = &state_handlers; *shp != NULL; shp = &(*shp)->next)
+	;
+    *shp = sh;
+    return 0;
+}
+
+/*
+ * ppp_del_state_handler - remove a handler added with
+ * ppp_add_state_handler.
+ */
+void
+ppp_del_state_handler(ppp_state_event_fn *func, void *ctx)
+{
+    struct state_handler *sh, **shp;
+    int i;
+
+    for (shp = &state_handlers; (sh = *shp) != NULL; shp = &sh->next) {
+	if (sh->func == func && sh->ctx == ctx) {
+	    *shp = sh->next;
+	    free(sh);
+	    break;
+	}
+    }
+
+    if (state_handlers == NULL) {
+	for (i = 0; i < PPP_EV_MAX; ++i) {
+#ifndef PPP_WITH_IPV6CP
+	    if (i == PPP_EV_IPV6_UP || i == PPP_EV_IPV6_DOWN)
+		continue;
+#endif
+	    ppp_del_notify(state_notify_type[i], state_notify,
+			   (void *) (intptr_t) i);
+	}
+    }
+}
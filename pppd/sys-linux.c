@@ -628,6 +628,19 @@ int ppp_generic_establish (int fd)
 {
     int x;
 
+    if (sys_ops_hook) {
+	/*
+	 * No kernel unit: the channel fd carries the frames and the
+	 * unit number only names the interface, so default it to our
+	 * pid to keep concurrent instances apart.
+	 */
+	ifunit = (req_unit >= 0)? req_unit: getpid();
+	x = fcntl(fd, F_GETFL);
+	if (x == -1 || fcntl(fd, F_SETFL, x | O_NONBLOCK) == -1)
+	    warn("Couldn't set channel to nonblock: %m");
+	return fd;
+    }
+
     if (new_style_driver) {
 	int flags;
 
@@ -772,6 +785,8 @@ flushfailed:
  */
 void ppp_generic_disestablish(int dev_fd)
 {
+    if (sys_ops_hook)
+	return;
     if (new_style_driver) {
 	close(ppp_fd);
 	ppp_fd = -1;
@@ -1535,6 +1550,11 @@ void output (int unit, unsigned char *p, int len)
 
     if (len < PPP_HDRLEN)
 	return;
+    count_chan_frame(p, len, 1);
+    if (sys_ops_hook) {
+	(*sys_ops_hook->output)(p, len);
+	return;
+    }
     if (new_style_driver) {
 	p += 2;
 	len -= 2;
@@ -1562,6 +1582,8 @@ int read_packet (unsigned char *buf)
     int len, nr;
 
     len = PPP_MRU + PPP_HDRLEN;
+    if (sys_ops_hook)
+	return (*sys_ops_hook->read_packet)(buf, len);
     if (new_style_driver) {
 	*buf++ = PPP_ALLSTATIONS;
 	*buf++ = PPP_UI;
@@ -1634,6 +1656,12 @@ ppp_set_mtu(int unit, int mtu)
 {
     struct ifreq ifr;
 
+    if (sys_ops_hook) {
+	if (sys_ops_hook->set_mtu)
+	    (*sys_ops_hook->set_mtu)(mtu);
+	return;
+    }
+
     memset (&ifr, '\0', sizeof (ifr));
     strlcpy(ifr.ifr_name, ifname, sizeof (ifr.ifr_name));
     ifr.ifr_mtu = mtu;
@@ -1650,6 +1678,9 @@ ppp_get_mtu(int unit)
 {
     struct ifreq ifr;
 
+    if (sys_ops_hook)
+	return sys_ops_hook->get_mtu? (*sys_ops_hook->get_mtu)(): 0;
+
     memset (&ifr, '\0', sizeof (ifr));
     strlcpy(ifr.ifr_name, ifname, sizeof (ifr.ifr_name));
 
@@ -1742,6 +1773,10 @@ ccp_test(int unit, u_char *opt_ptr, int opt_len, int for_transmit)
 {
     struct ppp_option_data data;
 
+    if (sys_ops_hook)
+	return sys_ops_hook->ccp_test?
+	    (*sys_ops_hook->ccp_test)(opt_ptr, opt_len, for_transmit): 0;
+
     memset (&data, '\0', sizeof (data));
     data.ptr      = opt_ptr;
     data.length   = opt_len;
@@ -1762,6 +1797,11 @@ void ccp_flags_set (int unit, int isopen, int isup)
 {
 	int x;
 
+	if (sys_ops_hook) {
+		if (sys_ops_hook->ccp_flags)
+			(*sys_ops_hook->ccp_flags)(isopen, isup);
+		return;
+	}
 	x = (isopen? SC_CCP_OPEN: 0) | (isup? SC_CCP_UP: 0);
 	if (still_ppp() && ppp_dev_fd >= 0)
 		modify_flags(ppp_dev_fd, SC_CCP_OPEN|SC_CCP_UP, x);
@@ -1775,6 +1815,10 @@ int set_filters(struct bpf_program *pass, struct bpf_program *active)
 {
 	struct sock_fprog fp;
 
+	if (sys_ops_hook) {
+		warn("packet filters are not supported by this system layer");
+		return 1;
+	}
 	fp.len = pass->bf_len;
 	fp.filter = (struct sock_filter *) pass->bf_insns;
 	if (ioctl(ppp_dev_fd, PPPIOCSPASS, &fp) < 0) {
@@ -1801,6 +1845,8 @@ int set_filters(struct bpf_program *pass, struct bpf_program *active)
 int
 get_idle_time(int u, struct ppp_idle *ip)
 {
+    if (sys_ops_hook)
+	return sys_ops_hook->get_idle? (*sys_ops_hook->get_idle)(ip): 0;
     return ioctl(ppp_dev_fd, PPPIOCGIDLE, ip) >= 0;
 }
 
@@ -1832,6 +1878,8 @@ get_ppp_stats_ioctl(int u, struct pppd_stats *stats)
     stats->bytes_out = data.p.ppp_obytes;
     stats->pkts_in = data.p.ppp_ipackets;
     stats->pkts_out = data.p.ppp_opackets;
+    stats->errors_in = data.p.ppp_ierrors;
+    stats->errors_out = data.p.ppp_oerrors;
 
     if (stats->bytes_in < previbytes)
 	++iwraps;
@@ -1869,6 +1917,10 @@ get_ppp_stats_rtnetlink(int u, struct pppd_stats *stats)
             uint64_t tx_packets;
             uint64_t rx_bytes;
             uint64_t tx_bytes;
+            uint64_t rx_errors;
+            uint64_t tx_errors;
+            uint64_t rx_dropped;
+            uint64_t tx_dropped;
         } stats;
     } nlresp_data;
     size_t nlresp_size;
@@ -1899,6 +1951,10 @@ get_ppp_stats_rtnetlink(int u, struct pppd_stats *stats)
     stats->bytes_out = nlresp_data.stats.tx_bytes;
     stats->pkts_in   = nlresp_data.stats.rx_packets;
     stats->pkts_out  = nlresp_data.stats.tx_packets;
+    stats->errors_in   = nlresp_data.stats.rx_errors;
+    stats->errors_out  = nlresp_data.stats.tx_errors;
+    stats->dropped_in  = nlresp_data.stats.rx_dropped;
+    stats->dropped_out = nlresp_data.stats.tx_dropped;
 
     return 1;
 err:
@@ -1910,52 +1966,76 @@ err:
 
 /********************************************************************
  * get_ppp_stats_sysfs - return statistics for the link, using the files in sysfs,
- * this provides native 64-bit counters.
+ * this provides native 64-bit counters.  The files are kept open, so
+ * that each reading is one pread per counter, and are opened again if
+ * the interface is renamed or goes away.
  */
-static int
-get_ppp_stats_sysfs(int u, struct pppd_stats *stats)
-{
-    char fname[PATH_MAX+1];
-    char buf[21], *err; /* 2^64 < 10^20 */
-    int blen, fd, rlen;
-    unsigned long long val;
-
-    struct {
-	const char* fname;
-	void* ptr;
-	unsigned size;
-    } slist[] = {
-#define statfield(fn, field)	{ .fname = #fn, .ptr = &stats->field, .size = sizeof(stats->field) }
-	statfield(rx_bytes, bytes_in),
-	statfield(tx_bytes, bytes_out),
-	statfield(rx_packets, pkts_in),
-	statfield(tx_packets, pkts_out),
+static const struct {
+    const char *fname;
+    size_t off;
+    unsigned size;
+} sysfs_stat_files[] = {
+#define statfield(fn, field)	{ #fn, offsetof(struct pppd_stats, field), \
+				  sizeof(((struct pppd_stats *)0)->field) }
+    statfield(rx_bytes, bytes_in),
+    statfield(tx_bytes, bytes_out),
+    statfield(rx_packets, pkts_in),
+    statfield(tx_packets, pkts_out),
+    statfield(rx_errors, errors_in),
+    statfield(tx_errors, errors_out),
+    statfield(rx_dropped, dropped_in),
+    statfield(tx_dropped, dropped_out),
 #undef statfield
-    };
+};
+#define N_SYSFS_STATS	(sizeof(sysfs_stat_files) / sizeof(sysfs_stat_files[0]))
 
-    blen = snprintf(fname, sizeof(fname), "/sys/class/net/%s/statistics/", ifname);
-    if (blen >= sizeof(fname))
-	return 0; /* ifname max 15, so this should be impossible */
+static int sysfs_stat_fds[N_SYSFS_STATS];
+static char sysfs_stat_ifname[IFNAMSIZ];	/* "" if the files aren't open */
 
-    for (int i = 0; i < sizeof(slist) / sizeof(*slist); ++i) {
-	if (snprintf(fname + blen, sizeof(fname) - blen, "%s", slist[i].fname) >= sizeof(fname) - blen) {
-	    fname[blen] = 0;
-	    error("sysfs stats: filename %s/%s overflowed PATH_MAX", fname, slist[i].fname);
-	    return 0;
-	}
+/* Close the first n of the files */
+static void
+sysfs_stats_close(int n)
+{
+    for (int i = 0; i < n; ++i)
+	close(sysfs_stat_fds[i]);
+    sysfs_stat_ifname[0] = 0;
+}
 
-	fd = open(fname, O_RDONLY);
-	if (fd < 0) {
+static int
+sysfs_stats_open(void)
+{
+    char fname[PATH_MAX+1];
+
+    for (int i = 0; i < N_SYSFS_STATS; ++i) {
+	slprintf(fname, sizeof(fname), "/sys/class/net/%s/statistics/%s",
+		 ifname, sysfs_stat_files[i].fname);
+	sysfs_stat_fds[i] = open(fname, O_RDONLY | O_CLOEXEC);
+	if (sysfs_stat_fds[i] < 0) {
 	    error("%s: %m", fname);
+	    sysfs_stats_close(i);
 	    return 0;
 	}
+    }
+    strlcpy(sysfs_stat_ifname, ifname, sizeof(sysfs_stat_ifname));
+    return 1;
+}
 
-	rlen = read(fd, buf, sizeof(buf) - 1);
-	close(fd);
-	if (rlen < 0) {
-	    error("%s: %m", fname);
+/*
+ * sysfs_stats_read - read the open files.  Returns 1 if all went
+ * well, 0 if a read failed, or -1 if what was read made no sense.
+ */
+static int
+sysfs_stats_read(struct pppd_stats *stats)
+{
+    char buf[21], *err; /* 2^64 < 10^20 */
+    int rlen;
+    unsigned long long val;
+    void *ptr;
+
+    for (int i = 0; i < N_SYSFS_STATS; ++i) {
+	rlen = pread(sysfs_stat_fds[i], buf, sizeof(buf) - 1, 0);
+	if (rlen < 0)
 	    return 0;
-	}
 	/* trim trailing \n if present */
 	while (rlen > 0 && buf[rlen-1] == '\n')
 	    rlen--;
@@ -1965,25 +2045,48 @@ get_ppp_stats_sysfs(int u, struct pppd_stats *stats)
 	val = strtoull(buf, &err, 10);
 	if (*buf < '0' || *buf > '9' || errno != 0 || *err) {
 	    error("string to number conversion error converting %s (from %s) for remaining string %s%s%s",
-		    buf, fname, err, errno ? ": " : "", errno ? strerror(errno) : "");
-	    return 0;
+		    buf, sysfs_stat_files[i].fname, err, errno ? ": " : "", errno ? strerror(errno) : "");
+	    return -1;
 	}
-	switch (slist[i].size) {
-#define stattype(type)	case sizeof(type): *(type*)slist[i].ptr = (type)val; break
+	ptr = (char *)stats + sysfs_stat_files[i].off;
+	switch (sysfs_stat_files[i].size) {
+#define stattype(type)	case sizeof(type): *(type*)ptr = (type)val; break
 	    stattype(uint64_t);
 	    stattype(uint32_t);
 	    stattype(uint16_t);
 	    stattype(uint8_t);
 #undef stattype
 	default:
-	    error("Don't know how to store stats for %s of size %u", slist[i].fname, slist[i].size);
-	    return 0;
+	    error("Don't know how to store stats for %s of size %u", sysfs_stat_files[i].fname, sysfs_stat_files[i].size);
+	    return -1;
 	}
     }
 
     return 1;
 }
 
+static int
+get_ppp_stats_sysfs(int u, struct pppd_stats *stats)
+{
+    int r;
+
+    if (sysfs_stat_ifname[0] != 0 && strcmp(sysfs_stat_ifname, ifname) != 0)
+	sysfs_stats_close(N_SYSFS_STATS);
+    if (sysfs_stat_ifname[0] == 0 && !sysfs_stats_open())
+	return 0;
+    r = sysfs_stats_read(stats);
+    if (r == 0) {
+	/* the interface may have been replaced by one of the same name */
+	sysfs_stats_close(N_SYSFS_STATS);
+	if (!sysfs_stats_open())
+	    return 0;
+	r = sysfs_stats_read(stats);
+	if (r == 0)
+	    error("sysfs stats for %s: %m", ifname);
+    }
+    return r > 0;
+}
+
 /********************************************************************
  * Periodic timer function to be used to keep stats up to date in case of ioctl
  * polling.
@@ -2007,6 +2110,9 @@ int get_ppp_stats(int u, struct pppd_stats *stats)
 {
     static int (*func)(int, struct pppd_stats*) = NULL;
 
+    memset(stats, 0, sizeof(*stats));
+    if (sys_ops_hook)
+	return sys_ops_hook->get_stats? (*sys_ops_hook->get_stats)(stats): 0;
     if (!func) {
 	if (kernel_version < KVERSION(3, 8, 0)) {
 	    /* In kernel versions prior to 3.8 pppstat in kernel was
@@ -2044,6 +2150,9 @@ int ccp_fatal_error (int unit)
 {
 	int flags;
 
+	if (sys_ops_hook)
+		return sys_ops_hook->ccp_fatal_error?
+			(*sys_ops_hook->ccp_fatal_error)(): 0;
 	if (ioctl(ppp_dev_fd, PPPIOCGFLAGS, &flags) < 0) {
 		error("Couldn't read compression error flags: %m");
 		flags = 0;
@@ -2240,57 +2349,60 @@ int have_route_to(u_int32_t addr)
  *
  * Try using netlink to add/remove routes.
  */
+struct route_nlreq {
+    struct nlmsghdr nlh;
+    struct rtmsg rtmsg;
+    struct {
+	struct rtattr rta;
+	unsigned ind;
+    } oif;
+    struct {
+	struct rtattr rta;
+	unsigned val;
+    } metric;
+    struct {
+	struct rtattr rta;
+	unsigned id;
+    } table;
+    struct {
+	struct rtattr rta;
+	unsigned char ipdata[16]; /* IPv6 MAX */
+    } prefix;
+};
+
+/*
+ * route_netlink_fill - build a RTM_NEWROUTE/RTM_DELROUTE request,
+ * returns the length of the message, or 0 on error.
+ */
 static
-int _route_netlink(const char* op_fam, int operation, int family, unsigned metric, const void* prefix, uint8_t len)
+size_t route_netlink_fill(struct route_nlreq *nlreq, int operation, int family, unsigned metric, const void* prefix, uint8_t len, unsigned ifindex)
 {
-    struct {
-	struct nlmsghdr nlh;
-	struct rtmsg rtmsg;
-	struct {
-	    struct rtattr rta;
-	    unsigned ind;
-	} oif;
-	struct {
-	    struct rtattr rta;
-	    unsigned val;
-	} metric;
-	struct {
-	    struct rtattr rta;
-	    unsigned id;
-	} table;
-	struct {
-	    struct rtattr rta;
-	    unsigned char ipdata[16]; /* IPv6 MAX */
-	} prefix;
-    } nlreq;
-    int resp;
-    size_t txsz = sizeof(nlreq) - sizeof(nlreq.prefix);
-    char in6addr[INET6_ADDRSTRLEN];
+    size_t txsz = sizeof(*nlreq) - sizeof(nlreq->prefix);
 
-    memset(&nlreq, 0, sizeof(nlreq));
+    memset(nlreq, 0, sizeof(*nlreq));
 
-    nlreq.nlh.nlmsg_type = operation;
-    nlreq.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK | NLM_F_CREATE;
+    nlreq->nlh.nlmsg_type = operation;
+    nlreq->nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK | NLM_F_CREATE;
     if (operation == RTM_NEWROUTE)
-	nlreq.nlh.nlmsg_flags |= NLM_F_APPEND;
+	nlreq->nlh.nlmsg_flags |= NLM_F_APPEND;
 
-    nlreq.rtmsg.rtm_family = family;
-    nlreq.rtmsg.rtm_table = RT_TABLE_UNSPEC;
-    nlreq.rtmsg.rtm_protocol = RTPROT_BOOT;
-    nlreq.rtmsg.rtm_scope = RT_SCOPE_LINK;
-    nlreq.rtmsg.rtm_type = RTN_UNICAST;
+    nlreq->rtmsg.rtm_family = family;
+    nlreq->rtmsg.rtm_table = RT_TABLE_UNSPEC;
+    nlreq->rtmsg.rtm_protocol = RTPROT_BOOT;
+    nlreq->rtmsg.rtm_scope = RT_SCOPE_LINK;
+    nlreq->rtmsg.rtm_type = RTN_UNICAST;
 
-    nlreq.oif.rta.rta_len = sizeof(nlreq.oif);
-    nlreq.oif.rta.rta_type = RTA_OIF;
-    nlreq.oif.ind = if_nametoindex(ifname);
+    nlreq->oif.rta.rta_len = sizeof(nlreq->oif);
+    nlreq->oif.rta.rta_type = RTA_OIF;
+    nlreq->oif.ind = ifindex;
 
-    nlreq.metric.rta.rta_len = sizeof(nlreq.metric);
-    nlreq.metric.rta.rta_type = RTA_PRIORITY;
-    nlreq.metric.val = metric;
+    nlreq->metric.rta.rta_len = sizeof(nlreq->metric);
+    nlreq->metric.rta.rta_type = RTA_PRIORITY;
+    nlreq->metric.val = metric;
 
-    nlreq.table.rta.rta_len = sizeof(nlreq.table);
-    nlreq.table.rta.rta_type = RTA_TABLE;
-    nlreq.table.id = routing_table_id;
+    nlreq->table.rta.rta_len = sizeof(nlreq->table);
+    nlreq->table.rta.rta_type = RTA_TABLE;
+    nlreq->table.id = routing_table_id;
 
     if (prefix) {
 	char nbytes;
@@ -2299,15 +2411,30 @@ int _route_netlink(const char* op_fam, int operation, int family, unsigned metri
 	case AF_INET6: nbytes = 16; break;
 	default: error("Unable to add route given that address family isn't known and prefix was specified."); return 0;
 	}
-	nlreq.rtmsg.rtm_dst_len = len;
-	nlreq.prefix.rta.rta_type = RTA_DST;
-	nlreq.prefix.rta.rta_len = sizeof(nlreq.prefix.rta) + nbytes;
-	memcpy(nlreq.prefix.ipdata, prefix, nbytes);
+	nlreq->rtmsg.rtm_dst_len = len;
+	nlreq->prefix.rta.rta_type = RTA_DST;
+	nlreq->prefix.rta.rta_len = sizeof(nlreq->prefix.rta) + nbytes;
+	memcpy(nlreq->prefix.ipdata, prefix, nbytes);
 
-	txsz += nlreq.prefix.rta.rta_len;
+	txsz += nlreq->prefix.rta.rta_len;
     }
 
-    nlreq.nlh.nlmsg_len = txsz;
+    nlreq->nlh.nlmsg_len = txsz;
+    return txsz;
+}
+
+static
+int _route_netlink(const char* op_fam, int operation, int family, unsigned metric, const void* prefix, uint8_t len)
+{
+    struct route_nlreq nlreq;
+    int resp;
+    size_t txsz;
+    char in6addr[INET6_ADDRSTRLEN];
+
+    txsz = route_netlink_fill(&nlreq, operation, family, metric, prefix, len, if_nametoindex(ifname));
+    if (!txsz)
+	return 0;
+
     resp = rtnetlink_msg(op_fam, NULL, &nlreq, txsz, NULL, NULL, 0);
 
     /* In some cases the interface could be down already from kernel perspective,
@@ -2322,6 +2449,132 @@ int _route_netlink(const char* op_fam, int operation, int family, unsigned metri
 
     return 0;
 }
+
+/* Number of route requests sent to the kernel in a single sendmsg() */
+#define ROUTE_BATCH	64
+
+/*
+ * route_netlink_batch - send up to ROUTE_BATCH route requests in one
+ * netlink message and collect the individual acknowledgements.
+ */
+static
+int route_netlink_batch(int fd, int operation, int family, unsigned metric, struct ppp_route_req *routes, int count, unsigned ifindex)
+{
+    struct route_nlreq nlreq[ROUTE_BATCH];
+    struct iovec iov[ROUTE_BATCH];
+    struct sockaddr_nl nladdr;
+    struct msghdr msg;
+    union {
+	struct nlmsghdr nlh;
+	char bfr[4096];
+    } resp;
+    struct nlmsghdr *nlh;
+    char in6addr[INET6_ADDRSTRLEN];
+    int i, pending = 0, ok = 0;
+    ssize_t r;
+
+    for (i = 0; i < count; ++i) {
+	size_t txsz = route_netlink_fill(&nlreq[i], operation, family, metric,
+		routes[i].prefix, routes[i].len, ifindex);
+	nlreq[i].nlh.nlmsg_seq = i + 1;
+	iov[i].iov_base = &nlreq[i];
+	iov[i].iov_len = NLMSG_ALIGN(txsz);
+	if (!txsz)
+	    return 0;
+    }
+
+    memset(&nladdr, 0, sizeof(nladdr));
+    nladdr.nl_family = AF_NETLINK;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &nladdr;
+    msg.msg_namelen = sizeof(nladdr);
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
+
+    if (sendmsg(fd, &msg, 0) < 0) {
+	error("route_netlink_batch: sendmsg: %m");
+	return 0;
+    }
+
+    /* the kernel acknowledges each request in the batch in turn */
+    pending = count;
+    while (pending > 0) {
+	r = recv(fd, &resp, sizeof(resp), 0);
+	if (r < 0) {
+	    if (errno == EINTR)
+		continue;
+	    error("route_netlink_batch: recv: %m");
+	    break;
+	}
+	for (nlh = &resp.nlh; NLMSG_OK(nlh, r); nlh = NLMSG_NEXT(nlh, r)) {
+	    struct nlmsgerr *nlerr;
+	    int err;
+
+	    if (nlh->nlmsg_type != NLMSG_ERROR || nlh->nlmsg_seq < 1 || nlh->nlmsg_seq > count)
+		continue;
+	    --pending;
+
+	    nlerr = NLMSG_DATA(nlh);
+	    err = -nlerr->error;
+	    i = nlh->nlmsg_seq - 1;
+
+	    /* In some cases the interface could be down already from kernel perspective,
+	     * and routes already removed resulting in errno=ESRCH, treat as success */
+	    if (err == 0 || (operation == RTM_DELROUTE && err == ESRCH)) {
+		routes[i].result = 1;
+		++ok;
+	    } else {
+		error("Unable to %s %s %s/%d route: %s", operation == RTM_NEWROUTE ? "add" : "remove",
+			family == AF_INET ? "IPv4" : "IPv6",
+			inet_ntop(family, routes[i].prefix, in6addr, sizeof(in6addr)),
+			routes[i].len, strerror(err));
+	    }
+	}
+    }
+
+    return ok;
+}
+
+static
+int route_netlink_many(int operation, int family, unsigned metric, struct ppp_route_req *routes, int count)
+{
+    struct sockaddr_nl nladdr;
+    unsigned ifindex;
+    int fd, one, i, ok = 0;
+
+    if (count <= 0)
+	return 0;
+
+    for (i = 0; i < count; ++i)
+	routes[i].result = 0;
+
+    fd = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+    if (fd < 0) {
+	error("route_netlink_many: socket(NETLINK_ROUTE): %m");
+	return 0;
+    }
+
+    /* we only need the error code out of each acknowledgement */
+    one = 1;
+    setsockopt(fd, SOL_NETLINK, NETLINK_CAP_ACK, &one, sizeof(one));
+
+    memset(&nladdr, 0, sizeof(nladdr));
+    nladdr.nl_family = AF_NETLINK;
+    if (bind(fd, (struct sockaddr *)&nladdr, sizeof(nladdr)) < 0) {
+	error("route_netlink_many: bind(AF_NETLINK): %m");
+	close(fd);
+	return 0;
+    }
+
+    ifindex = if_nametoindex(ifname);
+    for (i = 0; i < count; i += ROUTE_BATCH)
+	ok += route_netlink_batch(fd, operation, family, metric, routes + i,
+		count - i < ROUTE_BATCH ? count - i : ROUTE_BATCH, ifindex);
+
+    close(fd);
+    return ok;
+}
 #define route_netlink(operation, family, metric, prefix, length) _route_netlink(#operation "/" #family, operation, family, metric, prefix, length)
 
 /********************************************************************
@@ -2346,12 +2599,40 @@ int sifdelroute(int family, const void* prefix, uint8_t len, unsigned metric)
     return route_netlink(RTM_DELROUTE, family, metric, prefix, len);
 }
 
+/********************************************************************
+ * sifaddroutes - add several non-default routes through the ppp interface,
+ * batching the netlink requests.  Sets the result field of each entry and
+ * returns the number of routes that were added.
+ */
+int sifaddroutes(int family, struct ppp_route_req *routes, int count, unsigned metric)
+{
+    return route_netlink_many(RTM_NEWROUTE, family, metric, routes, count);
+}
+
+/********************************************************************
+ * sifdelroutes - remove several non-default routes through the ppp interface,
+ * batching the netlink requests.  Sets the result field of each entry and
+ * returns the number of routes that were removed.
+ */
+int sifdelroutes(int family, struct ppp_route_req *routes, int count, unsigned metric)
+{
+    return route_netlink_many(RTM_DELROUTE, family, metric, routes, count);
+}
+
 /********************************************************************
  *
  * sifdefaultroute - assign a default route through the address given.
  */
 int sifdefaultroute (int unit, u_int32_t ouraddr, u_int32_t gateway)
 {
+    if (sys_ops_hook) {
+	if (sys_ops_hook->default_route
+	    && !(*sys_ops_hook->default_route)(AF_INET, 1))
+	    return 0;
+	have_default_route = 1;
+	return 1;
+    }
+
     /* try appending using netlink first */
     if (route_netlink(RTM_NEWROUTE, AF_INET, dfl_route_metric, NULL, 0))
 	return 1;
@@ -2388,6 +2669,12 @@ int sifdefaultroute (int unit, u_int32_t ouraddr, u_int32_t gateway)
 
 int cifdefaultroute (int unit, u_int32_t ouraddr, u_int32_t gateway)
 {
+    if (sys_ops_hook) {
+	have_default_route = 0;
+	return sys_ops_hook->default_route == NULL
+	    || (*sys_ops_hook->default_route)(AF_INET, 0);
+    }
+
     /* try removing using netlink first */
     if (route_netlink(RTM_DELROUTE, AF_INET, dfl_route_metric, NULL, 0))
 	return 1;
@@ -2429,6 +2716,14 @@ int cifdefaultroute (int unit, u_int32_t ouraddr, u_int32_t gateway)
 
 int sif6defaultroute (int unit, eui64_t ouraddr, eui64_t gateway)
 {
+    if (sys_ops_hook) {
+	if (sys_ops_hook->default_route
+	    && !(*sys_ops_hook->default_route)(AF_INET6, 1))
+	    return 0;
+	have_default_route6 = 1;
+	return 1;
+    }
+
     /* try appending using netlink first */
     if (route_netlink(RTM_NEWROUTE, AF_INET6, dfl_route6_metric, NULL, 0))
 	return 1;
@@ -2460,6 +2755,12 @@ int sif6defaultroute (int unit, eui64_t ouraddr, eui64_t gateway)
 
 int cif6defaultroute (int unit, eui64_t ouraddr, eui64_t gateway)
 {
+    if (sys_ops_hook) {
+	have_default_route6 = 0;
+	return sys_ops_hook->default_route == NULL
+	    || (*sys_ops_hook->default_route)(AF_INET6, 0);
+    }
+
     /* try removing using netlink first */
     if (route_netlink(RTM_DELROUTE, AF_INET6, dfl_route6_metric, NULL, 0))
 	return 1;
@@ -2498,6 +2799,17 @@ int sifproxyarp (int unit, u_int32_t his_adr)
     struct arpreq arpreq;
     char *forw_path;
 
+    if (sys_ops_hook) {
+	if (has_proxy_arp == 0) {
+	    if (sys_ops_hook->proxy_arp
+		&& !(*sys_ops_hook->proxy_arp)(his_adr, 1))
+		return 0;
+	    proxy_arp_addr = his_adr;
+	    has_proxy_arp = 1;
+	}
+	return 1;
+    }
+
     if (has_proxy_arp == 0) {
 	memset (&arpreq, '\0', sizeof(arpreq));
 
@@ -2548,6 +2860,15 @@ int cifproxyarp (int unit, u_int32_t his_adr)
 {
     struct arpreq arpreq;
 
+    if (sys_ops_hook) {
+	if (has_proxy_arp) {
+	    has_proxy_arp = 0;
+	    if (sys_ops_hook->proxy_arp)
+		return (*sys_ops_hook->proxy_arp)(his_adr, 0);
+	}
+	return 1;
+    }
+
     if (has_proxy_arp) {
 	has_proxy_arp = 0;
 	memset (&arpreq, '\0', sizeof(arpreq));
@@ -2871,6 +3192,10 @@ int ppp_check_kernel_support(void)
     sscanf(utsname.release, "%d.%d.%d", &osmaj, &osmin, &ospatch);
     kernel_version = KVERSION(osmaj, osmin, ospatch);
 
+    /* a plugin is standing in for the kernel driver */
+    if (sys_ops_hook)
+	return 1;
+
     fd = open("/dev/ppp", O_RDWR);
     if (fd >= 0) {
 	new_style_driver = 1;
@@ -3073,6 +3398,10 @@ int sifvjcomp (int u, int vjcomp, int cidcomp, int maxcid)
 {
 	u_int x;
 
+	if (sys_ops_hook)
+		return sys_ops_hook->set_vjcomp == NULL
+			|| (*sys_ops_hook->set_vjcomp)(vjcomp, cidcomp, maxcid);
+
 	if (vjcomp) {
 		if (ioctl(ppp_dev_fd, PPPIOCSMAXCID, (caddr_t) &maxcid) < 0) {
 			error("Couldn't set up TCP header compression: %m");
@@ -3162,6 +3491,10 @@ static int setifstate (int u, int state)
 {
     struct ifreq ifr;
 
+    if (sys_ops_hook)
+	return sys_ops_hook->set_ifstate == NULL
+	    || (*sys_ops_hook->set_ifstate)(state);
+
     memset (&ifr, '\0', sizeof (ifr));
     strlcpy(ifr.ifr_name, ifname, sizeof (ifr.ifr_name));
     if (ioctl(sock_fd, SIOCGIFFLAGS, (caddr_t) &ifr) < 0) {
@@ -3194,6 +3527,10 @@ int sifaddr (int unit, u_int32_t our_adr, u_int32_t his_adr,
     struct ifreq   ifr;
     struct rtentry rt;
 
+    if (sys_ops_hook)
+	return sys_ops_hook->set_addr == NULL
+	    || (*sys_ops_hook->set_addr)(our_adr, his_adr, net_mask);
+
     memset (&ifr, '\0', sizeof (ifr));
     memset (&rt,  '\0', sizeof (rt));
 
@@ -3295,6 +3632,10 @@ int cifaddr (int unit, u_int32_t our_adr, u_int32_t his_adr)
 {
     struct ifreq ifr;
 
+    if (sys_ops_hook)
+	return sys_ops_hook->clear_addr == NULL
+	    || (*sys_ops_hook->clear_addr)(our_adr, his_adr);
+
     if (kernel_version < KVERSION(2,1,16)) {
 /*
  *  Delete the route through the device
@@ -3412,6 +3753,10 @@ int sif6addr (int unit, eui64_t our_eui64, eui64_t his_eui64)
     struct in6_rtmsg rt6;
     int ret;
 
+    if (sys_ops_hook)
+	return sys_ops_hook->set_addr6 == NULL
+	    || (*sys_ops_hook->set_addr6)(our_eui64.e8, his_eui64.e8);
+
     if (sock6_fd < 0) {
 	errno = -sock6_fd;
 	error("IPv6 socket creation failed: %m");
@@ -3481,6 +3826,10 @@ int cif6addr (int unit, eui64_t our_eui64, eui64_t his_eui64)
     struct ifreq ifr;
     struct in6_ifreq ifr6;
 
+    if (sys_ops_hook)
+	return sys_ops_hook->clear_addr6 == NULL
+	    || (*sys_ops_hook->clear_addr6)(our_eui64.e8, his_eui64.e8);
+
     if (sock6_fd < 0) {
 	errno = -sock6_fd;
 	error("IPv6 socket creation failed: %m");
@@ -3653,6 +4002,10 @@ sifnpmode(int u, int proto, enum NPmode mode)
 {
     struct npioctl npi;
 
+    if (sys_ops_hook)
+	return sys_ops_hook->set_npmode == NULL
+	    || (*sys_ops_hook->set_npmode)(proto, mode);
+
     npi.protocol = proto;
     npi.mode     = mode;
     if (ioctl(ppp_dev_fd, PPPIOCSNPMODE, (caddr_t) &npi) < 0) {
@@ -3686,6 +4039,17 @@ get_host_seed(void)
 int
 sys_check_options(void)
 {
+    if (sys_ops_hook) {
+	if (demand) {
+	    ppp_option_error("demand dialling needs the kernel PPP driver");
+	    return 0;
+	}
+	if (multilink) {
+	    warn("Warning: multilink needs the kernel PPP driver");
+	    multilink = 0;
+	}
+	return 1;
+    }
     if (demand && driver_is_old) {
 	ppp_option_error("demand dialling is not supported by kernel driver "
 		     "version %d.%d.%d", driver_version, driver_modification,
@@ -1043,6 +1043,7 @@ output(int unit, u_char *p, int len)
 
     dump_packet("sent", p, len);
     if (snoop_send_hook) snoop_send_hook(p, len);
+    count_chan_frame(p, len, 1);
 
     data.len = len;
     data.buf = (caddr_t) p;
@@ -1293,6 +1294,7 @@ get_ppp_stats(int u, struct pppd_stats *stats)
 	error("Couldn't get link statistics: %m");
 	return 0;
     }
+    memset(stats, 0, sizeof(*stats));
     stats->bytes_in = s.p.ppp_ibytes;
     stats->bytes_out = s.p.ppp_obytes;
     stats->pkts_in = s.p.ppp_ipackets;
@@ -1688,6 +1690,28 @@ int sifdelroute(int family, const void* prefix, uint8_t len, unsigned metric)
     return 0;
 }
 
+/********************************************************************
+ * sifaddroutes - add several non-default routes through the ppp interface.
+ */
+int sifaddroutes(int family, struct ppp_route_req *routes, int count, unsigned metric)
+{
+    int i, ok = 0;
+    for (i = 0; i < count; ++i)
+	ok += routes[i].result = sifaddroute(family, routes[i].prefix, routes[i].len, metric);
+    return ok;
+}
+
+/********************************************************************
+ * sifdelroutes - remove several non-default routes through the ppp interface.
+ */
+int sifdelroutes(int family, struct ppp_route_req *routes, int count, unsigned metric)
+{
+    int i, ok = 0;
+    for (i = 0; i < count; ++i)
+	ok += routes[i].result = sifdelroute(family, routes[i].prefix, routes[i].len, metric);
+    return ok;
+}
+
 /*
  * sifdefaultroute - assign a default route through the address given.
  */
@@ -1095,6 +1095,55 @@ int tdb_delete(TDB_CONTEXT *tdb, TDB_DATA key)
 	return tdb_delete_hash(tdb, key, hash);
 }
 
+/* call fn on every live record, holding a read lock on its hash chain
+   meanwhile, so fn must not change the database.  a non-zero return
+   from fn ends the walk early.
+
+   return the number of records visited, or -1 on failure
+*/
+int tdb_traverse(TDB_CONTEXT *tdb, tdb_traverse_func fn, void *state)
+{
+	struct list_struct rec;
+	tdb_off rec_ptr;
+	TDB_DATA key, dbuf;
+	int count = 0;
+	u32 i;
+
+	for (i = 0; i < tdb->header.hash_size; i++) {
+		if (tdb_lock(tdb, i, F_RDLCK) == -1)
+			return -1;
+		if (ofs_read(tdb, TDB_HASH_TOP(i), &rec_ptr) == -1)
+			goto fail;
+		while (rec_ptr) {
+			if (rec_read(tdb, rec_ptr, &rec) == -1)
+				goto fail;
+			if (!TDB_DEAD(&rec)) {
+				key.dptr = tdb_alloc_read(tdb, rec_ptr + sizeof(rec),
+							  rec.key_len + rec.data_len);
+				if (!key.dptr)
+					goto fail;
+				key.dsize = rec.key_len;
+				dbuf.dptr = key.dptr + rec.key_len;
+				dbuf.dsize = rec.data_len;
+				count++;
+				if (fn && fn(tdb, key, dbuf, state)) {
+					SAFE_FREE(key.dptr);
+					tdb_unlock(tdb, i, F_RDLCK);
+					return count;
+				}
+				SAFE_FREE(key.dptr);
+			}
+			rec_ptr = rec.next;
+		}
+		tdb_unlock(tdb, i, F_RDLCK);
+	}
+	return count;
+
+fail:
+	tdb_unlock(tdb, i, F_RDLCK);
+	return -1;
+}
+
 /* store an element in the database, replacing any existing element
    with the same key 
 
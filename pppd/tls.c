@@ -282,6 +282,13 @@ void tls_free_verify_info(struct tls_info **in) {
     }
 }
 
+const char *tls_get_peer_name(SSL *ssl)
+{
+    struct tls_info *inf = SSL_get_ex_data(ssl, 0);
+
+    return inf? inf->peer_name: NULL;
+}
+
 const SSL_METHOD* tls_method() {
     return TLS_method();
 }
@@ -72,6 +72,11 @@ int tls_set_verify_info(SSL *ssl, const char *peer_name, const char *peer_cert_f
  */
 void tls_free_verify_info(struct tls_info **in);
 
+/**
+ * Get the peer name set with tls_set_verify_info
+ */
+const char *tls_get_peer_name(SSL *ssl);
+
 /**
  * Configure the SSL context's CRL details
  */
@@ -0,0 +1,895 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*
+ * pppmetrics - export the sessions of every pppd on this host in the
+ * Prometheus text format.
+ *
+ * Copyright (c) 2026 The pppd Project. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THE AUTHORS OF THIS SOFTWARE DISCLAIM ALL WARRANTIES WITH REGARD TO
+ * THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+ * AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Each pppd built with TDB support keeps an entry in pppd2.tdb holding
+ * its script environment (IFNAME, IFINDEX, PEERNAME, IPREMOTE and so
+ * on).  A scrape walks the database once, fetches the 64-bit counters
+ * of every interface with a single RTM_GETSTATS dump, and joins the two
+ * on the interface index.  The cost is a few system calls per session
+ * plus one dump, however many sessions there are, and the rendered page
+ * is reused by scrapes that arrive within the cache interval.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/if_link.h>
+
+#include "tdb.h"
+#include "pathnames.h"
+
+#define DEFAULT_PORT	9863
+#define MAX_CLIENTS	16
+#define CLIENT_TIMEOUT	10000	/* ms for a client to send its request */
+#define NL_BUFSIZE	65536
+
+static char *progname;
+static char *dbfile = PPP_PATH_PPPDB;
+static int cache_ms = 1000;
+
+/* Growable output buffer */
+struct buf {
+    char	*p;
+    size_t	len;
+    size_t	size;
+};
+
+/* One pppd, from its database entry; the strings point into data */
+struct session {
+    char	*data;
+    long	pid;
+    unsigned	ifindex;
+    long	start;
+    const char	*ifname;
+    const char	*peer;
+    const char	*iplocal;
+    const char	*ipremote;
+    const char	*bundle;
+    const char	*device;
+    const char	*linkname;
+};
+
+struct stats_ent {
+    unsigned	ifindex;
+    int		seen;		/* already reported for some session */
+    struct rtnl_link_stats64 s;
+};
+
+/* A rendered page, shared by the clients sending it */
+struct page {
+    int		refs;
+    struct timespec when;
+    struct buf	b;
+};
+
+struct client {
+    int		fd;
+    size_t	inlen;
+    char	in[1024];
+    char	hdr[256];
+    size_t	hdrlen;
+    size_t	off;		/* bytes of hdr + page sent so far */
+    struct page	*page;
+    long	deadline;
+};
+
+static struct session *sessions;
+static int nsessions, maxsessions;
+
+static struct stats_ent *stats;
+static int nstats, maxstats;
+static int *stats_hash;
+static unsigned stats_hmask;
+
+static TDB_CONTEXT *pppdb;
+static int nlfd = -1;
+static unsigned nlseq;
+
+static struct page *cached;
+static struct client clients[MAX_CLIENTS];
+
+static void
+fatal(const char *fmt, ...)
+{
+    va_list ap;
+
+    fprintf(stderr, "%s: ", progname);
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fputc('\n', stderr);
+    exit(1);
+}
+
+/*
+ * tdb.c calls this from pppd when it creates the database; we only
+ * ever open it read-only.
+ */
+int
+mkdir_recursive(const char *path)
+{
+    errno = EROFS;
+    return -1;
+}
+
+static void *
+xrealloc(void *p, size_t n)
+{
+    p = realloc(p, n);
+    if (p == NULL)
+	fatal("out of memory");
+    return p;
+}
+
+static long
+now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000;
+}
+
+static void
+bprintf(struct buf *b, const char *fmt, ...)
+{
+    va_list ap;
+    int n;
+
+    for (;;) {
+	va_start(ap, fmt);
+	n = vsnprintf(b->p + b->len, b->size - b->len, fmt, ap);
+	va_end(ap);
+	if (n < 0)
+	    return;
+	if ((size_t) n < b->size - b->len)
+	    break;
+	b->size = (b->size + n + 1) * 2;
+	b->p = xrealloc(b->p, b->size);
+    }
+    b->len += n;
+}
+
+static void
+bput(struct buf *b, const char *p, size_t n)
+{
+    if (b->len + n >= b->size) {
+	b->size = (b->size + n + 1) * 2;
+	b->p = xrealloc(b->p, b->size);
+    }
+    memcpy(b->p + b->len, p, n);
+    b->len += n;
+    b->p[b->len] = 0;
+}
+
+/*
+ * bputlabel - add name="value" to a label set, escaping the value
+ * as the exposition format requires.  Null values are left out.
+ */
+static void
+bputlabel(struct buf *b, const char *name, const char *val, int *first)
+{
+    size_t n;
+
+    if (val == NULL)
+	return;
+    if (!*first)
+	bput(b, ",", 1);
+    *first = 0;
+    bput(b, name, strlen(name));
+    bput(b, "=\"", 2);
+    for (;;) {
+	n = strcspn(val, "\\\"\n");
+	bput(b, val, n);
+	val += n;
+	if (*val == 0)
+	    break;
+	bput(b, *val == '\n'? "\\n": *val == '"'? "\\\"": "\\\\", 2);
+	++val;
+    }
+    bput(b, "\"", 1);
+}
+
+/*
+ * parse_entry - split up a "VAR=value;VAR=value;..." database entry.
+ * A ';' only ends a value when a VAR= follows it, so that values
+ * containing ';' (peer names, say) survive.
+ */
+static void
+parse_entry(struct session *s)
+{
+    char *p, *q, *val, *end;
+
+    for (p = s->data; *p; p = end) {
+	val = strchr(p, '=');
+	if (val == NULL)
+	    break;
+	*val++ = 0;
+	for (end = val; (end = strchr(end, ';')) != NULL; ++end) {
+	    for (q = end + 1; isupper((unsigned char) *q) || isdigit((unsigned char) *q)
+		     || *q == '_'; ++q)
+		;
+	    if (*q == '=' || *q == 0)
+		break;
+	}
+	if (end == NULL)
+	    end = val + strlen(val);
+	else
+	    *end++ = 0;
+
+	if (strcmp(p, "IFNAME") == 0)
+	    s->ifname = val;
+	else if (strcmp(p, "IFINDEX") == 0)
+	    s->ifindex = strtoul(val, NULL, 10);
+	else if (strcmp(p, "PEERNAME") == 0)
+	    s->peer = val;
+	else if (strcmp(p, "IPLOCAL") == 0)
+	    s->iplocal = val;
+	else if (strcmp(p, "IPREMOTE") == 0)
+	    s->ipremote = val;
+	else if (strcmp(p, "BUNDLE") == 0)
+	    s->bundle = val;
+	else if (strcmp(p, "DEVICE") == 0)
+	    s->device = val;
+	else if (strcmp(p, "LINKNAME") == 0)
+	    s->linkname = val;
+	else if (strcmp(p, "CONNECT_START") == 0)
+	    s->start = strtol(val, NULL, 10);
+    }
+}
+
+/*
+ * get_session - database traversal callback.  Entries of pppds are
+ * keyed "pppd<pid>"; the other keys point at these.
+ */
+static int
+get_session(TDB_CONTEXT *tdb, TDB_DATA key, TDB_DATA dbuf, void *arg)
+{
+    struct session *s;
+    long pid = 0;
+    size_t i;
+
+    if (key.dsize < 5 || key.dsize > 14 || memcmp(key.dptr, "pppd", 4) != 0)
+	return 0;
+    for (i = 4; i < key.dsize; ++i) {
+	if (!isdigit((unsigned char) key.dptr[i]))
+	    return 0;
+	pid = pid * 10 + key.dptr[i] - '0';
+    }
+
+    if (nsessions >= maxsessions) {
+	maxsessions = maxsessions? maxsessions * 2: 256;
+	sessions = xrealloc(sessions, maxsessions * sizeof(*sessions));
+    }
+    s = &sessions[nsessions++];
+    memset(s, 0, sizeof(*s));
+    s->pid = pid;
+    s->data = xrealloc(NULL, dbuf.dsize + 1);
+    memcpy(s->data, dbuf.dptr, dbuf.dsize);
+    s->data[dbuf.dsize] = 0;
+    parse_entry(s);
+    return 0;
+}
+
+static void
+free_sessions(void)
+{
+    int i;
+
+    for (i = 0; i < nsessions; ++i)
+	free(sessions[i].data);
+    nsessions = 0;
+}
+
+/*
+ * read_sessions - walk the pppd database.  It may not exist yet if no
+ * pppd has run since boot, which just means there are no sessions.
+ */
+static int
+read_sessions(void)
+{
+    if (pppdb == NULL) {
+	pppdb = tdb_open(dbfile, 0, 0, O_RDONLY, 0);
+	if (pppdb == NULL)
+	    return errno == ENOENT? 0: -1;
+    }
+    if (tdb_traverse(pppdb, get_session, NULL) < 0) {
+	/* perhaps the file was replaced; try again next time */
+	tdb_close(pppdb);
+	pppdb = NULL;
+	return -1;
+    }
+    return 0;
+}
+
+static struct stats_ent *
+find_stats(unsigned ifindex)
+{
+    unsigned h;
+    int i;
+
+    if (stats_hash == NULL)
+	return NULL;
+    for (h = ifindex & stats_hmask; (i = stats_hash[h]) >= 0;
+	 h = (h + 1) & stats_hmask)
+	if (stats[i].ifindex == ifindex)
+	    return &stats[i];
+    return NULL;
+}
+
+static void
+hash_stats(void)
+{
+    unsigned size, h;
+    int i;
+
+    for (size = 64; size < 2 * (unsigned) nstats; size <<= 1)
+	;
+    if (size - 1 != stats_hmask || stats_hash == NULL) {
+	stats_hash = xrealloc(stats_hash, size * sizeof(int));
+	stats_hmask = size - 1;
+    }
+    memset(stats_hash, 0xff, size * sizeof(int));
+    for (i = 0; i < nstats; ++i) {
+	for (h = stats[i].ifindex & stats_hmask; stats_hash[h] >= 0;
+	     h = (h + 1) & stats_hmask)
+	    ;
+	stats_hash[h] = i;
+    }
+}
+
+/*
+ * read_stats - get the counters of every interface with one
+ * RTM_GETSTATS dump, asking only for the 64-bit link statistics.
+ */
+static int
+read_stats(void)
+{
+    static char buf[NL_BUFSIZE];
+    struct {
+	struct nlmsghdr nlh;
+	struct if_stats_msg ifsm;
+    } req;
+    struct sockaddr_nl sa;
+    struct nlmsghdr *nlh;
+    struct if_stats_msg *ifsm;
+    struct rtattr *rta;
+    int n, len, done;
+
+    nstats = 0;
+    if (nlfd < 0) {
+	nlfd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+	if (nlfd < 0)
+	    return -1;
+    }
+
+    memset(&req, 0, sizeof(req));
+    req.nlh.nlmsg_len = sizeof(req);
+    req.nlh.nlmsg_type = RTM_GETSTATS;
+    req.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.nlh.nlmsg_seq = ++nlseq;
+    req.ifsm.family = AF_UNSPEC;
+    req.ifsm.filter_mask = IFLA_STATS_FILTER_BIT(IFLA_STATS_LINK_64);
+    memset(&sa, 0, sizeof(sa));
+    sa.nl_family = AF_NETLINK;
+    if (sendto(nlfd, &req, sizeof(req), 0, (struct sockaddr *) &sa,
+	       sizeof(sa)) < 0)
+	return -1;
+
+    for (done = 0; !done; ) {
+	n = recv(nlfd, buf, sizeof(buf), 0);
+	if (n < 0) {
+	    if (errno == EINTR)
+		continue;
+	    return -1;
+	}
+	for (nlh = (struct nlmsghdr *) buf; NLMSG_OK(nlh, n);
+	     nlh = NLMSG_NEXT(nlh, n)) {
+	    if (nlh->nlmsg_seq != nlseq)
+		continue;
+	    if (nlh->nlmsg_type == NLMSG_DONE) {
+		done = 1;
+		break;
+	    }
+	    if (nlh->nlmsg_type == NLMSG_ERROR) {
+		struct nlmsgerr *err = NLMSG_DATA(nlh);
+		errno = -err->error;
+		return -1;
+	    }
+	    if (nlh->nlmsg_type != RTM_NEWSTATS)
+		continue;
+	    ifsm = NLMSG_DATA(nlh);
+	    len = nlh->nlmsg_len - NLMSG_LENGTH(sizeof(*ifsm));
+	    rta = (struct rtattr *) ((char *) ifsm
+				     + NLMSG_ALIGN(sizeof(*ifsm)));
+	    for (; RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+		if (rta->rta_type != IFLA_STATS_LINK_64)
+		    continue;
+		if (nstats >= maxstats) {
+		    maxstats = maxstats? maxstats * 2: 256;
+		    stats = xrealloc(stats, maxstats * sizeof(*stats));
+		}
+		memset(&stats[nstats], 0, sizeof(stats[nstats]));
+		stats[nstats].ifindex = ifsm->ifindex;
+		memcpy(&stats[nstats].s, RTA_DATA(rta),
+		       RTA_PAYLOAD(rta) < sizeof(stats[nstats].s)?
+		       RTA_PAYLOAD(rta): sizeof(stats[nstats].s));
+		++nstats;
+	    }
+	}
+    }
+    hash_stats();
+    return 0;
+}
+
+/*
+ * session_live - an entry whose interface has gone was probably left
+ * by a pppd that died without cleaning up.  Entries of pppds that are
+ * still negotiating have no interface yet; check that those processes
+ * exist.
+ */
+static int
+session_live(struct session *s)
+{
+    if (s->ifindex == 0 && s->ifname != NULL)
+	s->ifindex = if_nametoindex(s->ifname);	/* older pppd */
+    if (s->ifindex != 0)
+	return find_stats(s->ifindex) != NULL;
+    return kill(s->pid, 0) == 0 || errno == EPERM;
+}
+
+static const struct counter {
+    const char	*name;
+    const char	*help;
+    size_t	off;
+} counters[] = {
+    { "ppp_receive_bytes_total", "Bytes received on the interface",
+      offsetof(struct rtnl_link_stats64, rx_bytes) },
+    { "ppp_receive_packets_total", "Packets received on the interface",
+      offsetof(struct rtnl_link_stats64, rx_packets) },
+    { "ppp_receive_errors_total", "Receive errors on the interface",
+      offsetof(struct rtnl_link_stats64, rx_errors) },
+    { "ppp_receive_dropped_total", "Received packets dropped",
+      offsetof(struct rtnl_link_stats64, rx_dropped) },
+    { "ppp_transmit_bytes_total", "Bytes sent on the interface",
+      offsetof(struct rtnl_link_stats64, tx_bytes) },
+    { "ppp_transmit_packets_total", "Packets sent on the interface",
+      offsetof(struct rtnl_link_stats64, tx_packets) },
+    { "ppp_transmit_errors_total", "Transmit errors on the interface",
+      offsetof(struct rtnl_link_stats64, tx_errors) },
+    { "ppp_transmit_dropped_total", "Packets dropped on transmit",
+      offsetof(struct rtnl_link_stats64, tx_dropped) },
+};
+
+static void
+render(struct buf *b)
+{
+    struct timespec t0, t1;
+    struct stats_ent *st;
+    struct session *s;
+    int i, live, first, db_ok, nl_ok;
+    unsigned j;
+    char pidbuf[24];
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    free_sessions();
+    db_ok = read_sessions() == 0;
+    nl_ok = read_stats() == 0;
+
+    /* drop stale entries */
+    for (i = live = 0; i < nsessions; ++i) {
+	if (session_live(&sessions[i]))
+	    sessions[live++] = sessions[i];
+	else
+	    free(sessions[i].data);
+    }
+    nsessions = live;
+
+    bprintf(b, "# HELP ppp_sessions Number of pppd processes running.\n"
+	    "# TYPE ppp_sessions gauge\nppp_sessions %d\n", nsessions);
+
+    bprintf(b, "# HELP ppp_session_info Details of each pppd.\n"
+	    "# TYPE ppp_session_info gauge\n");
+    for (i = 0; i < nsessions; ++i) {
+	s = &sessions[i];
+	snprintf(pidbuf, sizeof(pidbuf), "%ld", s->pid);
+	bprintf(b, "ppp_session_info{");
+	first = 1;
+	bputlabel(b, "pid", pidbuf, &first);
+	bputlabel(b, "ifname", s->ifname, &first);
+	bputlabel(b, "peer", s->peer, &first);
+	bputlabel(b, "ip_local", s->iplocal, &first);
+	bputlabel(b, "ip_remote", s->ipremote, &first);
+	bputlabel(b, "bundle", s->bundle, &first);
+	bputlabel(b, "device", s->device, &first);
+	bputlabel(b, "linkname", s->linkname, &first);
+	bprintf(b, "} 1\n");
+    }
+
+    bprintf(b, "# HELP ppp_session_start_time_seconds When IPCP came up.\n"
+	    "# TYPE ppp_session_start_time_seconds gauge\n");
+    for (i = 0; i < nsessions; ++i) {
+	s = &sessions[i];
+	if (s->start == 0 || s->ifname == NULL)
+	    continue;
+	first = 1;
+	bprintf(b, "ppp_session_start_time_seconds{");
+	snprintf(pidbuf, sizeof(pidbuf), "%ld", s->pid);
+	bputlabel(b, "pid", pidbuf, &first);
+	bputlabel(b, "ifname", s->ifname, &first);
+	bprintf(b, "} %ld\n", s->start);
+    }
+
+    /*
+     * The links of a multilink bundle share one interface; report its
+     * counters once.
+     */
+    for (j = 0; j < sizeof(counters) / sizeof(counters[0]); ++j) {
+	bprintf(b, "# HELP %s %s.\n# TYPE %s counter\n",
+		counters[j].name, counters[j].help, counters[j].name);
+	for (i = 0; i < nstats; ++i)
+	    stats[i].seen = 0;
+	for (i = 0; i < nsessions; ++i) {
+	    s = &sessions[i];
+	    if (s->ifindex == 0 || s->ifname == NULL
+		|| (st = find_stats(s->ifindex)) == NULL || st->seen)
+		continue;
+	    st->seen = 1;
+	    first = 1;
+	    bprintf(b, "%s{", counters[j].name);
+	    bputlabel(b, "ifname", s->ifname, &first);
+	    bprintf(b, "} %llu\n", (unsigned long long)
+		    *(uint64_t *) ((char *) &st->s + counters[j].off));
+	}
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    bprintf(b, "# HELP pppmetrics_up Whether the pppd database and the "
+	    "interface counters could be read.\n"
+	    "# TYPE pppmetrics_up gauge\n"
+	    "pppmetrics_up{source=\"tdb\"} %d\n"
+	    "pppmetrics_up{source=\"netlink\"} %d\n", db_ok, nl_ok);
+    bprintf(b, "# HELP pppmetrics_scrape_duration_seconds Time taken to "
+	    "gather the metrics.\n"
+	    "# TYPE pppmetrics_scrape_duration_seconds gauge\n"
+	    "pppmetrics_scrape_duration_seconds %.6f\n",
+	    (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9);
+}
+
+static void
+put_page(struct page *pg)
+{
+    if (pg != NULL && --pg->refs == 0) {
+	free(pg->b.p);
+	free(pg);
+    }
+}
+
+/*
+ * get_page - return the current page, rendering a new one if the
+ * cached one is older than the cache interval.
+ */
+static struct page *
+get_page(void)
+{
+    struct timespec ts;
+    long age;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    if (cached != NULL) {
+	age = (ts.tv_sec - cached->when.tv_sec) * 1000L
+	    + (ts.tv_nsec - cached->when.tv_nsec) / 1000000;
+	if (age < cache_ms) {
+	    ++cached->refs;
+	    return cached;
+	}
+	put_page(cached);
+    }
+    cached = xrealloc(NULL, sizeof(*cached));
+    memset(cached, 0, sizeof(*cached));
+    cached->refs = 1;
+    cached->when = ts;
+    render(&cached->b);
+    ++cached->refs;
+    return cached;
+}
+
+static int
+open_listener(const char *addr)
+{
+    struct sockaddr_in sin;
+    struct sockaddr_un sun;
+    char host[64], *p;
+    int fd, one = 1;
+    mode_t mask;
+
+    if (addr[0] == '/') {
+	memset(&sun, 0, sizeof(sun));
+	sun.sun_family = AF_UNIX;
+	if (strlen(addr) >= sizeof(sun.sun_path))
+	    fatal("socket path %s too long", addr);
+	strcpy(sun.sun_path, addr);
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+	    fatal("socket: %s", strerror(errno));
+	unlink(addr);
+	mask = umask(0117);
+	if (bind(fd, (struct sockaddr *) &sun, sizeof(sun)) < 0)
+	    fatal("can't bind %s: %s", addr, strerror(errno));
+	umask(mask);
+    } else {
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	sin.sin_port = htons(DEFAULT_PORT);
+	snprintf(host, sizeof(host), "%s", addr);
+	p = strrchr(host, ':');
+	if (p != NULL) {
+	    *p++ = 0;
+	    sin.sin_port = htons(atoi(p));
+	}
+	if (host[0] != 0 && inet_pton(AF_INET, host, &sin.sin_addr) != 1)
+	    fatal("bad address %s", addr);
+	fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+	    fatal("socket: %s", strerror(errno));
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if (bind(fd, (struct sockaddr *) &sin, sizeof(sin)) < 0)
+	    fatal("can't bind %s: %s", addr, strerror(errno));
+    }
+    if (listen(fd, 64) < 0)
+	fatal("listen: %s", strerror(errno));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+static void
+drop_client(struct client *c)
+{
+    close(c->fd);
+    put_page(c->page);
+    memset(c, 0, sizeof(*c));
+    c->fd = -1;
+}
+
+/*
+ * got_request - answer a complete request header.  Anything other
+ * than GET or HEAD of / or /metrics gets an error.
+ */
+static void
+got_request(struct client *c)
+{
+    char *path, *end;
+    int head;
+
+    c->in[c->inlen] = 0;
+    head = strncmp(c->in, "HEAD ", 5) == 0;
+    if (!head && strncmp(c->in, "GET ", 4) != 0) {
+	c->hdrlen = snprintf(c->hdr, sizeof(c->hdr),
+			     "HTTP/1.0 405 Method Not Allowed\r\n"
+			     "Allow: GET, HEAD\r\nContent-Length: 0\r\n"
+			     "Connection: close\r\n\r\n");
+	return;
+    }
+    path = c->in + (head? 5: 4);
+    end = path + strcspn(path, " ?\r\n");
+    *end = 0;
+    if (strcmp(path, "/") != 0 && strcmp(path, "/metrics") != 0) {
+	c->hdrlen = snprintf(c->hdr, sizeof(c->hdr),
+			     "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\n"
+			     "Connection: close\r\n\r\n");
+	return;
+    }
+    c->page = get_page();
+    c->hdrlen = snprintf(c->hdr, sizeof(c->hdr),
+			 "HTTP/1.0 200 OK\r\n"
+			 "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+			 "Content-Length: %zu\r\nConnection: close\r\n\r\n",
+			 c->page->b.len);
+    if (head) {
+	put_page(c->page);
+	c->page = NULL;
+    }
+}
+
+static void
+client_input(struct client *c)
+{
+    int n;
+
+    n = read(c->fd, c->in + c->inlen, sizeof(c->in) - 1 - c->inlen);
+    if (n < 0 && (errno == EAGAIN || errno == EINTR))
+	return;
+    if (n <= 0) {
+	drop_client(c);
+	return;
+    }
+    c->inlen += n;
+    c->in[c->inlen] = 0;
+    if (strstr(c->in, "\r\n\r\n") != NULL || strstr(c->in, "\n\n") != NULL)
+	got_request(c);
+    else if (c->inlen >= sizeof(c->in) - 1)
+	drop_client(c);
+}
+
+static void
+client_output(struct client *c)
+{
+    size_t total;
+    ssize_t n;
+
+    total = c->hdrlen + (c->page? c->page->b.len: 0);
+    while (c->off < total) {
+	if (c->off < c->hdrlen)
+	    n = write(c->fd, c->hdr + c->off, c->hdrlen - c->off);
+	else
+	    n = write(c->fd, c->page->b.p + (c->off - c->hdrlen),
+		      total - c->off);
+	if (n < 0) {
+	    if (errno == EAGAIN || errno == EINTR)
+		return;
+	    break;
+	}
+	c->off += n;
+    }
+    drop_client(c);
+}
+
+static void
+serve(int lfd)
+{
+    struct pollfd pfd[MAX_CLIENTS + 1];
+    struct client *c;
+    int i, n, fd;
+    long now;
+
+    for (i = 0; i < MAX_CLIENTS; ++i)
+	clients[i].fd = -1;
+
+    for (;;) {
+	pfd[0].fd = lfd;
+	pfd[0].events = POLLIN;
+	for (i = 0; i < MAX_CLIENTS; ++i) {
+	    c = &clients[i];
+	    pfd[i+1].fd = c->fd;
+	    pfd[i+1].events = c->hdrlen? POLLOUT: POLLIN;
+	    pfd[i+1].revents = 0;
+	}
+	n = poll(pfd, MAX_CLIENTS + 1, 1000);
+	if (n < 0) {
+	    if (errno == EINTR)
+		continue;
+	    fatal("poll: %s", strerror(errno));
+	}
+	now = now_ms();
+	for (i = 0; i < MAX_CLIENTS; ++i) {
+	    c = &clients[i];
+	    if (c->fd < 0)
+		continue;
+	    if (pfd[i+1].revents & (POLLERR | POLLNVAL))
+		drop_client(c);
+	    else if (pfd[i+1].revents & POLLOUT)
+		client_output(c);
+	    else if (pfd[i+1].revents & (POLLIN | POLLHUP))
+		client_input(c);
+	    else if (now > c->deadline)
+		drop_client(c);
+	}
+	if (pfd[0].revents & POLLIN) {
+	    while ((fd = accept(lfd, NULL, NULL)) >= 0) {
+		for (i = 0; i < MAX_CLIENTS; ++i)
+		    if (clients[i].fd < 0)
+			break;
+		if (i == MAX_CLIENTS) {
+		    close(fd);
+		    continue;
+		}
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+		c = &clients[i];
+		c->fd = fd;
+		c->deadline = now + CLIENT_TIMEOUT;
+	    }
+	}
+    }
+}
+
+static void
+usage(void)
+{
+    fprintf(stderr, "Usage: %s [-1] [-c cache-ms] [-f database] "
+	    "[-l [address]:port | -l /socket/path]\n", progname);
+    exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+    struct buf b;
+    char *listen_addr = NULL;
+    int c, once = 0;
+
+    progname = strrchr(argv[0], '/');
+    progname = progname? progname + 1: argv[0];
+
+    while ((c = getopt(argc, argv, "1c:f:l:")) != -1) {
+	switch (c) {
+	case '1':
+	    once = 1;
+	    break;
+	case 'c':
+	    cache_ms = atoi(optarg);
+	    break;
+	case 'f':
+	    dbfile = optarg;
+	    break;
+	case 'l':
+	    listen_addr = optarg;
+	    break;
+	default:
+	    usage();
+	}
+    }
+    if (optind != argc)
+	usage();
+
+    if (once) {
+	memset(&b, 0, sizeof(b));
+	render(&b);
+	fwrite(b.p, 1, b.len, stdout);
+	return ferror(stdout) || fflush(stdout)? 1: 0;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    serve(open_listener(listen_addr? listen_addr: ""));
+    return 0;
+}